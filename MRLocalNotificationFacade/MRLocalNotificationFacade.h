@@ -22,6 +22,8 @@
 
 #import <UIKit/UIKit.h>
 
+@class CLLocation;
+
 NS_ASSUME_NONNULL_BEGIN
 
 /**
@@ -34,6 +36,97 @@ extern NSString *const MRLocalNotificationErrorDomain;
  */
 extern NSString *const MRRecoveryURLErrorKey;
 
+/**
+ The corresponding value in a notification's `userInfo` is the string that identifies the notification.
+ 
+ Notifications that contain an identifier are tracked by the facade in an in-process index.
+ */
+extern NSString *const MRLocalNotificationIdentifierKey;
+
+/**
+ Key of the `userInfo` dictionary of a notification whose value references the payload kept by the payload store (see `payloadStoreDirectoryURL`).
+ */
+extern NSString *const MRLocalNotificationPayloadKey;
+
+/**
+ Key of the `applyDesiredNotifications:` result whose value is an array with the identifiers of the notifications that have been scheduled.
+ */
+extern NSString *const MRLocalNotificationInsertedIdentifiersKey;
+
+/**
+ Key of the `applyDesiredNotifications:` result whose value is an array with the identifiers of the notifications that have been cancelled and scheduled again with new values.
+ */
+extern NSString *const MRLocalNotificationUpdatedIdentifiersKey;
+
+/**
+ Key of the `applyDesiredNotifications:` result whose value is an array with the identifiers of the notifications that have been cancelled.
+ */
+extern NSString *const MRLocalNotificationDeletedIdentifiersKey;
+
+/**
+ Key of the `applyDesiredNotifications:` result whose value is an array with the identifiers of the notifications that were already scheduled.
+ */
+extern NSString *const MRLocalNotificationUnchangedIdentifiersKey;
+
+/**
+ Key of the `applyDesiredNotifications:` result whose value is a dictionary with the `NSError` objects describing the problems detected, keyed by notification identifier.
+ */
+extern NSString *const MRLocalNotificationErrorsByIdentifierKey;
+
+/**
+ Key of the `metricsSnapshot` dictionary whose value is a dictionary with the number of calls to each `defaultApplication` method, keyed by selector name.
+ */
+extern NSString *const MRLocalNotificationMetricsApplicationCallsKey;
+
+/**
+ Key of the `metricsSnapshot` dictionary whose value is a dictionary with the latencies of each operation (`schedule`, `cancel`, `validate` and the `handle` entry points).
+ 
+ The latencies of each operation are described by a dictionary with the number of calls (`count`), the accumulated time (`nanoseconds`) and a log2 histogram (`histogram`) where the element at index `i` counts the calls that took between 2^i and 2^(i+1) nanoseconds.
+ */
+extern NSString *const MRLocalNotificationMetricsLatenciesKey;
+
+/**
+ Key of the `metricsSnapshot` dictionary whose value is a dictionary with the number of validation errors detected, keyed by `MRLocalNotificationErrorCode`.
+ */
+extern NSString *const MRLocalNotificationMetricsErrorsKey;
+
+/**
+ Key of the `metricsSnapshot` dictionary whose value is a dictionary with the nanoseconds spent in `init` and in the first resolution of each lazily initialized state (`defaultApplication`, `defaultTimeZone`, `defaultCalendar`, `hasRegisteredNotifications` and `settings`).
+ 
+ Startup costs are recorded even while `instrumentationEnabled` is `NO`.
+ */
+extern NSString *const MRLocalNotificationMetricsStartupKey;
+
+/**
+ Key of the `runUntilDate:` report whose value is the number of workload events that have been run.
+ */
+extern NSString *const MRLocalNotificationSimulationEventsKey;
+
+/**
+ Key of the `runUntilDate:` report whose value is the number of notifications delivered to `handleDidReceiveLocalNotification:`.
+ */
+extern NSString *const MRLocalNotificationSimulationDeliveredKey;
+
+/**
+ Key of the `runUntilDate:` report whose value is the number of notifications discarded by the simulated application because of the pending notifications limit.
+ */
+extern NSString *const MRLocalNotificationSimulationDroppedKey;
+
+/**
+ Key of the `runUntilDate:` report whose value is a dictionary with the accumulated (`total`) and the maximum (`maximum`) seconds elapsed between the intended and the actual fire time of the delivered notifications.
+ */
+extern NSString *const MRLocalNotificationSimulationLatencyKey;
+
+/**
+ Key of the `runUntilDate:` report whose value is the number of nanoseconds spent inside the facade (workload events and deliveries), excluding the simulated application.
+ */
+extern NSString *const MRLocalNotificationSimulationFacadeTimeKey;
+
+/**
+ Key of the `runUntilDate:` report whose value is the number of nanoseconds of CPU time used by the simulation thread.
+ */
+extern NSString *const MRLocalNotificationSimulationCPUTimeKey;
+
 /**
  Error codes within the `MRLocalNotificationErrorDomain`.
  */
@@ -65,6 +158,75 @@ typedef enum {
 } MRLocalNotificationErrorCode;
 
 
+/**
+ `MRLocalNotificationTemplate` holds the shared values of a family of notifications, validated once when the template is built with `buildTemplateWithNotification:badgeIncrement:error:`.
+ */
+@interface MRLocalNotificationTemplate : NSObject
+
+/**
+ The notification copied for creating each notification; its `fireDate` is `nil` and its `userInfo` has no `MRLocalNotificationIdentifierKey`.
+ */
+@property (nonatomic, readonly) UILocalNotification *prototype;
+
+/**
+ The amount added to the prototype's `applicationIconBadgeNumber` for each notification created after the first one.
+ */
+@property (nonatomic, readonly) NSInteger badgeIncrement;
+
+@end
+
+
+/**
+ `MRLocalNotificationCoalescer` groups items that arrive in bursts.
+ 
+ The first item added opens a window of `window` seconds. The items added until the window closes are grouped by category, in order of first arrival, and passed to the batch handler at once. The class depends only on Foundation and is not thread-safe; use it from a single queue.
+ */
+@interface MRLocalNotificationCoalescer : NSObject
+
+/**
+ Initializes a coalescer.
+ 
+ @param window Seconds between the first item of a burst and the invocation of `batchHandler`.
+ @param batchHandler Block invoked when a window closes with an array of batches; each batch is an array with the items added with the same category.
+ @return An initialized coalescer.
+ */
+- (instancetype)initWithWindow:(NSTimeInterval)window
+                  batchHandler:(void(^)(NSArray *batches))batchHandler;
+
+/**
+ Seconds between the first item of a burst and the invocation of the batch handler.
+ */
+@property (nonatomic, readonly) NSTimeInterval window;
+
+/**
+ Block used for running `block` after `delay` seconds when a window opens.
+ 
+ Default value runs the block on the main queue with `dispatch_after`. Replace it for driving the receiver without a run loop, for example from unit tests.
+ */
+@property (nonatomic, copy) void(^scheduler)(NSTimeInterval delay, dispatch_block_t block);
+
+/**
+ Number of items added since the current window opened.
+ */
+@property (nonatomic, readonly) NSUInteger pendingCount;
+
+/**
+ Adds an item to the current window, opening a new window if needed.
+ 
+ @param item The item.
+ @param category The category used for grouping the item, or `nil`.
+ */
+- (void)addItem:(id)item
+       category:(nullable NSString *)category;
+
+/**
+ Closes the current window, passing the pending items to the batch handler immediately.
+ */
+- (void)flush;
+
+@end
+
+
 /**
 `MRLocalNotificationFacade` wraps most of the APIs related with local notifications.
  */
@@ -84,6 +246,60 @@ typedef enum {
  */
 @property (nullable, nonatomic, strong) NSString *defaultSoundName;
 
+/**
+ Maximum number of notifications that the receiver keeps scheduled in the `defaultApplication`.
+ 
+ If it is greater than zero, notifications scheduled beyond this limit are kept in a queue ordered by fire date, and only the earliest ones are handed to the system. The queue is used for refilling the free slots when notifications are cancelled or delivered and when the application enters the foreground. Queued notifications are kept in memory only.
+ 
+ Default value is `0` (no limit). The system keeps only the soonest-firing 64 notifications.
+ */
+@property (nonatomic, assign) NSUInteger maximumScheduledNotifications;
+
+/**
+ Block that returns the current time as an interval since the reference date.
+ 
+ The receiver uses it whenever it compares fire dates with the current time. `MRLocalNotificationSimulator` sets it for running the receiver on a virtual clock.
+ 
+ Default value is `nil` (the system clock).
+ */
+@property (nullable, nonatomic, copy) NSTimeInterval(^clock)(void);
+
+/**
+ Whether the receiver assigns the `applicationIconBadgeNumber` of scheduled notifications automatically.
+ 
+ When enabled, notifications with an identifier (see `MRLocalNotificationIdentifierKey`) are badged in fire date order: the one that fires next gets `automaticBadgeBase + 1`, the following one `automaticBadgeBase + 2`, and so on. Scheduling or cancelling a notification only reschedules the later notifications whose badge actually changes. The badge of the notification passed to `scheduleNotification:withError:` is overwritten.
+ 
+ Default value is `NO`.
+ */
+@property (nonatomic, assign) BOOL automaticBadges;
+
+/**
+ Badge number that precedes the badge of the next notification when `automaticBadges` is enabled.
+ 
+ It is incremented each time a notification that does not repeat is delivered, so it usually mirrors the number of delivered notifications not yet seen by the user. Reset it (for example to `0` when the application clears its badge) to resequence all the scheduled notifications.
+ 
+ Default value is `0`.
+ */
+@property (nonatomic, assign) NSInteger automaticBadgeBase;
+
+/**
+ Directory where the receiver keeps a journal of the notifications it schedules and cancels.
+ 
+ Only notifications with an identifier (see `MRLocalNotificationIdentifierKey`) are journaled. When a journal is available, the receiver's index of scheduled notifications is loaded from it instead of from the `defaultApplication`. The journal is read in the background; if the index is needed before, it is loaded from the `defaultApplication` instead of waiting.
+ 
+ Default value is `nil` (no journal).
+ */
+@property (nullable, nonatomic, strong) NSURL *journalDirectoryURL;
+
+/**
+ Directory where the receiver keeps the `userInfo` payloads of the notifications it schedules.
+ 
+ When set, the `userInfo` of each scheduled notification with an identifier (see `MRLocalNotificationIdentifierKey`) is replaced with the identifier and a content-addressed key (`MRLocalNotificationPayloadKey`), and the rest of values are written to this directory. This keeps the notifications fetched from the `defaultApplication` small. The handle methods pass the notification with its full `userInfo` to the handlers, and `getUserInfoFromNotification:` returns it. Payloads no longer referenced are removed when notifications are cancelled, and when delivered notifications that do not repeat have been passed to the handlers. The payloads of notifications delivered without being handled are removed the first time the receiver loads its index of scheduled notifications; their full `userInfo` is not available afterwards.
+ 
+ Default value is `nil` (no payload store).
+ */
+@property (nullable, nonatomic, strong) NSURL *payloadStoreDirectoryURL;
+
 /**
  Creates an `UILocalNotification` and initializes it with the given parameters.
 
@@ -159,16 +375,112 @@ typedef enum {
                  appIconBadge:(NSInteger)badgeNumber
                         sound:(BOOL)hasSound;
 
+/**
+ Creates a template from the given notification, checking it against the current user notification settings.
+ 
+ Every field of `notification` except `fireDate` (category, alert fields, sound, badge, repeat, time zone and `userInfo`) is shared by the notifications created with the template. Since identifiers must be unique, the `MRLocalNotificationIdentifierKey` value of `userInfo` is not; pass one identifier per notification when creating them instead.
+ 
+ @param notification The prototype notification.
+ @param badgeIncrement The amount added to the badge number of each notification with respect to the previous one, or `0` for using the same badge number.
+ @param errorPtr If the notification is not valid or if some problem has been detected, upon return contains an instance of `NSError` that describes the problem.
+ @return An initialized template, or `nil` if the notification is not valid.
+ */
+- (nullable MRLocalNotificationTemplate *)buildTemplateWithNotification:(UILocalNotification *)notification
+                                                         badgeIncrement:(NSInteger)badgeIncrement
+                                                                  error:(NSError *_Nullable*_Nullable)errorPtr;
+
+/**
+ Creates one notification without identifier for each of the given dates using the given template.
+ 
+ @param notificationTemplate The template.
+ @param fireDates An array of `NSDate` objects.
+ @return An array of `UILocalNotification` objects.
+ */
+- (NSArray *)buildNotificationsWithTemplate:(MRLocalNotificationTemplate *)notificationTemplate
+                                  fireDates:(NSArray *)fireDates;
+
+/**
+ Creates one notification for each of the given dates using the given template.
+ 
+ @param notificationTemplate The template.
+ @param fireDates An array of `NSDate` objects.
+ @param identifiers An array with the `MRLocalNotificationIdentifierKey` value of each notification, with as many elements as `fireDates`, or `nil` for notifications without identifier.
+ @return An array of `UILocalNotification` objects.
+ */
+- (NSArray *)buildNotificationsWithTemplate:(MRLocalNotificationTemplate *)notificationTemplate
+                                  fireDates:(NSArray *)fireDates
+                                identifiers:(nullable NSArray *)identifiers;
+
+/**
+ Creates one notification without identifier for each of the given time intervals (since now) using the given template.
+ 
+ @param notificationTemplate The template.
+ @param fireIntervals A C array of non-negative time intervals.
+ @param count The number of elements in `fireIntervals`.
+ @return An array of `UILocalNotification` objects.
+ */
+- (NSArray *)buildNotificationsWithTemplate:(MRLocalNotificationTemplate *)notificationTemplate
+                              fireIntervals:(const NSTimeInterval *)fireIntervals
+                                      count:(NSUInteger)count;
+
+/**
+ Creates one notification for each of the given time intervals (since now) using the given template.
+ 
+ @param notificationTemplate The template.
+ @param fireIntervals A C array of non-negative time intervals.
+ @param count The number of elements in `fireIntervals`.
+ @param identifiers An array with the `MRLocalNotificationIdentifierKey` value of each notification, with `count` elements, or `nil` for notifications without identifier.
+ @return An array of `UILocalNotification` objects.
+ */
+- (NSArray *)buildNotificationsWithTemplate:(MRLocalNotificationTemplate *)notificationTemplate
+                              fireIntervals:(const NSTimeInterval *)fireIntervals
+                                      count:(NSUInteger)count
+                                identifiers:(nullable NSArray *)identifiers;
+
 /**
  All currently scheduled local notifications.
  */
 - (NSArray *)scheduledNotifications;
 
+/**
+ Notifications waiting in the receiver's queue for a free slot in the `defaultApplication`.
+ 
+ The array is not sorted. See `maximumScheduledNotifications`.
+ */
+- (NSArray *)queuedNotifications;
+
+/**
+ Notifications that are pending according to the receiver's journal.
+ 
+ This method does not query the `defaultApplication`. Delivered notifications that do not repeat are excluded.
+ 
+ @return The journaled notifications or an empty array if `journalDirectoryURL` is `nil`.
+ */
+- (NSArray *)journaledNotifications;
+
+/**
+ Rewrites the receiver's journal in the background keeping only the records of pending notifications.
+ 
+ The journal is also compacted automatically when most of its records are obsolete.
+ */
+- (void)compactJournal;
+
+/**
+ Fills the free slots of the `defaultApplication` with the earliest notifications from the receiver's queue.
+ 
+ The receiver fetches the pending notifications of the `defaultApplication` only once and then tracks them, considering free the slots of the notifications that do not repeat and whose fire date has passed.
+ 
+ This method is invoked automatically by `handleDidReceiveLocalNotification:` and when the application enters the foreground. It does nothing if `maximumScheduledNotifications` is `0`.
+ */
+- (void)replenishScheduledNotifications;
+
 /**
  Cancels the delivery of the specified scheduled local notification.
  
  Calling this method also programmatically dismisses the notification if it is currently displaying an alert.
  
+ If the notification has an identifier, the indexed notification with the same identifier is the one cancelled.
+ 
  @param notification The local notification to cancel. If it is `nil`, the method returns immediately.
  */
 - (void)cancelNotification:(UILocalNotification *)notification;
@@ -178,6 +490,172 @@ typedef enum {
  */
 - (void)cancelAllNotifications;
 
+/**
+ Cancels the scheduled notifications with the given category.
+ 
+ The bulk cancellation methods only consider the notifications that contain an identifier (see `MRLocalNotificationIdentifierKey`); they are looked up in indexes maintained by the facade, without fetching `scheduledNotifications`.
+ 
+ @param category The category identifier of the notifications to cancel.
+ @return The cancelled notifications.
+ */
+- (NSArray *)cancelNotificationsWithCategory:(NSString *)category;
+
+/**
+ Cancels the scheduled notifications whose `userInfo` contains the given value for the given key.
+ 
+ The index for `key` is built the first time it is used and maintained afterwards.
+ 
+ @param value The `userInfo` value.
+ @param key The `userInfo` key.
+ @return The cancelled notifications.
+ */
+- (NSArray *)cancelNotificationsWithUserInfoValue:(id)value
+                                           forKey:(id<NSCopying>)key;
+
+/**
+ Cancels the scheduled notifications whose next fire date (converted to GMT if needed) is in the given range.
+ 
+ @param startDate The start of the range (included).
+ @param endDate The end of the range (excluded).
+ @return The cancelled notifications.
+ */
+- (NSArray *)cancelNotificationsWithFireDateFrom:(NSDate *)startDate
+                                              to:(NSDate *)endDate;
+
+/**
+ Cancels the scheduled notifications that match the given predicate.
+ 
+ @param predicate The predicate evaluated with each `UILocalNotification` object.
+ @return The cancelled notifications.
+ */
+- (NSArray *)cancelNotificationsMatchingPredicate:(NSPredicate *)predicate;
+
+/**
+ Returns the identifier of the given notification.
+ 
+ @param notification The notification object.
+ @return The string stored in the notification's `userInfo` for the `MRLocalNotificationIdentifierKey` key or `nil` if there is none.
+ */
+- (nullable NSString *)getIdentifierFromNotification:(UILocalNotification *)notification;
+
+/**
+ Returns the scheduled notification with the given identifier.
+ 
+ The notification is looked up in the receiver's index, without querying the `defaultApplication`.
+ 
+ @param identifier The notification identifier.
+ @return The scheduled notification object or `nil` if the index contains no pending notification with the given identifier.
+ */
+- (nullable UILocalNotification *)scheduledNotificationWithIdentifier:(NSString *)identifier;
+
+/**
+ Returns the `userInfo` of the given notification, including the payload kept by the payload store, if any.
+ 
+ @param notification The notification.
+ @return The full `userInfo` dictionary.
+ */
+- (nullable NSDictionary *)getUserInfoFromNotification:(UILocalNotification *)notification;
+
+/**
+ Returns the scheduled notification that fires next.
+ 
+ Only notifications that contain an identifier (see `MRLocalNotificationIdentifierKey`) are considered. They are kept in an index ordered by their next GMT fire date, which is updated when notifications are scheduled, cancelled or delivered. Notifications with a `timeZone` are ordered by their fire date in the current system time zone, and are moved when it changes. The query costs O(log N).
+ 
+ @return The notification with the earliest pending fire date, or `nil`.
+ */
+- (nullable UILocalNotification *)nextScheduledNotification;
+
+/**
+ Returns the scheduled notifications whose next fire date (converted to GMT if needed) is in the given range, ordered by fire date.
+ 
+ Repeating notifications are included once, at their next fire date. See `nextScheduledNotification`.
+ 
+ @param startDate The start of the range (included).
+ @param endDate The end of the range (excluded).
+ @return An array of `UILocalNotification` objects.
+ */
+- (NSArray *)scheduledNotificationsFiringFrom:(NSDate *)startDate
+                                           to:(NSDate *)endDate;
+
+/**
+ Synchronizes the receiver's index of notifications with the `scheduledNotifications` array.
+ 
+ This method is invoked automatically when the application enters the foreground.
+ */
+- (void)reconcileScheduledNotifications;
+
+/**
+ Makes the scheduled notifications match the given ones, cancelling and scheduling only what differs.
+ 
+ Notifications are matched by their `MRLocalNotificationIdentifierKey` identifier; desired notifications without identifier are ignored, and scheduled notifications without identifier are left untouched. A scheduled notification is replaced when its fire date, time zone, repeat interval, alert body, badge number, sound name or category differ from the desired one; if the desired notification is not valid, the scheduled one is kept. The cost is linear in the number of desired and scheduled notifications.
+ 
+ @param desiredNotifications An array of `UILocalNotification` objects that should be scheduled.
+ @return A dictionary describing the changes, with `MRLocalNotificationInsertedIdentifiersKey`, `MRLocalNotificationUpdatedIdentifiersKey`, `MRLocalNotificationDeletedIdentifiersKey`, `MRLocalNotificationUnchangedIdentifiersKey` and `MRLocalNotificationErrorsByIdentifierKey` keys.
+ */
+- (NSDictionary *)applyDesiredNotifications:(NSArray *)desiredNotifications;
+
+/**
+ Maximum number of notifications from the region pool that the receiver keeps scheduled at once.
+ 
+ The system monitors a small number of regions per application, shared with the regions monitored by the application itself.
+ 
+ Default value is `20`.
+ */
+@property (nonatomic, assign) NSUInteger maximumRegionNotifications;
+
+/**
+ Adds a region-triggered notification to the pool of candidates for `updateRegionPoolWithLocation:`.
+ 
+ The notification must contain an identifier (see `MRLocalNotificationIdentifierKey`) and a `CLCircularRegion`; a pooled notification with the same identifier is replaced. Pooled notifications are not scheduled until they are among the nearest to a location passed to `updateRegionPoolWithLocation:`. They are kept in memory only.
+ 
+ @param notification The notification to add.
+ @param errorPtr If the notification is not valid, upon return contains an instance of `NSError` that describes the problem.
+ @return `YES` if the notification has been added to the pool.
+ */
+- (BOOL)addNotificationToRegionPool:(UILocalNotification *)notification
+                              error:(NSError *_Nullable*_Nullable)errorPtr;
+
+/**
+ Removes a notification from the region pool, cancelling it if it was scheduled by `updateRegionPoolWithLocation:`.
+ 
+ @param notification A notification with the identifier of the pooled notification.
+ */
+- (void)removeNotificationFromRegionPool:(UILocalNotification *)notification;
+
+/**
+ Removes all the notifications from the region pool, cancelling the ones scheduled by `updateRegionPoolWithLocation:`.
+ */
+- (void)removeAllNotificationsFromRegionPool;
+
+/**
+ Schedules the `maximumRegionNotifications` pooled notifications whose regions are nearest to the given location.
+ 
+ The distance to a region is measured from the location to the region boundary, so regions containing the location come first. Pooled notifications are kept in a grid index, so a query usually visits only the cells around the location. Only the differences with the previous selection are cancelled and scheduled. Call this method when the location changes significantly.
+ 
+ @param location The current location.
+ @return An array with the identifiers of the selected notifications, nearest first.
+ */
+- (NSArray *)updateRegionPoolWithLocation:(CLLocation *)location;
+
+/**
+ Whether the facade counts the calls to `defaultApplication`, the validation errors and the latency of its main operations. Default is `NO`.
+ 
+ When disabled, the instrumentation costs one nil check per operation.
+ */
+@property (nonatomic, assign) BOOL instrumentationEnabled;
+
+/**
+ Returns the metrics collected since the instrumentation was enabled or since the last `resetMetrics` call.
+ 
+ @return A dictionary with `MRLocalNotificationMetricsApplicationCallsKey`, `MRLocalNotificationMetricsLatenciesKey`, `MRLocalNotificationMetricsErrorsKey` and `MRLocalNotificationMetricsStartupKey` keys; empty if `instrumentationEnabled` is `NO`.
+ */
+- (NSDictionary *)metricsSnapshot;
+
+/**
+ Discards the metrics collected so far. Startup costs are kept, since they are only measured once.
+ */
+- (void)resetMetrics;
+
 @end
 
 
@@ -236,15 +714,61 @@ typedef enum {
                          action2:(nullable UIUserNotificationAction *)action2
                          action3:(nullable UIUserNotificationAction *)action3;
 
+/**
+ If `YES`, the handlers matching an action are invoked concurrently on a global queue and the completion handler passed to `handleActionWithIdentifier:forLocalNotification:completionHandler:` is invoked on the main queue once all of them finish. Default is `NO`.
+ */
+@property (nonatomic, assign) BOOL concurrentActionHandlers;
+
 /**
  Stores the given `handler` block associated with the given `identifier`.
  
+ Replaces the handler previously stored with this method for the same `identifier`; handlers added with the `addNotificationHandler:` methods are kept. Handlers can be registered from any thread.
+ 
  @param handler The block that should be invoked for handling an action for a notification `userInfo`.
  @param identifier The identifier of the action that should be associated with the handler.
  */
 - (void)setNotificationHandler:(void(^_Nullable)(NSString *identifier, UILocalNotification *notification))handler
        forActionWithIdentifier:(NSString *)identifier;
 
+/**
+ Adds a handler for the action with the given `identifier`, in addition to any other handler for that action.
+ 
+ @param handler The block that should be invoked for handling the action.
+ @param identifier The identifier of the action.
+ @return An opaque object to pass to `removeNotificationHandler:`.
+ */
+- (id<NSObject>)addNotificationHandler:(void(^)(NSString *identifier, UILocalNotification *notification))handler
+               forActionWithIdentifier:(NSString *)identifier;
+
+/**
+ Adds a handler for every action whose identifier begins with the given prefix.
+ 
+ @param handler The block that should be invoked for handling the action.
+ @param identifierPrefix The prefix of the action identifiers.
+ @return An opaque object to pass to `removeNotificationHandler:`.
+ */
+- (id<NSObject>)addNotificationHandler:(void(^)(NSString *identifier, UILocalNotification *notification))handler
+         forActionWithIdentifierPrefix:(NSString *)identifierPrefix;
+
+/**
+ Adds a handler for the actions of notifications with the given `category`.
+ 
+ @param handler The block that should be invoked for handling the action.
+ @param identifier The identifier of the action, or `nil` for handling every action of the category.
+ @param category The category identifier of the notifications.
+ @return An opaque object to pass to `removeNotificationHandler:`.
+ */
+- (id<NSObject>)addNotificationHandler:(void(^)(NSString *identifier, UILocalNotification *notification))handler
+               forActionWithIdentifier:(nullable NSString *)identifier
+                              category:(NSString *)category;
+
+/**
+ Removes a handler added with one of the `addNotificationHandler:` methods.
+ 
+ @param token The object returned when the handler was added.
+ */
+- (void)removeNotificationHandler:(id<NSObject>)token;
+
 @end
 
 
@@ -266,6 +790,8 @@ typedef enum {
 /**
  Returns the user notification settings for the app.
  
+ The settings are read once from the `defaultApplication` and cached until `handleDidRegisterUserNotificationSettings:` is invoked or the application enters the foreground.
+ 
  @return A user notification settings object indicating the types of notifications that your app may use.
  */
 - (nullable UIUserNotificationSettings *)currentUserNotificationSettings;
@@ -317,7 +843,7 @@ typedef enum {
 /**
  View controller used as presenting view controller by the method `showAlertController:`.
  
- If `defaultAlertPresenter` is `nil`, a new view controller instance is created for every `showAlertController:` invocation.
+ If `defaultAlertPresenter` is `nil`, a view controller in a dedicated window is created on the first `showAlertController:` invocation and reused afterwards. Alerts shown while another one is visible are queued and presented in order, each one after the previous one is dismissed. The window is hidden when the last alert is dismissed.
  */
 @property (nullable, nonatomic, strong) UIViewController *defaultAlertPresenter;
 
@@ -339,6 +865,8 @@ typedef enum {
 /**
  Presents the given alert controller.
  
+ When `defaultAlertPresenter` is `nil`, the alert waits for the alerts presented before to be dismissed (see `defaultAlertPresenter`).
+ 
  @param alert Alert controller object that needs to be presented.
  */
 - (void)showAlertController:(UIAlertController *)alert;
@@ -351,7 +879,7 @@ typedef enum {
 /**
  Returns the `UIApplication` instance.
  
- Default value is `UIApplication.sharedApplication`.
+ Default value is `UIApplication.sharedApplication`, resolved on first use.
  */
 @property (nullable, nonatomic, strong) UIApplication *defaultApplication;
 
@@ -362,6 +890,22 @@ typedef enum {
  */
 @property (nullable, nonatomic, copy) void(^onDidReceiveNotification)(UILocalNotification *notification, BOOL *shouldShowAlert);
 
+/**
+ Seconds during which received notifications are coalesced before they are handled.
+ 
+ If it is greater than zero, `handleDidReceiveLocalNotification:` groups the notifications received within this window by category (see `MRLocalNotificationCoalescer`), passes them to `onDidReceiveNotifications` (or to `onDidReceiveNotification`, one by one) and presents at most one alert for all of them.
+ 
+ Default value is `0` (no coalescing).
+ */
+@property (nonatomic, assign) NSTimeInterval notificationCoalescingWindow;
+
+/**
+ Block invoked with the notifications coalesced during `notificationCoalescingWindow`, grouped by category.
+ 
+ `batches` has one array of `UILocalNotification` objects per category, in order of first arrival (see `MRLocalNotificationCoalescer`). `shouldShowAlert` is given a default value according to the application state, but can be changed within the block; a single alert is presented for all the batches. When this block is set, `onDidReceiveNotification` is not invoked for coalesced notifications.
+ */
+@property (nullable, nonatomic, copy) void(^onDidReceiveNotifications)(NSArray *batches, BOOL *shouldShowAlert);
+
 /**
  Returns `YES` if the method `application:didRegisterUserNotificationSettings:` is known to have been received with a not `nil` notification settings parameter.
  
@@ -376,6 +920,15 @@ typedef enum {
  */
 - (nullable UILocalNotification *)getNotificationFromLaunchOptions:(nullable NSDictionary *)launchOptions;
 
+/**
+ Returns the local notification object (if any) from the given launch options dictionary, and handles it later without initializing `defaultInstance` on the launch path.
+ 
+ Use it in `application:didFinishLaunchingWithOptions:` instead of `getNotificationFromLaunchOptions:` and `handleDidReceiveLocalNotification:`. The notification is handled by `defaultInstance` on a later iteration of the main run loop, as `handleDidReceiveLocalNotification:` would while the application is not active (no alert is shown unless `onDidReceiveNotification` asks for it).
+ @param launchOptions Launch options dictionary.
+ @returns The local notification object or `nil` if `UIApplicationLaunchOptionsLocalNotificationKey` does not contain a local notification or the given `launchOptions` was `nil`.
+ */
++ (nullable UILocalNotification *)deferHandlingOfNotificationFromLaunchOptions:(nullable NSDictionary *)launchOptions;
+
 /**
  The number currently set as the badge of the app icon in Springboard.
  */
@@ -400,7 +953,7 @@ typedef enum {
 /**
  Handles `application:didReceiveLocalNotification:`.
  
- This method invokes `onDidReceiveNotification` block and may display the given notification using an alert controller when the application is in active state (`UIApplicationStateActive`).
+ This method invokes `onDidReceiveNotification` block and may display the given notification using an alert controller when the application is in active state (`UIApplicationStateActive`). See `notificationCoalescingWindow` for handling bursts of notifications.
  
  @param notification A local notification that encapsulates details about the notification, potentially including custom data. If it is `nil`, the method returns immediately.
  */
@@ -409,7 +962,7 @@ typedef enum {
 /**
  Handles `application:handleActionWithIdentifier:forLocalNotification:completionHandler:`.
  
- This method invokes the action hanlder block associated with the given action `identifier`.
+ This method invokes every action handler block matching the given action `identifier`: exact handlers first, then the handlers of the notification category, then prefix handlers. The completion handler is invoked once, after all of them.
  
  @param identifier The identifier associated with the custom action. This string corresponds to the identifier from the `UILocalNotificationAction` object that was used to configure the action in the local notification.
  @param notification The local notification object that was triggered.
@@ -422,24 +975,87 @@ typedef enum {
 @end
 
 
+/**
+ Calendar components of a date, used by the batch date building methods.
+ */
+typedef struct {
+    NSInteger year;
+    NSInteger month;
+    NSInteger day;
+    NSInteger hour;
+    NSInteger minute;
+    NSInteger second;
+} MRLocalNotificationDateComponents;
+
+
+/**
+ `MRLocalNotificationRecurrenceRule` describes how a notification repeats, including a subset of the iCalendar recurrence rules.
+ */
+@interface MRLocalNotificationRecurrenceRule : NSObject <NSCopying>
+
+/**
+ The calendar unit at which the rule repeats (equivalent to the notification's `repeatInterval`).
+ 
+ Default value is `NSCalendarUnitDay`.
+ */
+@property (nonatomic, assign) NSCalendarUnit frequency;
+
+/**
+ The number of `frequency` units between consecutive periods.
+ 
+ Default value is `1`.
+ */
+@property (nonatomic, assign) NSInteger interval;
+
+/**
+ Weekdays allowed by the rule (1 is Sunday, 7 is Saturday), like iCalendar's `BYDAY`.
+ 
+ With weekly, monthly or yearly frequencies, the matching days of each period become occurrences; with shorter frequencies, occurrences on other weekdays are skipped.
+ */
+@property (nullable, nonatomic, copy) NSIndexSet *weekdays;
+
+/**
+ Days of the month allowed by the rule (1 to 31), like iCalendar's `BYMONTHDAY`.
+ 
+ It is applied the same way than `weekdays`; when both are given, a day must match both.
+ */
+@property (nullable, nonatomic, copy) NSIndexSet *monthDays;
+
+/**
+ Maximum number of occurrences, like iCalendar's `COUNT`.
+ 
+ Default value is `0` (unlimited).
+ */
+@property (nonatomic, assign) NSUInteger count;
+
+/**
+ Last date at which an occurrence may happen, like iCalendar's `UNTIL`.
+ */
+@property (nullable, nonatomic, strong) NSDate *until;
+
+@end
+
+
 @interface MRLocalNotificationFacade (NSDate)
 
 /**
  Time zone used when one is needed for building a notification object.
+ 
+ Default value is `NSTimeZone.defaultTimeZone`, resolved on first use.
  */
 @property (nullable, nonatomic, strong) NSTimeZone *defaultTimeZone;
 
 /**
  Calendar used when one is needed for building `NSDate` objects or customizing notification's *repeat interval*.
  
- Default value is `NSCalendar.autoupdatingCurrentCalendar`.
+ Default value is `NSCalendar.autoupdatingCurrentCalendar`, resolved on first use.
  */
 @property (nullable, nonatomic, strong) NSCalendar *defaultCalendar;
 
 /**
  Returns a new `NSDate` object representing the absolute time calculated from given components and `defaultCalendar` property.
  
- The parameters are interpreted in the context of the calendar with which it is used (`defaultCalendar`).
+ The parameters are interpreted in the context of the calendar with which it is used (`defaultCalendar`) and the `defaultTimeZone`. The `defaultCalendar` is never modified, so this method can be invoked from any thread as long as `defaultCalendar` and `defaultTimeZone` are not being changed concurrently.
  
  @param day The number of day units for the receiver.
  @param month The number of month units for the receiver.
@@ -456,6 +1072,19 @@ typedef enum {
                       minute:(NSInteger)minute
                       second:(NSInteger)second;
 
+/**
+ Calculates the absolute times of the given components using the `defaultCalendar` and the `defaultTimeZone`.
+ 
+ This is the batch equivalent of `buildDateWithDay:month:year:hour:minute:second:`. Gregorian calendars are handled with integer date arithmetic; other calendars use a per-thread copy of the `defaultCalendar`. As with `NSCalendar`, local times skipped by a daylight saving time transition move forward by the length of the gap, and repeated local times resolve to their first occurrence.
+ 
+ @param timeIntervals A C array where the time intervals since the reference date are stored.
+ @param components A C array with the components of each date.
+ @param count The number of elements in `timeIntervals` and `components`.
+ */
+- (void)buildTimeIntervals:(NSTimeInterval *)timeIntervals
+            fromComponents:(const MRLocalNotificationDateComponents *)components
+                     count:(NSUInteger)count;
+
 /**
  Converts the given date from GMT to the `defaultTimeZone`.
  
@@ -473,7 +1102,29 @@ typedef enum {
 - (NSDate *)convertDateToGMT:(NSDate *)timeDate;
 
 /**
- Retrieves the components of the given `date` using the receiver's `defaultCalendar`.
+ Converts in place the given time intervals from GMT to the `defaultTimeZone`.
+ 
+ This is the batch equivalent of `convertDateToDefaultTimeZone:`; it does not create any `NSDate` object.
+ 
+ @param timeIntervals A C array of time intervals since the reference date (see `timeIntervalSinceReferenceDate`).
+ @param count The number of elements in `timeIntervals`.
+ */
+- (void)convertTimeIntervalsToDefaultTimeZone:(NSTimeInterval *)timeIntervals
+                                        count:(NSUInteger)count;
+
+/**
+ Converts in place the given time intervals from the `defaultTimeZone` to GMT.
+ 
+ This is the batch equivalent of `convertDateToGMT:`; it does not create any `NSDate` object.
+ 
+ @param timeIntervals A C array of time intervals since the reference date (see `timeIntervalSinceReferenceDate`).
+ @param count The number of elements in `timeIntervals`.
+ */
+- (void)convertTimeIntervalsToGMT:(NSTimeInterval *)timeIntervals
+                            count:(NSUInteger)count;
+
+/**
+ Retrieves the components of the given `date` using the receiver's `defaultCalendar` and `defaultTimeZone`.
  
  @param date The date.
  @param day A pointer for storing the day value.
@@ -491,6 +1142,19 @@ typedef enum {
       minute:(nullable NSInteger *)minute
       second:(nullable NSInteger *)second;
 
+/**
+ Retrieves the components of the given time intervals using the receiver's `defaultCalendar` and `defaultTimeZone`.
+ 
+ This is the batch equivalent of `date:getDay:month:year:hour:minute:second:`.
+ 
+ @param components A C array where the components of each date are stored.
+ @param timeIntervals A C array of time intervals since the reference date.
+ @param count The number of elements in `components` and `timeIntervals`.
+ */
+- (void)getComponents:(MRLocalNotificationDateComponents *)components
+    fromTimeIntervals:(const NSTimeInterval *)timeIntervals
+                count:(NSUInteger)count;
+
 /**
  Returns the `fireDate` of the given `notification` converted to GMT (if needed).
  
@@ -499,6 +1163,58 @@ typedef enum {
  */
 - (NSDate *)getGMTFireDateFromNotification:(UILocalNotification *)notification;
 
+/**
+ Returns a recurrence rule equivalent to the `repeatInterval` of the given `notification`.
+ 
+ @param notification The notification object.
+ @return A new recurrence rule or `nil` if the notification does not repeat.
+ */
+- (nullable MRLocalNotificationRecurrenceRule *)getRecurrenceRuleFromNotification:(UILocalNotification *)notification;
+
+/**
+ Returns an enumerator of the GMT dates at which the given notification fires, starting with its fire date.
+ 
+ Occurrences are computed lazily in the wall-clock time of the notification's `timeZone` (or the time zone of its `repeatCalendar`). Gregorian calendars use integer date arithmetic; other calendars fall back to `NSCalendar`.
+ 
+ @param notification The notification object.
+ @param rule The recurrence rule to apply or `nil` for using the notification's `repeatInterval`.
+ @return An enumerator of `NSDate` objects in ascending order.
+ */
+- (NSEnumerator *)enumeratorOfFireDatesFromNotification:(UILocalNotification *)notification
+                                                   rule:(nullable MRLocalNotificationRecurrenceRule *)rule;
+
+/**
+ Returns the GMT dates at which the given notification fires within the given window.
+ 
+ Periods before `startDate` are skipped arithmetically instead of being enumerated whenever the rule allows it.
+ 
+ @param notification The notification object.
+ @param rule The recurrence rule to apply or `nil` for using the notification's `repeatInterval`.
+ @param startDate The start of the window (inclusive).
+ @param endDate The end of the window (exclusive).
+ @param limit The maximum number of dates to return or `0` for no limit.
+ @return An array of `NSDate` objects in ascending order.
+ */
+- (NSArray *)getFireDatesFromNotification:(UILocalNotification *)notification
+                                     rule:(nullable MRLocalNotificationRecurrenceRule *)rule
+                                    after:(NSDate *)startDate
+                                   before:(NSDate *)endDate
+                                    limit:(NSUInteger)limit;
+
+/**
+ Returns the GMT dates at which each of the given notifications fires within the given window.
+ 
+ @param notifications An array of `UILocalNotification` objects.
+ @param startDate The start of the window (inclusive).
+ @param endDate The end of the window (exclusive).
+ @param limit The maximum number of dates to return per notification or `0` for no limit.
+ @return An array with one array of `NSDate` objects per notification, in the same order than `notifications`.
+ */
+- (NSArray *)getFireDatesFromNotifications:(NSArray *)notifications
+                                     after:(NSDate *)startDate
+                                    before:(NSDate *)endDate
+                                     limit:(NSUInteger)limit;
+
 @end
 
 
@@ -516,6 +1232,20 @@ typedef enum {
  */
 @property (nullable, nonatomic, copy) void(^onDidCancelErrorAlert)(NSError *error);
 
+/**
+ Serial queue where the operations submitted with `enqueueScheduleNotification:completion:` and `enqueueCancelNotification:completion:` are validated and coalesced.
+ 
+ It must not be the main queue nor the queue used by `commitExecutor`. Change it only while no operations are pending.
+ */
+@property (nonatomic, strong) dispatch_queue_t pipelineQueue;
+
+/**
+ Block used for committing the pending operations to `defaultApplication`.
+ 
+ The block receives the commit block and must run it, usually asynchronously on the main thread. When `nil` (the default), the commit block is dispatched to the main queue, so all the operations enqueued during a run loop turn are committed in one batch. Assign it before enqueueing any operation.
+ */
+@property (nullable, nonatomic, copy) void(^commitExecutor)(dispatch_block_t block);
+
 /**
  Sets a URL in the `contactSupportURL` property using the `mailto` scheme and the given email address.
  
@@ -549,9 +1279,21 @@ typedef enum {
 - (BOOL)canPresentNotificationNow:(nullable UILocalNotification *)notification
                             error:(NSError *_Nullable*_Nullable)errorPtr;
 
+/**
+ Checks if a local notification can be presented now without building any error object.
+ 
+ @param notification The local notification object that you want to check.
+ @param codePtr If the notification cannot be presented, upon return contains the code of the error that describes the problem; otherwise it is left untouched.
+ @return `YES` if the notification can be presented now; `NO` otherwise.
+ */
+- (BOOL)canPresentNotificationNow:(nullable UILocalNotification *)notification
+                        errorCode:(nullable MRLocalNotificationErrorCode *)codePtr;
+
 /**
  Returns whether the `scheduledNotifications` array contains an object thas is equal (`isEqual:`) to the given `notification` or not.
  
+ If the notification has an identifier, the receiver's index is checked instead and the result is `YES` when a pending notification with the same identifier exists.
+ 
  @param notification The object used for checking equality with each element of the array.
  @return `YES` if there is an object equal; `NO` otherwise.
  */
@@ -569,6 +1311,40 @@ typedef enum {
 - (BOOL)scheduleNotification:(nullable UILocalNotification *)notification
                    withError:(NSError *_Nullable*_Nullable)errorPtr;
 
+/**
+ Schedules the given local notifications for delivery at their encapsulated dates and times.
+
+ This method behaves like `scheduleNotification:withError:` for each element of `notifications`, but it reads the scheduled notifications and the user notification settings only once for the whole batch. Notifications that are equal to a previous element of the batch are reported as already scheduled.
+
+ @param notifications An array of `UILocalNotification` objects that you want to schedule.
+ @param errorsPtr Upon return contains an array with the same number of elements than `notifications`; each element is either an instance of `NSError` that describes the problem detected with the corresponding notification or `NSNull`.
+ @return The indexes of the notifications that have been scheduled.
+ */
+- (NSIndexSet *)scheduleNotifications:(NSArray *)notifications
+                               errors:(NSArray *_Nullable*_Nullable)errorsPtr;
+
+/**
+ Submits a local notification for being scheduled asynchronously.
+ 
+ This method can be invoked from any thread. The notification is validated on `pipelineQueue` and it is committed together with the rest of operations enqueued before the next commit. Notifications with identifier are validated against the user notification settings seen by the previous commit, so the commit only checks whether they are already scheduled and hands them to `defaultApplication`; the rest (and all of them if the settings changed in between) are committed with `scheduleNotifications:errors:`. A later operation for the same notification (or for a notification with the same identifier) supersedes this one before it is committed; a later schedule replaces the notification and a later cancel drops it.
+ 
+ @param notification The local notification object that you want to schedule.
+ @param completion Block invoked on the thread where the commit runs; `success` is `NO` if the notification has not been scheduled, and `error` describes the problem detected, if any.
+ */
+- (void)enqueueScheduleNotification:(nullable UILocalNotification *)notification
+                         completion:(void(^_Nullable)(BOOL success, NSError *_Nullable error))completion;
+
+/**
+ Submits a local notification for being cancelled asynchronously.
+ 
+ This method can be invoked from any thread. The cancellation is committed with `cancelNotification:` together with the rest of operations enqueued before the next commit. A pending schedule of the same notification is dropped, so it never reaches `defaultApplication`.
+ 
+ @param notification The local notification object that you want to cancel.
+ @param completion Block invoked on the thread where the commit runs.
+ */
+- (void)enqueueCancelNotification:(UILocalNotification *)notification
+                       completion:(void(^_Nullable)(BOOL success, NSError *_Nullable error))completion;
+
 /**
  Checks if a local notification can be scheduled.
  
@@ -581,6 +1357,30 @@ typedef enum {
                    withRecovery:(BOOL)recovery
                           error:(NSError *_Nullable*_Nullable)errorPtr;
 
+/**
+ Checks if a local notification can be scheduled without building any error object.
+ 
+ Use `buildErrorWithCode:` for getting the `NSError` that corresponds to the returned code when it is needed.
+ 
+ @param notification The local notification object that you want to check.
+ @param recovery If `recovery` parameter is `NO`, any error detected will be considered enough to prevent the given notification from being scheduled; if `YES` is passed, only non-recoverable errors will.
+ @param codePtr If the notification cannot be scheduled or if some problem has been detected, upon return contains the code of the error that describes the problem; otherwise it is left untouched.
+ @return `YES` if the notification can be scheduled; `NO` otherwise.
+ */
+- (BOOL)canScheduleNotification:(nullable UILocalNotification *)notification
+                   withRecovery:(BOOL)recovery
+                      errorCode:(nullable MRLocalNotificationErrorCode *)codePtr;
+
+/**
+ Creates an error object within the `MRLocalNotificationErrorDomain` for the given code.
+ 
+ The error contains the localized descriptions and the recovery options used by `buildAlertControlForError:`.
+ 
+ @param code The error code.
+ @return An initialized error object.
+ */
+- (NSError *)buildErrorWithCode:(MRLocalNotificationErrorCode)code;
+
 /**
  Creates an alert for displaying the given error.
  
@@ -591,4 +1391,76 @@ typedef enum {
 
 @end
 
+
+/**
+ `MRLocalNotificationSimulator` replays a workload against a facade on a virtual clock.
+ 
+ The simulator replaces the facade's `defaultApplication` with a simulated application and its `clock` with the simulated time. The simulated application keeps at most `maximumPendingNotifications` notifications, discarding the ones that fire last as the system does, and delivers them to `handleDidReceiveLocalNotification:` in fire date order, applying `repeatInterval` with `repeatCalendar`. It is never active, so no alerts are presented, and region-triggered notifications never fire.
+ 
+ Simulations are single-threaded and deterministic: notifications that fire at a date are delivered before the events of that date, and events with the same date run in the order they were added.
+ */
+@interface MRLocalNotificationSimulator : NSObject
+
+/**
+ Initializes a simulator for the given facade.
+ 
+ @param facade The facade to drive. Its `defaultApplication` and `clock` are replaced.
+ @param startDate The initial date of the virtual clock.
+ @return An initialized simulator.
+ */
+- (instancetype)initWithFacade:(MRLocalNotificationFacade *)facade
+                     startDate:(NSDate *)startDate;
+
+/**
+ The facade driven by the receiver.
+ */
+@property (nonatomic, readonly) MRLocalNotificationFacade *facade;
+
+/**
+ The current date of the virtual clock.
+ */
+@property (nonatomic, readonly) NSDate *currentDate;
+
+/**
+ Maximum number of pending notifications kept by the simulated application.
+ 
+ Default value is `64`.
+ */
+@property (nonatomic, assign) NSUInteger maximumPendingNotifications;
+
+/**
+ The notifications pending in the simulated application.
+ */
+@property (nonatomic, readonly) NSArray *pendingNotifications;
+
+/**
+ Adds an event to the workload.
+ 
+ @param date The date of the virtual clock when `block` runs.
+ @param block Block that uses the given facade (for example for scheduling or cancelling notifications).
+ */
+- (void)addEventAtDate:(NSDate *)date
+                 block:(void(^)(MRLocalNotificationFacade *facade))block;
+
+/**
+ Adds a time zone change to the workload.
+ 
+ The change sets `NSTimeZone.defaultTimeZone` (which `NSTimeZone.localTimeZone` follows) only while `runUntilDate:` runs (the previous value is restored when it returns or raises) and notifies the facade as `NSSystemTimeZoneDidChangeNotification` would.
+ 
+ @param date The date of the virtual clock when the time zone changes.
+ @param timeZone The new time zone.
+ */
+- (void)addTimeZoneChangeAtDate:(NSDate *)date
+                       timeZone:(NSTimeZone *)timeZone;
+
+/**
+ Advances the virtual clock to the given date, delivering the notifications and running the events due until then.
+ 
+ @param endDate The date the virtual clock is advanced to.
+ @return A report with `MRLocalNotificationSimulationEventsKey`, `MRLocalNotificationSimulationDeliveredKey`, `MRLocalNotificationSimulationDroppedKey`, `MRLocalNotificationSimulationLatencyKey`, `MRLocalNotificationSimulationFacadeTimeKey` and `MRLocalNotificationSimulationCPUTimeKey` keys for this run.
+ */
+- (NSDictionary *)runUntilDate:(NSDate *)endDate;
+
+@end
+
 NS_ASSUME_NONNULL_END
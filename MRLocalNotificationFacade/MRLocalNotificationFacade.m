@@ -21,27 +21,98 @@
 // THE SOFTWARE.
 
 #import "MRLocalNotificationFacade.h"
+#import <mach/mach.h>
+#import <mach/mach_time.h>
+#import <CommonCrypto/CommonDigest.h>
+#import <CoreLocation/CoreLocation.h>
+#import <fcntl.h>
+#import <unistd.h>
 
 
 NSString *const MRLocalNotificationErrorDomain = @"MRLocalNotificationErrorDomain";
 
 NSString *const MRRecoveryURLErrorKey = @"MRRecoveryURLErrorKey";
 
+NSString *const MRLocalNotificationIdentifierKey = @"MRLocalNotificationIdentifierKey";
+
+NSString *const MRLocalNotificationPayloadKey = @"MRLocalNotificationPayloadKey";
+
+NSString *const MRLocalNotificationInsertedIdentifiersKey = @"MRLocalNotificationInsertedIdentifiersKey";
+
+NSString *const MRLocalNotificationUpdatedIdentifiersKey = @"MRLocalNotificationUpdatedIdentifiersKey";
+
+NSString *const MRLocalNotificationDeletedIdentifiersKey = @"MRLocalNotificationDeletedIdentifiersKey";
+
+NSString *const MRLocalNotificationUnchangedIdentifiersKey = @"MRLocalNotificationUnchangedIdentifiersKey";
+
+NSString *const MRLocalNotificationErrorsByIdentifierKey = @"MRLocalNotificationErrorsByIdentifierKey";
+
+NSString *const MRLocalNotificationMetricsApplicationCallsKey = @"MRLocalNotificationMetricsApplicationCallsKey";
+
+NSString *const MRLocalNotificationMetricsLatenciesKey = @"MRLocalNotificationMetricsLatenciesKey";
+
+NSString *const MRLocalNotificationMetricsErrorsKey = @"MRLocalNotificationMetricsErrorsKey";
+
+NSString *const MRLocalNotificationMetricsStartupKey = @"MRLocalNotificationMetricsStartupKey";
+
+NSString *const MRLocalNotificationSimulationEventsKey = @"MRLocalNotificationSimulationEventsKey";
+
+NSString *const MRLocalNotificationSimulationDeliveredKey = @"MRLocalNotificationSimulationDeliveredKey";
+
+NSString *const MRLocalNotificationSimulationDroppedKey = @"MRLocalNotificationSimulationDroppedKey";
+
+NSString *const MRLocalNotificationSimulationLatencyKey = @"MRLocalNotificationSimulationLatencyKey";
+
+NSString *const MRLocalNotificationSimulationFacadeTimeKey = @"MRLocalNotificationSimulationFacadeTimeKey";
+
+NSString *const MRLocalNotificationSimulationCPUTimeKey = @"MRLocalNotificationSimulationCPUTimeKey";
+
 static NSString *const kMRUserNotificationsRegisteredKey = @"kMRUserNotificationsRegisteredKey";
 
+static MRLocalNotificationErrorCode const kMRLocalNotificationErrorNone = 0;
+
+static NSString *const kMRThreadCalendarKey = @"kMRThreadCalendarKey";
+
 
 #pragma mark - MRLocalNotificationFacadeAlertViewController_ -
 
 
-// `UIViewController` subclass with custom rotation handling.
+// `UIViewController` subclass with custom rotation handling that presents one alert at a time.
 @interface MRLocalNotificationFacadeAlertViewController_ : UIViewController
+- (void)presentAlert:(UIAlertController *)alert;
 @end
 
 
-@implementation MRLocalNotificationFacadeAlertViewController_
+@implementation MRLocalNotificationFacadeAlertViewController_ {
+    NSMutableArray *_pendingAlerts;
+}
+
+- (void)presentAlert:(UIAlertController *const)alert
+{
+    NSParameterAssert(alert);
+    if (self.presentedViewController || _pendingAlerts.count > 0) {
+        if (_pendingAlerts == nil) {
+            _pendingAlerts = NSMutableArray.array;
+        }
+        [_pendingAlerts addObject:alert];
+        return;
+    }
+    [self presentViewController:alert animated:YES completion:nil];
+}
 
 #pragma mark Private
 
+- (BOOL)mr_presentNextAlert
+{
+    UIAlertController *const alert = _pendingAlerts.firstObject;
+    if (alert == nil) {
+        return NO;
+    }
+    [_pendingAlerts removeObjectAtIndex:0];
+    [self presentViewController:alert animated:YES completion:nil];
+    return YES;
+}
+
 - (CGFloat)mr_degreesToRadians:(CGFloat const)degrees
 {
     return degrees*M_PI/180;
@@ -79,6 +150,25 @@ static NSString *const kMRUserNotificationsRegisteredKey = @"kMRUserNotification
     });
 }
 
+- (void)viewWillAppear:(BOOL const)animated
+{
+    [super viewWillAppear:animated];
+    NSNotificationCenter *const defaultCenter = NSNotificationCenter.defaultCenter;
+    [defaultCenter addObserver:self
+                      selector:@selector(statusBarDidChangeFrame:)
+                          name:UIApplicationDidChangeStatusBarFrameNotification
+                        object:nil];
+}
+
+- (void)viewDidDisappear:(BOOL const)animated
+{
+    [super viewDidDisappear:animated];
+    NSNotificationCenter *const defaultCenter = NSNotificationCenter.defaultCenter;
+    [defaultCenter removeObserver:self
+                             name:UIApplicationDidChangeStatusBarFrameNotification
+                           object:nil];
+}
+
 - (void)viewDidAppear:(BOOL const)animated
 {
     [super viewDidAppear:animated];
@@ -93,6 +183,20 @@ static NSString *const kMRUserNotificationsRegisteredKey = @"kMRUserNotification
 
 #pragma mark - UIViewController
 
+- (void)dismissViewControllerAnimated:(BOOL const)animated completion:(void(^const)(void))completion
+{
+    __weak typeof(self) welf = self;
+    [super dismissViewControllerAnimated:animated completion:^{
+        UIWindow *const window = welf.view.window;
+        if (welf.presentedViewController == nil && ![welf mr_presentNextAlert]) {
+            window.hidden = YES;
+        }
+        if (completion) {
+            completion();
+        }
+    }];
+}
+
 - (BOOL)shouldAutorotate
 {
     return NO;
@@ -100,268 +204,3925 @@ static NSString *const kMRUserNotificationsRegisteredKey = @"kMRUserNotification
 
 #pragma mark - NSObject
 
-- (instancetype)init
+- (void)dealloc
+{
+    NSNotificationCenter *const defaultCenter = NSNotificationCenter.defaultCenter;
+    [defaultCenter removeObserver:self];
+}
+
+@end
+
+
+#pragma mark - MRLocalNotificationSettingsSnapshot_ -
+
+
+// Immutable, pre-decoded copy of the user notification settings.
+@interface MRLocalNotificationSettingsSnapshot_ : NSObject
+@property (nonatomic, readonly) UIUserNotificationSettings *settings;
+@property (nonatomic, readonly) UIUserNotificationType types;
+@property (nonatomic, readonly) NSDictionary *categories;
+- (instancetype)initWithSettings:(UIUserNotificationSettings *)settings;
+- (BOOL)allowsTypes:(UIUserNotificationType)types;
+@end
+
+
+@implementation MRLocalNotificationSettingsSnapshot_
+
+- (instancetype)initWithSettings:(UIUserNotificationSettings *const)settings
 {
     self = [super init];
     if (self) {
-        NSNotificationCenter *const defaultCenter = NSNotificationCenter.defaultCenter;
-        [defaultCenter addObserver:self
-                          selector:@selector(statusBarDidChangeFrame:)
-                              name:UIApplicationDidChangeStatusBarFrameNotification
-                            object:nil];
+        _settings = settings;
+        _types = settings.types;
+        NSSet *const categories = settings.categories;
+        NSMutableDictionary *const categoriesByIdentifier =
+        [NSMutableDictionary dictionaryWithCapacity:categories.count];
+        for (UIUserNotificationCategory *const category in categories) {
+            NSString *const identifier = category.identifier;
+            if (identifier) {
+                categoriesByIdentifier[identifier] = category;
+            }
+        }
+        _categories = categoriesByIdentifier.copy;
     }
     return self;
 }
 
-- (void)dealloc
+- (BOOL)allowsTypes:(UIUserNotificationType const)types
 {
-    NSNotificationCenter *const defaultCenter = NSNotificationCenter.defaultCenter;
-    [defaultCenter removeObserver:self];
+    return (_types & types) == types;
 }
 
 @end
 
 
-#pragma mark - MRLocalNotificationFacade -
+#pragma mark - MRLocalNotificationHeap_ -
 
 
-@interface MRLocalNotificationFacade ()
-@property (nonatomic, strong) UIApplication *defaultApplication;
-@property (nonatomic, copy) void(^onDidReceiveNotification)(UILocalNotification *n, BOOL *alert);
-@property (nonatomic, readwrite) BOOL hasRegisteredNotifications;
-@property (nonatomic, strong) NSTimeZone *defaultTimeZone;
-@property (nonatomic, strong) NSCalendar *defaultCalendar;
-@property (nonatomic, strong) UIViewController *defaultAlertPresenter;
-@property (nonatomic, copy) void(^onDidCancelNotificationAlert)(UILocalNotification *notification);
-@property (nonatomic, strong) NSMutableDictionary *actionHandlers;
-@property (nonatomic, strong) NSURL *contactSupportURL;
-@property (nonatomic, copy) void(^onDidCancelErrorAlert)(NSError *error);
+// Min-heap of objects ordered by a time interval key (ties in insertion order) that supports
+// removal of arbitrary elements.
+@interface MRLocalNotificationHeap_ : NSObject
+@property (nonatomic, readonly) NSUInteger count;
+@property (nonatomic, readonly) id firstObject;
+@property (nonatomic, readonly) NSTimeInterval firstKey;
+@property (nonatomic, readonly) NSArray *allObjects;
+- (void)addObject:(id)object withKey:(NSTimeInterval)key;
+- (BOOL)containsObject:(id)object;
+- (void)removeFirstObject;
+- (void)removeObject:(id)object;
+- (void)removeAllObjects;
 @end
 
 
-@implementation MRLocalNotificationFacade
+@interface MRLocalNotificationHeapEntry_ : NSObject
+@property (nonatomic, strong) id object;
+@property (nonatomic, assign) NSTimeInterval key;
+@property (nonatomic, assign) NSUInteger position;
+@property (nonatomic, assign) uint64_t sequence;
+@end
 
-+ (instancetype)defaultInstance
+
+@implementation MRLocalNotificationHeapEntry_
+@end
+
+
+@implementation MRLocalNotificationHeap_ {
+    NSMutableArray *_entries;
+    NSMapTable *_entriesByObject;
+    uint64_t _sequence;
+}
+
+- (NSUInteger)count
 {
-    static MRLocalNotificationFacade *__defaultInstance;
-    static dispatch_once_t onceToken;
-    dispatch_once(&onceToken, ^{
-        __defaultInstance = [[self alloc] init];
-    });
-    return __defaultInstance;
+    return _entries.count;
 }
 
-- (UIMutableUserNotificationAction *)buildAction:(NSString *const)identifier
-                                           title:(NSString *const)title
-                                     destructive:(BOOL const)isDestructive
-                                  backgroundMode:(BOOL const)runsInBackground
-                                  authentication:(BOOL const)authRequired
+- (id)firstObject
 {
-    NSParameterAssert(identifier);
-    NSParameterAssert(title);
-    NSParameterAssert(runsInBackground || authRequired);
-    UIMutableUserNotificationAction *const action =
-    [[UIMutableUserNotificationAction alloc] init];
-    if (runsInBackground) {
-        action.activationMode = UIUserNotificationActivationModeBackground;
-    } else {
-        action.activationMode = UIUserNotificationActivationModeForeground;
-    }
-    action.title = title;
-    action.identifier = identifier;
-    action.destructive = isDestructive;
-    action.authenticationRequired = authRequired;
-    return action;
+    MRLocalNotificationHeapEntry_ *const entry = _entries.firstObject;
+    return entry.object;
 }
 
-- (UIMutableUserNotificationCategory *)buildCategory:(NSString *const)identifier
-                                      minimalActions:(NSArray *const)minimalActions
-                                      defaultActions:(NSArray *const)defaultActions
+- (NSTimeInterval)firstKey
 {
-    NSParameterAssert(identifier);
-    NSParameterAssert(minimalActions.count <= 2);
-    NSParameterAssert(defaultActions.count <= 4);
-    UIMutableUserNotificationCategory *const category =
-    [[UIMutableUserNotificationCategory alloc] init];
-    category.identifier = identifier;
-    [category setActions:minimalActions forContext:UIUserNotificationActionContextMinimal];
-    [category setActions:defaultActions forContext:UIUserNotificationActionContextDefault];
-    return category;
+    MRLocalNotificationHeapEntry_ *const entry = _entries.firstObject;
+    return entry.key;
 }
 
-- (void)customizeMinimalCategory:(UIMutableUserNotificationCategory *const)category
-                         action0:(UIUserNotificationAction *const)action0
-                         action1:(UIUserNotificationAction *const)action1
+- (NSArray *)allObjects
 {
-    NSParameterAssert(category);
-    NSMutableArray *const actions = [NSMutableArray arrayWithCapacity:4];
-    if (action0) {
-        [actions addObject:action0];
-    }
-    if (action1) {
-        [actions addObject:action1];
+    NSMutableArray *const objects = [NSMutableArray arrayWithCapacity:_entries.count];
+    for (MRLocalNotificationHeapEntry_ *const entry in _entries) {
+        [objects addObject:entry.object];
     }
-    [category setActions:actions forContext:UIUserNotificationActionContextMinimal];
+    return objects;
 }
 
-- (void)customizeDefaultCategory:(UIMutableUserNotificationCategory *const)category
-                         action0:(UIUserNotificationAction *const)action0
-                         action1:(UIUserNotificationAction *const)action1
-                         action2:(UIUserNotificationAction *const)action2
-                         action3:(UIUserNotificationAction *const)action3
+- (void)addObject:(id const)object withKey:(NSTimeInterval const)key
 {
-    NSParameterAssert(category);
-    NSMutableArray *const actions = [NSMutableArray arrayWithCapacity:4];
-    if (action0) {
-        [actions addObject:action0];
-    }
-    if (action1) {
-        [actions addObject:action1];
-    }
-    if (action2) {
-        [actions addObject:action2];
-    }
-    if (action3) {
-        [actions addObject:action3];
-    }
-    [category setActions:actions forContext:UIUserNotificationActionContextDefault];
+    NSParameterAssert(object);
+    NSParameterAssert(![self containsObject:object]);
+    MRLocalNotificationHeapEntry_ *const entry = MRLocalNotificationHeapEntry_.new;
+    entry.object = object;
+    entry.key = key;
+    entry.position = _entries.count;
+    entry.sequence = _sequence++;
+    [_entries addObject:entry];
+    [_entriesByObject setObject:entry forKey:object];
+    [self mr_siftUp:entry.position];
 }
 
-- (void)setNotificationHandler:(void(^const)(NSString *identifier, UILocalNotification *n))handler
-       forActionWithIdentifier:(NSString *const)identifier
+- (BOOL)containsObject:(id const)object
 {
-    NSParameterAssert(identifier);
-    if (handler) {
-        void(^const handlerCopy)(NSString *, UILocalNotification *) = [handler copy];
-        [self.actionHandlers setObject:handlerCopy forKey:identifier];
-    } else {
-        [self.actionHandlers removeObjectForKey:identifier];
+    return (object && [_entriesByObject objectForKey:object] != nil);
+}
+
+- (void)removeFirstObject
+{
+    if (_entries.count > 0) {
+        [self mr_removeEntryAtPosition:0];
     }
 }
 
-- (UILocalNotification *)buildNotificationWithDate:(NSDate *const)fireDate
-                                          timeZone:(BOOL const)timeZone
-                                          category:(NSString *const)category
-                                          userInfo:(NSDictionary *const)userInfo
+- (void)removeObject:(id const)object
 {
-    NSParameterAssert(fireDate);
-    UILocalNotification *const notification = [[UILocalNotification alloc] init];
-    notification.fireDate = fireDate;
-    if (timeZone) {
-        notification.timeZone = self.defaultTimeZone;
+    MRLocalNotificationHeapEntry_ *const entry = (object ? [_entriesByObject objectForKey:object] : nil);
+    if (entry) {
+        [self mr_removeEntryAtPosition:entry.position];
     }
-    notification.category = category;
-    notification.userInfo = userInfo;
-    return notification;
 }
 
-- (UILocalNotification *)buildNotificationWithInterval:(NSTimeInterval)fireInterval
-                                              category:(NSString *)category
-                                              userInfo:(NSDictionary *)userInfo
+- (void)removeAllObjects
 {
-    NSParameterAssert(fireInterval >= 0);
-    NSDate *const fireDate = [NSDate dateWithTimeIntervalSinceNow:fireInterval];
-    return [self buildNotificationWithDate:fireDate
-                                  timeZone:NO
-                                  category:category
-                                  userInfo:userInfo];
+    [_entries removeAllObjects];
+    [_entriesByObject removeAllObjects];
 }
 
-- (UILocalNotification *)buildNotificationWithRegion:(CLRegion *const)fireRegion
-                                        triggersOnce:(BOOL const)regionTriggersOnce
-                                            category:(NSString *const)category
-                                            userInfo:(NSDictionary *const)userInfo
+#pragma mark Private
+
+- (BOOL)mr_isEntry:(MRLocalNotificationHeapEntry_ *const)entry
+       beforeEntry:(MRLocalNotificationHeapEntry_ *const)otherEntry
 {
-    NSParameterAssert(fireRegion);
-    UILocalNotification *const notification = [[UILocalNotification alloc] init];
-    notification.region = fireRegion;
-    notification.regionTriggersOnce = regionTriggersOnce;
-    notification.category = category;
-    notification.userInfo = userInfo;
-    return notification;
+    return (entry.key < otherEntry.key ||
+            (entry.key == otherEntry.key && entry.sequence < otherEntry.sequence));
 }
 
-- (void)customizeNotificationRepeat:(UILocalNotification *const)notification
-                           interval:(NSCalendarUnit const)calendarUnit
+- (void)mr_removeEntryAtPosition:(NSUInteger const)position
 {
-    NSParameterAssert(notification);
-    notification.repeatInterval = calendarUnit;
-    notification.repeatCalendar = self.defaultCalendar;
+    MRLocalNotificationHeapEntry_ *const entry = _entries[position];
+    [_entriesByObject removeObjectForKey:entry.object];
+    NSUInteger const lastPosition = _entries.count - 1;
+    if (position != lastPosition) {
+        [self mr_swapPosition:position withPosition:lastPosition];
+    }
+    [_entries removeLastObject];
+    if (position < _entries.count) {
+        [self mr_siftDown:position];
+        [self mr_siftUp:position];
+    }
 }
 
-- (void)customizeNotificationAlert:(UILocalNotification *const)notification
-                             title:(NSString *const)alertTitle
-                              body:(NSString *const)alertBody
-                            action:(NSString *const)alertAction
-                       launchImage:(NSString *const)alertLaunchImage
+- (void)mr_swapPosition:(NSUInteger const)position withPosition:(NSUInteger const)otherPosition
 {
-    NSParameterAssert(notification);
-    if ([notification respondsToSelector:@selector(setAlertTitle:)]) {
-        notification.alertTitle = alertTitle;
-    } else if (alertTitle.length > 0) {
-        NSLog(@"setAlertTitle: not supported");
+    MRLocalNotificationHeapEntry_ *const entry = _entries[position];
+    MRLocalNotificationHeapEntry_ *const otherEntry = _entries[otherPosition];
+    [_entries exchangeObjectAtIndex:position withObjectAtIndex:otherPosition];
+    entry.position = otherPosition;
+    otherEntry.position = position;
+}
+
+- (void)mr_siftUp:(NSUInteger)position
+{
+    while (position > 0) {
+        NSUInteger const parent = (position - 1)/2;
+        MRLocalNotificationHeapEntry_ *const entry = _entries[position];
+        MRLocalNotificationHeapEntry_ *const parentEntry = _entries[parent];
+        if (![self mr_isEntry:entry beforeEntry:parentEntry]) {
+            break;
+        }
+        [self mr_swapPosition:position withPosition:parent];
+        position = parent;
     }
-    notification.alertBody = alertBody;
-    notification.alertAction = alertAction;
-    notification.hasAction = (alertAction.length > 0);
-    notification.alertLaunchImage = alertLaunchImage;
 }
 
-- (void)customizeNotification:(UILocalNotification *const)notification
-                 appIconBadge:(NSInteger const)badgeNumber
-                        sound:(BOOL const)hasSound
+- (void)mr_siftDown:(NSUInteger)position
 {
-    NSParameterAssert(notification);
-    notification.applicationIconBadgeNumber = badgeNumber;
-    if (hasSound) {
-        notification.soundName = self.defaultSoundName;
+    NSUInteger const count = _entries.count;
+    while (YES) {
+        NSUInteger const left = 2*position + 1;
+        NSUInteger const right = left + 1;
+        NSUInteger smallest = position;
+        MRLocalNotificationHeapEntry_ *smallestEntry = _entries[position];
+        if (left < count) {
+            MRLocalNotificationHeapEntry_ *const leftEntry = _entries[left];
+            if ([self mr_isEntry:leftEntry beforeEntry:smallestEntry]) {
+                smallest = left;
+                smallestEntry = leftEntry;
+            }
+        }
+        if (right < count) {
+            MRLocalNotificationHeapEntry_ *const rightEntry = _entries[right];
+            if ([self mr_isEntry:rightEntry beforeEntry:smallestEntry]) {
+                smallest = right;
+                smallestEntry = rightEntry;
+            }
+        }
+        if (smallest == position) {
+            break;
+        }
+        [self mr_swapPosition:position withPosition:smallest];
+        position = smallest;
+    }
+}
+
+#pragma mark - NSObject
+
+- (instancetype)init
+{
+    self = [super init];
+    if (self) {
+        _entries = NSMutableArray.array;
+        _entriesByObject = NSMapTable.strongToStrongObjectsMapTable;
     }
+    return self;
+}
+
+@end
+
+
+#pragma mark - MRLocalNotificationSkipList_ -
+
+
+#define kMRSkipListMaximumLevel 32
+
+
+@interface MRLocalNotificationSkipListNode_ : NSObject {
+@public
+    NSTimeInterval _key;
+    NSString *_identifier;
+    NSUInteger _level;
+    __unsafe_unretained MRLocalNotificationSkipListNode_ *_forward[kMRSkipListMaximumLevel];
+    NSUInteger _width[kMRSkipListMaximumLevel];
+}
+@end
+
+
+@implementation MRLocalNotificationSkipListNode_
+@end
+
+
+// Indexable skip list: identifiers ordered by key (ties broken by identifier), where each link
+// stores the number of positions it skips so ranks are found in O(log N).
+// Nodes are owned by the identifier map.
+@interface MRLocalNotificationSkipList_ : NSObject
+@property (nonatomic, readonly) NSUInteger count;
+@property (nonatomic, readonly) NSString *firstIdentifier;
+@property (nonatomic, readonly) NSTimeInterval firstKey;
+- (void)setKey:(NSTimeInterval)key forIdentifier:(NSString *)identifier;
+- (void)removeIdentifier:(NSString *)identifier;
+- (NSUInteger)rankOfIdentifier:(NSString *)identifier;
+- (NSUInteger)rankOfKey:(NSTimeInterval)key identifier:(NSString *)identifier;
+- (NSArray *)identifiersFromRank:(NSUInteger)rank;
+- (NSArray *)identifiersFromKey:(NSTimeInterval)startKey toKey:(NSTimeInterval)endKey;
+@end
+
+
+@implementation MRLocalNotificationSkipList_ {
+    MRLocalNotificationSkipListNode_ *_head;
+    NSMutableDictionary *_nodes;
+    NSUInteger _level;
+}
+
+- (NSUInteger)count
+{
+    return _nodes.count;
+}
+
+- (NSString *)firstIdentifier
+{
+    MRLocalNotificationSkipListNode_ *const first = _head->_forward[0];
+    return (first ? first->_identifier : nil);
+}
+
+- (NSTimeInterval)firstKey
+{
+    MRLocalNotificationSkipListNode_ *const first = _head->_forward[0];
+    return (first ? first->_key : NAN);
+}
+
+- (void)setKey:(NSTimeInterval const)key forIdentifier:(NSString *const)identifier
+{
+    NSParameterAssert(!isnan(key));
+    NSParameterAssert(identifier);
+    [self removeIdentifier:identifier];
+    __unsafe_unretained MRLocalNotificationSkipListNode_ *update[kMRSkipListMaximumLevel];
+    NSUInteger rank[kMRSkipListMaximumLevel];
+    [self mr_findKey:key identifier:identifier update:update rank:rank];
+    NSUInteger level = 1;
+    while (level < kMRSkipListMaximumLevel && (arc4random() & 3) == 0) {
+        level += 1;
+    }
+    for (NSUInteger index = _level; index < level; index++) {
+        rank[index] = 0;
+        update[index] = _head;
+        _head->_width[index] = _nodes.count;
+    }
+    _level = MAX(_level, level);
+    MRLocalNotificationSkipListNode_ *const node = MRLocalNotificationSkipListNode_.new;
+    node->_key = key;
+    node->_identifier = identifier.copy;
+    node->_level = level;
+    for (NSUInteger index = 0; index < level; index++) {
+        node->_forward[index] = update[index]->_forward[index];
+        update[index]->_forward[index] = node;
+        node->_width[index] = update[index]->_width[index] - (rank[0] - rank[index]);
+        update[index]->_width[index] = (rank[0] - rank[index]) + 1;
+    }
+    for (NSUInteger index = level; index < _level; index++) {
+        update[index]->_width[index] += 1;
+    }
+    _nodes[node->_identifier] = node;
+}
+
+- (void)removeIdentifier:(NSString *const)identifier
+{
+    NSParameterAssert(identifier);
+    MRLocalNotificationSkipListNode_ *const node = _nodes[identifier];
+    if (node == nil) {
+        return;
+    }
+    __unsafe_unretained MRLocalNotificationSkipListNode_ *update[kMRSkipListMaximumLevel];
+    NSUInteger rank[kMRSkipListMaximumLevel];
+    [self mr_findKey:node->_key identifier:identifier update:update rank:rank];
+    for (NSUInteger index = 0; index < _level; index++) {
+        if (update[index]->_forward[index] == node) {
+            update[index]->_width[index] += node->_width[index] - 1;
+            update[index]->_forward[index] = node->_forward[index];
+        } else {
+            update[index]->_width[index] -= 1;
+        }
+    }
+    while (_level > 1 && _head->_forward[_level - 1] == nil) {
+        _level -= 1;
+    }
+    [_nodes removeObjectForKey:identifier];
+}
+
+- (NSUInteger)rankOfIdentifier:(NSString *const)identifier
+{
+    NSParameterAssert(identifier);
+    MRLocalNotificationSkipListNode_ *const node = _nodes[identifier];
+    if (node == nil) {
+        return NSNotFound;
+    }
+    return [self rankOfKey:node->_key identifier:identifier];
+}
+
+- (NSUInteger)rankOfKey:(NSTimeInterval const)key identifier:(NSString *const)identifier
+{
+    __unsafe_unretained MRLocalNotificationSkipListNode_ *update[kMRSkipListMaximumLevel];
+    NSUInteger rank[kMRSkipListMaximumLevel];
+    [self mr_findKey:key identifier:identifier update:update rank:rank];
+    return rank[0];
+}
+
+- (NSArray *)identifiersFromRank:(NSUInteger const)rank
+{
+    NSUInteger const count = _nodes.count;
+    NSMutableArray *const identifiers = [NSMutableArray arrayWithCapacity:(rank < count ? count - rank : 0)];
+    __unsafe_unretained MRLocalNotificationSkipListNode_ *node = _head;
+    NSUInteger traversed = 0;
+    for (NSUInteger index = _level; index > 0; index--) {
+        while (node->_forward[index - 1] && traversed + node->_width[index - 1] <= rank) {
+            traversed += node->_width[index - 1];
+            node = node->_forward[index - 1];
+        }
+    }
+    node = node->_forward[0];
+    while (node) {
+        [identifiers addObject:node->_identifier];
+        node = node->_forward[0];
+    }
+    return identifiers;
+}
+
+- (NSArray *)identifiersFromKey:(NSTimeInterval const)startKey toKey:(NSTimeInterval const)endKey
+{
+    NSMutableArray *const identifiers = NSMutableArray.array;
+    __unsafe_unretained MRLocalNotificationSkipListNode_ *node = _head;
+    for (NSUInteger index = _level; index > 0; index--) {
+        while (node->_forward[index - 1] && node->_forward[index - 1]->_key < startKey) {
+            node = node->_forward[index - 1];
+        }
+    }
+    node = node->_forward[0];
+    while (node && node->_key < endKey) {
+        [identifiers addObject:node->_identifier];
+        node = node->_forward[0];
+    }
+    return identifiers;
+}
+
+#pragma mark Private
+
+- (void)mr_findKey:(NSTimeInterval const)key
+        identifier:(NSString *const)identifier
+            update:(__unsafe_unretained MRLocalNotificationSkipListNode_ **const)update
+              rank:(NSUInteger *const)rank
+{
+    __unsafe_unretained MRLocalNotificationSkipListNode_ *node = _head;
+    for (NSUInteger index = _level; index > 0; index--) {
+        rank[index - 1] = (index == _level ? 0 : rank[index]);
+        MRLocalNotificationSkipListNode_ *next = node->_forward[index - 1];
+        while (next && (next->_key < key ||
+                        (next->_key == key && [next->_identifier compare:identifier] == NSOrderedAscending))) {
+            rank[index - 1] += node->_width[index - 1];
+            node = next;
+            next = node->_forward[index - 1];
+        }
+        update[index - 1] = node;
+    }
+}
+
+#pragma mark - NSObject
+
+- (instancetype)init
+{
+    self = [super init];
+    if (self) {
+        _head = MRLocalNotificationSkipListNode_.new;
+        _head->_level = kMRSkipListMaximumLevel;
+        _nodes = NSMutableDictionary.dictionary;
+        _level = 1;
+    }
+    return self;
+}
+
+@end
+
+
+#pragma mark - MRLocalNotificationRegionIndex_ -
+
+
+static double const kMREarthRadius = 6371008.8;
+static double const kMRRegionIndexCellDegrees = 0.1;
+
+static double MRDistanceBetweenCoordinates_(double const latitude1, double const longitude1,
+                                            double const latitude2, double const longitude2)
+{
+    double const radians = M_PI/180;
+    double const sinLatitude = sin((latitude2 - latitude1)*radians/2);
+    double const sinLongitude = sin((longitude2 - longitude1)*radians/2);
+    double const haversine = (sinLatitude*sinLatitude +
+                              cos(latitude1*radians)*cos(latitude2*radians)*sinLongitude*sinLongitude);
+    return 2*kMREarthRadius*asin(MIN(1, sqrt(haversine)));
+}
+
+
+@interface MRLocalNotificationRegionEntry_ : NSObject {
+@public
+    NSString *_identifier;
+    double _latitude;
+    double _longitude;
+    double _radius;
+    int64_t _cell;
+}
+@end
+
+
+@implementation MRLocalNotificationRegionEntry_
+@end
+
+
+// Uniform latitude/longitude grid of circular regions. Nearest queries visit rings of cells
+// around the query point until no unvisited cell can hold a closer region. Distances are
+// measured to the region boundary (zero inside the region).
+@interface MRLocalNotificationRegionIndex_ : NSObject
+@property (nonatomic, readonly) NSUInteger count;
+- (instancetype)initWithCellDegrees:(double)cellDegrees;
+- (void)setLatitude:(double)latitude
+          longitude:(double)longitude
+             radius:(double)radius
+      forIdentifier:(NSString *)identifier;
+- (void)removeIdentifier:(NSString *)identifier;
+- (void)removeAllIdentifiers;
+- (NSArray *)identifiersNearestToLatitude:(double)latitude
+                                longitude:(double)longitude
+                                    count:(NSUInteger)count;
+@end
+
+
+@implementation MRLocalNotificationRegionIndex_ {
+    double _cellDegrees;
+    int64_t _rows;
+    int64_t _columns;
+    double _maximumRadius;
+    NSMutableDictionary *_entries;
+    NSMutableDictionary *_cells;
+}
+
+- (instancetype)initWithCellDegrees:(double const)cellDegrees
+{
+    NSParameterAssert(cellDegrees > 0 && cellDegrees <= 180);
+    self = [super init];
+    if (self) {
+        _cellDegrees = cellDegrees;
+        _rows = (int64_t)ceil(180/cellDegrees);
+        _columns = (int64_t)ceil(360/cellDegrees);
+        _entries = NSMutableDictionary.dictionary;
+        _cells = NSMutableDictionary.dictionary;
+    }
+    return self;
+}
+
+- (NSUInteger)count
+{
+    return _entries.count;
+}
+
+- (void)setLatitude:(double const)latitude
+          longitude:(double const)longitude
+             radius:(double const)radius
+      forIdentifier:(NSString *const)identifier
+{
+    NSParameterAssert(identifier);
+    NSParameterAssert(radius >= 0);
+    [self removeIdentifier:identifier];
+    MRLocalNotificationRegionEntry_ *const entry = MRLocalNotificationRegionEntry_.new;
+    entry->_identifier = identifier.copy;
+    entry->_latitude = latitude;
+    entry->_longitude = longitude;
+    entry->_radius = radius;
+    entry->_cell = ([self mr_rowForLatitude:latitude]*_columns +
+                    [self mr_columnForLongitude:longitude]);
+    NSNumber *const cellKey = @(entry->_cell);
+    NSMutableArray *cell = _cells[cellKey];
+    if (cell == nil) {
+        cell = NSMutableArray.array;
+        _cells[cellKey] = cell;
+    }
+    [cell addObject:entry];
+    _entries[entry->_identifier] = entry;
+    _maximumRadius = MAX(_maximumRadius, radius);
+}
+
+- (void)removeIdentifier:(NSString *const)identifier
+{
+    NSParameterAssert(identifier);
+    MRLocalNotificationRegionEntry_ *const entry = _entries[identifier];
+    if (entry == nil) {
+        return;
+    }
+    NSNumber *const cellKey = @(entry->_cell);
+    NSMutableArray *const cell = _cells[cellKey];
+    [cell removeObjectIdenticalTo:entry];
+    if (cell.count == 0) {
+        [_cells removeObjectForKey:cellKey];
+    }
+    [_entries removeObjectForKey:identifier];
+    if (_entries.count == 0) {
+        _maximumRadius = 0;
+    }
+}
+
+- (void)removeAllIdentifiers
+{
+    [_entries removeAllObjects];
+    [_cells removeAllObjects];
+    _maximumRadius = 0;
+}
+
+- (NSArray *)identifiersNearestToLatitude:(double const)latitude
+                                longitude:(double const)longitude
+                                    count:(NSUInteger const)count
+{
+    NSUInteger const limit = MIN(count, _entries.count);
+    if (limit == 0) {
+        return @[];
+    }
+    // Sorted by distance; entries stay retained by _entries during the query.
+    double *const distances = malloc(limit*sizeof(double));
+    __unsafe_unretained MRLocalNotificationRegionEntry_ **const nearest =
+        (__unsafe_unretained MRLocalNotificationRegionEntry_ **)calloc(limit, sizeof(id));
+    NSUInteger found = 0;
+    int64_t const row = [self mr_rowForLatitude:latitude];
+    int64_t const column = [self mr_columnForLongitude:longitude];
+    int64_t const firstOffset = -(_columns/2);
+    int64_t const lastOffset = _columns - 1 + firstOffset;
+    int64_t const lastRing = MAX(_rows, -firstOffset);
+    for (int64_t ring = 0; ring <= lastRing; ring++) {
+        if (found == limit &&
+            [self mr_minimumDistanceToRing:ring latitude:latitude] - _maximumRadius > distances[limit - 1]) {
+            break;
+        }
+        if ((2*ring + 1)*(2*ring + 1) > 4*(int64_t)_cells.count) {
+            // Sparse grid (or polar query): scanning every entry is cheaper than more rings.
+            found = 0;
+            for (MRLocalNotificationRegionEntry_ *const entry in _entries.objectEnumerator) {
+                found = [self mr_insertEntry:entry
+                                    latitude:latitude
+                                   longitude:longitude
+                                   distances:distances
+                                     nearest:nearest
+                                       found:found
+                                       limit:limit];
+            }
+            break;
+        }
+        for (int64_t rowOffset = -ring; rowOffset <= ring; rowOffset++) {
+            int64_t const cellRow = row + rowOffset;
+            if (cellRow < 0 || cellRow >= _rows) {
+                continue;
+            }
+            BOOL const isEdgeRow = (rowOffset == -ring || rowOffset == ring);
+            int64_t const step = (isEdgeRow ? 1 : 2*ring);
+            for (int64_t columnOffset = -ring; columnOffset <= ring; columnOffset += step) {
+                if (columnOffset < firstOffset || columnOffset > lastOffset) {
+                    continue;
+                }
+                int64_t const cellColumn = (column + columnOffset + _columns)%_columns;
+                for (MRLocalNotificationRegionEntry_ *const entry in _cells[@(cellRow*_columns + cellColumn)]) {
+                    found = [self mr_insertEntry:entry
+                                        latitude:latitude
+                                       longitude:longitude
+                                       distances:distances
+                                         nearest:nearest
+                                           found:found
+                                           limit:limit];
+                }
+            }
+        }
+    }
+    NSMutableArray *const identifiers = [NSMutableArray arrayWithCapacity:found];
+    for (NSUInteger index = 0; index < found; index++) {
+        [identifiers addObject:nearest[index]->_identifier];
+    }
+    free(nearest);
+    free(distances);
+    return identifiers;
+}
+
+#pragma mark Private
+
+- (NSUInteger)mr_insertEntry:(MRLocalNotificationRegionEntry_ *const)entry
+                    latitude:(double const)latitude
+                   longitude:(double const)longitude
+                   distances:(double *const)distances
+                     nearest:(__unsafe_unretained MRLocalNotificationRegionEntry_ **const)nearest
+                       found:(NSUInteger)found
+                       limit:(NSUInteger const)limit
+{
+    double const distance = MAX(0, MRDistanceBetweenCoordinates_(latitude, longitude,
+                                                                 entry->_latitude,
+                                                                 entry->_longitude) - entry->_radius);
+    if (found == limit && distance >= distances[limit - 1]) {
+        return found;
+    }
+    NSUInteger position = (found < limit ? found++ : limit - 1);
+    while (position > 0 && distances[position - 1] > distance) {
+        distances[position] = distances[position - 1];
+        nearest[position] = nearest[position - 1];
+        position -= 1;
+    }
+    distances[position] = distance;
+    nearest[position] = entry;
+    return found;
+}
+
+- (int64_t)mr_rowForLatitude:(double const)latitude
+{
+    int64_t const row = (int64_t)floor((latitude + 90)/_cellDegrees);
+    return MIN(MAX(row, 0), _rows - 1);
+}
+
+- (int64_t)mr_columnForLongitude:(double const)longitude
+{
+    int64_t const column = (int64_t)floor((longitude + 180)/_cellDegrees)%_columns;
+    return (column < 0 ? column + _columns : column);
+}
+
+- (double)mr_minimumDistanceToRing:(int64_t const)ring latitude:(double const)latitude
+{
+    // The query point may be anywhere in its cell, so a cell `ring` steps away is at least
+    // `ring - 1` cells apart along the latitude or along the longitude.
+    if (ring < 2) {
+        return 0;
+    }
+    double const radians = M_PI/180;
+    double const angle = (ring - 1)*_cellDegrees*radians;
+    double const latitudeDistance = kMREarthRadius*angle;
+    double const highestLatitude = MIN(90, fabs(latitude) + (ring + 1)*_cellDegrees);
+    double const longitudeDistance = (ring > _columns/2
+                                      ? INFINITY
+                                      : 2*kMREarthRadius*asin(cos(highestLatitude*radians)*sin(MIN(angle, M_PI)/2)));
+    return MIN(latitudeDistance, longitudeDistance);
+}
+
+@end
+
+
+#pragma mark - MRLocalNotificationJournal_ -
+
+
+typedef enum {
+    MRLocalNotificationJournalSchedule_  = 1,
+    MRLocalNotificationJournalCancel_    = 2,
+    MRLocalNotificationJournalCancelAll_ = 3,
+} MRLocalNotificationJournalOperation_;
+
+// Fixed-size journal record; the archived notification (if any) follows the record in the file.
+typedef struct {
+    uint32_t operation;
+    uint32_t categoryHash;
+    uint64_t identifierHash;
+    double fireDate;
+    uint64_t repeatInterval;
+    uint64_t payloadOffset;
+    uint64_t payloadLength;
+} MRLocalNotificationJournalRecord_;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+} MRLocalNotificationJournalHeader_;
+
+static uint32_t const kMRLocalNotificationJournalMagic = 0x4a4c524d;
+static uint32_t const kMRLocalNotificationJournalVersion = 1;
+static NSUInteger const kMRLocalNotificationJournalCompactionThreshold = 1024;
+
+static uint64_t MRLocalNotificationHash64_(NSString *const string)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    const char *bytes = string.UTF8String;
+    while (bytes && *bytes) {
+        hash ^= (uint8_t)*bytes++;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+
+// Append-only binary log of schedule and cancel operations.
+@interface MRLocalNotificationJournal_ : NSObject
+- (instancetype)initWithDirectoryURL:(NSURL *)directoryURL;
+- (void)appendNotification:(UILocalNotification *)notification
+                identifier:(NSString *)identifier
+                  fireDate:(NSDate *)gmtFireDate;
+- (void)appendCancellationWithIdentifier:(NSString *)identifier;
+- (void)appendCancellationOfAllNotifications;
+- (NSArray *)pendingNotificationsAtTime:(NSTimeInterval)now;
+- (void)compact;
+@property (nonatomic, readonly) BOOL replayed;
+@end
+
+
+@implementation MRLocalNotificationJournal_ {
+    dispatch_queue_t _queue;
+    NSURL *_fileURL;
+    int _fileDescriptor;
+    BOOL _replayed;
+    NSData *_mappedData;
+    uint64_t _fileLength;
+    NSMutableDictionary *_records;
+    NSUInteger _recordCount;
+}
+
+- (instancetype)initWithDirectoryURL:(NSURL *const)directoryURL
+{
+    NSParameterAssert(directoryURL);
+    self = [super init];
+    if (self) {
+        _queue = dispatch_queue_create("MRLocalNotificationJournal", DISPATCH_QUEUE_SERIAL);
+        _fileURL = [directoryURL URLByAppendingPathComponent:@"MRLocalNotificationJournal.bin"];
+        _fileDescriptor = -1;
+        _records = NSMutableDictionary.dictionary;
+        dispatch_async(_queue, ^{
+            NSFileManager *const fileManager = NSFileManager.defaultManager;
+            [fileManager createDirectoryAtURL:directoryURL
+                  withIntermediateDirectories:YES
+                                   attributes:nil
+                                        error:NULL];
+            [self mr_replay];
+            __atomic_store_n(&_replayed, YES, __ATOMIC_RELEASE);
+        });
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    if (_fileDescriptor >= 0) {
+        close(_fileDescriptor);
+    }
+}
+
+- (BOOL)replayed
+{
+    return __atomic_load_n(&_replayed, __ATOMIC_ACQUIRE);
+}
+
+- (void)appendNotification:(UILocalNotification *const)notification
+                identifier:(NSString *const)identifier
+                  fireDate:(NSDate *const)gmtFireDate
+{
+    NSParameterAssert(notification);
+    NSParameterAssert(identifier);
+    MRLocalNotificationJournalRecord_ record = {0};
+    record.operation = MRLocalNotificationJournalSchedule_;
+    record.identifierHash = MRLocalNotificationHash64_(identifier);
+    record.categoryHash = (uint32_t)MRLocalNotificationHash64_(notification.category);
+    record.fireDate = (gmtFireDate ? gmtFireDate.timeIntervalSinceReferenceDate : NAN);
+    record.repeatInterval = notification.repeatInterval;
+    NSData *const payload = [NSKeyedArchiver archivedDataWithRootObject:notification];
+    dispatch_async(_queue, ^{
+        [self mr_appendRecord:record payload:payload];
+    });
+}
+
+- (void)appendCancellationWithIdentifier:(NSString *const)identifier
+{
+    NSParameterAssert(identifier);
+    MRLocalNotificationJournalRecord_ record = {0};
+    record.operation = MRLocalNotificationJournalCancel_;
+    record.identifierHash = MRLocalNotificationHash64_(identifier);
+    dispatch_async(_queue, ^{
+        [self mr_appendRecord:record payload:nil];
+    });
+}
+
+- (void)appendCancellationOfAllNotifications
+{
+    MRLocalNotificationJournalRecord_ record = {0};
+    record.operation = MRLocalNotificationJournalCancelAll_;
+    dispatch_async(_queue, ^{
+        [self mr_appendRecord:record payload:nil];
+    });
+}
+
+- (NSArray *)pendingNotificationsAtTime:(NSTimeInterval const)now
+{
+    NSMutableArray *const notifications = NSMutableArray.array;
+    dispatch_sync(_queue, ^{
+        for (NSValue *const value in _records.objectEnumerator) {
+            MRLocalNotificationJournalRecord_ record;
+            [value getValue:&record];
+            if (record.repeatInterval == 0 && !isnan(record.fireDate) && record.fireDate < now) {
+                continue;
+            }
+            NSData *const payload = [self mr_payloadForRecord:record];
+            UILocalNotification *const notification = (payload
+                                                       ? [NSKeyedUnarchiver unarchiveObjectWithData:payload]
+                                                       : nil);
+            if ([notification isKindOfClass:UILocalNotification.class]) {
+                [notifications addObject:notification];
+            }
+        }
+    });
+    return notifications;
+}
+
+- (void)compact
+{
+    dispatch_async(_queue, ^{
+        [self mr_compact];
+    });
+}
+
+#pragma mark Private
+
+- (void)mr_replay
+{
+    NSData *const data = [NSData dataWithContentsOfURL:_fileURL
+                                               options:NSDataReadingMappedAlways
+                                                 error:NULL];
+    MRLocalNotificationJournalHeader_ header = {0};
+    if (data.length >= sizeof(header)) {
+        [data getBytes:&header length:sizeof(header)];
+    }
+    if (header.magic != kMRLocalNotificationJournalMagic ||
+        header.version != kMRLocalNotificationJournalVersion) {
+        [self mr_writeData:NSData.data records:@{}];
+        return;
+    }
+    _mappedData = data;
+    uint64_t offset = sizeof(header);
+    uint64_t const length = data.length;
+    while (offset + sizeof(MRLocalNotificationJournalRecord_) <= length) {
+        MRLocalNotificationJournalRecord_ record;
+        [data getBytes:&record range:NSMakeRange((NSUInteger)offset, sizeof(record))];
+        uint64_t const end = offset + sizeof(record) + record.payloadLength;
+        if (end > length) {
+            break;
+        }
+        [self mr_applyRecord:record];
+        offset = end;
+    }
+    _fileLength = offset;
+    [self mr_openFile];
+    if (_fileDescriptor >= 0 && ftruncate(_fileDescriptor, (off_t)_fileLength) != 0) {
+        NSLog(@"unable to truncate notifications journal at %@: %s", _fileURL, strerror(errno));
+    }
+}
+
+- (void)mr_applyRecord:(MRLocalNotificationJournalRecord_ const)record
+{
+    _recordCount += 1;
+    switch (record.operation) {
+        case MRLocalNotificationJournalSchedule_:
+            _records[@(record.identifierHash)] = [NSValue valueWithBytes:&record
+                                                                objCType:@encode(MRLocalNotificationJournalRecord_)];
+            break;
+        case MRLocalNotificationJournalCancel_:
+            [_records removeObjectForKey:@(record.identifierHash)];
+            break;
+        case MRLocalNotificationJournalCancelAll_:
+            [_records removeAllObjects];
+            break;
+    }
+}
+
+- (void)mr_appendRecord:(MRLocalNotificationJournalRecord_)record payload:(NSData *const)payload
+{
+    record.payloadLength = payload.length;
+    record.payloadOffset = (payload ? _fileLength + sizeof(record) : 0);
+    NSMutableData *const data = [NSMutableData dataWithBytes:&record length:sizeof(record)];
+    if (payload) {
+        [data appendData:payload];
+    }
+    // Unlike NSFileHandle, write errors (such as a full disk) are reported instead of raised.
+    if (![self mr_writeBytes:data.bytes length:data.length atOffset:_fileLength]) {
+        NSLog(@"unable to append to notifications journal at %@: %s", _fileURL, strerror(errno));
+        if (_fileDescriptor >= 0) {
+            ftruncate(_fileDescriptor, (off_t)_fileLength);
+        }
+        return;
+    }
+    _fileLength += data.length;
+    [self mr_applyRecord:record];
+    if (_recordCount > kMRLocalNotificationJournalCompactionThreshold &&
+        _recordCount > 2*_records.count) {
+        [self mr_compact];
+    }
+}
+
+- (NSData *)mr_payloadForRecord:(MRLocalNotificationJournalRecord_ const)record
+{
+    if (record.payloadLength == 0) {
+        return nil;
+    }
+    uint64_t const end = record.payloadOffset + record.payloadLength;
+    if (end > _mappedData.length) {
+        _mappedData = [NSData dataWithContentsOfURL:_fileURL
+                                            options:NSDataReadingMappedAlways
+                                              error:NULL];
+    }
+    if (end > _mappedData.length) {
+        return nil;
+    }
+    NSRange const range = NSMakeRange((NSUInteger)record.payloadOffset, (NSUInteger)record.payloadLength);
+    return [_mappedData subdataWithRange:range];
+}
+
+- (void)mr_compact
+{
+    NSMutableData *const data = NSMutableData.data;
+    NSMutableDictionary *const records = [NSMutableDictionary dictionaryWithCapacity:_records.count];
+    uint64_t const headerLength = sizeof(MRLocalNotificationJournalHeader_);
+    for (NSNumber *const key in _records) {
+        MRLocalNotificationJournalRecord_ record;
+        [_records[key] getValue:&record];
+        NSData *const payload = [self mr_payloadForRecord:record];
+        record.payloadLength = payload.length;
+        record.payloadOffset = (payload ? headerLength + data.length + sizeof(record) : 0);
+        [data appendBytes:&record length:sizeof(record)];
+        if (payload) {
+            [data appendData:payload];
+        }
+        records[key] = [NSValue valueWithBytes:&record
+                                      objCType:@encode(MRLocalNotificationJournalRecord_)];
+    }
+    [self mr_writeData:data records:records];
+}
+
+- (void)mr_writeData:(NSData *const)recordsData records:(NSDictionary *const)records
+{
+    MRLocalNotificationJournalHeader_ const header = { kMRLocalNotificationJournalMagic,
+                                                       kMRLocalNotificationJournalVersion };
+    NSMutableData *const data = [NSMutableData dataWithBytes:&header length:sizeof(header)];
+    [data appendData:recordsData];
+    if (_fileDescriptor >= 0) {
+        close(_fileDescriptor);
+        _fileDescriptor = -1;
+    }
+    if (![data writeToURL:_fileURL atomically:YES]) {
+        NSLog(@"unable to write notifications journal at %@", _fileURL);
+    }
+    _records = records.mutableCopy;
+    _recordCount = records.count;
+    _fileLength = data.length;
+    _mappedData = [NSData dataWithContentsOfURL:_fileURL
+                                        options:NSDataReadingMappedAlways
+                                          error:NULL];
+    [self mr_openFile];
+}
+
+- (void)mr_openFile
+{
+    _fileDescriptor = open(_fileURL.fileSystemRepresentation, O_WRONLY | O_CLOEXEC);
+    if (_fileDescriptor < 0) {
+        NSLog(@"unable to open notifications journal at %@: %s", _fileURL, strerror(errno));
+    }
+}
+
+- (BOOL)mr_writeBytes:(const void *const)bytes length:(size_t const)length atOffset:(uint64_t const)offset
+{
+    if (_fileDescriptor < 0) {
+        errno = EBADF;
+        return NO;
+    }
+    size_t written = 0;
+    while (written < length) {
+        ssize_t const result = pwrite(_fileDescriptor, (const char *)bytes + written, length - written,
+                                      (off_t)(offset + written));
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            errno = (result == 0 ? EIO : errno);
+            return NO;
+        }
+        written += (size_t)result;
+    }
+    return YES;
+}
+
+@end
+
+
+#pragma mark - MRLocalNotificationPayloadStore_ -
+
+
+static NSUInteger const kMRPayloadStoreCacheCapacity = 64;
+
+
+// Payloads are stored as binary property lists named after their SHA-1 digest.
+@interface MRLocalNotificationPayloadStore_ : NSObject
+- (instancetype)initWithDirectoryURL:(NSURL *)directoryURL;
+- (NSString *)storePayload:(NSDictionary *)payload;
+- (NSDictionary *)payloadForKey:(NSString *)key;
+- (void)removePayloadForKey:(NSString *)key;
+- (void)removePayloadsExceptForKeys:(NSSet *)keys;
+- (void)removeAllPayloads;
+@end
+
+
+@implementation MRLocalNotificationPayloadStore_ {
+    dispatch_queue_t _queue;
+    NSURL *_directoryURL;
+    NSMutableDictionary *_cache;
+    NSMutableOrderedSet *_recentKeys;
+}
+
+- (instancetype)initWithDirectoryURL:(NSURL *const)directoryURL
+{
+    NSParameterAssert(directoryURL);
+    self = [super init];
+    if (self) {
+        _queue = dispatch_queue_create("MRLocalNotificationPayloadStore", DISPATCH_QUEUE_SERIAL);
+        _directoryURL = directoryURL;
+        _cache = [NSMutableDictionary dictionaryWithCapacity:kMRPayloadStoreCacheCapacity];
+        _recentKeys = [NSMutableOrderedSet orderedSetWithCapacity:kMRPayloadStoreCacheCapacity];
+        dispatch_async(_queue, ^{
+            NSFileManager *const fileManager = NSFileManager.defaultManager;
+            [fileManager createDirectoryAtURL:directoryURL
+                  withIntermediateDirectories:YES
+                                   attributes:nil
+                                        error:NULL];
+        });
+    }
+    return self;
+}
+
+- (NSString *)storePayload:(NSDictionary *const)payload
+{
+    NSParameterAssert(payload);
+    NSData *const data = [NSPropertyListSerialization dataWithPropertyList:payload
+                                                                    format:NSPropertyListBinaryFormat_v1_0
+                                                                   options:0
+                                                                     error:NULL];
+    if (data == nil) {
+        NSLog(@"unable to serialize notification payload");
+        return nil;
+    }
+    unsigned char digest[CC_SHA1_DIGEST_LENGTH];
+    CC_SHA1(data.bytes, (CC_LONG)data.length, digest);
+    NSMutableString *const key = [NSMutableString stringWithCapacity:CC_SHA1_DIGEST_LENGTH*2];
+    for (NSUInteger index = 0; index < CC_SHA1_DIGEST_LENGTH; index++) {
+        [key appendFormat:@"%02x", digest[index]];
+    }
+    NSDictionary *const payloadCopy = payload.copy;
+    dispatch_async(_queue, ^{
+        [self mr_cachePayload:payloadCopy forKey:key];
+        NSURL *const fileURL = [self mr_fileURLForKey:key];
+        if (![fileURL checkResourceIsReachableAndReturnError:NULL] &&
+            ![data writeToURL:fileURL atomically:YES]) {
+            NSLog(@"unable to write notification payload at %@", fileURL);
+        }
+    });
+    return key;
+}
+
+- (NSDictionary *)payloadForKey:(NSString *const)key
+{
+    NSParameterAssert(key);
+    __block NSDictionary *payload;
+    dispatch_sync(_queue, ^{
+        payload = _cache[key];
+        if (payload == nil) {
+            NSData *const data = [NSData dataWithContentsOfURL:[self mr_fileURLForKey:key]];
+            id const plist = (data
+                              ? [NSPropertyListSerialization propertyListWithData:data
+                                                                          options:NSPropertyListImmutable
+                                                                           format:NULL
+                                                                            error:NULL]
+                              : nil);
+            payload = ([plist isKindOfClass:NSDictionary.class] ? plist : nil);
+        }
+        if (payload) {
+            [self mr_cachePayload:payload forKey:key];
+        }
+    });
+    return payload;
+}
+
+- (void)removePayloadForKey:(NSString *const)key
+{
+    NSParameterAssert(key);
+    dispatch_async(_queue, ^{
+        [_cache removeObjectForKey:key];
+        [_recentKeys removeObject:key];
+        NSFileManager *const fileManager = NSFileManager.defaultManager;
+        [fileManager removeItemAtURL:[self mr_fileURLForKey:key] error:NULL];
+    });
+}
+
+- (void)removePayloadsExceptForKeys:(NSSet *const)keys
+{
+    NSParameterAssert(keys);
+    NSSet *const keptKeys = keys.copy;
+    dispatch_async(_queue, ^{
+        for (NSString *const key in _cache.allKeys) {
+            if (![keptKeys containsObject:key]) {
+                [_cache removeObjectForKey:key];
+                [_recentKeys removeObject:key];
+            }
+        }
+        NSFileManager *const fileManager = NSFileManager.defaultManager;
+        NSArray *const fileURLs = [fileManager contentsOfDirectoryAtURL:_directoryURL
+                                             includingPropertiesForKeys:nil
+                                                                options:0
+                                                                  error:NULL];
+        for (NSURL *const fileURL in fileURLs) {
+            if ([fileURL.pathExtension isEqualToString:@"plist"] &&
+                ![keptKeys containsObject:fileURL.URLByDeletingPathExtension.lastPathComponent]) {
+                [fileManager removeItemAtURL:fileURL error:NULL];
+            }
+        }
+    });
+}
+
+- (void)removeAllPayloads
+{
+    dispatch_async(_queue, ^{
+        [_cache removeAllObjects];
+        [_recentKeys removeAllObjects];
+        NSFileManager *const fileManager = NSFileManager.defaultManager;
+        NSArray *const fileURLs = [fileManager contentsOfDirectoryAtURL:_directoryURL
+                                             includingPropertiesForKeys:nil
+                                                                options:0
+                                                                  error:NULL];
+        for (NSURL *const fileURL in fileURLs) {
+            if ([fileURL.pathExtension isEqualToString:@"plist"]) {
+                [fileManager removeItemAtURL:fileURL error:NULL];
+            }
+        }
+    });
+}
+
+#pragma mark Private
+
+- (NSURL *)mr_fileURLForKey:(NSString *const)key
+{
+    return [[_directoryURL URLByAppendingPathComponent:key] URLByAppendingPathExtension:@"plist"];
+}
+
+- (void)mr_cachePayload:(NSDictionary *const)payload forKey:(NSString *const)key
+{
+    [_recentKeys removeObject:key];
+    [_recentKeys addObject:key];
+    _cache[key] = payload;
+    while (_recentKeys.count > kMRPayloadStoreCacheCapacity) {
+        NSString *const leastRecentKey = _recentKeys.firstObject;
+        [_recentKeys removeObjectAtIndex:0];
+        [_cache removeObjectForKey:leastRecentKey];
+    }
+}
+
+@end
+
+
+#pragma mark - MRTimeZoneTransitionTable_ -
+
+
+static NSTimeInterval const kMRTimeZoneTableYear = 365.2425*86400;
+
+// Years covered by the table, relative to the reference date (1970 to 2100).
+static NSInteger const kMRTimeZoneTableFirstYear = -31;
+enum {
+    kMRTimeZoneTableYears = 130
+};
+
+// Offsets of one year of the table; the first transition is the start of the year.
+typedef struct {
+    NSUInteger count;
+    NSTimeInterval *transitions;
+    NSTimeInterval *offsets;
+} MRTimeZoneTransitionYear_;
+
+// Table of the UTC offsets of a time zone, searchable by binary search.
+// Years are built on first use from the transitions of the time zone and never change afterwards, so lookups take no lock.
+@interface MRTimeZoneTransitionTable_ : NSObject
+@property (nonatomic, readonly) NSTimeZone *timeZone;
+- (instancetype)initWithTimeZone:(NSTimeZone *)timeZone;
+- (NSTimeInterval)secondsFromGMTForTimeInterval:(NSTimeInterval)timeInterval;
+- (NSTimeInterval)timeIntervalFromLocalTimeInterval:(NSTimeInterval)localTime;
+@end
+
+
+@implementation MRTimeZoneTransitionTable_ {
+    MRTimeZoneTransitionYear_ *_years[kMRTimeZoneTableYears];
+}
+
+- (instancetype)initWithTimeZone:(NSTimeZone *const)timeZone
+{
+    NSParameterAssert(timeZone);
+    self = [super init];
+    if (self) {
+        _timeZone = timeZone;
+    }
+    return self;
+}
+
+- (NSTimeInterval)secondsFromGMTForTimeInterval:(NSTimeInterval const)timeInterval
+{
+    double const yearIndex = floor(timeInterval/kMRTimeZoneTableYear) - kMRTimeZoneTableFirstYear;
+    if (!(yearIndex >= 0 && yearIndex < kMRTimeZoneTableYears)) {
+        return [self mr_sampleOffsetAtTime:timeInterval];
+    }
+    MRTimeZoneTransitionYear_ *year = __atomic_load_n(&_years[(NSUInteger)yearIndex], __ATOMIC_ACQUIRE);
+    if (year == NULL) {
+        year = [self mr_yearAtIndex:(NSUInteger)yearIndex];
+    }
+    NSUInteger low = 0;
+    NSUInteger high = year->count;
+    while (high - low > 1) {
+        NSUInteger const middle = (low + high)/2;
+        if (year->transitions[middle] <= timeInterval) {
+            low = middle;
+        } else {
+            high = middle;
+        }
+    }
+    return year->offsets[low];
+}
+
+- (NSTimeInterval)timeIntervalFromLocalTimeInterval:(NSTimeInterval const)localTime
+{
+    // Like NSCalendar, repeated local times resolve to their first occurrence and skipped ones move forward by the length of the gap.
+    NSTimeInterval const offsetBefore = [self secondsFromGMTForTimeInterval:localTime - 86400];
+    NSTimeInterval const offsetAfter = [self secondsFromGMTForTimeInterval:localTime + 86400];
+    NSTimeInterval const timeBefore = localTime - offsetBefore;
+    if (offsetBefore == offsetAfter) {
+        return timeBefore;
+    }
+    NSTimeInterval const timeAfter = localTime - offsetAfter;
+    BOOL const isTimeBeforeValid = ([self secondsFromGMTForTimeInterval:timeBefore] == offsetBefore);
+    BOOL const isTimeAfterValid = ([self secondsFromGMTForTimeInterval:timeAfter] == offsetAfter);
+    if (isTimeBeforeValid && isTimeAfterValid) {
+        return MIN(timeBefore, timeAfter);
+    }
+    return (isTimeAfterValid ? timeAfter : timeBefore);
+}
+
+#pragma mark Private
+
+- (NSTimeInterval)mr_sampleOffsetAtTime:(NSTimeInterval const)timeInterval
+{
+    NSDate *const date = [NSDate dateWithTimeIntervalSinceReferenceDate:timeInterval];
+    return [_timeZone secondsFromGMTForDate:date];
+}
+
+- (MRTimeZoneTransitionYear_ *)mr_yearAtIndex:(NSUInteger const)yearIndex
+{
+    @synchronized(self) {
+        MRTimeZoneTransitionYear_ *year = _years[yearIndex];
+        if (year) {
+            return year;
+        }
+        NSTimeInterval const startTime = (NSTimeInterval)((NSInteger)yearIndex + kMRTimeZoneTableFirstYear)*kMRTimeZoneTableYear;
+        NSTimeInterval const endTime = startTime + kMRTimeZoneTableYear;
+        NSMutableData *const transitions = NSMutableData.data;
+        NSMutableData *const offsets = NSMutableData.data;
+        NSTimeInterval time = startTime;
+        NSTimeInterval offset = [self mr_sampleOffsetAtTime:time];
+        [transitions appendBytes:&time length:sizeof(time)];
+        [offsets appendBytes:&offset length:sizeof(offset)];
+        NSDate *transitionDate = [_timeZone nextDaylightSavingTimeTransitionAfterDate:
+                                  [NSDate dateWithTimeIntervalSinceReferenceDate:startTime]];
+        while (transitionDate && transitionDate.timeIntervalSinceReferenceDate < endTime) {
+            time = transitionDate.timeIntervalSinceReferenceDate;
+            NSTimeInterval const transitionOffset = [self mr_sampleOffsetAtTime:time];
+            if (transitionOffset != offset) {
+                offset = transitionOffset;
+                [transitions appendBytes:&time length:sizeof(time)];
+                [offsets appendBytes:&offset length:sizeof(offset)];
+            }
+            transitionDate = [_timeZone nextDaylightSavingTimeTransitionAfterDate:transitionDate];
+        }
+        year = malloc(sizeof(MRTimeZoneTransitionYear_));
+        year->count = transitions.length/sizeof(NSTimeInterval);
+        year->transitions = malloc(transitions.length);
+        year->offsets = malloc(offsets.length);
+        memcpy(year->transitions, transitions.bytes, transitions.length);
+        memcpy(year->offsets, offsets.bytes, offsets.length);
+        __atomic_store_n(&_years[yearIndex], year, __ATOMIC_RELEASE);
+        return year;
+    }
+}
+
+#pragma mark - NSObject
+
+- (void)dealloc
+{
+    for (NSUInteger index = 0; index < kMRTimeZoneTableYears; index++) {
+        MRTimeZoneTransitionYear_ *const year = _years[index];
+        if (year) {
+            free(year->transitions);
+            free(year->offsets);
+            free(year);
+        }
+    }
+}
+
+@end
+
+
+#pragma mark - MRLocalNotificationRecurrenceRule -
+
+
+static int64_t MRFloorDivide_(int64_t const a, int64_t const b)
+{
+    int64_t const quotient = a/b;
+    return ((a % b != 0) && ((a < 0) != (b < 0))) ? quotient - 1 : quotient;
+}
+
+// Days since 1970-01-01 of the given proleptic Gregorian date.
+static int64_t MRDaysFromCivil_(int64_t year, int64_t const month, int64_t const day)
+{
+    year -= (month <= 2);
+    int64_t const era = MRFloorDivide_(year, 400);
+    int64_t const yearOfEra = year - era*400;
+    int64_t const dayOfYear = (153*(month + (month > 2 ? -3 : 9)) + 2)/5 + day - 1;
+    int64_t const dayOfEra = yearOfEra*365 + yearOfEra/4 - yearOfEra/100 + dayOfYear;
+    return era*146097 + dayOfEra - 719468;
+}
+
+// Proleptic Gregorian date of the given number of days since 1970-01-01.
+static void MRCivilFromDays_(int64_t days, int64_t *const year, int64_t *const month, int64_t *const day)
+{
+    days += 719468;
+    int64_t const era = MRFloorDivide_(days, 146097);
+    int64_t const dayOfEra = days - era*146097;
+    int64_t const yearOfEra = (dayOfEra - dayOfEra/1460 + dayOfEra/36524 - dayOfEra/146096)/365;
+    int64_t const dayOfYear = dayOfEra - (365*yearOfEra + yearOfEra/4 - yearOfEra/100);
+    int64_t const monthPrime = (5*dayOfYear + 2)/153;
+    int64_t const civilDay = dayOfYear - (153*monthPrime + 2)/5 + 1;
+    int64_t const civilMonth = monthPrime + (monthPrime < 10 ? 3 : -9);
+    if (year) {
+        *year = yearOfEra + era*400 + (civilMonth <= 2);
+    }
+    if (month) {
+        *month = civilMonth;
+    }
+    if (day) {
+        *day = civilDay;
+    }
+}
+
+static int64_t MRDaysInMonth_(int64_t const year, int64_t const month)
+{
+    static int64_t const daysInMonth[] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+    BOOL const isLeapYear = (year % 4 == 0 && (year % 100 != 0 || year % 400 == 0));
+    return (month == 2 && isLeapYear) ? 29 : daysInMonth[month - 1];
+}
+
+// Weekday of the given number of days since 1970-01-01 (1 is Sunday, 7 is Saturday).
+static int64_t MRWeekdayFromDays_(int64_t const days)
+{
+    int64_t const shiftedDays = days + 4;
+    return shiftedDays - MRFloorDivide_(shiftedDays, 7)*7 + 1;
+}
+
+
+@interface MRLocalNotificationRecurrenceRule ()
+- (BOOL)mr_hasDayFilters;
+@end
+
+
+@implementation MRLocalNotificationRecurrenceRule
+
+#pragma mark Private
+
+- (BOOL)mr_hasDayFilters
+{
+    return (self.weekdays.count > 0 || self.monthDays.count > 0);
+}
+
+#pragma mark - NSCopying
+
+- (id)copyWithZone:(NSZone *const)zone
+{
+    MRLocalNotificationRecurrenceRule *const rule = [[self.class allocWithZone:zone] init];
+    rule.frequency = self.frequency;
+    rule.interval = self.interval;
+    rule.weekdays = self.weekdays;
+    rule.monthDays = self.monthDays;
+    rule.count = self.count;
+    rule.until = self.until;
+    return rule;
+}
+
+#pragma mark - NSObject
+
+- (instancetype)init
+{
+    self = [super init];
+    if (self) {
+        _frequency = NSCalendarUnitDay;
+        _interval = 1;
+    }
+    return self;
+}
+
+@end
+
+
+#pragma mark - MRLocalNotificationRecurrenceEnumerator_ -
+
+
+static NSUInteger const kMRRecurrenceMaximumEmptyPeriods = 1000;
+
+// Lazy enumerator of the occurrences of a recurrence rule.
+@interface MRLocalNotificationRecurrenceEnumerator_ : NSEnumerator
+- (instancetype)initWithRule:(MRLocalNotificationRecurrenceRule *)rule
+                   startDate:(NSDate *)startDate
+                    calendar:(NSCalendar *)calendar
+               timeZoneTable:(MRTimeZoneTransitionTable_ *)timeZoneTable;
+- (BOOL)getNextTimeInterval:(NSTimeInterval *)timeInterval;
+- (void)skipToDate:(NSDate *)date;
+@end
+
+
+@implementation MRLocalNotificationRecurrenceEnumerator_ {
+    MRLocalNotificationRecurrenceRule *_rule;
+    NSCalendar *_calendar;
+    MRTimeZoneTransitionTable_ *_timeZoneTable;
+    BOOL _isGregorian;
+    NSCalendarUnit _frequency;
+    int64_t _interval;
+    NSTimeInterval _startTime;
+    NSTimeInterval _untilTime;
+    int64_t _startDay;
+    int64_t _startWeekFirstDay;
+    NSTimeInterval _startSecondOfDay;
+    int64_t _startYear;
+    int64_t _startMonth;
+    int64_t _startMonthDay;
+    int64_t _period;
+    NSUInteger _emitted;
+    NSUInteger _emptyPeriods;
+    BOOL _finished;
+    NSTimeInterval _candidates[366];
+    NSUInteger _candidateCount;
+    NSUInteger _candidateIndex;
+}
+
+- (instancetype)initWithRule:(MRLocalNotificationRecurrenceRule *const)rule
+                   startDate:(NSDate *const)startDate
+                    calendar:(NSCalendar *const)calendar
+               timeZoneTable:(MRTimeZoneTransitionTable_ *const)timeZoneTable
+{
+    NSParameterAssert(rule);
+    NSParameterAssert(startDate);
+    NSParameterAssert(calendar);
+    NSParameterAssert(timeZoneTable);
+    self = [super init];
+    if (self) {
+        _rule = rule.copy;
+        _calendar = calendar;
+        _timeZoneTable = timeZoneTable;
+        _isGregorian = [calendar.calendarIdentifier isEqualToString:NSCalendarIdentifierGregorian];
+        _frequency = [self.class mr_normalizedFrequency:rule.frequency interval:&_interval];
+        _interval *= MAX(rule.interval, 1);
+        _startTime = startDate.timeIntervalSince1970;
+        _untilTime = (rule.until ? rule.until.timeIntervalSince1970 : INFINITY);
+        NSTimeInterval const localTime = [self mr_localTimeFromTime:_startTime];
+        _startDay = (int64_t)floor(localTime/86400);
+        _startSecondOfDay = localTime - _startDay*86400.0;
+        MRCivilFromDays_(_startDay, &_startYear, &_startMonth, &_startMonthDay);
+        int64_t const firstWeekday = MAX((int64_t)calendar.firstWeekday, 1);
+        _startWeekFirstDay = _startDay - (MRWeekdayFromDays_(_startDay) - firstWeekday + 7) % 7;
+    }
+    return self;
+}
+
+- (BOOL)getNextTimeInterval:(NSTimeInterval *const)timeInterval
+{
+    NSUInteger const count = _rule.count;
+    while (!_finished) {
+        if (count > 0 && _emitted >= count) {
+            _finished = YES;
+            break;
+        }
+        if (_candidateIndex < _candidateCount) {
+            NSTimeInterval const time = _candidates[_candidateIndex];
+            _candidateIndex += 1;
+            if (time < _startTime) {
+                continue;
+            }
+            if (time > _untilTime) {
+                _finished = YES;
+                break;
+            }
+            _emitted += 1;
+            if (timeInterval) {
+                *timeInterval = time;
+            }
+            return YES;
+        }
+        if (_frequency == 0 && _period > 0) {
+            _finished = YES;
+            break;
+        }
+        [self mr_expandPeriod:_period];
+        _period += 1;
+        _emptyPeriods = (_candidateCount == 0 ? _emptyPeriods + 1 : 0);
+        if (_emptyPeriods > kMRRecurrenceMaximumEmptyPeriods) {
+            _finished = YES;
+        }
+    }
+    return NO;
+}
+
+- (void)skipToDate:(NSDate *const)date
+{
+    NSParameterAssert(date);
+    BOOL const hasDayFilters = _rule.mr_hasDayFilters;
+    if (!_isGregorian || _frequency == 0 || (_rule.count > 0 && hasDayFilters)) {
+        return;
+    }
+    NSTimeInterval const time = date.timeIntervalSince1970;
+    int64_t const day = (int64_t)floor([self mr_localTimeFromTime:time]/86400);
+    int64_t year;
+    int64_t month;
+    MRCivilFromDays_(day, &year, &month, NULL);
+    int64_t period;
+    switch (_frequency) {
+        case NSCalendarUnitMinute:
+        case NSCalendarUnitHour: {
+            int64_t const step = (_frequency == NSCalendarUnitHour ? 3600 : 60)*_interval;
+            period = (int64_t)floor((time - _startTime)/step);
+            break;
+        }
+        case NSCalendarUnitDay:
+            period = MRFloorDivide_(day - _startDay, _interval);
+            break;
+        case NSCalendarUnitWeekOfYear:
+            period = MRFloorDivide_(day - _startWeekFirstDay, 7*_interval);
+            break;
+        case NSCalendarUnitMonth:
+            period = MRFloorDivide_((year*12 + month) - (_startYear*12 + _startMonth), _interval);
+            break;
+        default:
+            period = MRFloorDivide_(year - _startYear, _interval);
+            break;
+    }
+    period -= 1;
+    if (period > _period) {
+        if (!hasDayFilters) {
+            _emitted += (NSUInteger)(period - _period);
+        }
+        _period = period;
+        _candidateCount = 0;
+        _candidateIndex = 0;
+    }
+}
+
+#pragma mark Private
+
++ (NSCalendarUnit)mr_normalizedFrequency:(NSCalendarUnit const)unit interval:(int64_t *const)interval
+{
+    *interval = 1;
+    switch (unit) {
+        case NSCalendarUnitMinute:
+        case NSCalendarUnitHour:
+        case NSCalendarUnitDay:
+        case NSCalendarUnitMonth:
+        case NSCalendarUnitYear:
+            return unit;
+        case NSCalendarUnitWeekday:
+        case NSCalendarUnitWeekdayOrdinal:
+        case NSCalendarUnitWeekOfMonth:
+        case NSCalendarUnitWeekOfYear:
+            return NSCalendarUnitWeekOfYear;
+        case NSCalendarUnitQuarter:
+            *interval = 3;
+            return NSCalendarUnitMonth;
+        case NSCalendarUnitEra:
+        case NSCalendarUnitYearForWeekOfYear:
+            return NSCalendarUnitYear;
+        default:
+            return 0;
+    }
+}
+
+- (NSTimeInterval)mr_localTimeFromTime:(NSTimeInterval const)time
+{
+    MRTimeZoneTransitionTable_ *const table = _timeZoneTable;
+    return time + [table secondsFromGMTForTimeInterval:time - NSTimeIntervalSince1970];
+}
+
+- (NSTimeInterval)mr_timeFromLocalTime:(NSTimeInterval const)localTime
+{
+    MRTimeZoneTransitionTable_ *const table = _timeZoneTable;
+    return [table timeIntervalFromLocalTimeInterval:localTime - NSTimeIntervalSince1970] + NSTimeIntervalSince1970;
+}
+
+- (BOOL)mr_acceptsDay:(int64_t const)day
+{
+    NSIndexSet *const weekdays = _rule.weekdays;
+    if (weekdays.count > 0 && ![weekdays containsIndex:(NSUInteger)MRWeekdayFromDays_(day)]) {
+        return NO;
+    }
+    NSIndexSet *const monthDays = _rule.monthDays;
+    if (monthDays.count > 0) {
+        int64_t monthDay;
+        MRCivilFromDays_(day, NULL, NULL, &monthDay);
+        if (![monthDays containsIndex:(NSUInteger)monthDay]) {
+            return NO;
+        }
+    }
+    return YES;
+}
+
+- (void)mr_addDay:(int64_t const)day
+{
+    if (_candidateCount < sizeof(_candidates)/sizeof(*_candidates)) {
+        NSTimeInterval const localTime = day*86400.0 + _startSecondOfDay;
+        _candidates[_candidateCount] = [self mr_timeFromLocalTime:localTime];
+        _candidateCount += 1;
+    }
+}
+
+- (void)mr_addDaysFrom:(int64_t const)firstDay to:(int64_t const)lastDay
+{
+    for (int64_t day = firstDay; day <= lastDay; day++) {
+        if ([self mr_acceptsDay:day]) {
+            [self mr_addDay:day];
+        }
+    }
+}
+
+- (void)mr_expandPeriod:(int64_t const)period
+{
+    _candidateCount = 0;
+    _candidateIndex = 0;
+    if (_frequency == 0) {
+        _candidates[0] = _startTime;
+        _candidateCount = 1;
+        return;
+    }
+    if (!_isGregorian) {
+        [self mr_expandCalendarPeriod:period];
+        return;
+    }
+    BOOL const hasDayFilters = _rule.mr_hasDayFilters;
+    switch (_frequency) {
+        case NSCalendarUnitMinute:
+        case NSCalendarUnitHour: {
+            int64_t const step = (_frequency == NSCalendarUnitHour ? 3600 : 60)*_interval;
+            NSTimeInterval const time = _startTime + period*step;
+            int64_t const day = (int64_t)floor([self mr_localTimeFromTime:time]/86400);
+            if (!hasDayFilters || [self mr_acceptsDay:day]) {
+                _candidates[0] = time;
+                _candidateCount = 1;
+            }
+            break;
+        }
+        case NSCalendarUnitDay: {
+            int64_t const day = _startDay + period*_interval;
+            [self mr_addDaysFrom:day to:day];
+            break;
+        }
+        case NSCalendarUnitWeekOfYear: {
+            if (hasDayFilters) {
+                int64_t const weekFirstDay = _startWeekFirstDay + 7*period*_interval;
+                [self mr_addDaysFrom:weekFirstDay to:weekFirstDay + 6];
+            } else {
+                [self mr_addDay:_startDay + 7*period*_interval];
+            }
+            break;
+        }
+        case NSCalendarUnitMonth: {
+            int64_t const months = (_startMonth - 1) + period*_interval;
+            int64_t const year = _startYear + MRFloorDivide_(months, 12);
+            int64_t const month = months - MRFloorDivide_(months, 12)*12 + 1;
+            int64_t const daysInMonth = MRDaysInMonth_(year, month);
+            int64_t const firstDay = MRDaysFromCivil_(year, month, 1);
+            if (hasDayFilters) {
+                [self mr_addDaysFrom:firstDay to:firstDay + daysInMonth - 1];
+            } else {
+                [self mr_addDay:firstDay + MIN(_startMonthDay, daysInMonth) - 1];
+            }
+            break;
+        }
+        default: {
+            int64_t const year = _startYear + period*_interval;
+            if (hasDayFilters) {
+                int64_t const firstDay = MRDaysFromCivil_(year, 1, 1);
+                int64_t const lastDay = MRDaysFromCivil_(year, 12, 31);
+                [self mr_addDaysFrom:firstDay to:lastDay];
+            } else {
+                int64_t const daysInMonth = MRDaysInMonth_(year, _startMonth);
+                [self mr_addDay:MRDaysFromCivil_(year, _startMonth, MIN(_startMonthDay, daysInMonth))];
+            }
+            break;
+        }
+    }
+}
+
+- (void)mr_expandCalendarPeriod:(int64_t const)period
+{
+    NSCalendar *const calendar = _calendar.copy;
+    calendar.timeZone = _timeZoneTable.timeZone;
+    NSDate *const startDate = [NSDate dateWithTimeIntervalSince1970:_startTime];
+    NSCalendarUnit const unit = (_frequency == NSCalendarUnitWeekOfYear ? NSCalendarUnitDay : _frequency);
+    NSInteger const value = (NSInteger)(period*_interval*(_frequency == NSCalendarUnitWeekOfYear ? 7 : 1));
+    NSDate *const date = [calendar dateByAddingUnit:unit value:value toDate:startDate options:0];
+    if (date == nil) {
+        return;
+    }
+    if (_rule.mr_hasDayFilters) {
+        NSDateComponents *const components = [calendar components:(NSCalendarUnitWeekday | NSCalendarUnitDay)
+                                                         fromDate:date];
+        NSIndexSet *const weekdays = _rule.weekdays;
+        NSIndexSet *const monthDays = _rule.monthDays;
+        if ((weekdays.count > 0 && ![weekdays containsIndex:(NSUInteger)components.weekday]) ||
+            (monthDays.count > 0 && ![monthDays containsIndex:(NSUInteger)components.day])) {
+            return;
+        }
+    }
+    _candidates[0] = date.timeIntervalSince1970;
+    _candidateCount = 1;
+}
+
+#pragma mark - NSEnumerator
+
+- (id)nextObject
+{
+    NSTimeInterval timeInterval;
+    if ([self getNextTimeInterval:&timeInterval]) {
+        return [NSDate dateWithTimeIntervalSince1970:timeInterval];
+    }
+    return nil;
+}
+
+@end
+
+
+#pragma mark - MRLocalNotificationTemplate -
+
+
+@interface MRLocalNotificationTemplate ()
+- (instancetype)initWithNotification:(UILocalNotification *)notification
+                      badgeIncrement:(NSInteger)badgeIncrement;
+- (UILocalNotification *)notificationWithFireDate:(NSDate *)fireDate
+                                       identifier:(NSString *)identifier
+                                            index:(NSUInteger)index;
+@end
+
+
+@implementation MRLocalNotificationTemplate
+
+- (instancetype)initWithNotification:(UILocalNotification *const)notification
+                      badgeIncrement:(NSInteger const)badgeIncrement
+{
+    NSParameterAssert(notification);
+    self = [super init];
+    if (self) {
+        UILocalNotification *const prototype = notification.copy;
+        NSDictionary *const userInfo = notification.userInfo;
+        if (userInfo[MRLocalNotificationIdentifierKey]) {
+            // Identifiers are unique, so they are given to each notification instead.
+            NSMutableDictionary *const sharedUserInfo = userInfo.mutableCopy;
+            [sharedUserInfo removeObjectForKey:MRLocalNotificationIdentifierKey];
+            prototype.userInfo = (sharedUserInfo.count > 0 ? sharedUserInfo.copy : nil);
+        } else {
+            prototype.userInfo = userInfo.copy;
+        }
+        prototype.fireDate = nil;
+        _prototype = prototype;
+        _badgeIncrement = badgeIncrement;
+    }
+    return self;
+}
+
+- (UILocalNotification *)notificationWithFireDate:(NSDate *const)fireDate
+                                       identifier:(NSString *const)identifier
+                                            index:(NSUInteger const)index
+{
+    NSParameterAssert(fireDate);
+    UILocalNotification *const prototype = _prototype;
+    UILocalNotification *const notification = prototype.copy;
+    notification.fireDate = fireDate;
+    if (identifier) {
+        NSMutableDictionary *const userInfo = [NSMutableDictionary dictionaryWithDictionary:(prototype.userInfo ?: @{})];
+        userInfo[MRLocalNotificationIdentifierKey] = identifier;
+        notification.userInfo = userInfo;
+    }
+    if (_badgeIncrement != 0) {
+        notification.applicationIconBadgeNumber = (prototype.applicationIconBadgeNumber +
+                                                   _badgeIncrement*(NSInteger)index);
+    }
+    return notification;
+}
+
+@end
+
+
+#pragma mark - MRLocalNotificationMetrics_ -
+
+
+typedef enum {
+    MRApplicationCallScheduledLocalNotifications_,
+    MRApplicationCallScheduleLocalNotification_,
+    MRApplicationCallCancelLocalNotification_,
+    MRApplicationCallCancelAllLocalNotifications_,
+    MRApplicationCallPresentLocalNotificationNow_,
+    MRApplicationCallCurrentUserNotificationSettings_,
+    MRApplicationCallRegisterUserNotificationSettings_,
+    MRApplicationCallApplicationIconBadgeNumber_,
+    MRApplicationCallSetApplicationIconBadgeNumber_,
+    MRApplicationCallApplicationState_,
+    MRApplicationCallCanOpenURL_,
+    MRApplicationCallOpenURL_,
+    MRApplicationCallCount_
+} MRApplicationCall_;
+
+typedef enum {
+    MRMetricsOperationSchedule_,
+    MRMetricsOperationCancel_,
+    MRMetricsOperationValidate_,
+    MRMetricsOperationHandleDidRegister_,
+    MRMetricsOperationHandleDidReceive_,
+    MRMetricsOperationHandleAction_,
+    MRMetricsOperationCount_
+} MRMetricsOperation_;
+
+// Enum constants, since they size the arrays of `MRLocalNotificationMetrics_`.
+enum {
+    kMRMetricsHistogramBuckets = 40,
+    kMRMetricsErrorCodes = (MRLocalNotificationErrorMissingAlertBody - MRLocalNotificationErrorUnknown + 1)
+};
+
+static NSString *const kMRApplicationCallNames[MRApplicationCallCount_] = {
+    @"scheduledLocalNotifications",
+    @"scheduleLocalNotification",
+    @"cancelLocalNotification",
+    @"cancelAllLocalNotifications",
+    @"presentLocalNotificationNow",
+    @"currentUserNotificationSettings",
+    @"registerUserNotificationSettings",
+    @"applicationIconBadgeNumber",
+    @"setApplicationIconBadgeNumber",
+    @"applicationState",
+    @"canOpenURL",
+    @"openURL",
+};
+
+static NSString *const kMRMetricsOperationNames[MRMetricsOperationCount_] = {
+    @"schedule",
+    @"cancel",
+    @"validate",
+    @"handleDidRegisterUserNotificationSettings",
+    @"handleDidReceiveLocalNotification",
+    @"handleActionWithIdentifier",
+};
+
+
+static uint64_t MRNanosecondsSince_(uint64_t const startTime)
+{
+    static mach_timebase_info_data_t timebase;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        mach_timebase_info(&timebase);
+    });
+    return (mach_absolute_time() - startTime)*timebase.numer/timebase.denom;
+}
+
+
+// Counters are updated with relaxed atomics, so they can be recorded from any thread.
+@interface MRLocalNotificationMetrics_ : NSObject
+- (void)countApplicationCall:(MRApplicationCall_)call;
+- (void)countErrorCode:(MRLocalNotificationErrorCode)code;
+- (void)recordOperation:(MRMetricsOperation_)operation startTime:(uint64_t)startTime;
+- (NSDictionary *)snapshot;
+@end
+
+
+@implementation MRLocalNotificationMetrics_ {
+    int64_t _applicationCalls[MRApplicationCallCount_];
+    int64_t _errorCodes[kMRMetricsErrorCodes];
+    int64_t _operationCounts[MRMetricsOperationCount_];
+    int64_t _operationNanoseconds[MRMetricsOperationCount_];
+    int64_t _histograms[MRMetricsOperationCount_][kMRMetricsHistogramBuckets];
+}
+
+- (void)countApplicationCall:(MRApplicationCall_ const)call
+{
+    __atomic_fetch_add(&_applicationCalls[call], 1, __ATOMIC_RELAXED);
+}
+
+- (void)countErrorCode:(MRLocalNotificationErrorCode const)code
+{
+    NSInteger const index = code - MRLocalNotificationErrorUnknown;
+    if (index >= 0 && index < (NSInteger)kMRMetricsErrorCodes) {
+        __atomic_fetch_add(&_errorCodes[index], 1, __ATOMIC_RELAXED);
+    }
+}
+
+- (void)recordOperation:(MRMetricsOperation_ const)operation startTime:(uint64_t const)startTime
+{
+    uint64_t const nanoseconds = MRNanosecondsSince_(startTime);
+    NSUInteger bucket = 0;
+    while (bucket + 1 < kMRMetricsHistogramBuckets && (nanoseconds >> (bucket + 1)) > 0) {
+        bucket += 1;
+    }
+    __atomic_fetch_add(&_operationCounts[operation], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&_operationNanoseconds[operation], (int64_t)nanoseconds, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&_histograms[operation][bucket], 1, __ATOMIC_RELAXED);
+}
+
+- (NSDictionary *)snapshot
+{
+    NSMutableDictionary *const applicationCalls = NSMutableDictionary.dictionary;
+    for (NSUInteger call = 0; call < MRApplicationCallCount_; call++) {
+        int64_t const count = __atomic_load_n(&_applicationCalls[call], __ATOMIC_RELAXED);
+        applicationCalls[kMRApplicationCallNames[call]] = @(count);
+    }
+    NSMutableDictionary *const latencies = NSMutableDictionary.dictionary;
+    for (NSUInteger operation = 0; operation < MRMetricsOperationCount_; operation++) {
+        NSMutableArray *const histogram = [NSMutableArray arrayWithCapacity:kMRMetricsHistogramBuckets];
+        for (NSUInteger bucket = 0; bucket < kMRMetricsHistogramBuckets; bucket++) {
+            [histogram addObject:@(__atomic_load_n(&_histograms[operation][bucket], __ATOMIC_RELAXED))];
+        }
+        latencies[kMRMetricsOperationNames[operation]] =
+        @{ @"count": @(__atomic_load_n(&_operationCounts[operation], __ATOMIC_RELAXED)),
+           @"nanoseconds": @(__atomic_load_n(&_operationNanoseconds[operation], __ATOMIC_RELAXED)),
+           @"histogram": histogram };
+    }
+    NSMutableDictionary *const errors = NSMutableDictionary.dictionary;
+    for (NSUInteger index = 0; index < kMRMetricsErrorCodes; index++) {
+        int64_t const count = __atomic_load_n(&_errorCodes[index], __ATOMIC_RELAXED);
+        if (count > 0) {
+            errors[@(MRLocalNotificationErrorUnknown + index)] = @(count);
+        }
+    }
+    return @{ MRLocalNotificationMetricsApplicationCallsKey: applicationCalls,
+              MRLocalNotificationMetricsLatenciesKey: latencies,
+              MRLocalNotificationMetricsErrorsKey: errors };
+}
+
+@end
+
+
+#pragma mark - MRLocalNotificationActionRegistry_ -
+
+
+@interface MRLocalNotificationActionHandlerEntry_ : NSObject
+@property (nonatomic, copy) NSString *identifier;
+@property (nonatomic, copy) NSString *identifierPrefix;
+@property (nonatomic, copy) NSString *category;
+@property (nonatomic, copy) void(^handler)(NSString *identifier, UILocalNotification *notification);
+@property (nonatomic, assign) BOOL replaceable;
+@end
+
+
+@implementation MRLocalNotificationActionHandlerEntry_
+@end
+
+
+// Immutable; the facade swaps whole registries when handlers are added or removed.
+@interface MRLocalNotificationActionRegistry_ : NSObject
+@property (nonatomic, readonly) NSArray *entries;
+- (instancetype)initWithEntries:(NSArray *)entries;
+- (NSArray *)handlersForActionWithIdentifier:(NSString *)identifier
+                                    category:(NSString *)category;
+@end
+
+
+@implementation MRLocalNotificationActionRegistry_ {
+    NSDictionary *_exactEntries;
+    NSDictionary *_categoryEntries;
+    NSArray *_prefixEntries;
+}
+
+- (instancetype)initWithEntries:(NSArray *const)entries
+{
+    NSParameterAssert(entries);
+    self = [super init];
+    if (self) {
+        _entries = entries.copy;
+        NSMutableDictionary *const exactEntries = NSMutableDictionary.dictionary;
+        NSMutableDictionary *const categoryEntries = NSMutableDictionary.dictionary;
+        NSMutableArray *const prefixEntries = NSMutableArray.array;
+        for (MRLocalNotificationActionHandlerEntry_ *const entry in entries) {
+            NSMutableDictionary *const dictionary = (entry.category ? categoryEntries : exactEntries);
+            NSString *const key = (entry.category ?: entry.identifier);
+            if (key) {
+                NSMutableArray *const array = (dictionary[key] ?: NSMutableArray.array);
+                [array addObject:entry];
+                dictionary[key] = array;
+            } else {
+                [prefixEntries addObject:entry];
+            }
+        }
+        _exactEntries = exactEntries.copy;
+        _categoryEntries = categoryEntries.copy;
+        _prefixEntries = prefixEntries.copy;
+    }
+    return self;
+}
+
+- (NSArray *)handlersForActionWithIdentifier:(NSString *const)identifier
+                                    category:(NSString *const)category
+{
+    NSParameterAssert(identifier);
+    NSMutableArray *const handlers = NSMutableArray.array;
+    for (MRLocalNotificationActionHandlerEntry_ *const entry in _exactEntries[identifier]) {
+        [handlers addObject:entry.handler];
+    }
+    for (MRLocalNotificationActionHandlerEntry_ *const entry in (category ? _categoryEntries[category] : nil)) {
+        if (entry.identifier == nil || [entry.identifier isEqualToString:identifier]) {
+            [handlers addObject:entry.handler];
+        }
+    }
+    for (MRLocalNotificationActionHandlerEntry_ *const entry in _prefixEntries) {
+        if ([identifier hasPrefix:entry.identifierPrefix]) {
+            [handlers addObject:entry.handler];
+        }
+    }
+    return handlers;
+}
+
+@end
+
+
+#pragma mark - MRLocalNotificationPipelineOperation_ -
+
+
+typedef enum {
+    MRLocalNotificationPipelineSchedule_,
+    MRLocalNotificationPipelineCancel_,
+    MRLocalNotificationPipelineReplace_,
+} MRLocalNotificationPipelineKind_;
+
+
+@interface MRLocalNotificationPipelineOperation_ : NSObject
+@property (nonatomic, assign) MRLocalNotificationPipelineKind_ kind;
+@property (nonatomic, strong) UILocalNotification *notification;
+@property (nonatomic, copy) void(^completion)(BOOL success, NSError *error);
+@property (nonatomic, assign) MRLocalNotificationErrorCode errorCode;
+@property (nonatomic, strong) MRLocalNotificationSettingsSnapshot_ *validationSettings;
+@property (nonatomic, assign) MRLocalNotificationErrorCode validationCode;
+@property (nonatomic, assign) BOOL scheduled;
+@property (nonatomic, assign) BOOL superseded;
+@property (nonatomic, assign) NSUInteger batchIndex;
+@end
+
+
+@implementation MRLocalNotificationPipelineOperation_
+@end
+
+
+#pragma mark - MRLocalNotificationCoalescer -
+
+
+@interface MRLocalNotificationCoalescer ()
+@property (nonatomic, copy) void(^batchHandler)(NSArray *batches);
+@end
+
+
+@implementation MRLocalNotificationCoalescer {
+    NSMutableArray *_batches;
+    NSMutableDictionary *_batchesByCategory;
+    NSUInteger _generation;
+}
+
+- (instancetype)initWithWindow:(NSTimeInterval const)window
+                  batchHandler:(void(^const)(NSArray *batches))batchHandler
+{
+    NSParameterAssert(window >= 0);
+    NSParameterAssert(batchHandler);
+    self = [super init];
+    if (self) {
+        _window = window;
+        _batchHandler = [batchHandler copy];
+        _batches = NSMutableArray.array;
+        _batchesByCategory = NSMutableDictionary.dictionary;
+        _scheduler = ^(NSTimeInterval const delay, dispatch_block_t const block) {
+            dispatch_time_t const when = dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay*NSEC_PER_SEC));
+            dispatch_after(when, dispatch_get_main_queue(), block);
+        };
+    }
+    return self;
+}
+
+- (void)addItem:(id const)item
+       category:(NSString *const)category
+{
+    NSParameterAssert(item);
+    id const key = (category ?: NSNull.null);
+    NSMutableArray *batch = _batchesByCategory[key];
+    if (batch == nil) {
+        batch = NSMutableArray.array;
+        _batchesByCategory[key] = batch;
+        [_batches addObject:batch];
+    }
+    [batch addObject:item];
+    _pendingCount += 1;
+    if (_pendingCount == 1) {
+        // a flush before the timer fires bumps the generation, so a stale timer does nothing
+        NSUInteger const generation = _generation;
+        __weak typeof(self) welf = self;
+        self.scheduler(self.window, ^{
+            MRLocalNotificationCoalescer *const coalescer = welf;
+            if (coalescer && coalescer->_generation == generation) {
+                [coalescer flush];
+            }
+        });
+    }
+}
+
+- (void)flush
+{
+    if (_pendingCount == 0) {
+        return;
+    }
+    NSMutableArray *const batches = [NSMutableArray arrayWithCapacity:_batches.count];
+    for (NSArray *const batch in _batches) {
+        [batches addObject:batch.copy];
+    }
+    [_batches removeAllObjects];
+    [_batchesByCategory removeAllObjects];
+    _pendingCount = 0;
+    _generation += 1;
+    self.batchHandler(batches);
+}
+
+@end
+
+
+#pragma mark - MRLocalNotificationFacade -
+
+
+@interface MRLocalNotificationFacade ()
+@property (nonatomic, strong) UIApplication *defaultApplication;
+@property (nonatomic, copy) void(^onDidReceiveNotification)(UILocalNotification *n, BOOL *alert);
+@property (nonatomic, copy) void(^onDidReceiveNotifications)(NSArray *batches, BOOL *alert);
+@property (nonatomic, assign) NSTimeInterval notificationCoalescingWindow;
+@property (nonatomic, strong) MRLocalNotificationCoalescer *notificationCoalescer;
+@property (nonatomic, readwrite) BOOL hasRegisteredNotifications;
+@property (nonatomic, assign) BOOL hasResolvedRegisteredNotifications;
+@property (nonatomic, strong) NSMutableDictionary *startupCosts;
+@property (nonatomic, strong) NSTimeZone *defaultTimeZone;
+@property (nonatomic, strong) NSCalendar *defaultCalendar;
+@property (nonatomic, strong) UIViewController *defaultAlertPresenter;
+@property (nonatomic, strong) UIWindow *alertWindow;
+@property (nonatomic, copy) void(^onDidCancelNotificationAlert)(UILocalNotification *notification);
+@property (strong) MRLocalNotificationActionRegistry_ *actionRegistry;
+@property (nonatomic, assign) BOOL concurrentActionHandlers;
+@property (strong) MRLocalNotificationMetrics_ *metrics;
+@property (nonatomic, strong) NSMutableDictionary *scheduledNotificationsIndex;
+@property (nonatomic, strong) NSMutableDictionary *categoryIndex;
+@property (nonatomic, strong) NSMutableDictionary *userInfoIndexes;
+@property (nonatomic, strong) MRLocalNotificationSettingsSnapshot_ *settingsSnapshot;
+@property (strong) MRLocalNotificationSettingsSnapshot_ *pipelineSettingsSnapshot;
+@property (nonatomic, strong) MRLocalNotificationHeap_ *overflowQueue;
+@property (nonatomic, strong) MRLocalNotificationHeap_ *overflowPendingNotifications;
+@property (nonatomic, strong) MRLocalNotificationHeap_ *overflowFiringNotifications;
+@property (nonatomic, strong) MRLocalNotificationJournal_ *journal;
+@property (nonatomic, strong) MRLocalNotificationPayloadStore_ *payloadStore;
+@property (nonatomic, strong) NSCountedSet *payloadReferences;
+@property (nonatomic, strong) NSMutableDictionary *payloadsByKey;
+@property (nonatomic, assign) BOOL needsPayloadSweep;
+@property (nonatomic, strong) MRLocalNotificationSkipList_ *timeIndex;
+@property (nonatomic, strong) NSMutableSet *floatingIdentifiers;
+@property (nonatomic, assign) BOOL sequencingBadges;
+@property (nonatomic, strong) NSMutableDictionary *regionPool;
+@property (nonatomic, strong) MRLocalNotificationRegionIndex_ *regionIndex;
+@property (nonatomic, strong) NSMutableSet *regionPoolScheduledIdentifiers;
+@property (strong) MRTimeZoneTransitionTable_ *defaultTimeZoneTable;
+@property (nonatomic, strong) NSCache *timeZoneTables;
+@property (nonatomic, strong) NSURL *contactSupportURL;
+@property (nonatomic, copy) void(^onDidCancelErrorAlert)(NSError *error);
+@property (nonatomic, strong) dispatch_queue_t pipelineQueue;
+@property (nonatomic, copy) void(^commitExecutor)(dispatch_block_t block);
+@property (nonatomic, strong) NSMutableArray *pipelineOperations;
+@property (nonatomic, strong) NSMutableDictionary *pipelineOperationsByKey;
+- (BOOL)mr_isNotificationValid:(UILocalNotification *)notification
+                  withSettings:(MRLocalNotificationSettingsSnapshot_ *)settings
+                      recovery:(BOOL)recovery
+                     errorCode:(MRLocalNotificationErrorCode *)codePtr;
+- (BOOL)mr_isNotificationIntrinsicallyValid:(UILocalNotification *)notification
+                                  errorCode:(MRLocalNotificationErrorCode *)codePtr;
+- (MRLocalNotificationRecurrenceEnumerator_ *)mr_recurrenceEnumeratorForNotification:(UILocalNotification *)notification
+                                                                                rule:(MRLocalNotificationRecurrenceRule *)rule;
+- (MRLocalNotificationRecurrenceEnumerator_ *)mr_recurrenceEnumeratorForNotification:(UILocalNotification *)notification
+                                                                                rule:(MRLocalNotificationRecurrenceRule *)rule
+                                                                            timeZone:(NSTimeZone *)timeZone;
+- (NSDate *)mr_GMTFireDateFromNotification:(UILocalNotification *)notification timeZone:(NSTimeZone *)timeZone;
+- (NSIndexSet *)mr_scheduleNotifications:(NSArray *)notifications
+                  scheduledNotifications:(NSArray *)scheduledNotifications
+                                  errors:(NSArray **)errorsPtr;
+- (NSTimeInterval)mr_now;
+- (void)mr_handleCoalescedNotifications:(NSArray *)batches;
+- (void)systemTimeZoneDidChange:(NSNotification *)notification;
+@end
+
+
+@implementation MRLocalNotificationFacade
+
+@synthesize defaultApplication = _defaultApplication;
+@synthesize defaultTimeZone = _defaultTimeZone;
+
++ (instancetype)defaultInstance
+{
+    static MRLocalNotificationFacade *__defaultInstance;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        __defaultInstance = [[self alloc] init];
+    });
+    return __defaultInstance;
+}
+
+- (UIMutableUserNotificationAction *)buildAction:(NSString *const)identifier
+                                           title:(NSString *const)title
+                                     destructive:(BOOL const)isDestructive
+                                  backgroundMode:(BOOL const)runsInBackground
+                                  authentication:(BOOL const)authRequired
+{
+    NSParameterAssert(identifier);
+    NSParameterAssert(title);
+    NSParameterAssert(runsInBackground || authRequired);
+    UIMutableUserNotificationAction *const action =
+    [[UIMutableUserNotificationAction alloc] init];
+    if (runsInBackground) {
+        action.activationMode = UIUserNotificationActivationModeBackground;
+    } else {
+        action.activationMode = UIUserNotificationActivationModeForeground;
+    }
+    action.title = title;
+    action.identifier = identifier;
+    action.destructive = isDestructive;
+    action.authenticationRequired = authRequired;
+    return action;
+}
+
+- (UIMutableUserNotificationCategory *)buildCategory:(NSString *const)identifier
+                                      minimalActions:(NSArray *const)minimalActions
+                                      defaultActions:(NSArray *const)defaultActions
+{
+    NSParameterAssert(identifier);
+    NSParameterAssert(minimalActions.count <= 2);
+    NSParameterAssert(defaultActions.count <= 4);
+    UIMutableUserNotificationCategory *const category =
+    [[UIMutableUserNotificationCategory alloc] init];
+    category.identifier = identifier;
+    [category setActions:minimalActions forContext:UIUserNotificationActionContextMinimal];
+    [category setActions:defaultActions forContext:UIUserNotificationActionContextDefault];
+    return category;
+}
+
+- (void)customizeMinimalCategory:(UIMutableUserNotificationCategory *const)category
+                         action0:(UIUserNotificationAction *const)action0
+                         action1:(UIUserNotificationAction *const)action1
+{
+    NSParameterAssert(category);
+    NSMutableArray *const actions = [NSMutableArray arrayWithCapacity:4];
+    if (action0) {
+        [actions addObject:action0];
+    }
+    if (action1) {
+        [actions addObject:action1];
+    }
+    [category setActions:actions forContext:UIUserNotificationActionContextMinimal];
+}
+
+- (void)customizeDefaultCategory:(UIMutableUserNotificationCategory *const)category
+                         action0:(UIUserNotificationAction *const)action0
+                         action1:(UIUserNotificationAction *const)action1
+                         action2:(UIUserNotificationAction *const)action2
+                         action3:(UIUserNotificationAction *const)action3
+{
+    NSParameterAssert(category);
+    NSMutableArray *const actions = [NSMutableArray arrayWithCapacity:4];
+    if (action0) {
+        [actions addObject:action0];
+    }
+    if (action1) {
+        [actions addObject:action1];
+    }
+    if (action2) {
+        [actions addObject:action2];
+    }
+    if (action3) {
+        [actions addObject:action3];
+    }
+    [category setActions:actions forContext:UIUserNotificationActionContextDefault];
+}
+
+- (void)setNotificationHandler:(void(^const)(NSString *identifier, UILocalNotification *n))handler
+       forActionWithIdentifier:(NSString *const)identifier
+{
+    NSParameterAssert(identifier);
+    MRLocalNotificationActionHandlerEntry_ *entry;
+    if (handler) {
+        entry = MRLocalNotificationActionHandlerEntry_.new;
+        entry.identifier = identifier;
+        entry.handler = handler;
+        entry.replaceable = YES;
+    }
+    [self mr_updateActionRegistryWithEntry:entry removingEntries:^BOOL(MRLocalNotificationActionHandlerEntry_ *const oldEntry) {
+        return (oldEntry.replaceable && [oldEntry.identifier isEqualToString:identifier]);
+    }];
+}
+
+- (id<NSObject>)addNotificationHandler:(void(^const)(NSString *identifier, UILocalNotification *n))handler
+               forActionWithIdentifier:(NSString *const)identifier
+{
+    NSParameterAssert(handler);
+    NSParameterAssert(identifier);
+    MRLocalNotificationActionHandlerEntry_ *const entry = MRLocalNotificationActionHandlerEntry_.new;
+    entry.identifier = identifier;
+    entry.handler = handler;
+    [self mr_updateActionRegistryWithEntry:entry removingEntries:nil];
+    return entry;
+}
+
+- (id<NSObject>)addNotificationHandler:(void(^const)(NSString *identifier, UILocalNotification *n))handler
+         forActionWithIdentifierPrefix:(NSString *const)identifierPrefix
+{
+    NSParameterAssert(handler);
+    NSParameterAssert(identifierPrefix);
+    MRLocalNotificationActionHandlerEntry_ *const entry = MRLocalNotificationActionHandlerEntry_.new;
+    entry.identifierPrefix = identifierPrefix;
+    entry.handler = handler;
+    [self mr_updateActionRegistryWithEntry:entry removingEntries:nil];
+    return entry;
+}
+
+- (id<NSObject>)addNotificationHandler:(void(^const)(NSString *identifier, UILocalNotification *n))handler
+               forActionWithIdentifier:(NSString *const)identifier
+                              category:(NSString *const)category
+{
+    NSParameterAssert(handler);
+    NSParameterAssert(category);
+    MRLocalNotificationActionHandlerEntry_ *const entry = MRLocalNotificationActionHandlerEntry_.new;
+    entry.identifier = identifier;
+    entry.category = category;
+    entry.handler = handler;
+    [self mr_updateActionRegistryWithEntry:entry removingEntries:nil];
+    return entry;
+}
+
+- (void)removeNotificationHandler:(id<NSObject> const)token
+{
+    NSParameterAssert(token);
+    [self mr_updateActionRegistryWithEntry:nil removingEntries:^BOOL(MRLocalNotificationActionHandlerEntry_ *const oldEntry) {
+        return (oldEntry == token);
+    }];
+}
+
+- (UILocalNotification *)buildNotificationWithDate:(NSDate *const)fireDate
+                                          timeZone:(BOOL const)timeZone
+                                          category:(NSString *const)category
+                                          userInfo:(NSDictionary *const)userInfo
+{
+    NSParameterAssert(fireDate);
+    UILocalNotification *const notification = [[UILocalNotification alloc] init];
+    notification.fireDate = fireDate;
+    if (timeZone) {
+        notification.timeZone = self.defaultTimeZone;
+    }
+    notification.category = category;
+    notification.userInfo = userInfo;
+    return notification;
+}
+
+- (UILocalNotification *)buildNotificationWithInterval:(NSTimeInterval)fireInterval
+                                              category:(NSString *)category
+                                              userInfo:(NSDictionary *)userInfo
+{
+    NSParameterAssert(fireInterval >= 0);
+    NSDate *const fireDate = [NSDate dateWithTimeIntervalSinceReferenceDate:[self mr_now] + fireInterval];
+    return [self buildNotificationWithDate:fireDate
+                                  timeZone:NO
+                                  category:category
+                                  userInfo:userInfo];
+}
+
+- (UILocalNotification *)buildNotificationWithRegion:(CLRegion *const)fireRegion
+                                        triggersOnce:(BOOL const)regionTriggersOnce
+                                            category:(NSString *const)category
+                                            userInfo:(NSDictionary *const)userInfo
+{
+    NSParameterAssert(fireRegion);
+    UILocalNotification *const notification = [[UILocalNotification alloc] init];
+    notification.region = fireRegion;
+    notification.regionTriggersOnce = regionTriggersOnce;
+    notification.category = category;
+    notification.userInfo = userInfo;
+    return notification;
+}
+
+- (void)customizeNotificationRepeat:(UILocalNotification *const)notification
+                           interval:(NSCalendarUnit const)calendarUnit
+{
+    NSParameterAssert(notification);
+    notification.repeatInterval = calendarUnit;
+    notification.repeatCalendar = self.defaultCalendar;
+}
+
+- (void)customizeNotificationAlert:(UILocalNotification *const)notification
+                             title:(NSString *const)alertTitle
+                              body:(NSString *const)alertBody
+                            action:(NSString *const)alertAction
+                       launchImage:(NSString *const)alertLaunchImage
+{
+    NSParameterAssert(notification);
+    if ([notification respondsToSelector:@selector(setAlertTitle:)]) {
+        notification.alertTitle = alertTitle;
+    } else if (alertTitle.length > 0) {
+        NSLog(@"setAlertTitle: not supported");
+    }
+    notification.alertBody = alertBody;
+    notification.alertAction = alertAction;
+    notification.hasAction = (alertAction.length > 0);
+    notification.alertLaunchImage = alertLaunchImage;
+}
+
+- (void)customizeNotification:(UILocalNotification *const)notification
+                 appIconBadge:(NSInteger const)badgeNumber
+                        sound:(BOOL const)hasSound
+{
+    NSParameterAssert(notification);
+    notification.applicationIconBadgeNumber = badgeNumber;
+    if (hasSound) {
+        notification.soundName = self.defaultSoundName;
+    }
+}
+
+- (MRLocalNotificationTemplate *)buildTemplateWithNotification:(UILocalNotification *const)notification
+                                                badgeIncrement:(NSInteger const)badgeIncrement
+                                                         error:(NSError **const)errorPtr
+{
+    NSParameterAssert(notification);
+    MRLocalNotificationErrorCode code = kMRLocalNotificationErrorNone;
+    BOOL const isValid = [self mr_isNotificationValid:notification
+                                         withSettings:self.settingsSnapshot
+                                             recovery:YES
+                                            errorCode:&code];
+    if (code != kMRLocalNotificationErrorNone && errorPtr) {
+        *errorPtr = [self buildErrorWithCode:code];
+    }
+    if (!isValid) {
+        return nil;
+    }
+    return [[MRLocalNotificationTemplate alloc] initWithNotification:notification
+                                                      badgeIncrement:badgeIncrement];
+}
+
+- (NSArray *)buildNotificationsWithTemplate:(MRLocalNotificationTemplate *const)notificationTemplate
+                                  fireDates:(NSArray *const)fireDates
+{
+    return [self buildNotificationsWithTemplate:notificationTemplate
+                                      fireDates:fireDates
+                                    identifiers:nil];
+}
+
+- (NSArray *)buildNotificationsWithTemplate:(MRLocalNotificationTemplate *const)notificationTemplate
+                                  fireDates:(NSArray *const)fireDates
+                                identifiers:(NSArray *const)identifiers
+{
+    NSParameterAssert(notificationTemplate);
+    NSParameterAssert(fireDates);
+    NSParameterAssert(identifiers == nil || identifiers.count == fireDates.count);
+    NSMutableArray *const notifications = [NSMutableArray arrayWithCapacity:fireDates.count];
+    NSUInteger index = 0;
+    for (NSDate *const fireDate in fireDates) {
+        [notifications addObject:[notificationTemplate notificationWithFireDate:fireDate
+                                                                     identifier:identifiers[index]
+                                                                          index:index]];
+        index += 1;
+    }
+    return notifications;
+}
+
+- (NSArray *)buildNotificationsWithTemplate:(MRLocalNotificationTemplate *const)notificationTemplate
+                              fireIntervals:(NSTimeInterval const *const)fireIntervals
+                                      count:(NSUInteger const)count
+{
+    return [self buildNotificationsWithTemplate:notificationTemplate
+                                  fireIntervals:fireIntervals
+                                          count:count
+                                    identifiers:nil];
+}
+
+- (NSArray *)buildNotificationsWithTemplate:(MRLocalNotificationTemplate *const)notificationTemplate
+                              fireIntervals:(NSTimeInterval const *const)fireIntervals
+                                      count:(NSUInteger const)count
+                                identifiers:(NSArray *const)identifiers
+{
+    NSParameterAssert(notificationTemplate);
+    NSParameterAssert(fireIntervals || count == 0);
+    NSParameterAssert(identifiers == nil || identifiers.count == count);
+    NSTimeInterval const now = [self mr_now];
+    NSMutableArray *const notifications = [NSMutableArray arrayWithCapacity:count];
+    for (NSUInteger index = 0; index < count; index++) {
+        NSParameterAssert(fireIntervals[index] >= 0);
+        NSDate *const fireDate = [NSDate dateWithTimeIntervalSinceReferenceDate:now + fireIntervals[index]];
+        [notifications addObject:[notificationTemplate notificationWithFireDate:fireDate
+                                                                     identifier:identifiers[index]
+                                                                          index:index]];
+    }
+    return notifications;
+}
+
+- (void)presentNotificationNow:(UILocalNotification *const)notification
+{
+    NSParameterAssert(notification);
+    if (!NSThread.isMainThread) {
+        NSLog(@"presenting notification from a thread other than the main thread");
+        dispatch_async(dispatch_get_main_queue(), ^{
+            [self presentNotificationNow:notification];
+        });
+        return;
+    }
+    UIApplication *const application = self.defaultApplication;
+    [self.metrics countApplicationCall:MRApplicationCallPresentLocalNotificationNow_];
+    [application presentLocalNotificationNow:notification];
+}
+
+- (void)scheduleNotification:(UILocalNotification *const)notification
+{
+    NSParameterAssert(notification);
+    MRLocalNotificationMetrics_ *const metrics = self.metrics;
+    uint64_t const startTime = (metrics ? mach_absolute_time() : 0);
+    NSString *const identifier = [self getIdentifierFromNotification:notification];
+    NSUInteger const badgeRank = [self mr_assignBadgeToNotification:notification identifier:identifier];
+    [self mr_storePayloadOfNotification:notification];
+    if (self.maximumScheduledNotifications > 0) {
+        [self mr_scheduleNotificationWithOverflow:notification];
+    } else {
+        UIApplication *const application = self.defaultApplication;
+        [metrics countApplicationCall:MRApplicationCallScheduleLocalNotification_];
+        [application scheduleLocalNotification:notification];
+    }
+    if (identifier) {
+        [self mr_setIndexedNotification:notification.copy forIdentifier:identifier];
+        [self.journal appendNotification:notification
+                              identifier:identifier
+                                fireDate:[self getGMTFireDateFromNotification:notification]];
+    }
+    if (badgeRank != NSNotFound) {
+        [self mr_sequenceBadgesFromRank:badgeRank];
+    }
+    [metrics recordOperation:MRMetricsOperationSchedule_ startTime:startTime];
+}
+
+- (NSArray *)scheduledNotifications
+{
+    UIApplication *const application = self.defaultApplication;
+    [self.metrics countApplicationCall:MRApplicationCallScheduledLocalNotifications_];
+    NSArray *const localNotifications = application.scheduledLocalNotifications;
+    return (localNotifications ?: @[]);
+}
+
+- (NSArray *)queuedNotifications
+{
+    MRLocalNotificationHeap_ *const queue = self.overflowQueue;
+    return queue.allObjects;
+}
+
+- (void)cancelNotification:(UILocalNotification *const)notification
+{
+    UIApplication *const application = self.defaultApplication;
+    MRLocalNotificationMetrics_ *const metrics = self.metrics;
+    uint64_t const startTime = (metrics ? mach_absolute_time() : 0);
+    if (notification) {
+        NSString *const identifier = [self getIdentifierFromNotification:notification];
+        NSMutableDictionary *const index = self.scheduledNotificationsIndex;
+        UILocalNotification *const indexedNotification = (identifier ? index[identifier] : nil);
+        NSUInteger const badgeRank = (indexedNotification && self.automaticBadges && !self.sequencingBadges
+                                      ? [self.timeIndex rankOfIdentifier:identifier]
+                                      : NSNotFound);
+        UILocalNotification *const cancelledNotification = (indexedNotification ?: notification);
+        MRLocalNotificationHeap_ *const queue = self.overflowQueue;
+        if ([queue containsObject:cancelledNotification]) {
+            [queue removeObject:cancelledNotification];
+        } else {
+            [metrics countApplicationCall:MRApplicationCallCancelLocalNotification_];
+            [application cancelLocalNotification:cancelledNotification];
+            if (_overflowPendingNotifications) {
+                [self mr_removeOverflowPendingNotification:cancelledNotification];
+                [self mr_fillOverflowSlots];
+            }
+        }
+        if (identifier) {
+            [self mr_setIndexedNotification:nil forIdentifier:identifier];
+            [self.journal appendCancellationWithIdentifier:identifier];
+            // A cancelled pooled notification is scheduled again by the next location update.
+            [_regionPoolScheduledIdentifiers removeObject:identifier];
+        }
+        [self mr_removePayloadOfNotification:cancelledNotification];
+        if (badgeRank != NSNotFound) {
+            [self mr_sequenceBadgesFromRank:badgeRank];
+        }
+    }
+    [metrics recordOperation:MRMetricsOperationCancel_ startTime:startTime];
+}
+
+- (void)cancelAllNotifications
+{
+    UIApplication *const application = self.defaultApplication;
+    [self.metrics countApplicationCall:MRApplicationCallCancelAllLocalNotifications_];
+    [application cancelAllLocalNotifications];
+    [self mr_resetScheduledNotificationsIndex:NSMutableDictionary.dictionary];
+    [self.overflowQueue removeAllObjects];
+    [_overflowPendingNotifications removeAllObjects];
+    [_overflowFiringNotifications removeAllObjects];
+    [_regionPoolScheduledIdentifiers removeAllObjects];
+    [self.journal appendCancellationOfAllNotifications];
+    [self.payloadStore removeAllPayloads];
+    [_payloadsByKey removeAllObjects];
+}
+
+- (NSArray *)journaledNotifications
+{
+    MRLocalNotificationJournal_ *const journal = self.journal;
+    return (journal ? [journal pendingNotificationsAtTime:[self mr_now]] : @[]);
+}
+
+- (void)compactJournal
+{
+    [self.journal compact];
+}
+
+- (void)replenishScheduledNotifications
+{
+    if (self.maximumScheduledNotifications == 0) {
+        return;
+    }
+    [self mr_fillOverflowSlots];
+}
+
+- (NSString *)getIdentifierFromNotification:(UILocalNotification *const)notification
+{
+    NSParameterAssert(notification);
+    id const identifier = notification.userInfo[MRLocalNotificationIdentifierKey];
+    if ([identifier isKindOfClass:NSString.class]) {
+        return identifier;
+    }
+    return nil;
+}
+
+- (NSDictionary *)getUserInfoFromNotification:(UILocalNotification *const)notification
+{
+    NSParameterAssert(notification);
+    NSDictionary *const userInfo = notification.userInfo;
+    NSString *const payloadKey = userInfo[MRLocalNotificationPayloadKey];
+    if (![payloadKey isKindOfClass:NSString.class]) {
+        return userInfo;
+    }
+    NSDictionary *const payload = [self.payloadStore payloadForKey:payloadKey];
+    if (payload == nil) {
+        NSLog(@"missing notification payload %@", payloadKey);
+        return userInfo;
+    }
+    NSMutableDictionary *const fullUserInfo = payload.mutableCopy;
+    NSString *const identifier = userInfo[MRLocalNotificationIdentifierKey];
+    if (identifier) {
+        fullUserInfo[MRLocalNotificationIdentifierKey] = identifier;
+    }
+    return fullUserInfo.copy;
+}
+
+- (UILocalNotification *)scheduledNotificationWithIdentifier:(NSString *const)identifier
+{
+    NSParameterAssert(identifier);
+    return [self mr_indexedNotificationForIdentifier:identifier];
+}
+
+- (NSArray *)cancelNotificationsWithCategory:(NSString *const)category
+{
+    NSParameterAssert(category);
+    NSArray *const identifiers = [self.categoryIndex[category] allObjects];
+    return [self mr_cancelNotificationsWithIdentifiers:identifiers];
+}
+
+- (NSArray *)cancelNotificationsWithUserInfoValue:(id const)value
+                                           forKey:(id<NSCopying> const)key
+{
+    NSParameterAssert(value);
+    NSParameterAssert(key);
+    NSArray *const identifiers = [[self mr_userInfoIndexForKey:key][value] allObjects];
+    return [self mr_cancelNotificationsWithIdentifiers:identifiers];
+}
+
+- (NSArray *)cancelNotificationsWithFireDateFrom:(NSDate *const)startDate
+                                              to:(NSDate *const)endDate
+{
+    NSParameterAssert(startDate);
+    NSParameterAssert(endDate);
+    [self mr_pruneTimeIndex];
+    NSArray *const identifiers = [self.timeIndex identifiersFromKey:startDate.timeIntervalSinceReferenceDate
+                                                              toKey:endDate.timeIntervalSinceReferenceDate];
+    return [self mr_cancelNotificationsWithIdentifiers:identifiers];
+}
+
+- (UILocalNotification *)nextScheduledNotification
+{
+    [self mr_pruneTimeIndex];
+    NSString *const identifier = self.timeIndex.firstIdentifier;
+    return (identifier ? self.scheduledNotificationsIndex[identifier] : nil);
+}
+
+- (NSArray *)scheduledNotificationsFiringFrom:(NSDate *const)startDate
+                                           to:(NSDate *const)endDate
+{
+    NSParameterAssert(startDate);
+    NSParameterAssert(endDate);
+    [self mr_pruneTimeIndex];
+    NSArray *const identifiers = [self.timeIndex identifiersFromKey:startDate.timeIntervalSinceReferenceDate
+                                                              toKey:endDate.timeIntervalSinceReferenceDate];
+    NSDictionary *const index = self.scheduledNotificationsIndex;
+    NSMutableArray *const notifications = [NSMutableArray arrayWithCapacity:identifiers.count];
+    for (NSString *const identifier in identifiers) {
+        [notifications addObject:index[identifier]];
+    }
+    return notifications;
+}
+
+- (NSArray *)cancelNotificationsMatchingPredicate:(NSPredicate *const)predicate
+{
+    NSParameterAssert(predicate);
+    NSMutableArray *const identifiers = NSMutableArray.array;
+    [self.scheduledNotificationsIndex enumerateKeysAndObjectsUsingBlock:^(NSString *const identifier, UILocalNotification *const notification, BOOL *const stop) {
+        if ([predicate evaluateWithObject:notification]) {
+            [identifiers addObject:identifier];
+        }
+    }];
+    return [self mr_cancelNotificationsWithIdentifiers:identifiers];
+}
+
+- (NSDictionary *)applyDesiredNotifications:(NSArray *const)desiredNotifications
+{
+    NSParameterAssert(desiredNotifications);
+    NSArray *const snapshot = [self mr_reconcileScheduledNotifications];
+    NSMutableDictionary *const index = self.scheduledNotificationsIndex;
+    MRLocalNotificationSettingsSnapshot_ *const settings = self.settingsSnapshot;
+    NSMutableSet *const desiredIdentifiers = [NSMutableSet setWithCapacity:desiredNotifications.count];
+    NSMutableArray *const inserted = NSMutableArray.array;
+    NSMutableArray *const updated = NSMutableArray.array;
+    NSMutableArray *const deleted = NSMutableArray.array;
+    NSMutableArray *const unchanged = NSMutableArray.array;
+    NSMutableDictionary *const errors = NSMutableDictionary.dictionary;
+    NSMutableArray *const cancelledNotifications = NSMutableArray.array;
+    NSMutableArray *const scheduledNotifications = NSMutableArray.array;
+    NSMutableArray *const scheduledIdentifiers = NSMutableArray.array;
+    NSMutableSet *const replacedIdentifiers = NSMutableSet.set;
+    for (UILocalNotification *const notification in desiredNotifications) {
+        NSString *const identifier = ([notification isKindOfClass:UILocalNotification.class]
+                                      ? [self getIdentifierFromNotification:notification]
+                                      : nil);
+        if (identifier == nil) {
+            NSLog(@"ignoring desired notification without identifier");
+            continue;
+        }
+        if ([desiredIdentifiers containsObject:identifier]) {
+            errors[identifier] = [self buildErrorWithCode:MRLocalNotificationErrorAlreadyScheduled];
+            continue;
+        }
+        [desiredIdentifiers addObject:identifier];
+        UILocalNotification *const currentNotification = index[identifier];
+        if (currentNotification == nil) {
+            [scheduledNotifications addObject:notification];
+            [scheduledIdentifiers addObject:identifier];
+            continue;
+        }
+        if ([self mr_isNotification:notification equivalentToNotification:currentNotification]) {
+            [unchanged addObject:identifier];
+            continue;
+        }
+        MRLocalNotificationErrorCode code = kMRLocalNotificationErrorNone;
+        BOOL const valid = ([self mr_isNotificationIntrinsicallyValid:notification errorCode:&code] &&
+                            [self mr_isNotificationValid:notification
+                                            withSettings:settings
+                                                recovery:YES
+                                               errorCode:&code]);
+        if (!valid) {
+            errors[identifier] = [self buildErrorWithCode:code];
+            continue;
+        }
+        [cancelledNotifications addObject:currentNotification];
+        [scheduledNotifications addObject:notification];
+        [scheduledIdentifiers addObject:identifier];
+        [replacedIdentifiers addObject:identifier];
+    }
+    for (NSString *const identifier in index.allKeys) {
+        if (![desiredIdentifiers containsObject:identifier]) {
+            [cancelledNotifications addObject:index[identifier]];
+            [deleted addObject:identifier];
+        }
+    }
+    for (UILocalNotification *const notification in cancelledNotifications) {
+        [self cancelNotification:notification];
+    }
+    NSArray *scheduleErrors;
+    // Reuses the reconciled snapshot instead of fetching the pending notifications again.
+    NSIndexSet *const scheduledIndexes = [self mr_scheduleNotifications:scheduledNotifications
+                                                 scheduledNotifications:snapshot
+                                                                 errors:&scheduleErrors];
+    [scheduledIdentifiers enumerateObjectsUsingBlock:^(NSString *const identifier, NSUInteger const idx, BOOL *const stop) {
+        id const error = scheduleErrors[idx];
+        if (error != NSNull.null) {
+            errors[identifier] = error;
+        }
+        if ([scheduledIndexes containsIndex:idx]) {
+            BOOL const isUpdate = [replacedIdentifiers containsObject:identifier];
+            [(isUpdate ? updated : inserted) addObject:identifier];
+        }
+    }];
+    return @{ MRLocalNotificationInsertedIdentifiersKey: inserted.copy,
+              MRLocalNotificationUpdatedIdentifiersKey: updated.copy,
+              MRLocalNotificationDeletedIdentifiersKey: deleted.copy,
+              MRLocalNotificationUnchangedIdentifiersKey: unchanged.copy,
+              MRLocalNotificationErrorsByIdentifierKey: errors.copy };
+}
+
+- (BOOL)addNotificationToRegionPool:(UILocalNotification *const)notification
+                              error:(NSError **const)errorPtr
+{
+    NSParameterAssert(notification);
+    NSString *const identifier = [self getIdentifierFromNotification:notification];
+    MRLocalNotificationErrorCode code = kMRLocalNotificationErrorNone;
+    BOOL isValid = NO;
+    if (identifier == nil || ![notification.region isKindOfClass:CLCircularRegion.class]) {
+        code = MRLocalNotificationErrorInvalidObject;
+        [self.metrics countErrorCode:code];
+    } else {
+        isValid = [self mr_isNotificationValid:notification
+                                  withSettings:self.settingsSnapshot
+                                      recovery:YES
+                                     errorCode:&code];
+    }
+    if (code != kMRLocalNotificationErrorNone && errorPtr) {
+        *errorPtr = [self buildErrorWithCode:code];
+    }
+    if (!isValid) {
+        return NO;
+    }
+    CLCircularRegion *const region = (CLCircularRegion *)notification.region;
+    UILocalNotification *const pooledNotification = notification.copy;
+    UILocalNotification *const previousNotification = self.regionPool[identifier];
+    self.regionPool[identifier] = pooledNotification;
+    [self.regionIndex setLatitude:region.center.latitude
+                        longitude:region.center.longitude
+                           radius:region.radius
+                    forIdentifier:identifier];
+    if (previousNotification && [self.regionPoolScheduledIdentifiers containsObject:identifier]) {
+        [self cancelNotification:previousNotification];
+        [self scheduleNotification:pooledNotification.copy];
+        [self.regionPoolScheduledIdentifiers addObject:identifier];
+    }
+    return YES;
+}
+
+- (void)removeNotificationFromRegionPool:(UILocalNotification *const)notification
+{
+    NSParameterAssert(notification);
+    NSString *const identifier = [self getIdentifierFromNotification:notification];
+    UILocalNotification *const pooledNotification = (identifier ? self.regionPool[identifier] : nil);
+    if (pooledNotification == nil) {
+        return;
+    }
+    if ([self.regionPoolScheduledIdentifiers containsObject:identifier]) {
+        [self cancelNotification:pooledNotification];
+    }
+    [self mr_removeIdentifierFromRegionPool:identifier];
+}
+
+- (void)removeAllNotificationsFromRegionPool
+{
+    NSDictionary *const regionPool = self.regionPool;
+    for (NSString *const identifier in self.regionPoolScheduledIdentifiers.allObjects) {
+        [self cancelNotification:regionPool[identifier]];
+    }
+    [self.regionPool removeAllObjects];
+    [self.regionIndex removeAllIdentifiers];
+    [self.regionPoolScheduledIdentifiers removeAllObjects];
+}
+
+- (NSArray *)updateRegionPoolWithLocation:(CLLocation *const)location
+{
+    NSParameterAssert(location);
+    CLLocationCoordinate2D const coordinate = location.coordinate;
+    NSArray *const identifiers = [self.regionIndex identifiersNearestToLatitude:coordinate.latitude
+                                                                      longitude:coordinate.longitude
+                                                                          count:self.maximumRegionNotifications];
+    NSDictionary *const regionPool = self.regionPool;
+    NSMutableSet *const scheduledIdentifiers = self.regionPoolScheduledIdentifiers;
+    NSSet *const selectedIdentifiers = [NSSet setWithArray:identifiers];
+    for (NSString *const identifier in scheduledIdentifiers.allObjects) {
+        if (![selectedIdentifiers containsObject:identifier]) {
+            [self cancelNotification:regionPool[identifier]];
+        }
+    }
+    for (NSString *const identifier in identifiers) {
+        if (![scheduledIdentifiers containsObject:identifier]) {
+            [self scheduleNotification:[regionPool[identifier] copy]];
+            [scheduledIdentifiers addObject:identifier];
+        }
+    }
+    return identifiers;
+}
+
+- (NSDictionary *)metricsSnapshot
+{
+    MRLocalNotificationMetrics_ *const metrics = self.metrics;
+    if (metrics == nil) {
+        return @{};
+    }
+    NSMutableDictionary *const snapshot = metrics.snapshot.mutableCopy;
+    NSMutableDictionary *const startupCosts = self.startupCosts;
+    @synchronized(startupCosts) {
+        snapshot[MRLocalNotificationMetricsStartupKey] = startupCosts.copy;
+    }
+    return snapshot;
+}
+
+- (void)resetMetrics
+{
+    if (self.metrics) {
+        self.metrics = MRLocalNotificationMetrics_.new;
+    }
+}
+
+- (void)reconcileScheduledNotifications
+{
+    [self mr_reconcileScheduledNotifications];
+}
+
+#pragma mark Private
+
+- (NSArray *)mr_reconcileScheduledNotifications
+{
+    NSArray *const scheduledNotifications = self.scheduledNotifications;
+    NSMutableDictionary *const index =
+    [NSMutableDictionary dictionaryWithCapacity:scheduledNotifications.count];
+    for (UILocalNotification *const notification in scheduledNotifications) {
+        NSString *const identifier = [self getIdentifierFromNotification:notification];
+        if (identifier) {
+            index[identifier] = notification;
+        }
+    }
+    for (UILocalNotification *const notification in self.overflowQueue.allObjects) {
+        NSString *const identifier = [self getIdentifierFromNotification:notification];
+        if (identifier) {
+            index[identifier] = notification;
+        }
+    }
+    [self mr_resetScheduledNotificationsIndex:index];
+    return scheduledNotifications;
+}
+
+- (NSArray *)mr_cancelNotificationsWithIdentifiers:(NSArray *const)identifiers
+{
+    NSMutableDictionary *const index = self.scheduledNotificationsIndex;
+    NSMutableArray *const cancelledNotifications = [NSMutableArray arrayWithCapacity:identifiers.count];
+    BOOL const sequenceBadges = (self.automaticBadges && !self.sequencingBadges);
+    NSUInteger badgeRank = NSNotFound;
+    self.sequencingBadges = (self.sequencingBadges || sequenceBadges);
+    for (NSString *const identifier in identifiers) {
+        UILocalNotification *const notification = index[identifier];
+        if (notification) {
+            if (sequenceBadges) {
+                badgeRank = MIN(badgeRank, [self.timeIndex rankOfIdentifier:identifier]);
+            }
+            [cancelledNotifications addObject:notification];
+            [self cancelNotification:notification];
+        }
+    }
+    if (sequenceBadges) {
+        self.sequencingBadges = NO;
+        if (badgeRank != NSNotFound) {
+            [self mr_sequenceBadgesFromRank:badgeRank];
+        }
+    }
+    return cancelledNotifications.copy;
+}
+
+- (void)mr_resetScheduledNotificationsIndex:(NSMutableDictionary *const)index
+{
+    _scheduledNotificationsIndex = index;
+    _categoryIndex = nil;
+    _userInfoIndexes = nil;
+    _payloadReferences = nil;
+    _timeIndex = nil;
+    _floatingIdentifiers = nil;
+}
+
+- (NSTimeInterval)mr_timeIndexKeyForNotification:(UILocalNotification *const)notification
+{
+    // Floating notifications fire at their wall-clock time in the current zone, not in the one they were built for.
+    NSTimeZone *const timeZone = (notification.timeZone ? NSTimeZone.defaultTimeZone : nil);
+    NSDate *const fireDate = [self mr_GMTFireDateFromNotification:notification timeZone:timeZone];
+    if (fireDate == nil) {
+        return NAN;
+    }
+    NSTimeInterval const now = [self mr_now];
+    NSTimeInterval const fireTime = fireDate.timeIntervalSinceReferenceDate;
+    if (notification.repeatInterval == 0 || fireTime >= now) {
+        return fireTime;
+    }
+    MRLocalNotificationRecurrenceEnumerator_ *const enumerator =
+    [self mr_recurrenceEnumeratorForNotification:notification rule:nil timeZone:timeZone];
+    [enumerator skipToDate:[NSDate dateWithTimeIntervalSinceReferenceDate:now]];
+    NSTimeInterval time;
+    while ([enumerator getNextTimeInterval:&time]) {
+        if (time - NSTimeIntervalSince1970 >= now) {
+            return time - NSTimeIntervalSince1970;
+        }
+    }
+    return NAN;
+}
+
+- (void)mr_pruneTimeIndex
+{
+    MRLocalNotificationSkipList_ *const timeIndex = self.timeIndex;
+    NSMutableDictionary *const index = self.scheduledNotificationsIndex;
+    NSTimeInterval const now = [self mr_now];
+    NSUInteger badgeRank = NSNotFound;
+    while (timeIndex.count > 0 && timeIndex.firstKey < now) {
+        NSString *const identifier = timeIndex.firstIdentifier;
+        UILocalNotification *const notification = index[identifier];
+        NSTimeInterval const key = (notification.repeatInterval != 0
+                                    ? [self mr_timeIndexKeyForNotification:notification]
+                                    : NAN);
+        if (!isnan(key)) {
+            [timeIndex setKey:key forIdentifier:identifier];
+        } else if (notification.repeatInterval != 0 || notification == nil) {
+            [timeIndex removeIdentifier:identifier];
+        } else {
+            if (self.automaticBadges) {
+                [self mr_incrementAutomaticBadgeBase];
+            }
+            [self mr_setIndexedNotification:nil forIdentifier:identifier];
+            continue;
+        }
+        // The badge base stays, so the notifications that followed the first one move up one badge.
+        badgeRank = 0;
+    }
+    if (badgeRank != NSNotFound) {
+        [self mr_sequenceBadgesFromRank:badgeRank];
+    }
+}
+
+- (NSTimeInterval)mr_now
+{
+    NSTimeInterval(^const clock)(void) = self.clock;
+    return (clock ? clock() : NSDate.timeIntervalSinceReferenceDate);
+}
+
+- (void)mr_recordStartupCost:(NSString *const)name startTime:(uint64_t const)startTime
+{
+    // Only the first resolution counts as startup cost.
+    NSNumber *const nanoseconds = @(MRNanosecondsSince_(startTime));
+    NSMutableDictionary *const startupCosts = self.startupCosts;
+    @synchronized(startupCosts) {
+        if (startupCosts[name] == nil) {
+            startupCosts[name] = nanoseconds;
+        }
+    }
+}
+
+- (void)mr_removeIdentifierFromRegionPool:(NSString *const)identifier
+{
+    [_regionPool removeObjectForKey:identifier];
+    [_regionIndex removeIdentifier:identifier];
+    [_regionPoolScheduledIdentifiers removeObject:identifier];
+}
+
+- (NSUInteger)mr_assignBadgeToNotification:(UILocalNotification *const)notification
+                                identifier:(NSString *const)identifier
+{
+    if (!self.automaticBadges || self.sequencingBadges || identifier == nil) {
+        return NSNotFound;
+    }
+    NSTimeInterval const key = [self mr_timeIndexKeyForNotification:notification];
+    if (isnan(key)) {
+        return NSNotFound;
+    }
+    [self mr_pruneTimeIndex];
+    MRLocalNotificationSkipList_ *const timeIndex = self.timeIndex;
+    NSUInteger rank = [timeIndex rankOfKey:key identifier:identifier];
+    NSUInteger const previousRank = [timeIndex rankOfIdentifier:identifier];
+    if (previousRank != NSNotFound && previousRank < rank) {
+        rank -= 1;
+    }
+    notification.applicationIconBadgeNumber = self.automaticBadgeBase + (NSInteger)rank + 1;
+    // Notifications between the old and the new position shift by one.
+    return MIN(rank + 1, previousRank);
+}
+
+- (void)mr_incrementAutomaticBadgeBase
+{
+    // The delivered notification leaves the sequence, so later badges stay valid.
+    [self willChangeValueForKey:@"automaticBadgeBase"];
+    _automaticBadgeBase += 1;
+    [self didChangeValueForKey:@"automaticBadgeBase"];
+}
+
+- (void)mr_sequenceBadgesFromRank:(NSUInteger const)rank
+{
+    if (!self.automaticBadges || self.sequencingBadges) {
+        return;
+    }
+    self.sequencingBadges = YES;
+    NSDictionary *const index = self.scheduledNotificationsIndex;
+    NSInteger badge = self.automaticBadgeBase + (NSInteger)rank + 1;
+    for (NSString *const identifier in [self.timeIndex identifiersFromRank:rank]) {
+        UILocalNotification *const notification = index[identifier];
+        if (notification && notification.applicationIconBadgeNumber != badge) {
+            UILocalNotification *const badgedNotification = notification.copy;
+            badgedNotification.applicationIconBadgeNumber = badge;
+            [self mr_replaceScheduledNotification:notification
+                                 withNotification:badgedNotification
+                                       identifier:identifier];
+        }
+        badge += 1;
+    }
+    self.sequencingBadges = NO;
+}
+
+- (void)mr_replaceScheduledNotification:(UILocalNotification *const)notification
+                       withNotification:(UILocalNotification *const)replacement
+                             identifier:(NSString *const)identifier
+{
+    // Unlike cancel + schedule, this keeps the payload referenced all along.
+    MRLocalNotificationMetrics_ *const metrics = self.metrics;
+    MRLocalNotificationHeap_ *const queue = self.overflowQueue;
+    if ([queue containsObject:notification]) {
+        [queue removeObject:notification];
+        [queue addObject:replacement withKey:[self mr_overflowKeyForNotification:replacement]];
+    } else {
+        UIApplication *const application = self.defaultApplication;
+        [metrics countApplicationCall:MRApplicationCallCancelLocalNotification_];
+        [application cancelLocalNotification:notification];
+        [metrics countApplicationCall:MRApplicationCallScheduleLocalNotification_];
+        [application scheduleLocalNotification:replacement];
+        if ([_overflowPendingNotifications containsObject:notification]) {
+            [self mr_removeOverflowPendingNotification:notification];
+            [self mr_addOverflowPendingNotification:replacement];
+        }
+    }
+    [self mr_setIndexedNotification:replacement.copy forIdentifier:identifier];
+    [self.journal appendNotification:replacement
+                          identifier:identifier
+                            fireDate:[self getGMTFireDateFromNotification:replacement]];
+}
+
+- (void)mr_storePayloadOfNotification:(UILocalNotification *const)notification
+{
+    MRLocalNotificationPayloadStore_ *const store = self.payloadStore;
+    NSDictionary *const userInfo = notification.userInfo;
+    NSString *const identifier = [self getIdentifierFromNotification:notification];
+    if (store == nil || identifier == nil || userInfo[MRLocalNotificationPayloadKey]) {
+        return;
+    }
+    NSMutableDictionary *const payload = userInfo.mutableCopy;
+    [payload removeObjectForKey:MRLocalNotificationIdentifierKey];
+    if (payload.count == 0) {
+        return;
+    }
+    if (self.needsPayloadSweep) {
+        // Loads the index first, so its sweep cannot remove the payload written below.
+        [self scheduledNotificationsIndex];
+    }
+    NSString *const payloadKey = [store storePayload:payload];
+    if (payloadKey) {
+        self.payloadsByKey[payloadKey] = payload.copy;
+        notification.userInfo = @{ MRLocalNotificationIdentifierKey: identifier,
+                                   MRLocalNotificationPayloadKey: payloadKey };
+    }
+}
+
+- (void)mr_removePayloadOfNotification:(UILocalNotification *const)notification
+{
+    // Payloads are content-addressed, so other scheduled notifications may still refer to them.
+    NSString *const payloadKey = notification.userInfo[MRLocalNotificationPayloadKey];
+    if (payloadKey && self.payloadStore && [self.payloadReferences countForObject:payloadKey] == 0) {
+        [self.payloadStore removePayloadForKey:payloadKey];
+        [_payloadsByKey removeObjectForKey:payloadKey];
+    }
+}
+
+- (void)mr_sweepPayloadStore
+{
+    MRLocalNotificationPayloadStore_ *const store = self.payloadStore;
+    if (store == nil || !self.needsPayloadSweep) {
+        return;
+    }
+    // Removes the payloads of notifications delivered without being handled by a previous run.
+    self.needsPayloadSweep = NO;
+    NSCountedSet *const payloadReferences = self.payloadReferences;
+    [store removePayloadsExceptForKeys:payloadReferences];
+    for (NSString *const payloadKey in _payloadsByKey.allKeys) {
+        if ([payloadReferences countForObject:payloadKey] == 0) {
+            [_payloadsByKey removeObjectForKey:payloadKey];
+        }
+    }
+}
+
+- (UILocalNotification *)mr_notificationWithPayload:(UILocalNotification *const)notification
+{
+    if (notification.userInfo[MRLocalNotificationPayloadKey] == nil) {
+        return notification;
+    }
+    UILocalNotification *const fullNotification = notification.copy;
+    fullNotification.userInfo = [self getUserInfoFromNotification:notification];
+    return fullNotification;
+}
+
+- (void)mr_setIndexedNotification:(UILocalNotification *const)notification
+                    forIdentifier:(NSString *const)identifier
+{
+    NSParameterAssert(identifier);
+    NSMutableDictionary *const index = self.scheduledNotificationsIndex;
+    UILocalNotification *const previousNotification = index[identifier];
+    if (previousNotification) {
+        [self mr_updateSecondaryIndexesWithNotification:previousNotification
+                                             identifier:identifier
+                                                 adding:NO];
+    }
+    if (notification) {
+        index[identifier] = notification;
+        [self mr_updateSecondaryIndexesWithNotification:notification
+                                             identifier:identifier
+                                                 adding:YES];
+    } else {
+        [index removeObjectForKey:identifier];
+    }
+}
+
+- (void)mr_updateSecondaryIndexesWithNotification:(UILocalNotification *const)notification
+                                       identifier:(NSString *const)identifier
+                                           adding:(BOOL const)adding
+{
+    NSString *const category = notification.category;
+    if (category && _categoryIndex) {
+        [self mr_updateIndex:_categoryIndex key:category identifier:identifier adding:adding];
+    }
+    if (_timeIndex) {
+        NSTimeInterval const key = (adding ? [self mr_timeIndexKeyForNotification:notification] : NAN);
+        if (isnan(key)) {
+            [_timeIndex removeIdentifier:identifier];
+        } else {
+            [_timeIndex setKey:key forIdentifier:identifier];
+        }
+        if (adding && notification.timeZone) {
+            [_floatingIdentifiers addObject:identifier];
+        } else {
+            [_floatingIdentifiers removeObject:identifier];
+        }
+    }
+    NSString *const payloadKey = notification.userInfo[MRLocalNotificationPayloadKey];
+    if (payloadKey && _payloadReferences) {
+        if (adding) {
+            [_payloadReferences addObject:payloadKey];
+        } else {
+            [_payloadReferences removeObject:payloadKey];
+        }
+    }
+    NSDictionary *const userInfo = (_userInfoIndexes.count > 0
+                                    ? [self mr_indexedUserInfoOfNotification:notification]
+                                    : nil);
+    [_userInfoIndexes enumerateKeysAndObjectsUsingBlock:^(id const key, NSMutableDictionary *const valueIndex, BOOL *const stop) {
+        id const value = userInfo[key];
+        if (value) {
+            [self mr_updateIndex:valueIndex key:value identifier:identifier adding:adding];
+        }
+    }];
+}
+
+- (void)mr_updateIndex:(NSMutableDictionary *const)index
+                   key:(id const)key
+            identifier:(NSString *const)identifier
+                adding:(BOOL const)adding
+{
+    NSMutableSet *identifiers = index[key];
+    if (adding) {
+        if (identifiers == nil) {
+            identifiers = NSMutableSet.set;
+            index[key] = identifiers;
+        }
+        [identifiers addObject:identifier];
+    } else {
+        [identifiers removeObject:identifier];
+        if (identifiers && identifiers.count == 0) {
+            [index removeObjectForKey:key];
+        }
+    }
+}
+
+- (NSMutableDictionary *)mr_userInfoIndexForKey:(id const)key
+{
+    NSMutableDictionary *const userInfoIndexes = self.userInfoIndexes;
+    NSMutableDictionary *valueIndex = userInfoIndexes[key];
+    if (valueIndex == nil) {
+        valueIndex = NSMutableDictionary.dictionary;
+        [self.scheduledNotificationsIndex enumerateKeysAndObjectsUsingBlock:^(NSString *const identifier, UILocalNotification *const notification, BOOL *const stop) {
+            id const value = [self mr_indexedUserInfoOfNotification:notification][key];
+            if (value) {
+                [self mr_updateIndex:valueIndex key:value identifier:identifier adding:YES];
+            }
+        }];
+        userInfoIndexes[key] = valueIndex;
+    }
+    return valueIndex;
+}
+
+- (NSDictionary *)mr_indexedUserInfoOfNotification:(UILocalNotification *const)notification
+{
+    // Payloads stay in memory once known, so updating the indexes never reads the payload store.
+    NSDictionary *const userInfo = notification.userInfo;
+    NSString *const payloadKey = userInfo[MRLocalNotificationPayloadKey];
+    if (![payloadKey isKindOfClass:NSString.class]) {
+        return userInfo;
+    }
+    NSMutableDictionary *const payloads = self.payloadsByKey;
+    NSDictionary *payload = payloads[payloadKey];
+    if (payload == nil) {
+        payload = [self.payloadStore payloadForKey:payloadKey];
+        if (payload == nil) {
+            return userInfo;
+        }
+        payloads[payloadKey] = payload;
+    }
+    NSString *const identifier = userInfo[MRLocalNotificationIdentifierKey];
+    if (identifier == nil) {
+        return payload;
+    }
+    NSMutableDictionary *const fullUserInfo = payload.mutableCopy;
+    fullUserInfo[MRLocalNotificationIdentifierKey] = identifier;
+    return fullUserInfo;
+}
+
+- (BOOL)mr_isNotification:(UILocalNotification *const)notification
+ equivalentToNotification:(UILocalNotification *const)otherNotification
+{
+    NSDate *const fireDate = notification.fireDate;
+    NSDate *const otherFireDate = otherNotification.fireDate;
+    NSTimeZone *const timeZone = notification.timeZone;
+    NSTimeZone *const otherTimeZone = otherNotification.timeZone;
+    NSString *const alertBody = notification.alertBody;
+    NSString *const otherAlertBody = otherNotification.alertBody;
+    NSString *const soundName = notification.soundName;
+    NSString *const otherSoundName = otherNotification.soundName;
+    NSString *const category = notification.category;
+    NSString *const otherCategory = otherNotification.category;
+    return (notification.repeatInterval == otherNotification.repeatInterval &&
+            notification.applicationIconBadgeNumber == otherNotification.applicationIconBadgeNumber &&
+            (fireDate == otherFireDate || [fireDate isEqualToDate:otherFireDate]) &&
+            (timeZone == otherTimeZone || [timeZone isEqualToTimeZone:otherTimeZone]) &&
+            (alertBody == otherAlertBody || [alertBody isEqualToString:otherAlertBody]) &&
+            (soundName == otherSoundName || [soundName isEqualToString:otherSoundName]) &&
+            (category == otherCategory || [category isEqualToString:otherCategory]));
+}
+
+- (void)mr_updateActionRegistryWithEntry:(MRLocalNotificationActionHandlerEntry_ *const)entry
+                         removingEntries:(BOOL(^const)(MRLocalNotificationActionHandlerEntry_ *oldEntry))predicate
+{
+    @synchronized (self) {
+        NSArray *const oldEntries = self.actionRegistry.entries;
+        NSMutableArray *const entries = [NSMutableArray arrayWithCapacity:oldEntries.count + 1];
+        for (MRLocalNotificationActionHandlerEntry_ *const oldEntry in oldEntries) {
+            if (predicate == nil || !predicate(oldEntry)) {
+                [entries addObject:oldEntry];
+            }
+        }
+        if (entry) {
+            [entries addObject:entry];
+        }
+        self.actionRegistry = [[MRLocalNotificationActionRegistry_ alloc] initWithEntries:entries];
+    }
+}
+
+- (UILocalNotification *)mr_indexedNotificationForIdentifier:(NSString *const)identifier
+{
+    NSMutableDictionary *const index = self.scheduledNotificationsIndex;
+    UILocalNotification *const notification = index[identifier];
+    if (notification == nil) {
+        return nil;
+    }
+    BOOL const isFired = (notification.repeatInterval == 0 &&
+                          notification.region == nil &&
+                          notification.fireDate &&
+                          [self mr_timeIndexKeyForNotification:notification] < [self mr_now]);
+    if (isFired) {
+        [self mr_setIndexedNotification:nil forIdentifier:identifier];
+        return nil;
+    }
+    return notification;
+}
+
+- (NSTimeInterval)mr_overflowKeyForNotification:(UILocalNotification *const)notification
+{
+    NSDate *const fireDate = [self getGMTFireDateFromNotification:notification];
+    if (fireDate == nil) {
+        return -INFINITY;
+    }
+    return fireDate.timeIntervalSinceReferenceDate;
+}
+
+- (void)mr_scheduleNotificationWithOverflow:(UILocalNotification *const)notification
+{
+    UIApplication *const application = self.defaultApplication;
+    MRLocalNotificationHeap_ *const queue = self.overflowQueue;
+    MRLocalNotificationHeap_ *const pending = self.overflowPendingNotifications;
+    NSTimeInterval const key = [self mr_overflowKeyForNotification:notification];
+    [self mr_removeDeliveredOverflowNotifications];
+    if (pending.count < self.maximumScheduledNotifications) {
+        [self.metrics countApplicationCall:MRApplicationCallScheduleLocalNotification_];
+        [application scheduleLocalNotification:notification];
+        [self mr_addOverflowPendingNotification:notification];
+        return;
+    }
+    // Pending notifications are keyed by their negated fire time, so the first one fires last.
+    UILocalNotification *const latestNotification = pending.firstObject;
+    NSTimeInterval const latestKey = (latestNotification ? -pending.firstKey : -INFINITY);
+    if (latestNotification && key < latestKey) {
+        [self.metrics countApplicationCall:MRApplicationCallCancelLocalNotification_];
+        [application cancelLocalNotification:latestNotification];
+        [self mr_removeOverflowPendingNotification:latestNotification];
+        [queue addObject:latestNotification withKey:latestKey];
+        [self.metrics countApplicationCall:MRApplicationCallScheduleLocalNotification_];
+        [application scheduleLocalNotification:notification];
+        [self mr_addOverflowPendingNotification:notification];
+    } else {
+        [queue addObject:notification withKey:key];
+    }
+}
+
+- (void)mr_fillOverflowSlots
+{
+    UIApplication *const application = self.defaultApplication;
+    MRLocalNotificationHeap_ *const queue = self.overflowQueue;
+    MRLocalNotificationHeap_ *const pending = self.overflowPendingNotifications;
+    NSUInteger const limit = self.maximumScheduledNotifications;
+    [self mr_removeDeliveredOverflowNotifications];
+    while (pending.count < limit && queue.count > 0) {
+        UILocalNotification *const notification = queue.firstObject;
+        [queue removeFirstObject];
+        [self.metrics countApplicationCall:MRApplicationCallScheduleLocalNotification_];
+        [application scheduleLocalNotification:notification];
+        [self mr_addOverflowPendingNotification:notification];
+    }
+}
+
+- (void)mr_addOverflowPendingNotification:(UILocalNotification *const)notification
+{
+    NSTimeInterval const key = [self mr_overflowKeyForNotification:notification];
+    [self.overflowPendingNotifications addObject:notification withKey:-key];
+    if (notification.repeatInterval == 0 && notification.fireDate) {
+        [self.overflowFiringNotifications addObject:notification withKey:key];
+    }
+}
+
+- (void)mr_removeOverflowPendingNotification:(UILocalNotification *const)notification
+{
+    [_overflowPendingNotifications removeObject:notification];
+    [_overflowFiringNotifications removeObject:notification];
+}
+
+- (void)mr_removeDeliveredOverflowNotifications
+{
+    // The system drops the notifications that do not repeat once they are delivered.
+    MRLocalNotificationHeap_ *const pending = self.overflowPendingNotifications;
+    MRLocalNotificationHeap_ *const firing = self.overflowFiringNotifications;
+    NSTimeInterval const now = [self mr_now];
+    while (firing.count > 0 && firing.firstKey <= now) {
+        [pending removeObject:firing.firstObject];
+        [firing removeFirstObject];
+    }
+}
+
+- (MRTimeZoneTransitionTable_ *)mr_transitionTableForTimeZone:(NSTimeZone *const)timeZone
+{
+    MRTimeZoneTransitionTable_ *table = self.defaultTimeZoneTable;
+    if (table.timeZone == timeZone) {
+        return table;
+    }
+    NSCache *const tables = self.timeZoneTables;
+    table = [tables objectForKey:timeZone];
+    if (table == nil) {
+        table = [[MRTimeZoneTransitionTable_ alloc] initWithTimeZone:timeZone];
+        [tables setObject:table forKey:timeZone];
+    }
+    if (timeZone == self.defaultTimeZone) {
+        self.defaultTimeZoneTable = table;
+    }
+    return table;
+}
+
+#pragma mark NSNotification
+
+- (void)systemTimeZoneDidChange:(NSNotification *const)notification
+{
+    [NSTimeZone resetSystemTimeZone];
+    self.defaultTimeZoneTable = nil;
+    [self.timeZoneTables removeAllObjects];
+    MRLocalNotificationSkipList_ *const timeIndex = _timeIndex;
+    NSDictionary *const index = _scheduledNotificationsIndex;
+    for (NSString *const identifier in _floatingIdentifiers) {
+        UILocalNotification *const floatingNotification = index[identifier];
+        NSTimeInterval const key = (floatingNotification
+                                    ? [self mr_timeIndexKeyForNotification:floatingNotification]
+                                    : NAN);
+        if (isnan(key)) {
+            [timeIndex removeIdentifier:identifier];
+        } else {
+            [timeIndex setKey:key forIdentifier:identifier];
+        }
+    }
+}
+
+- (void)applicationWillEnterForeground:(NSNotification *const)notification
+{
+    self.settingsSnapshot = nil;
+    [self replenishScheduledNotifications];
+    [self reconcileScheduledNotifications];
+}
+
+#pragma mark Accessors
+
+- (UIApplication *)defaultApplication
+{
+    if (_defaultApplication == nil) {
+        @synchronized(self) {
+            if (_defaultApplication == nil) {
+                uint64_t const startTime = mach_absolute_time();
+                _defaultApplication = UIApplication.sharedApplication;
+                [self mr_recordStartupCost:@"defaultApplication" startTime:startTime];
+            }
+        }
+    }
+    return _defaultApplication;
+}
+
+- (NSTimeZone *)defaultTimeZone
+{
+    if (_defaultTimeZone == nil) {
+        @synchronized(self) {
+            if (_defaultTimeZone == nil) {
+                uint64_t const startTime = mach_absolute_time();
+                _defaultTimeZone = NSTimeZone.defaultTimeZone;
+                [self mr_recordStartupCost:@"defaultTimeZone" startTime:startTime];
+            }
+        }
+    }
+    return _defaultTimeZone;
+}
+
+- (NSCalendar *)defaultCalendar
+{
+    if (_defaultCalendar == nil) {
+        @synchronized(self) {
+            if (_defaultCalendar == nil) {
+                uint64_t const startTime = mach_absolute_time();
+                _defaultCalendar = NSCalendar.autoupdatingCurrentCalendar;
+                [self mr_recordStartupCost:@"defaultCalendar" startTime:startTime];
+            }
+        }
+    }
+    return _defaultCalendar;
+}
+
+- (BOOL)hasRegisteredNotifications
+{
+    if (!self.hasResolvedRegisteredNotifications) {
+        @synchronized(self) {
+            if (!self.hasResolvedRegisteredNotifications) {
+                uint64_t const startTime = mach_absolute_time();
+                NSUserDefaults *const userDefaults = NSUserDefaults.standardUserDefaults;
+                _hasRegisteredNotifications = (_hasRegisteredNotifications
+                                               || [userDefaults boolForKey:kMRUserNotificationsRegisteredKey]
+                                               || self.isRegisteredForNotifications);
+                self.hasResolvedRegisteredNotifications = YES;
+                [self mr_recordStartupCost:@"hasRegisteredNotifications" startTime:startTime];
+            }
+        }
+    }
+    return _hasRegisteredNotifications;
+}
+
+- (NSMutableDictionary *)regionPool
+{
+    if (_regionPool == nil) {
+        _regionPool = NSMutableDictionary.dictionary;
+    }
+    return _regionPool;
+}
+
+- (MRLocalNotificationRegionIndex_ *)regionIndex
+{
+    if (_regionIndex == nil) {
+        _regionIndex = [[MRLocalNotificationRegionIndex_ alloc] initWithCellDegrees:kMRRegionIndexCellDegrees];
+    }
+    return _regionIndex;
+}
+
+- (NSMutableSet *)regionPoolScheduledIdentifiers
+{
+    if (_regionPoolScheduledIdentifiers == nil) {
+        _regionPoolScheduledIdentifiers = NSMutableSet.set;
+    }
+    return _regionPoolScheduledIdentifiers;
+}
+
+- (MRLocalNotificationHeap_ *)overflowQueue
+{
+    if (_overflowQueue == nil) {
+        _overflowQueue = MRLocalNotificationHeap_.new;
+    }
+    return _overflowQueue;
+}
+
+- (MRLocalNotificationHeap_ *)overflowPendingNotifications
+{
+    // Fetched once; afterwards scheduling, cancellation and delivery keep it up to date.
+    if (_overflowPendingNotifications == nil) {
+        _overflowPendingNotifications = MRLocalNotificationHeap_.new;
+        _overflowFiringNotifications = MRLocalNotificationHeap_.new;
+        for (UILocalNotification *const notification in self.scheduledNotifications) {
+            if (![_overflowPendingNotifications containsObject:notification]) {
+                [self mr_addOverflowPendingNotification:notification];
+            }
+        }
+    }
+    return _overflowPendingNotifications;
+}
+
+- (MRLocalNotificationHeap_ *)overflowFiringNotifications
+{
+    if (_overflowFiringNotifications == nil) {
+        [self overflowPendingNotifications];
+    }
+    return _overflowFiringNotifications;
+}
+
+- (void)setSettingsSnapshot:(MRLocalNotificationSettingsSnapshot_ *const)settingsSnapshot
+{
+    _settingsSnapshot = settingsSnapshot;
+    self.pipelineSettingsSnapshot = settingsSnapshot;
+}
+
+- (MRLocalNotificationSettingsSnapshot_ *)settingsSnapshot
+{
+    if (_settingsSnapshot == nil) {
+        UIApplication *const application = self.defaultApplication;
+        @synchronized(self) {
+            if (_settingsSnapshot == nil) {
+                uint64_t const startTime = mach_absolute_time();
+                [self.metrics countApplicationCall:MRApplicationCallCurrentUserNotificationSettings_];
+                UIUserNotificationSettings *const settings = application.currentUserNotificationSettings;
+                _settingsSnapshot = [[MRLocalNotificationSettingsSnapshot_ alloc] initWithSettings:settings];
+                [self mr_recordStartupCost:@"settings" startTime:startTime];
+            }
+        }
+    }
+    return _settingsSnapshot;
+}
+
+- (NSMutableDictionary *)categoryIndex
+{
+    if (_categoryIndex == nil) {
+        NSMutableDictionary *const categoryIndex = NSMutableDictionary.dictionary;
+        [self.scheduledNotificationsIndex enumerateKeysAndObjectsUsingBlock:^(NSString *const identifier, UILocalNotification *const notification, BOOL *const stop) {
+            NSString *const category = notification.category;
+            if (category) {
+                [self mr_updateIndex:categoryIndex key:category identifier:identifier adding:YES];
+            }
+        }];
+        _categoryIndex = categoryIndex;
+    }
+    return _categoryIndex;
+}
+
+- (MRLocalNotificationSkipList_ *)timeIndex
+{
+    if (_timeIndex == nil) {
+        MRLocalNotificationSkipList_ *const timeIndex = MRLocalNotificationSkipList_.new;
+        NSMutableSet *const floatingIdentifiers = NSMutableSet.set;
+        [self.scheduledNotificationsIndex enumerateKeysAndObjectsUsingBlock:^(NSString *const identifier, UILocalNotification *const notification, BOOL *const stop) {
+            NSTimeInterval const key = [self mr_timeIndexKeyForNotification:notification];
+            if (!isnan(key)) {
+                [timeIndex setKey:key forIdentifier:identifier];
+            }
+            if (notification.timeZone) {
+                [floatingIdentifiers addObject:identifier];
+            }
+        }];
+        _timeIndex = timeIndex;
+        _floatingIdentifiers = floatingIdentifiers;
+    }
+    return _timeIndex;
+}
+
+- (NSCountedSet *)payloadReferences
+{
+    if (_payloadReferences == nil) {
+        NSCountedSet *const payloadReferences = NSCountedSet.set;
+        for (UILocalNotification *const notification in self.scheduledNotificationsIndex.objectEnumerator) {
+            NSString *const payloadKey = notification.userInfo[MRLocalNotificationPayloadKey];
+            if (payloadKey) {
+                [payloadReferences addObject:payloadKey];
+            }
+        }
+        _payloadReferences = payloadReferences;
+    }
+    return _payloadReferences;
+}
+
+- (NSMutableDictionary *)payloadsByKey
+{
+    if (_payloadsByKey == nil) {
+        _payloadsByKey = NSMutableDictionary.dictionary;
+    }
+    return _payloadsByKey;
+}
+
+- (NSMutableDictionary *)userInfoIndexes
+{
+    if (_userInfoIndexes == nil) {
+        _userInfoIndexes = NSMutableDictionary.dictionary;
+    }
+    return _userInfoIndexes;
+}
+
+- (NSMutableDictionary *)scheduledNotificationsIndex
+{
+    // The journal is used once replayed; waiting for it would block the first access.
+    if (_scheduledNotificationsIndex == nil && self.journal.replayed) {
+        NSArray *const notifications = [self.journal pendingNotificationsAtTime:[self mr_now]];
+        NSMutableDictionary *const index = [NSMutableDictionary dictionaryWithCapacity:notifications.count];
+        for (UILocalNotification *const notification in notifications) {
+            NSString *const identifier = [self getIdentifierFromNotification:notification];
+            if (identifier) {
+                index[identifier] = notification;
+            }
+        }
+        _scheduledNotificationsIndex = index;
+        [self mr_sweepPayloadStore];
+    }
+    if (_scheduledNotificationsIndex == nil) {
+        [self reconcileScheduledNotifications];
+        [self mr_sweepPayloadStore];
+    }
+    return _scheduledNotificationsIndex;
+}
+
+- (void)setJournalDirectoryURL:(NSURL *const)journalDirectoryURL
+{
+    [self willChangeValueForKey:@"journalDirectoryURL"];
+    _journalDirectoryURL = journalDirectoryURL;
+    _journal = (journalDirectoryURL
+                ? [[MRLocalNotificationJournal_ alloc] initWithDirectoryURL:journalDirectoryURL]
+                : nil);
+    [self didChangeValueForKey:@"journalDirectoryURL"];
+}
+
+- (void)setPayloadStoreDirectoryURL:(NSURL *const)payloadStoreDirectoryURL
+{
+    [self willChangeValueForKey:@"payloadStoreDirectoryURL"];
+    _payloadStoreDirectoryURL = payloadStoreDirectoryURL;
+    _payloadStore = (payloadStoreDirectoryURL
+                     ? [[MRLocalNotificationPayloadStore_ alloc] initWithDirectoryURL:payloadStoreDirectoryURL]
+                     : nil);
+    _needsPayloadSweep = (payloadStoreDirectoryURL != nil);
+    if (_scheduledNotificationsIndex) {
+        [self mr_sweepPayloadStore];
+    }
+    [self didChangeValueForKey:@"payloadStoreDirectoryURL"];
+}
+
+- (BOOL)instrumentationEnabled
+{
+    return (self.metrics != nil);
 }
 
-- (void)presentNotificationNow:(UILocalNotification *const)notification
+- (void)setInstrumentationEnabled:(BOOL const)instrumentationEnabled
 {
-    NSParameterAssert(notification);
-    if (!NSThread.isMainThread) {
-        NSLog(@"presenting notification from a thread other than the main thread");
+    if (instrumentationEnabled == self.instrumentationEnabled) {
+        return;
     }
-    UIApplication *const application = self.defaultApplication;
-    [application presentLocalNotificationNow:notification];
+    [self willChangeValueForKey:@"instrumentationEnabled"];
+    self.metrics = (instrumentationEnabled ? MRLocalNotificationMetrics_.new : nil);
+    [self didChangeValueForKey:@"instrumentationEnabled"];
 }
 
-- (void)scheduleNotification:(UILocalNotification *const)notification
+- (void)setAutomaticBadges:(BOOL const)automaticBadges
 {
-    NSParameterAssert(notification);
-    UIApplication *const application = self.defaultApplication;
-    [application scheduleLocalNotification:notification];
+    [self willChangeValueForKey:@"automaticBadges"];
+    _automaticBadges = automaticBadges;
+    if (automaticBadges) {
+        [self mr_pruneTimeIndex];
+        [self mr_sequenceBadgesFromRank:0];
+    }
+    [self didChangeValueForKey:@"automaticBadges"];
 }
 
-- (NSArray *)scheduledNotifications
+- (void)setAutomaticBadgeBase:(NSInteger const)automaticBadgeBase
 {
-    UIApplication *const application = self.defaultApplication;
-    NSArray *const localNotifications = application.scheduledLocalNotifications;
-    return (localNotifications ?: @[]);
+    [self willChangeValueForKey:@"automaticBadgeBase"];
+    _automaticBadgeBase = automaticBadgeBase;
+    if (self.automaticBadges) {
+        [self mr_pruneTimeIndex];
+        [self mr_sequenceBadgesFromRank:0];
+    }
+    [self didChangeValueForKey:@"automaticBadgeBase"];
 }
 
-- (void)cancelNotification:(UILocalNotification *const)notification
+- (MRLocalNotificationCoalescer *)notificationCoalescer
 {
-    UIApplication *const application = self.defaultApplication;
-    if (notification) {
-        [application cancelLocalNotification:notification];
+    if (_notificationCoalescer == nil) {
+        __weak typeof(self) welf = self;
+        _notificationCoalescer =
+        [[MRLocalNotificationCoalescer alloc] initWithWindow:self.notificationCoalescingWindow
+                                                batchHandler:^(NSArray *const batches) {
+                                                    [welf mr_handleCoalescedNotifications:batches];
+                                                }];
     }
+    return _notificationCoalescer;
 }
 
-- (void)cancelAllNotifications
+- (void)setNotificationCoalescingWindow:(NSTimeInterval const)notificationCoalescingWindow
 {
-    UIApplication *const application = self.defaultApplication;
-    [application cancelAllLocalNotifications];
+    NSParameterAssert(notificationCoalescingWindow >= 0);
+    [self willChangeValueForKey:@"notificationCoalescingWindow"];
+    _notificationCoalescingWindow = notificationCoalescingWindow;
+    [_notificationCoalescer flush];
+    _notificationCoalescer = nil;
+    [self didChangeValueForKey:@"notificationCoalescingWindow"];
 }
 
-#pragma mark Accessors
+- (void)setDefaultTimeZone:(NSTimeZone *const)defaultTimeZone
+{
+    [self willChangeValueForKey:@"defaultTimeZone"];
+    _defaultTimeZone = defaultTimeZone;
+    self.defaultTimeZoneTable = nil;
+    [self didChangeValueForKey:@"defaultTimeZone"];
+}
 
 - (void)setDefaultApplication:(UIApplication *const)defaultApplication
 {
     [self willChangeValueForKey:@"defaultApplication"];
     _defaultApplication = defaultApplication;
+    [self mr_resetScheduledNotificationsIndex:nil];
+    self.settingsSnapshot = nil;
+    _overflowPendingNotifications = nil;
+    _overflowFiringNotifications = nil;
     if (![defaultApplication isEqual:UIApplication.sharedApplication]) {
         NSLog(@"using %p instead of UIApplication.sharedApplication", defaultApplication);
     }
@@ -373,20 +4134,37 @@ static NSString *const kMRUserNotificationsRegisteredKey = @"kMRUserNotification
 
 - (instancetype)init
 {
+    uint64_t const startTime = mach_absolute_time();
     self = [super init];
     if (self) {
-        _defaultApplication = UIApplication.sharedApplication;
-        _defaultTimeZone = NSTimeZone.defaultTimeZone;
-        _defaultCalendar = NSCalendar.autoupdatingCurrentCalendar;
+        _startupCosts = NSMutableDictionary.dictionary;
         _defaultSoundName = UILocalNotificationDefaultSoundName;
-        _actionHandlers = NSMutableDictionary.dictionary;
-        NSUserDefaults *const userDefaults = NSUserDefaults.standardUserDefaults;
-        _hasRegisteredNotifications = ([userDefaults boolForKey:kMRUserNotificationsRegisteredKey]
-                                       || self.isRegisteredForNotifications);
+        _actionRegistry = [[MRLocalNotificationActionRegistry_ alloc] initWithEntries:@[]];
+        _timeZoneTables = NSCache.new;
+        _pipelineQueue = dispatch_queue_create("MRLocalNotificationFacade.pipeline", DISPATCH_QUEUE_SERIAL);
+        _pipelineOperations = NSMutableArray.array;
+        _pipelineOperationsByKey = NSMutableDictionary.dictionary;
+        _maximumRegionNotifications = 20;
+        NSNotificationCenter *const defaultCenter = NSNotificationCenter.defaultCenter;
+        [defaultCenter addObserver:self
+                          selector:@selector(applicationWillEnterForeground:)
+                              name:UIApplicationWillEnterForegroundNotification
+                            object:nil];
+        [defaultCenter addObserver:self
+                          selector:@selector(systemTimeZoneDidChange:)
+                              name:NSSystemTimeZoneDidChangeNotification
+                            object:nil];
+        [self mr_recordStartupCost:@"init" startTime:startTime];
     }
     return self;
 }
 
+- (void)dealloc
+{
+    NSNotificationCenter *const defaultCenter = NSNotificationCenter.defaultCenter;
+    [defaultCenter removeObserver:self];
+}
+
 @end
 
 
@@ -414,19 +4192,26 @@ static NSString *const kMRUserNotificationsRegisteredKey = @"kMRUserNotification
     [UIUserNotificationSettings settingsForTypes:types
                                       categories:categories];
     UIApplication *const application = self.defaultApplication;
+    [self.metrics countApplicationCall:MRApplicationCallRegisterUserNotificationSettings_];
     [application registerUserNotificationSettings:settings];
 }
 
 - (UIUserNotificationSettings *)currentUserNotificationSettings
 {
-    UIApplication *const application = self.defaultApplication;
-    UIUserNotificationSettings *const settings = application.currentUserNotificationSettings;
-    return settings;
+    MRLocalNotificationSettingsSnapshot_ *const snapshot = self.settingsSnapshot;
+    return snapshot.settings;
 }
 
 - (UIUserNotificationCategory *)getCategoryForIdentifier:(NSString *const)categoryIdentifier
                             fromUserNotificationSettings:(UIUserNotificationSettings *const)notificationSettings;
 {
+    if (categoryIdentifier == nil) {
+        return nil;
+    }
+    MRLocalNotificationSettingsSnapshot_ *const snapshot = self.settingsSnapshot;
+    if (notificationSettings && notificationSettings == snapshot.settings) {
+        return snapshot.categories[categoryIdentifier];
+    }
     NSSet *const categories = notificationSettings.categories;
     for (UIUserNotificationCategory *const category in categories) {
         if ([category.identifier isEqual:categoryIdentifier]) {
@@ -438,27 +4223,26 @@ static NSString *const kMRUserNotificationsRegisteredKey = @"kMRUserNotification
 
 - (BOOL)isRegisteredForNotifications
 {
-    UIUserNotificationSettings *const settings = self.currentUserNotificationSettings;
-    UIUserNotificationType const types = settings.types;
-    return (types != UIUserNotificationTypeNone);
+    MRLocalNotificationSettingsSnapshot_ *const snapshot = self.settingsSnapshot;
+    return (snapshot.types != UIUserNotificationTypeNone);
 }
 
 - (BOOL)isBadgeTypeAllowed
 {
-    UIUserNotificationSettings *const settings = self.currentUserNotificationSettings;
-    return (settings.types & UIUserNotificationTypeBadge) == UIUserNotificationTypeBadge;
+    MRLocalNotificationSettingsSnapshot_ *const snapshot = self.settingsSnapshot;
+    return [snapshot allowsTypes:UIUserNotificationTypeBadge];
 }
 
 - (BOOL)isSoundTypeAllowed
 {
-    UIUserNotificationSettings *const settings = self.currentUserNotificationSettings;
-    return (settings.types & UIUserNotificationTypeSound) == UIUserNotificationTypeSound;
+    MRLocalNotificationSettingsSnapshot_ *const snapshot = self.settingsSnapshot;
+    return [snapshot allowsTypes:UIUserNotificationTypeSound];
 }
 
 - (BOOL)isAlertTypeAllowed
 {
-    UIUserNotificationSettings *const settings = self.currentUserNotificationSettings;
-    return (settings.types & UIUserNotificationTypeAlert) == UIUserNotificationTypeAlert;
+    MRLocalNotificationSettingsSnapshot_ *const snapshot = self.settingsSnapshot;
+    return [snapshot allowsTypes:UIUserNotificationTypeAlert];
 }
 
 @end
@@ -517,16 +4301,59 @@ static NSString *const kMRUserNotificationsRegisteredKey = @"kMRUserNotification
 - (void)showAlertController:(UIAlertController *const)alert
 {
     NSParameterAssert(alert);
-    UIViewController *presentingViewController = self.defaultAlertPresenter;
-    if (presentingViewController == nil) {
+    UIViewController *const defaultAlertPresenter = self.defaultAlertPresenter;
+    if (defaultAlertPresenter) {
+        [defaultAlertPresenter presentViewController:alert animated:YES completion:nil];
+        return;
+    }
+    UIWindow *window = self.alertWindow;
+    if (window == nil) {
         UIApplication *const application = self.defaultApplication;
-        UIWindow *const window = [[UIWindow alloc] initWithFrame:application.keyWindow.frame];
+        window = [[UIWindow alloc] initWithFrame:application.keyWindow.frame];
         window.windowLevel = UIWindowLevelAlert;
-        presentingViewController = MRLocalNotificationFacadeAlertViewController_.new;
-        window.rootViewController = presentingViewController;
-        window.hidden = NO;
+        window.rootViewController = MRLocalNotificationFacadeAlertViewController_.new;
+        self.alertWindow = window;
     }
-    [presentingViewController presentViewController:alert animated:YES completion:nil];
+    window.hidden = NO;
+    MRLocalNotificationFacadeAlertViewController_ *const presentingViewController =
+    (MRLocalNotificationFacadeAlertViewController_ *)window.rootViewController;
+    [presentingViewController presentAlert:alert];
+}
+
+#pragma mark Private
+
+- (UIAlertController *)mr_buildAlertControlForNotifications:(NSArray *const)notifications
+{
+    if (notifications.count <= 1) {
+        UILocalNotification *const notification = notifications.firstObject;
+        return (notification ? [self buildAlertControlForNotification:notification] : nil);
+    }
+    NSBundle *const mainBundle = NSBundle.mainBundle;
+    NSDictionary *const localizedInfoDictionary = mainBundle.localizedInfoDictionary ?: mainBundle.infoDictionary;
+    NSString *const bundleName = localizedInfoDictionary[(NSString *)kCFBundleNameKey];
+    NSString *const format = NSLocalizedString(@"%lu notifications", nil);
+    NSMutableArray *const lines = [NSMutableArray arrayWithObject:[NSString stringWithFormat:format, (unsigned long)notifications.count]];
+    for (UILocalNotification *const notification in notifications) {
+        if (notification.alertBody.length > 0) {
+            [lines addObject:notification.alertBody];
+        }
+    }
+    UIAlertController *const alert = [UIAlertController alertControllerWithTitle:bundleName
+                                                                         message:[lines componentsJoinedByString:@"\n"]
+                                                                  preferredStyle:UIAlertControllerStyleAlert];
+    __weak typeof(self) welf = self;
+    UIAlertAction *const cancelAction =
+    [UIAlertAction actionWithTitle:NSLocalizedString(@"Cancel", nil)
+                             style:UIAlertActionStyleCancel
+                           handler:
+     ^(UIAlertAction *const action) {
+         void(^const onCancel)(UILocalNotification *) = welf.onDidCancelNotificationAlert;
+         for (UILocalNotification *const notification in (onCancel ? notifications : nil)) {
+             onCancel(notification);
+         }
+     }];
+    [alert addAction:cancelAction];
+    return alert;
 }
 
 @end
@@ -537,6 +4364,19 @@ static NSString *const kMRUserNotificationsRegisteredKey = @"kMRUserNotification
 
 @implementation MRLocalNotificationFacade (UIApplication)
 
++ (UILocalNotification *)deferHandlingOfNotificationFromLaunchOptions:(NSDictionary *const)launchOptions
+{
+    UILocalNotification *notification;
+    id const candidate = launchOptions[UIApplicationLaunchOptionsLocalNotificationKey];
+    if ([candidate isKindOfClass:UILocalNotification.class]) {
+        notification = candidate;
+        dispatch_async(dispatch_get_main_queue(), ^{
+            [self.defaultInstance mr_handleReceivedNotification:notification launching:YES];
+        });
+    }
+    return notification;
+}
+
 - (UILocalNotification *)getNotificationFromLaunchOptions:(NSDictionary *const)launchOptions
 {
     UILocalNotification *notification;
@@ -550,12 +4390,14 @@ static NSString *const kMRUserNotificationsRegisteredKey = @"kMRUserNotification
 - (NSInteger)applicationIconBadgeNumber
 {
     UIApplication *const application = self.defaultApplication;
+    [self.metrics countApplicationCall:MRApplicationCallApplicationIconBadgeNumber_];
     return application.applicationIconBadgeNumber;
 }
 
 - (void)setApplicationIconBadgeNumber:(NSInteger const)applicationIconBadgeNumber
 {
     UIApplication *const application = self.defaultApplication;
+    [self.metrics countApplicationCall:MRApplicationCallSetApplicationIconBadgeNumber_];
     application.applicationIconBadgeNumber = applicationIconBadgeNumber;
 }
 
@@ -569,24 +4411,42 @@ static NSString *const kMRUserNotificationsRegisteredKey = @"kMRUserNotification
     self.hasRegisteredNotifications = YES;
 }
 
-#pragma mark - UIApplicationDelegate
-
-- (void)handleDidRegisterUserNotificationSettings:(UIUserNotificationSettings *const)settings
+- (void)mr_handleReceivedNotification:(UILocalNotification *const)receivedNotification
+                            launching:(BOOL const)launching
 {
-    if (settings == nil) {
+    if (receivedNotification == nil) {
         return;
     }
-    [self mr_setHasRegisteredLocalNotifications];
-}
-
-- (void)handleDidReceiveLocalNotification:(UILocalNotification *const)notification
-{
-    if (notification == nil) {
+    MRLocalNotificationMetrics_ *const metrics = self.metrics;
+    uint64_t const startTime = (metrics ? mach_absolute_time() : 0);
+    UILocalNotification *const notification = [self mr_notificationWithPayload:receivedNotification];
+    NSString *const identifier = [self getIdentifierFromNotification:notification];
+    if (identifier && notification.repeatInterval == 0 &&
+        (notification.region == nil || notification.regionTriggersOnce)) {
+        if (self.automaticBadges && self.scheduledNotificationsIndex[identifier]) {
+            [self mr_incrementAutomaticBadgeBase];
+        }
+        if (notification.region) {
+            [self mr_removeIdentifierFromRegionPool:identifier];
+        }
+        [self mr_setIndexedNotification:nil forIdentifier:identifier];
+        [self.journal appendCancellationWithIdentifier:identifier];
+        // The handlers get `notification`, which already carries the full user info.
+        [self mr_removePayloadOfNotification:receivedNotification];
+    }
+    [self replenishScheduledNotifications];
+    if (!launching && self.notificationCoalescingWindow > 0) {
+        [self.notificationCoalescer addItem:notification category:notification.category];
+        [metrics recordOperation:MRMetricsOperationHandleDidReceive_ startTime:startTime];
         return;
     }
     void(^const handler)(UILocalNotification *, BOOL *) = self.onDidReceiveNotification;
-    UIApplication *const application = self.defaultApplication;
-    BOOL shouldShowAlert = application.applicationState == UIApplicationStateActive;
+    BOOL shouldShowAlert = NO;
+    if (!launching) {
+        UIApplication *const application = self.defaultApplication;
+        [metrics countApplicationCall:MRApplicationCallApplicationState_];
+        shouldShowAlert = application.applicationState == UIApplicationStateActive;
+    }
     if (handler) {
         handler(notification, &shouldShowAlert);
     }
@@ -596,18 +4456,99 @@ static NSString *const kMRUserNotificationsRegisteredKey = @"kMRUserNotification
             [self showAlertController:alert];
         }
     }
+    [metrics recordOperation:MRMetricsOperationHandleDidReceive_ startTime:startTime];
+}
+
+- (void)mr_handleCoalescedNotifications:(NSArray *const)batches
+{
+    NSMutableArray *const notifications = NSMutableArray.array;
+    for (NSArray *const batch in batches) {
+        [notifications addObjectsFromArray:batch];
+    }
+    UIApplication *const application = self.defaultApplication;
+    [self.metrics countApplicationCall:MRApplicationCallApplicationState_];
+    BOOL const isActive = application.applicationState == UIApplicationStateActive;
+    NSMutableArray *const alertNotifications = NSMutableArray.array;
+    void(^const batchHandler)(NSArray *, BOOL *) = self.onDidReceiveNotifications;
+    if (batchHandler) {
+        BOOL shouldShowAlert = isActive;
+        batchHandler(batches, &shouldShowAlert);
+        if (shouldShowAlert) {
+            [alertNotifications addObjectsFromArray:notifications];
+        }
+    } else {
+        void(^const handler)(UILocalNotification *, BOOL *) = self.onDidReceiveNotification;
+        for (UILocalNotification *const notification in notifications) {
+            BOOL shouldShowAlert = isActive;
+            if (handler) {
+                handler(notification, &shouldShowAlert);
+            }
+            if (shouldShowAlert) {
+                [alertNotifications addObject:notification];
+            }
+        }
+    }
+    UIAlertController *const alert = [self mr_buildAlertControlForNotifications:alertNotifications];
+    if (alert) {
+        [self showAlertController:alert];
+    }
+}
+
+#pragma mark - UIApplicationDelegate
+
+- (void)handleDidRegisterUserNotificationSettings:(UIUserNotificationSettings *const)settings
+{
+    if (settings == nil) {
+        return;
+    }
+    MRLocalNotificationMetrics_ *const metrics = self.metrics;
+    uint64_t const startTime = (metrics ? mach_absolute_time() : 0);
+    self.settingsSnapshot = nil;
+    [self mr_setHasRegisteredLocalNotifications];
+    [metrics recordOperation:MRMetricsOperationHandleDidRegister_ startTime:startTime];
+}
+
+- (void)handleDidReceiveLocalNotification:(UILocalNotification *const)receivedNotification
+{
+    [self mr_handleReceivedNotification:receivedNotification launching:NO];
 }
 
 - (void)handleActionWithIdentifier:(NSString *const)identifier
-              forLocalNotification:(UILocalNotification *const)notification
+              forLocalNotification:(UILocalNotification *const)receivedNotification
                  completionHandler:(void (^const)())completionHandler
 {
-    if (identifier && notification) {
-        void(^const handler)(NSString *, UILocalNotification *) = self.actionHandlers[identifier];
-        if (handler) {
-            handler(identifier, notification);
+    MRLocalNotificationMetrics_ *const metrics = self.metrics;
+    uint64_t const startTime = (metrics ? mach_absolute_time() : 0);
+    UILocalNotification *const notification = (receivedNotification
+                                               ? [self mr_notificationWithPayload:receivedNotification]
+                                               : nil);
+    NSArray *const handlers = (identifier && notification
+                               ? [self.actionRegistry handlersForActionWithIdentifier:identifier
+                                                                             category:notification.category]
+                               : nil);
+    if (self.concurrentActionHandlers && handlers.count > 1) {
+        dispatch_group_t const group = dispatch_group_create();
+        dispatch_queue_t const queue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
+        for (void(^const handler)(NSString *, UILocalNotification *) in handlers) {
+            dispatch_group_async(group, queue, ^{
+                handler(identifier, notification);
+            });
         }
+        dispatch_group_notify(group, dispatch_get_main_queue(), ^{
+            [self mr_removePayloadOfNotification:receivedNotification];
+            [metrics recordOperation:MRMetricsOperationHandleAction_ startTime:startTime];
+            if (completionHandler) {
+                completionHandler();
+            }
+        });
+        return;
     }
+    for (void(^const handler)(NSString *, UILocalNotification *) in handlers) {
+        handler(identifier, notification);
+    }
+    // Notifications delivered while the application was not active are only seen here.
+    [self mr_removePayloadOfNotification:receivedNotification];
+    [metrics recordOperation:MRMetricsOperationHandleAction_ startTime:startTime];
     if (completionHandler) {
         completionHandler();
     }
@@ -628,17 +4569,51 @@ static NSString *const kMRUserNotificationsRegisteredKey = @"kMRUserNotification
                       minute:(NSInteger const)minute
                       second:(NSInteger const)second
 {
+    MRLocalNotificationDateComponents const components = { year, month, day, hour, minute, second };
+    NSTimeInterval timeInterval;
+    [self buildTimeIntervals:&timeInterval
+              fromComponents:&components
+                       count:1];
+    return [NSDate dateWithTimeIntervalSinceReferenceDate:timeInterval];
+}
+
+- (void)buildTimeIntervals:(NSTimeInterval *const)timeIntervals
+            fromComponents:(MRLocalNotificationDateComponents const *const)components
+                     count:(NSUInteger const)count
+{
+    NSParameterAssert((timeIntervals && components) || count == 0);
     NSCalendar *const calendar = self.defaultCalendar;
-    calendar.timeZone = self.defaultTimeZone;
-    NSDateComponents *const dateComponents = [[NSDateComponents alloc] init];
-    dateComponents.day = day;
-    dateComponents.month = month;
-    dateComponents.year = year;
-    dateComponents.hour = hour;
-    dateComponents.minute = minute;
-    dateComponents.second = second;
-    NSDate *const date = [calendar dateFromComponents:dateComponents];
-    return date;
+    NSTimeZone *const timeZone = self.defaultTimeZone;
+    if (![calendar.calendarIdentifier isEqualToString:NSCalendarIdentifierGregorian]) {
+        NSCalendar *const threadCalendar = [self mr_threadCalendarWithTimeZone:timeZone];
+        NSDateComponents *const dateComponents = [[NSDateComponents alloc] init];
+        for (NSUInteger index = 0; index < count; index++) {
+            MRLocalNotificationDateComponents const component = components[index];
+            dateComponents.day = component.day;
+            dateComponents.month = component.month;
+            dateComponents.year = component.year;
+            dateComponents.hour = component.hour;
+            dateComponents.minute = component.minute;
+            dateComponents.second = component.second;
+            NSDate *const date = [threadCalendar dateFromComponents:dateComponents];
+            timeIntervals[index] = (date ? date.timeIntervalSinceReferenceDate : NAN);
+        }
+        return;
+    }
+    MRTimeZoneTransitionTable_ *const table = [self mr_transitionTableForTimeZone:timeZone];
+    for (NSUInteger index = 0; index < count; index++) {
+        MRLocalNotificationDateComponents const component = components[index];
+        int64_t const months = (int64_t)component.month - 1;
+        int64_t const year = component.year + MRFloorDivide_(months, 12);
+        int64_t const month = months - MRFloorDivide_(months, 12)*12 + 1;
+        int64_t const days = MRDaysFromCivil_(year, month, 1) + component.day - 1;
+        NSTimeInterval const localTime = (days*86400.0 +
+                                          component.hour*3600.0 +
+                                          component.minute*60.0 +
+                                          component.second -
+                                          NSTimeIntervalSince1970);
+        timeIntervals[index] = [table timeIntervalFromLocalTimeInterval:localTime];
+    }
 }
 
 - (NSDate *)convertDateToDefaultTimeZone:(NSDate *const)gmtDate
@@ -670,15 +4645,11 @@ static NSString *const kMRUserNotificationsRegisteredKey = @"kMRUserNotification
       second:(NSInteger *const)second
 {
     NSParameterAssert(date);
-    NSCalendar *const calendar = self.defaultCalendar;
-    NSCalendarUnit const mask = (NSCalendarUnitSecond |
-                                 NSCalendarUnitMinute |
-                                 NSCalendarUnitHour   |
-                                 NSCalendarUnitDay    |
-                                 NSCalendarUnitMonth  |
-                                 NSCalendarUnitYear);
-    NSDateComponents *const components = [calendar components:mask
-                                                     fromDate:date];
+    NSTimeInterval const timeInterval = date.timeIntervalSinceReferenceDate;
+    MRLocalNotificationDateComponents components;
+    [self getComponents:&components
+      fromTimeIntervals:&timeInterval
+                  count:1];
     if (second) {
         *second = components.second;
     }
@@ -699,13 +4670,87 @@ static NSString *const kMRUserNotificationsRegisteredKey = @"kMRUserNotification
     }
 }
 
+- (void)getComponents:(MRLocalNotificationDateComponents *const)components
+    fromTimeIntervals:(NSTimeInterval const *const)timeIntervals
+                count:(NSUInteger const)count
+{
+    NSParameterAssert((timeIntervals && components) || count == 0);
+    NSCalendar *const calendar = self.defaultCalendar;
+    NSTimeZone *const timeZone = self.defaultTimeZone;
+    if (![calendar.calendarIdentifier isEqualToString:NSCalendarIdentifierGregorian]) {
+        NSCalendar *const threadCalendar = [self mr_threadCalendarWithTimeZone:timeZone];
+        NSCalendarUnit const mask = (NSCalendarUnitSecond |
+                                     NSCalendarUnitMinute |
+                                     NSCalendarUnitHour   |
+                                     NSCalendarUnitDay    |
+                                     NSCalendarUnitMonth  |
+                                     NSCalendarUnitYear);
+        for (NSUInteger index = 0; index < count; index++) {
+            NSDate *const date = [NSDate dateWithTimeIntervalSinceReferenceDate:timeIntervals[index]];
+            NSDateComponents *const dateComponents = [threadCalendar components:mask
+                                                                       fromDate:date];
+            components[index].year = dateComponents.year;
+            components[index].month = dateComponents.month;
+            components[index].day = dateComponents.day;
+            components[index].hour = dateComponents.hour;
+            components[index].minute = dateComponents.minute;
+            components[index].second = dateComponents.second;
+        }
+        return;
+    }
+    MRTimeZoneTransitionTable_ *const table = [self mr_transitionTableForTimeZone:timeZone];
+    for (NSUInteger index = 0; index < count; index++) {
+        NSTimeInterval const timeInterval = timeIntervals[index];
+        NSTimeInterval const localTime = (timeInterval +
+                                          [table secondsFromGMTForTimeInterval:timeInterval] +
+                                          NSTimeIntervalSince1970);
+        int64_t const days = (int64_t)floor(localTime/86400);
+        int64_t const secondOfDay = (int64_t)floor(localTime - days*86400.0);
+        int64_t year;
+        int64_t month;
+        int64_t day;
+        MRCivilFromDays_(days, &year, &month, &day);
+        components[index].year = (NSInteger)year;
+        components[index].month = (NSInteger)month;
+        components[index].day = (NSInteger)day;
+        components[index].hour = (NSInteger)(secondOfDay/3600);
+        components[index].minute = (NSInteger)(secondOfDay/60 % 60);
+        components[index].second = (NSInteger)(secondOfDay % 60);
+    }
+}
+
+- (void)convertTimeIntervalsToDefaultTimeZone:(NSTimeInterval *const)timeIntervals
+                                        count:(NSUInteger const)count
+{
+    NSTimeZone *const timeZone = self.defaultTimeZone;
+    [self mr_convertTimeIntervals:timeIntervals
+                            count:count
+                       toTimeZone:timeZone
+                          reverse:NO];
+}
+
+- (void)convertTimeIntervalsToGMT:(NSTimeInterval *const)timeIntervals
+                            count:(NSUInteger const)count
+{
+    NSTimeZone *const timeZone = self.defaultTimeZone;
+    [self mr_convertTimeIntervals:timeIntervals
+                            count:count
+                       toTimeZone:timeZone
+                          reverse:YES];
+}
+
 - (NSDate *)getGMTFireDateFromNotification:(UILocalNotification *const)notification
 {
     NSParameterAssert(notification);
+    return [self mr_GMTFireDateFromNotification:notification timeZone:notification.timeZone];
+}
+
+- (NSDate *)mr_GMTFireDateFromNotification:(UILocalNotification *const)notification
+                                  timeZone:(NSTimeZone *const)timeZone
+{
     NSDate *gmtDate;
-    NSTimeZone *const timeZone = notification.timeZone;
     NSDate *const fireDate = notification.fireDate;
-    if (timeZone) {
+    if (timeZone && fireDate) {
         gmtDate = [self mr_convertDate:fireDate
                             toTimeZone:timeZone
                                reverse:YES];
@@ -715,21 +4760,154 @@ static NSString *const kMRUserNotificationsRegisteredKey = @"kMRUserNotification
     return gmtDate;
 }
 
+- (MRLocalNotificationRecurrenceRule *)getRecurrenceRuleFromNotification:(UILocalNotification *const)notification
+{
+    NSParameterAssert(notification);
+    NSCalendarUnit const repeatInterval = notification.repeatInterval;
+    if (repeatInterval == 0) {
+        return nil;
+    }
+    MRLocalNotificationRecurrenceRule *const rule = MRLocalNotificationRecurrenceRule.new;
+    rule.frequency = repeatInterval;
+    return rule;
+}
+
+- (NSEnumerator *)enumeratorOfFireDatesFromNotification:(UILocalNotification *const)notification
+                                                   rule:(MRLocalNotificationRecurrenceRule *const)rule
+{
+    NSParameterAssert(notification);
+    return [self mr_recurrenceEnumeratorForNotification:notification rule:rule];
+}
+
+- (NSArray *)getFireDatesFromNotification:(UILocalNotification *const)notification
+                                     rule:(MRLocalNotificationRecurrenceRule *const)rule
+                                    after:(NSDate *const)startDate
+                                   before:(NSDate *const)endDate
+                                    limit:(NSUInteger const)limit
+{
+    NSParameterAssert(notification);
+    NSParameterAssert(startDate);
+    NSParameterAssert(endDate);
+    MRLocalNotificationRecurrenceEnumerator_ *const enumerator =
+    [self mr_recurrenceEnumeratorForNotification:notification rule:rule];
+    if (enumerator == nil) {
+        return @[];
+    }
+    [enumerator skipToDate:startDate];
+    NSTimeInterval const startTime = startDate.timeIntervalSince1970;
+    NSTimeInterval const endTime = endDate.timeIntervalSince1970;
+    NSMutableArray *const fireDates = NSMutableArray.array;
+    NSTimeInterval time;
+    while ((limit == 0 || fireDates.count < limit) && [enumerator getNextTimeInterval:&time]) {
+        if (time >= endTime) {
+            break;
+        }
+        if (time >= startTime) {
+            [fireDates addObject:[NSDate dateWithTimeIntervalSince1970:time]];
+        }
+    }
+    return fireDates;
+}
+
+- (NSArray *)getFireDatesFromNotifications:(NSArray *const)notifications
+                                     after:(NSDate *const)startDate
+                                    before:(NSDate *const)endDate
+                                     limit:(NSUInteger const)limit
+{
+    NSParameterAssert(notifications);
+    NSMutableArray *const fireDates = [NSMutableArray arrayWithCapacity:notifications.count];
+    for (UILocalNotification *const notification in notifications) {
+        [fireDates addObject:[self getFireDatesFromNotification:notification
+                                                           rule:nil
+                                                          after:startDate
+                                                         before:endDate
+                                                          limit:limit]];
+    }
+    return fireDates;
+}
+
 #pragma mark Private
 
+- (NSCalendar *)mr_threadCalendarWithTimeZone:(NSTimeZone *const)timeZone
+{
+    NSCalendar *const sourceCalendar = self.defaultCalendar;
+    NSMutableDictionary *const threadDictionary = NSThread.currentThread.threadDictionary;
+    NSArray *const cachedCalendars = threadDictionary[kMRThreadCalendarKey];
+    NSCalendar *calendar;
+    if (cachedCalendars.firstObject == sourceCalendar) {
+        calendar = cachedCalendars.lastObject;
+    } else {
+        calendar = sourceCalendar.copy;
+        threadDictionary[kMRThreadCalendarKey] = @[ sourceCalendar, calendar ];
+    }
+    if (timeZone && ![calendar.timeZone isEqual:timeZone]) {
+        calendar.timeZone = timeZone;
+    }
+    return calendar;
+}
+
+- (MRLocalNotificationRecurrenceEnumerator_ *)mr_recurrenceEnumeratorForNotification:(UILocalNotification *const)notification
+                                                                                rule:(MRLocalNotificationRecurrenceRule *const)rule
+{
+    return [self mr_recurrenceEnumeratorForNotification:notification rule:rule timeZone:notification.timeZone];
+}
+
+- (MRLocalNotificationRecurrenceEnumerator_ *)mr_recurrenceEnumeratorForNotification:(UILocalNotification *const)notification
+                                                                                rule:(MRLocalNotificationRecurrenceRule *const)rule
+                                                                            timeZone:(NSTimeZone *const)notificationTimeZone
+{
+    NSDate *const fireDate = [self mr_GMTFireDateFromNotification:notification timeZone:notificationTimeZone];
+    if (fireDate == nil) {
+        return nil;
+    }
+    MRLocalNotificationRecurrenceRule *recurrenceRule = rule;
+    if (recurrenceRule == nil) {
+        recurrenceRule = [self getRecurrenceRuleFromNotification:notification];
+    }
+    if (recurrenceRule == nil) {
+        recurrenceRule = MRLocalNotificationRecurrenceRule.new;
+        recurrenceRule.frequency = 0;
+    }
+    NSCalendar *const calendar = (notification.repeatCalendar ?:
+                                  self.defaultCalendar ?:
+                                  NSCalendar.autoupdatingCurrentCalendar);
+    NSTimeZone *const timeZone = (notificationTimeZone ?: calendar.timeZone ?: NSTimeZone.defaultTimeZone);
+    MRTimeZoneTransitionTable_ *const timeZoneTable = [self mr_transitionTableForTimeZone:timeZone];
+    return [[MRLocalNotificationRecurrenceEnumerator_ alloc] initWithRule:recurrenceRule
+                                                                startDate:fireDate
+                                                                 calendar:calendar
+                                                            timeZoneTable:timeZoneTable];
+}
+
 - (NSDate *)mr_convertDate:(NSDate *const)date
                 toTimeZone:(NSTimeZone *const)timeZone
                    reverse:(BOOL const)reverse
 {
     NSParameterAssert(date);
     NSParameterAssert(timeZone);
-    NSInteger const seconds = [timeZone secondsFromGMTForDate:date];
-    NSInteger const signedSeconds = (reverse ? -1 : 1)*seconds;
-    NSDate *const convertedDate = [NSDate dateWithTimeInterval:signedSeconds
-                                                     sinceDate:date];
+    MRTimeZoneTransitionTable_ *const table = [self mr_transitionTableForTimeZone:timeZone];
+    NSTimeInterval const timeInterval = date.timeIntervalSinceReferenceDate;
+    NSTimeInterval const seconds = [table secondsFromGMTForTimeInterval:timeInterval];
+    NSTimeInterval const signedSeconds = (reverse ? -1 : 1)*seconds;
+    NSDate *const convertedDate = [NSDate dateWithTimeIntervalSinceReferenceDate:timeInterval + signedSeconds];
     return convertedDate;
 }
 
+- (void)mr_convertTimeIntervals:(NSTimeInterval *const)timeIntervals
+                          count:(NSUInteger const)count
+                     toTimeZone:(NSTimeZone *const)timeZone
+                        reverse:(BOOL const)reverse
+{
+    NSParameterAssert(timeIntervals || count == 0);
+    NSParameterAssert(timeZone);
+    MRTimeZoneTransitionTable_ *const table = [self mr_transitionTableForTimeZone:timeZone];
+    double const sign = (reverse ? -1 : 1);
+    for (NSUInteger index = 0; index < count; index++) {
+        NSTimeInterval const timeInterval = timeIntervals[index];
+        timeIntervals[index] = timeInterval + sign*[table secondsFromGMTForTimeInterval:timeInterval];
+    }
+}
+
 @end
 
 
@@ -745,6 +4923,7 @@ static NSString *const kMRUserNotificationsRegisteredKey = @"kMRUserNotification
                                                        error:errorPtr];
     if (recoverable) {
         UIApplication *const application = self.defaultApplication;
+        [self.metrics countApplicationCall:MRApplicationCallApplicationState_];
         switch (application.applicationState) {
             case UIApplicationStateActive:
                 NSLog(@"presenting notification in active state");
@@ -764,15 +4943,39 @@ static NSString *const kMRUserNotificationsRegisteredKey = @"kMRUserNotification
 - (BOOL)canPresentNotificationNow:(UILocalNotification *const)notification
                             error:(NSError **const)errorPtr
 {
-    BOOL const canSchedule = [self mr_isNotificationValid:notification
-                                             withRecovery:NO
-                                                    error:errorPtr];
-    return canSchedule;
+    MRLocalNotificationErrorCode code = kMRLocalNotificationErrorNone;
+    BOOL const canPresent = [self canPresentNotificationNow:notification
+                                                  errorCode:&code];
+    if (code != kMRLocalNotificationErrorNone && errorPtr) {
+        *errorPtr = [self buildErrorWithCode:code];
+    }
+    return canPresent;
+}
+
+- (BOOL)canPresentNotificationNow:(UILocalNotification *const)notification
+                        errorCode:(MRLocalNotificationErrorCode *const)codePtr
+{
+    MRLocalNotificationMetrics_ *const metrics = self.metrics;
+    uint64_t const startTime = (metrics ? mach_absolute_time() : 0);
+    MRLocalNotificationSettingsSnapshot_ *const settings = self.settingsSnapshot;
+    BOOL const canPresent = [self mr_isNotificationValid:notification
+                                            withSettings:settings
+                                                recovery:NO
+                                               errorCode:codePtr];
+    [metrics recordOperation:MRMetricsOperationValidate_ startTime:startTime];
+    return canPresent;
 }
 
 - (BOOL)scheduledNotificationsContainsNotification:(UILocalNotification *const)notification
 {
     NSParameterAssert(notification);
+    NSString *const identifier = [self getIdentifierFromNotification:notification];
+    if (identifier) {
+        return ([self mr_indexedNotificationForIdentifier:identifier] != nil);
+    }
+    if ([self.overflowQueue containsObject:notification]) {
+        return YES;
+    }
     NSArray *const scheduledNotifications = self.scheduledNotifications;
     for (UILocalNotification *const scheduledNotification in scheduledNotifications) {
         if ([scheduledNotification isEqual:notification]) {
@@ -801,27 +5004,166 @@ static NSString *const kMRUserNotificationsRegisteredKey = @"kMRUserNotification
                    withRecovery:(BOOL const)recovery
                           error:(NSError **const)errorPtr
 {
-    NSError *error;
-    BOOL recoverable = [self mr_isNotificationValid:notification
-                                       withRecovery:recovery
-                                              error:&error];
-    if (recoverable && [self getGMTFireDateFromNotification:notification].timeIntervalSinceNow < 0) {
-        recoverable = [self mr_buildError:&error
-                                 withCode:MRLocalNotificationErrorInvalidDate];
+    MRLocalNotificationErrorCode code = kMRLocalNotificationErrorNone;
+    BOOL const canSchedule = [self canScheduleNotification:notification
+                                              withRecovery:recovery
+                                                 errorCode:&code];
+    if (code != kMRLocalNotificationErrorNone && errorPtr) {
+        *errorPtr = [self buildErrorWithCode:code];
     }
-    if (recoverable && notification.region == nil && notification.fireDate == nil) {
-        recoverable = [self mr_buildError:&error
-                                 withCode:MRLocalNotificationErrorMissingDate];
+    return canSchedule;
+}
+
+- (BOOL)canScheduleNotification:(UILocalNotification *const)notification
+                   withRecovery:(BOOL const)recovery
+                      errorCode:(MRLocalNotificationErrorCode *const)codePtr
+{
+    MRLocalNotificationSettingsSnapshot_ *const settings = self.settingsSnapshot;
+    BOOL const canSchedule = [self mr_canScheduleNotification:notification
+                                                 withSettings:settings
+                                       scheduledNotifications:nil
+                                                     recovery:recovery
+                                                    errorCode:codePtr];
+    return canSchedule;
+}
+
+- (NSIndexSet *)scheduleNotifications:(NSArray *const)notifications
+                               errors:(NSArray **const)errorsPtr
+{
+    return [self mr_scheduleNotifications:notifications
+                   scheduledNotifications:nil
+                                   errors:errorsPtr];
+}
+
+- (NSIndexSet *)mr_scheduleNotifications:(NSArray *const)notifications
+                  scheduledNotifications:(NSArray *const)scheduledNotifications
+                                  errors:(NSArray **const)errorsPtr
+{
+    NSParameterAssert(notifications);
+    MRLocalNotificationSettingsSnapshot_ *const settings = self.settingsSnapshot;
+    NSMutableSet *scheduledSet;
+    NSMutableIndexSet *const scheduledIndexes = NSMutableIndexSet.indexSet;
+    NSMutableArray *const errors = (errorsPtr
+                                    ? [NSMutableArray arrayWithCapacity:notifications.count]
+                                    : nil);
+    NSUInteger index = 0;
+    for (UILocalNotification *const notification in notifications) {
+        if (scheduledSet == nil &&
+            [notification isKindOfClass:UILocalNotification.class] &&
+            [self getIdentifierFromNotification:notification] == nil) {
+            scheduledSet = [NSMutableSet setWithArray:(scheduledNotifications ?: self.scheduledNotifications)];
+        }
+        MRLocalNotificationErrorCode code = kMRLocalNotificationErrorNone;
+        BOOL const recoverable = [self mr_canScheduleNotification:notification
+                                                     withSettings:settings
+                                           scheduledNotifications:scheduledSet
+                                                         recovery:YES
+                                                        errorCode:&code];
+        if (recoverable) {
+            [self scheduleNotification:notification];
+            [scheduledSet addObject:notification];
+            [scheduledIndexes addIndex:index];
+        }
+        if (errors) {
+            NSError *const error = (code != kMRLocalNotificationErrorNone
+                                    ? [self buildErrorWithCode:code]
+                                    : nil);
+            [errors addObject:(error ?: NSNull.null)];
+        }
+        index += 1;
+    }
+    if (errorsPtr) {
+        *errorsPtr = errors.copy;
+    }
+    return scheduledIndexes.copy;
+}
+
+- (void)enqueueScheduleNotification:(UILocalNotification *const)notification
+                         completion:(void(^const)(BOOL success, NSError *error))completion
+{
+    dispatch_async(self.pipelineQueue, ^{
+        MRLocalNotificationPipelineOperation_ *const operation = MRLocalNotificationPipelineOperation_.new;
+        operation.kind = MRLocalNotificationPipelineSchedule_;
+        operation.notification = notification;
+        operation.completion = completion;
+        MRLocalNotificationErrorCode code = kMRLocalNotificationErrorNone;
+        if ([self mr_isNotificationIntrinsicallyValid:notification errorCode:&code]) {
+            [self mr_validatePipelineOperation:operation];
+        }
+        if (operation.errorCode == kMRLocalNotificationErrorNone && code == kMRLocalNotificationErrorNone) {
+            id const key = [self mr_pipelineKeyForNotification:notification];
+            MRLocalNotificationPipelineOperation_ *const previousOperation = self.pipelineOperationsByKey[key];
+            if (previousOperation) {
+                previousOperation.superseded = YES;
+                if (previousOperation.kind != MRLocalNotificationPipelineSchedule_) {
+                    operation.kind = MRLocalNotificationPipelineReplace_;
+                }
+            }
+            self.pipelineOperationsByKey[key] = operation;
+        } else if (operation.errorCode == kMRLocalNotificationErrorNone) {
+            operation.errorCode = code;
+        }
+        [self mr_addPipelineOperation:operation];
+    });
+}
+
+- (void)enqueueCancelNotification:(UILocalNotification *const)notification
+                       completion:(void(^const)(BOOL success, NSError *error))completion
+{
+    NSParameterAssert(notification);
+    dispatch_async(self.pipelineQueue, ^{
+        MRLocalNotificationPipelineOperation_ *const operation = MRLocalNotificationPipelineOperation_.new;
+        operation.kind = MRLocalNotificationPipelineCancel_;
+        operation.notification = notification;
+        operation.completion = completion;
+        id const key = [self mr_pipelineKeyForNotification:notification];
+        MRLocalNotificationPipelineOperation_ *const previousOperation = self.pipelineOperationsByKey[key];
+        previousOperation.superseded = YES;
+        self.pipelineOperationsByKey[key] = operation;
+        [self mr_addPipelineOperation:operation];
+    });
+}
+
+- (NSError *)buildErrorWithCode:(MRLocalNotificationErrorCode const)code
+{
+    BOOL contactSupport = NO;
+    if ([self mr_isNonRecoverableErrorCode:code] || code == MRLocalNotificationErrorCategoryNotRegistered) {
+        NSURL *const contactSupportURL = self.contactSupportURL;
+        UIApplication *const application = self.defaultApplication;
+        if (contactSupportURL) {
+            [self.metrics countApplicationCall:MRApplicationCallCanOpenURL_];
+        }
+        contactSupport = (contactSupportURL && [application canOpenURL:contactSupportURL]);
     }
-    if (recoverable && [self scheduledNotificationsContainsNotification:notification]) {
-        recoverable = [self mr_buildError:&error
-                                 withCode:MRLocalNotificationErrorAlreadyScheduled];
+    NSString *description;
+    if ([self mr_isNonRecoverableErrorCode:code]) {
+        description = NSLocalizedString(@"Error scheduling notification", nil);
+    } else {
+        description = NSLocalizedString(@"Local notifications", nil);
     }
-    if (error && errorPtr) {
-        *errorPtr = error;
+    NSString *recoverySuggestion;
+    NSArray *recoveryOptions;
+    NSURL *recoveryURL;
+    if (contactSupport) {
+        recoveryOptions = @[ NSLocalizedString(@"Contact Support", nil) ];
+        recoverySuggestion = NSLocalizedString(@"If the problem persists, please contact support.", nil);
+        recoveryURL = self.contactSupportURL;
+    } else {
+        recoverySuggestion = NSLocalizedString(@"Please go to Settings and enable missing notification types.", nil);
+        recoveryOptions = @[ NSLocalizedString(@"Settings", nil) ];
+        recoveryURL = [NSURL URLWithString:UIApplicationOpenSettingsURLString];
     }
-    BOOL const canSchedule = (recovery ? recoverable : error == nil);
-    return canSchedule;
+    NSString *const failureReason = [self mr_localizedFailureReasonForCode:code];
+    NSDictionary * const userInfo = @{ NSLocalizedDescriptionKey: description,
+                                       NSLocalizedFailureReasonErrorKey: failureReason,
+                                       NSLocalizedRecoverySuggestionErrorKey: recoverySuggestion,
+                                       NSLocalizedRecoveryOptionsErrorKey: recoveryOptions,
+                                       NSRecoveryAttempterErrorKey: self,
+                                       MRRecoveryURLErrorKey: recoveryURL };
+    NSError *const error = [NSError errorWithDomain:MRLocalNotificationErrorDomain
+                                               code:code
+                                           userInfo:userInfo];
+    return error;
 }
 
 - (UIAlertController *)buildAlertControlForError:(NSError *const)error
@@ -900,100 +5242,262 @@ static NSString *const kMRUserNotificationsRegisteredKey = @"kMRUserNotification
 
 #pragma mark Private
 
+- (BOOL)mr_isNotificationIntrinsicallyValid:(UILocalNotification *const)notification
+                                  errorCode:(MRLocalNotificationErrorCode *const)codePtr
+{
+    MRLocalNotificationErrorCode code = kMRLocalNotificationErrorNone;
+    if (notification == nil) {
+        code = MRLocalNotificationErrorNilObject;
+    } else if (![notification isKindOfClass:UILocalNotification.class]) {
+        code = MRLocalNotificationErrorInvalidObject;
+    } else if (notification.alertBody.length == 0 && notification.applicationIconBadgeNumber <= 0) {
+        code = MRLocalNotificationErrorMissingAlertBody;
+    } else if (notification.region == nil && notification.fireDate == nil) {
+        code = MRLocalNotificationErrorMissingDate;
+    } else if (notification.fireDate &&
+               [self getGMTFireDateFromNotification:notification].timeIntervalSinceReferenceDate < [self mr_now]) {
+        code = MRLocalNotificationErrorInvalidDate;
+    }
+    if (code != kMRLocalNotificationErrorNone) {
+        [self.metrics countErrorCode:code];
+    }
+    if (code != kMRLocalNotificationErrorNone && codePtr) {
+        *codePtr = code;
+    }
+    return (code == kMRLocalNotificationErrorNone);
+}
+
+- (id)mr_pipelineKeyForNotification:(UILocalNotification *const)notification
+{
+    NSString *const identifier = [self getIdentifierFromNotification:notification];
+    return (identifier ?: [NSValue valueWithNonretainedObject:notification]);
+}
+
+- (void)mr_addPipelineOperation:(MRLocalNotificationPipelineOperation_ *const)operation
+{
+    NSMutableArray *const operations = self.pipelineOperations;
+    [operations addObject:operation];
+    if (operations.count == 1) {
+        void(^const commitExecutor)(dispatch_block_t) = self.commitExecutor;
+        dispatch_block_t const commit = ^{
+            [self mr_commitPipelineOperations];
+        };
+        if (commitExecutor) {
+            commitExecutor(commit);
+        } else {
+            dispatch_async(dispatch_get_main_queue(), commit);
+        }
+    }
+}
+
+- (void)mr_validatePipelineOperation:(MRLocalNotificationPipelineOperation_ *const)operation
+{
+    // Runs on the pipeline queue, so it only uses the settings of the last commit and never the index.
+    MRLocalNotificationSettingsSnapshot_ *const settings = self.pipelineSettingsSnapshot;
+    UILocalNotification *const notification = operation.notification;
+    if (settings == nil || [self getIdentifierFromNotification:notification] == nil) {
+        return;
+    }
+    MRLocalNotificationErrorCode code = kMRLocalNotificationErrorNone;
+    BOOL recoverable = [self mr_isNotificationValid:notification
+                                       withSettings:settings
+                                           recovery:YES
+                                          errorCode:&code];
+    if (recoverable &&
+        notification.fireDate &&
+        [self getGMTFireDateFromNotification:notification].timeIntervalSinceReferenceDate < [self mr_now]) {
+        recoverable = [self mr_setErrorCode:&code
+                                   withCode:MRLocalNotificationErrorInvalidDate];
+    }
+    if (recoverable && notification.region == nil && notification.fireDate == nil) {
+        recoverable = [self mr_setErrorCode:&code
+                                   withCode:MRLocalNotificationErrorMissingDate];
+    }
+    if (recoverable) {
+        operation.validationSettings = settings;
+        operation.validationCode = code;
+    } else {
+        operation.errorCode = code;
+    }
+}
+
+- (void)mr_commitValidatedPipelineOperation:(MRLocalNotificationPipelineOperation_ *const)operation
+{
+    // Validated on the pipeline queue; only the already scheduled check depends on the index.
+    UILocalNotification *const notification = operation.notification;
+    if ([self scheduledNotificationsContainsNotification:notification]) {
+        [self mr_setErrorCode:NULL withCode:MRLocalNotificationErrorAlreadyScheduled];
+        operation.validationCode = MRLocalNotificationErrorAlreadyScheduled;
+        return;
+    }
+    [self scheduleNotification:notification];
+    operation.scheduled = YES;
+}
+
+- (void)mr_commitPipelineOperations
+{
+    __block NSArray *operations;
+    dispatch_sync(self.pipelineQueue, ^{
+        operations = self.pipelineOperations.copy;
+        [self.pipelineOperations removeAllObjects];
+        [self.pipelineOperationsByKey removeAllObjects];
+    });
+    MRLocalNotificationSettingsSnapshot_ *const settings = self.settingsSnapshot;
+    self.pipelineSettingsSnapshot = settings;
+    NSMutableArray *const scheduledNotifications = [NSMutableArray arrayWithCapacity:operations.count];
+    for (MRLocalNotificationPipelineOperation_ *const operation in operations) {
+        if (operation.superseded || operation.errorCode != kMRLocalNotificationErrorNone) {
+            continue;
+        }
+        UILocalNotification *const notification = operation.notification;
+        switch (operation.kind) {
+            case MRLocalNotificationPipelineCancel_:
+                [self cancelNotification:notification];
+                break;
+            case MRLocalNotificationPipelineReplace_: {
+                NSString *const identifier = [self getIdentifierFromNotification:notification];
+                if (identifier == nil || [self mr_indexedNotificationForIdentifier:identifier]) {
+                    [self cancelNotification:notification];
+                }
+            }   // fall through
+            case MRLocalNotificationPipelineSchedule_:
+                if (operation.validationSettings == settings) {
+                    [self mr_commitValidatedPipelineOperation:operation];
+                } else {
+                    operation.validationSettings = nil;
+                    operation.batchIndex = scheduledNotifications.count;
+                    [scheduledNotifications addObject:notification];
+                }
+                break;
+        }
+    }
+    NSArray *errors;
+    NSIndexSet *const scheduledIndexes = (scheduledNotifications.count > 0
+                                          ? [self scheduleNotifications:scheduledNotifications
+                                                                 errors:&errors]
+                                          : nil);
+    for (MRLocalNotificationPipelineOperation_ *const operation in operations) {
+        void(^const completion)(BOOL, NSError *) = operation.completion;
+        if (completion == nil) {
+            continue;
+        }
+        if (operation.errorCode != kMRLocalNotificationErrorNone) {
+            completion(NO, [self buildErrorWithCode:operation.errorCode]);
+        } else if (operation.superseded) {
+            completion(operation.kind == MRLocalNotificationPipelineCancel_, nil);
+        } else if (operation.kind == MRLocalNotificationPipelineCancel_) {
+            completion(YES, nil);
+        } else if (operation.validationSettings) {
+            MRLocalNotificationErrorCode const code = operation.validationCode;
+            completion(operation.scheduled, (code != kMRLocalNotificationErrorNone
+                                             ? [self buildErrorWithCode:code]
+                                             : nil));
+        } else {
+            NSUInteger const index = operation.batchIndex;
+            id const error = errors[index];
+            completion([scheduledIndexes containsIndex:index], (error != NSNull.null ? error : nil));
+        }
+    }
+}
+
+- (BOOL)mr_canScheduleNotification:(UILocalNotification *const)notification
+                       withSettings:(MRLocalNotificationSettingsSnapshot_ *const)settings
+             scheduledNotifications:(NSSet *const)scheduledSet
+                           recovery:(BOOL const)recovery
+                          errorCode:(MRLocalNotificationErrorCode *const)codePtr
+{
+    MRLocalNotificationMetrics_ *const metrics = self.metrics;
+    uint64_t const startTime = (metrics ? mach_absolute_time() : 0);
+    MRLocalNotificationErrorCode code = kMRLocalNotificationErrorNone;
+    BOOL recoverable = [self mr_isNotificationValid:notification
+                                       withSettings:settings
+                                           recovery:recovery
+                                          errorCode:&code];
+    if (recoverable &&
+        notification.fireDate &&
+        [self getGMTFireDateFromNotification:notification].timeIntervalSinceReferenceDate < [self mr_now]) {
+        recoverable = [self mr_setErrorCode:&code
+                                   withCode:MRLocalNotificationErrorInvalidDate];
+    }
+    if (recoverable && notification.region == nil && notification.fireDate == nil) {
+        recoverable = [self mr_setErrorCode:&code
+                                   withCode:MRLocalNotificationErrorMissingDate];
+    }
+    if (recoverable) {
+        BOOL const alreadyScheduled = (scheduledSet && [self getIdentifierFromNotification:notification] == nil
+                                       ? ([scheduledSet containsObject:notification] ||
+                                          [self.overflowQueue containsObject:notification])
+                                       : [self scheduledNotificationsContainsNotification:notification]);
+        if (alreadyScheduled) {
+            recoverable = [self mr_setErrorCode:&code
+                                       withCode:MRLocalNotificationErrorAlreadyScheduled];
+        }
+    }
+    if (code != kMRLocalNotificationErrorNone && codePtr) {
+        *codePtr = code;
+    }
+    BOOL const canSchedule = (recovery ? recoverable : code == kMRLocalNotificationErrorNone);
+    [metrics recordOperation:MRMetricsOperationValidate_ startTime:startTime];
+    return canSchedule;
+}
+
 - (BOOL)mr_isNotificationValid:(UILocalNotification *const)notification
-                  withRecovery:(BOOL const)recovery
-                         error:(NSError **const)errorPtr
+                  withSettings:(MRLocalNotificationSettingsSnapshot_ *const)settings
+                      recovery:(BOOL const)recovery
+                     errorCode:(MRLocalNotificationErrorCode *const)codePtr
 {
-    NSError *error;
+    MRLocalNotificationErrorCode code = kMRLocalNotificationErrorNone;
     BOOL recoverable = YES;
+    UIUserNotificationType const types = settings.types;
     if (notification == nil) {
-        recoverable = [self mr_buildError:&error
-                                 withCode:MRLocalNotificationErrorNilObject];
+        recoverable = [self mr_setErrorCode:&code
+                                   withCode:MRLocalNotificationErrorNilObject];
     }
     if (recoverable && ![notification isKindOfClass:UILocalNotification.class]) {
-        recoverable = [self mr_buildError:&error
-                                 withCode:MRLocalNotificationErrorInvalidObject];
+        recoverable = [self mr_setErrorCode:&code
+                                   withCode:MRLocalNotificationErrorInvalidObject];
     }
     if (recoverable && notification.alertBody.length == 0 && notification.applicationIconBadgeNumber <= 0) {
-        recoverable = [self mr_buildError:&error
-                                 withCode:MRLocalNotificationErrorMissingAlertBody];
+        recoverable = [self mr_setErrorCode:&code
+                                   withCode:MRLocalNotificationErrorMissingAlertBody];
     }
-    if (recoverable && notification.soundName && !self.isSoundTypeAllowed) {
-        recoverable = [self mr_buildError:&error
-                                 withCode:MRLocalNotificationErrorSoundNotAllowed];
+    if (recoverable && notification.soundName && (types & UIUserNotificationTypeSound) == 0) {
+        recoverable = [self mr_setErrorCode:&code
+                                   withCode:MRLocalNotificationErrorSoundNotAllowed];
     }
-    if (recoverable && notification.applicationIconBadgeNumber != 0 && !self.isBadgeTypeAllowed) {
-        recoverable = [self mr_buildError:&error
-                                 withCode:MRLocalNotificationErrorBadgeNotAllowed];
+    if (recoverable && notification.applicationIconBadgeNumber != 0 && (types & UIUserNotificationTypeBadge) == 0) {
+        recoverable = [self mr_setErrorCode:&code
+                                   withCode:MRLocalNotificationErrorBadgeNotAllowed];
     }
-    if (recoverable && notification.alertBody && !self.isAlertTypeAllowed) {
-        recoverable = [self mr_buildError:&error
-                                 withCode:MRLocalNotificationErrorAlertNotAllowed];
+    if (recoverable && notification.alertBody && (types & UIUserNotificationTypeAlert) == 0) {
+        recoverable = [self mr_setErrorCode:&code
+                                   withCode:MRLocalNotificationErrorAlertNotAllowed];
     }
-    if (recoverable && !self.isRegisteredForNotifications) {
-        recoverable = [self mr_buildError:&error
-                                 withCode:MRLocalNotificationErrorNoneAllowed];
+    if (recoverable && types == UIUserNotificationTypeNone) {
+        recoverable = [self mr_setErrorCode:&code
+                                   withCode:MRLocalNotificationErrorNoneAllowed];
     }
     if (recoverable) {
         NSString *const category = notification.category;
-        UIUserNotificationSettings *const settings = self.currentUserNotificationSettings;
-        if (category && [self getCategoryForIdentifier:category
-                          fromUserNotificationSettings:settings] == nil) {
-            recoverable = [self mr_buildError:&error
-                                     withCode:MRLocalNotificationErrorCategoryNotRegistered];
+        if (category && settings.categories[category] == nil) {
+            recoverable = [self mr_setErrorCode:&code
+                                       withCode:MRLocalNotificationErrorCategoryNotRegistered];
         }
     }
-    if (error && errorPtr) {
-        *errorPtr = error;
+    if (code != kMRLocalNotificationErrorNone && codePtr) {
+        *codePtr = code;
     }
-    BOOL const isValid = (recovery ? recoverable : error == nil);
+    BOOL const isValid = (recovery ? recoverable : code == kMRLocalNotificationErrorNone);
     return isValid;
 }
 
-- (BOOL)mr_buildError:(NSError **const)errorPtr withCode:(MRLocalNotificationErrorCode const)code
+- (BOOL)mr_setErrorCode:(MRLocalNotificationErrorCode *const)codePtr withCode:(MRLocalNotificationErrorCode const)code
 {
-    BOOL validNotification;
-    NSString *description;
-    NSString *recoverySuggestion;
-    NSArray *recoveryOptions;
-    UIApplication *const application = self.defaultApplication;
-    BOOL contactSupport = NO;
-    NSURL *recoveryURL;
-    if ([self mr_isNonRecoverableErrorCode:code]) {
-        validNotification = NO;
-        description = NSLocalizedString(@"Error scheduling notification", nil);
-        NSURL *const contactSupportURL = self.contactSupportURL;
-        contactSupport = (contactSupportURL && [application canOpenURL:contactSupportURL]);
-    } else {
-        validNotification = YES;
-        description = NSLocalizedString(@"Local notifications", nil);
-        if (code == MRLocalNotificationErrorCategoryNotRegistered) {
-            NSURL *const contactSupportURL = self.contactSupportURL;
-            contactSupport = (contactSupportURL && [application canOpenURL:contactSupportURL]);
-        }
-    }
-    if (contactSupport) {
-        recoveryOptions = @[ NSLocalizedString(@"Contact Support", nil) ];
-        recoverySuggestion = NSLocalizedString(@"If the problem persists, please contact support.", nil);
-        recoveryURL = self.contactSupportURL;
-    } else {
-        recoverySuggestion = NSLocalizedString(@"Please go to Settings and enable missing notification types.", nil);
-        recoveryOptions = @[ NSLocalizedString(@"Settings", nil) ];
-        recoveryURL = [NSURL URLWithString:UIApplicationOpenSettingsURLString];
-    }
-    NSString *const failureReason = [self mr_localizedFailureReasonForCode:code];
-    NSDictionary * const userInfo = @{ NSLocalizedDescriptionKey: description,
-                                       NSLocalizedFailureReasonErrorKey: failureReason,
-                                       NSLocalizedRecoverySuggestionErrorKey: recoverySuggestion,
-                                       NSLocalizedRecoveryOptionsErrorKey: recoveryOptions,
-                                       NSRecoveryAttempterErrorKey: self,
-                                       MRRecoveryURLErrorKey: recoveryURL };
-    NSError *const error = [NSError errorWithDomain:MRLocalNotificationErrorDomain
-                                               code:code
-                                           userInfo:userInfo];
-    if (errorPtr) {
-        *errorPtr = error;
+    [self.metrics countErrorCode:code];
+    if (codePtr) {
+        *codePtr = code;
     }
+    BOOL const validNotification = ![self mr_isNonRecoverableErrorCode:code];
     return validNotification;
 }
 
@@ -1092,10 +5596,417 @@ static NSString *const kMRUserNotificationsRegisteredKey = @"kMRUserNotification
     BOOL completed = NO;
     NSURL *const URL = error.userInfo[MRRecoveryURLErrorKey];
     UIApplication *const application = self.defaultApplication;
+    MRLocalNotificationMetrics_ *const metrics = self.metrics;
+    if (URL) {
+        [metrics countApplicationCall:MRApplicationCallCanOpenURL_];
+    }
     if (URL && [application canOpenURL:URL]) {
+        [metrics countApplicationCall:MRApplicationCallOpenURL_];
         completed = [application openURL:URL];
     }
     return completed;
 }
 
 @end
+
+
+#pragma mark - MRLocalNotificationSimulator -
+
+
+static uint64_t MRThreadCPUNanoseconds_(void)
+{
+    mach_port_t const thread = mach_thread_self();
+    thread_basic_info_data_t info;
+    mach_msg_type_number_t count = THREAD_BASIC_INFO_COUNT;
+    kern_return_t const result = thread_info(thread, THREAD_BASIC_INFO, (thread_info_t)&info, &count);
+    mach_port_deallocate(mach_task_self(), thread);
+    if (result != KERN_SUCCESS) {
+        return 0;
+    }
+    return (((uint64_t)info.user_time.seconds + (uint64_t)info.system_time.seconds)*NSEC_PER_SEC +
+            ((uint64_t)info.user_time.microseconds + (uint64_t)info.system_time.microseconds)*NSEC_PER_USEC);
+}
+
+
+@interface MRLocalNotificationSimulatedEntry_ : NSObject {
+@public
+    UILocalNotification *_notification;
+    NSTimeInterval _intendedTime;
+    NSTimeInterval _fireTime;
+}
+@end
+
+
+@implementation MRLocalNotificationSimulatedEntry_
+@end
+
+
+// Stand-in for `UIApplication` that keeps the pending notifications of a simulation.
+// It accounts the time spent in the calls made by the facade, so the simulator can exclude it.
+@interface MRLocalNotificationSimulatedApplication_ : NSObject
+@property (nonatomic, weak) MRLocalNotificationFacade *facade;
+@property (nonatomic, strong) NSTimeZone *timeZone;
+@property (nonatomic, assign) NSUInteger maximumPendingNotifications;
+@property (nonatomic, readonly) NSArray *scheduledLocalNotifications;
+@property (nonatomic, readonly) UIUserNotificationSettings *currentUserNotificationSettings;
+@property (nonatomic, readonly) UIApplicationState applicationState;
+@property (nonatomic, readonly) UIWindow *keyWindow;
+@property (nonatomic, assign) NSInteger applicationIconBadgeNumber;
+@property (nonatomic, readonly) MRLocalNotificationSimulatedEntry_ *nextEntry;
+@property (nonatomic, assign) NSUInteger droppedCount;
+@property (nonatomic, assign) uint64_t nanoseconds;
+- (void)scheduleLocalNotification:(UILocalNotification *)notification;
+- (void)cancelLocalNotification:(UILocalNotification *)notification;
+- (void)cancelAllLocalNotifications;
+- (void)presentLocalNotificationNow:(UILocalNotification *)notification;
+- (void)registerUserNotificationSettings:(UIUserNotificationSettings *)settings;
+- (BOOL)canOpenURL:(NSURL *)url;
+- (BOOL)openURL:(NSURL *)url;
+- (void)rearmEntry:(MRLocalNotificationSimulatedEntry_ *)entry;
+- (void)updateFloatingEntries;
+@end
+
+
+@implementation MRLocalNotificationSimulatedApplication_ {
+    NSMutableArray *_entries;
+    NSSet *_categories;
+}
+
+- (NSArray *)scheduledLocalNotifications
+{
+    uint64_t const startTime = mach_absolute_time();
+    NSMutableArray *const notifications = [NSMutableArray arrayWithCapacity:_entries.count];
+    for (MRLocalNotificationSimulatedEntry_ *const entry in _entries) {
+        [notifications addObject:entry->_notification.copy];
+    }
+    _nanoseconds += MRNanosecondsSince_(startTime);
+    return notifications;
+}
+
+- (UIUserNotificationSettings *)currentUserNotificationSettings
+{
+    UIUserNotificationType const types = (UIUserNotificationTypeAlert |
+                                          UIUserNotificationTypeBadge |
+                                          UIUserNotificationTypeSound);
+    return [UIUserNotificationSettings settingsForTypes:types categories:_categories];
+}
+
+- (UIApplicationState)applicationState
+{
+    return UIApplicationStateBackground;
+}
+
+- (UIWindow *)keyWindow
+{
+    return nil;
+}
+
+- (MRLocalNotificationSimulatedEntry_ *)nextEntry
+{
+    MRLocalNotificationSimulatedEntry_ *nextEntry;
+    for (MRLocalNotificationSimulatedEntry_ *const entry in _entries) {
+        if (nextEntry == nil || entry->_fireTime < nextEntry->_fireTime) {
+            nextEntry = entry;
+        }
+    }
+    return nextEntry;
+}
+
+- (void)scheduleLocalNotification:(UILocalNotification *const)notification
+{
+    uint64_t const startTime = mach_absolute_time();
+    MRLocalNotificationSimulatedEntry_ *const entry = MRLocalNotificationSimulatedEntry_.new;
+    entry->_notification = notification.copy;
+    [self mr_armEntry:entry notBefore:[self mr_now]];
+    [_entries addObject:entry];
+    if (_entries.count > _maximumPendingNotifications) {
+        MRLocalNotificationSimulatedEntry_ *lastEntry;
+        for (MRLocalNotificationSimulatedEntry_ *const candidate in _entries) {
+            if (lastEntry == nil || candidate->_fireTime >= lastEntry->_fireTime) {
+                lastEntry = candidate;
+            }
+        }
+        [_entries removeObjectIdenticalTo:lastEntry];
+        _droppedCount += 1;
+    }
+    _nanoseconds += MRNanosecondsSince_(startTime);
+}
+
+- (void)cancelLocalNotification:(UILocalNotification *const)notification
+{
+    uint64_t const startTime = mach_absolute_time();
+    NSUInteger const index = [_entries indexOfObjectPassingTest:^BOOL(MRLocalNotificationSimulatedEntry_ *const entry, NSUInteger const index, BOOL *const stop) {
+        return [entry->_notification isEqual:notification];
+    }];
+    if (index != NSNotFound) {
+        [_entries removeObjectAtIndex:index];
+    }
+    _nanoseconds += MRNanosecondsSince_(startTime);
+}
+
+- (void)cancelAllLocalNotifications
+{
+    [_entries removeAllObjects];
+}
+
+- (void)presentLocalNotificationNow:(UILocalNotification *const)notification
+{
+    uint64_t const startTime = mach_absolute_time();
+    MRLocalNotificationSimulatedEntry_ *const entry = MRLocalNotificationSimulatedEntry_.new;
+    entry->_notification = notification.copy;
+    entry->_notification.repeatInterval = 0;
+    entry->_intendedTime = [self mr_now];
+    entry->_fireTime = entry->_intendedTime;
+    [_entries addObject:entry];
+    _nanoseconds += MRNanosecondsSince_(startTime);
+}
+
+- (void)registerUserNotificationSettings:(UIUserNotificationSettings *const)settings
+{
+    _categories = settings.categories;
+}
+
+- (BOOL)canOpenURL:(NSURL *const)url
+{
+    return NO;
+}
+
+- (BOOL)openURL:(NSURL *const)url
+{
+    return NO;
+}
+
+- (void)rearmEntry:(MRLocalNotificationSimulatedEntry_ *const)entry
+{
+    // Occurrences are at least a minute apart, so skipping one second skips the delivered one.
+    if (entry->_notification.repeatInterval != 0) {
+        [self mr_armEntry:entry notBefore:entry->_fireTime + 1];
+    }
+    if (entry->_notification.repeatInterval == 0 || isinf(entry->_fireTime)) {
+        [_entries removeObjectIdenticalTo:entry];
+    }
+}
+
+- (void)updateFloatingEntries
+{
+    uint64_t const startTime = mach_absolute_time();
+    NSTimeInterval const now = [self mr_now];
+    for (MRLocalNotificationSimulatedEntry_ *const entry in _entries) {
+        if (entry->_notification.timeZone) {
+            [self mr_armEntry:entry notBefore:now];
+        }
+    }
+    _nanoseconds += MRNanosecondsSince_(startTime);
+}
+
+#pragma mark Private
+
+- (NSTimeInterval)mr_now
+{
+    return [self.facade mr_now];
+}
+
+- (void)mr_armEntry:(MRLocalNotificationSimulatedEntry_ *const)entry notBefore:(NSTimeInterval const)time
+{
+    // Past non-repeating notifications fire immediately; repeating ones at their next occurrence.
+    // Floating notifications fire at their wall-clock time in the simulated time zone.
+    MRLocalNotificationFacade *const facade = self.facade;
+    UILocalNotification *const notification = entry->_notification;
+    NSTimeZone *const timeZone = (notification.timeZone ? (self.timeZone ?: NSTimeZone.defaultTimeZone) : nil);
+    NSDate *const fireDate = [facade mr_GMTFireDateFromNotification:notification timeZone:timeZone];
+    NSTimeInterval intendedTime = (fireDate ? fireDate.timeIntervalSinceReferenceDate : INFINITY);
+    if (intendedTime < time && notification.repeatInterval != 0) {
+        MRLocalNotificationRecurrenceEnumerator_ *const enumerator =
+        [facade mr_recurrenceEnumeratorForNotification:notification rule:nil timeZone:timeZone];
+        [enumerator skipToDate:[NSDate dateWithTimeIntervalSinceReferenceDate:time]];
+        intendedTime = INFINITY;
+        NSTimeInterval nextTime;
+        while ([enumerator getNextTimeInterval:&nextTime]) {
+            if (nextTime - NSTimeIntervalSince1970 >= time) {
+                intendedTime = nextTime - NSTimeIntervalSince1970;
+                break;
+            }
+        }
+    }
+    entry->_intendedTime = intendedTime;
+    entry->_fireTime = MAX(intendedTime, time);
+}
+
+#pragma mark - NSObject
+
+- (instancetype)init
+{
+    self = [super init];
+    if (self) {
+        _entries = NSMutableArray.array;
+    }
+    return self;
+}
+
+@end
+
+
+@interface MRLocalNotificationSimulatorEvent_ : NSObject
+@property (nonatomic, copy) void(^block)(MRLocalNotificationFacade *facade);
+@end
+
+
+@implementation MRLocalNotificationSimulatorEvent_
+@end
+
+
+@interface MRLocalNotificationSimulator ()
+@property (nonatomic, strong) MRLocalNotificationFacade *facade;
+@property (nonatomic, strong) MRLocalNotificationSimulatedApplication_ *application;
+@property (nonatomic, strong) MRLocalNotificationHeap_ *events;
+@property (nonatomic, assign) NSTimeInterval now;
+@property (nonatomic, assign) uint64_t facadeNanoseconds;
+@end
+
+
+@implementation MRLocalNotificationSimulator
+
+- (instancetype)initWithFacade:(MRLocalNotificationFacade *const)facade
+                     startDate:(NSDate *const)startDate
+{
+    NSParameterAssert(facade);
+    NSParameterAssert(startDate);
+    self = [super init];
+    if (self) {
+        _facade = facade;
+        _now = startDate.timeIntervalSinceReferenceDate;
+        _events = MRLocalNotificationHeap_.new;
+        _application = MRLocalNotificationSimulatedApplication_.new;
+        _application.facade = facade;
+        _application.maximumPendingNotifications = 64;
+        __weak MRLocalNotificationSimulator *const weakSelf = self;
+        facade.clock = ^NSTimeInterval{
+            MRLocalNotificationSimulator *const simulator = weakSelf;
+            return (simulator ? simulator.now : NSDate.timeIntervalSinceReferenceDate);
+        };
+        facade.defaultApplication = (UIApplication *)_application;
+    }
+    return self;
+}
+
+- (NSDate *)currentDate
+{
+    return [NSDate dateWithTimeIntervalSinceReferenceDate:self.now];
+}
+
+- (NSUInteger)maximumPendingNotifications
+{
+    return self.application.maximumPendingNotifications;
+}
+
+- (void)setMaximumPendingNotifications:(NSUInteger const)maximumPendingNotifications
+{
+    self.application.maximumPendingNotifications = maximumPendingNotifications;
+}
+
+- (NSArray *)pendingNotifications
+{
+    return self.application.scheduledLocalNotifications;
+}
+
+- (void)addEventAtDate:(NSDate *const)date
+                 block:(void(^const)(MRLocalNotificationFacade *))block
+{
+    NSParameterAssert(date);
+    NSParameterAssert(block);
+    MRLocalNotificationSimulatorEvent_ *const event = MRLocalNotificationSimulatorEvent_.new;
+    event.block = block;
+    [self.events addObject:event withKey:date.timeIntervalSinceReferenceDate];
+}
+
+- (void)addTimeZoneChangeAtDate:(NSDate *const)date
+                       timeZone:(NSTimeZone *const)timeZone
+{
+    NSParameterAssert(timeZone);
+    __weak MRLocalNotificationSimulator *const weakSelf = self;
+    [self addEventAtDate:date block:^(MRLocalNotificationFacade *const facade) {
+        MRLocalNotificationSimulator *const simulator = weakSelf;
+        simulator.application.timeZone = timeZone;
+        [NSTimeZone setDefaultTimeZone:timeZone];
+        [facade systemTimeZoneDidChange:nil];
+        [simulator.application updateFloatingEntries];
+    }];
+}
+
+- (NSDictionary *)runUntilDate:(NSDate *const)endDate
+{
+    NSParameterAssert(endDate);
+    NSTimeInterval const endTime = endDate.timeIntervalSinceReferenceDate;
+    MRLocalNotificationFacade *const facade = self.facade;
+    MRLocalNotificationSimulatedApplication_ *const application = self.application;
+    MRLocalNotificationHeap_ *const events = self.events;
+    NSTimeZone *const systemTimeZone = NSTimeZone.defaultTimeZone;
+    // The time zone is process-wide, so it is restored even if an event raises.
+    @try {
+        if (application.timeZone) {
+            [NSTimeZone setDefaultTimeZone:application.timeZone];
+        }
+        uint64_t const startCPUTime = MRThreadCPUNanoseconds_();
+        NSUInteger const startDroppedCount = application.droppedCount;
+        NSUInteger eventCount = 0;
+        NSUInteger deliveredCount = 0;
+        NSTimeInterval totalLatency = 0;
+        NSTimeInterval maximumLatency = 0;
+        self.facadeNanoseconds = 0;
+        while (YES) {
+            MRLocalNotificationSimulatedEntry_ *const entry = application.nextEntry;
+            NSTimeInterval const fireTime = (entry ? entry->_fireTime : INFINITY);
+            NSTimeInterval const eventTime = (events.count > 0 ? events.firstKey : INFINITY);
+            if (MIN(fireTime, eventTime) > endTime) {
+                break;
+            }
+            if (fireTime <= eventTime) {
+                self.now = MAX(self.now, fireTime);
+                NSTimeInterval const latency = self.now - entry->_intendedTime;
+                totalLatency += latency;
+                maximumLatency = MAX(maximumLatency, latency);
+                deliveredCount += 1;
+                UILocalNotification *const notification = entry->_notification;
+                [application rearmEntry:entry];
+                [self mr_callFacade:^{
+                    [facade handleDidReceiveLocalNotification:notification];
+                }];
+            } else {
+                self.now = MAX(self.now, eventTime);
+                MRLocalNotificationSimulatorEvent_ *const event = events.firstObject;
+                [events removeFirstObject];
+                eventCount += 1;
+                [self mr_callFacade:^{
+                    event.block(facade);
+                }];
+            }
+        }
+        self.now = MAX(self.now, endTime);
+        uint64_t const cpuNanoseconds = MRThreadCPUNanoseconds_() - startCPUTime;
+        return @{ MRLocalNotificationSimulationEventsKey: @(eventCount),
+                  MRLocalNotificationSimulationDeliveredKey: @(deliveredCount),
+                  MRLocalNotificationSimulationDroppedKey: @(application.droppedCount - startDroppedCount),
+                  MRLocalNotificationSimulationLatencyKey: @{ @"total": @(totalLatency),
+                                                              @"maximum": @(maximumLatency) },
+                  MRLocalNotificationSimulationFacadeTimeKey: @(self.facadeNanoseconds),
+                  MRLocalNotificationSimulationCPUTimeKey: @(cpuNanoseconds) };
+    }
+    @finally {
+        [NSTimeZone setDefaultTimeZone:systemTimeZone];
+    }
+}
+
+#pragma mark Private
+
+- (void)mr_callFacade:(dispatch_block_t const)block
+{
+    MRLocalNotificationSimulatedApplication_ *const application = self.application;
+    uint64_t const applicationNanoseconds = application.nanoseconds;
+    uint64_t const startTime = mach_absolute_time();
+    block();
+    uint64_t const nanoseconds = MRNanosecondsSince_(startTime);
+    uint64_t const spentInApplication = application.nanoseconds - applicationNanoseconds;
+    self.facadeNanoseconds += (nanoseconds > spentInApplication ? nanoseconds - spentInApplication : 0);
+}
+
+@end
@@ -0,0 +1,872 @@
+// MRLocalNotificationBenchmarks.m
+//
+// Copyright (c) 2015 Héctor Marqués
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#import <XCTest/XCTest.h>
+#import <CoreLocation/CoreLocation.h>
+#import <mach/mach_time.h>
+#import <pthread.h>
+#import "MRLocalNotificationFacade.h"
+#import "MRTestApplication.h"
+
+
+// Each benchmark writes one JSON object per line to the standard output and,
+// if this variable names a file, appends the same lines to it.
+static NSString *const kMRBenchmarkOutputKey = @"MR_BENCHMARK_OUTPUT";
+// Comma separated list of scheduled notification counts; defaults to 1 to 10000.
+static NSString *const kMRBenchmarkSizesKey = @"MR_BENCHMARK_SIZES";
+// Seconds spent by each `scheduledLocalNotifications` call; defaults to 0.
+static NSString *const kMRBenchmarkFetchLatencyKey = @"MR_BENCHMARK_FETCH_LATENCY";
+// Number of events of the simulated workload; defaults to 1000000.
+static NSString *const kMRBenchmarkEventsKey = @"MR_BENCHMARK_EVENTS";
+
+
+// Hook of the allocation tools, declared in the private stack_logging.h of libmalloc.
+typedef void (MRBenchmarkMallocLogger_t)(uint32_t type, uintptr_t arg1, uintptr_t arg2, uintptr_t arg3,
+                                         uintptr_t result, uint32_t numHotFramesToSkip);
+extern MRBenchmarkMallocLogger_t *malloc_logger;
+static uint32_t const kMRBenchmarkMallocLogTypeAllocate = 2;
+
+
+#pragma mark - Functions -
+
+
+static double MRBenchmarkNanosecondsSince(uint64_t const startTime)
+{
+    static mach_timebase_info_data_t timebase;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        mach_timebase_info(&timebase);
+    });
+    uint64_t const elapsed = mach_absolute_time() - startTime;
+    return (double)elapsed * timebase.numer / timebase.denom;
+}
+
+static pthread_t MRBenchmarkAllocatingThread;
+static uint64_t MRBenchmarkAllocationCount;
+static MRBenchmarkMallocLogger_t *MRBenchmarkPreviousMallocLogger;
+
+static void MRBenchmarkMallocLogger(uint32_t const type, uintptr_t const arg1, uintptr_t const arg2, uintptr_t const arg3,
+                                    uintptr_t const result, uint32_t const numHotFramesToSkip)
+{
+    // Only allocations made by the measured thread are counted.
+    if ((type & kMRBenchmarkMallocLogTypeAllocate) && pthread_equal(pthread_self(), MRBenchmarkAllocatingThread)) {
+        __atomic_add_fetch(&MRBenchmarkAllocationCount, 1, __ATOMIC_RELAXED);
+    }
+    if (MRBenchmarkPreviousMallocLogger) {
+        MRBenchmarkPreviousMallocLogger(type, arg1, arg2, arg3, result, numHotFramesToSkip + 1);
+    }
+}
+
+static uint64_t MRBenchmarkCountAllocations(dispatch_block_t const block)
+{
+    NSCParameterAssert(block);
+    MRBenchmarkAllocatingThread = pthread_self();
+    MRBenchmarkPreviousMallocLogger = malloc_logger;
+    uint64_t const initialCount = __atomic_load_n(&MRBenchmarkAllocationCount, __ATOMIC_RELAXED);
+    malloc_logger = MRBenchmarkMallocLogger;
+    block();
+    malloc_logger = MRBenchmarkPreviousMallocLogger;
+    return __atomic_load_n(&MRBenchmarkAllocationCount, __ATOMIC_RELAXED) - initialCount;
+}
+
+static NSArray *MRBenchmarkSizes(void)
+{
+    NSString *const value = NSProcessInfo.processInfo.environment[kMRBenchmarkSizesKey];
+    if (value.length == 0) {
+        return @[ @1, @10, @100, @1000, @10000 ];
+    }
+    NSMutableArray *const sizes = NSMutableArray.array;
+    for (NSString *const component in [value componentsSeparatedByString:@","]) {
+        NSInteger const size = component.integerValue;
+        if (size > 0) {
+            [sizes addObject:@(size)];
+        }
+    }
+    return sizes;
+}
+
+static NSTimeInterval MRBenchmarkFetchLatency(void)
+{
+    return [NSProcessInfo.processInfo.environment[kMRBenchmarkFetchLatencyKey] doubleValue];
+}
+
+static NSUInteger MRBenchmarkEventCount(void)
+{
+    NSInteger const count = [NSProcessInfo.processInfo.environment[kMRBenchmarkEventsKey] integerValue];
+    return (count > 0 ? (NSUInteger)count : 1000000);
+}
+
+static void MRBenchmarkReport(NSString *const name, NSUInteger const size, NSUInteger const operations,
+                              double const nanoseconds, NSDictionary *const values)
+{
+    NSCParameterAssert(name);
+    NSMutableDictionary *const record = [NSMutableDictionary dictionaryWithDictionary:(values ?: @{})];
+    record[@"benchmark"] = name;
+    record[@"n"] = @(size);
+    record[@"operations"] = @(operations);
+    record[@"total_ns"] = @(nanoseconds);
+    record[@"ns_per_operation"] = @(operations > 0 ? nanoseconds / operations : 0);
+    record[@"fetch_latency"] = @(MRBenchmarkFetchLatency());
+    NSMutableData *const line = [[NSJSONSerialization dataWithJSONObject:record options:0 error:NULL] mutableCopy];
+    [line appendBytes:"\n" length:1];
+    @synchronized(kMRBenchmarkOutputKey) {
+        fwrite(line.bytes, 1, line.length, stdout);
+        fflush(stdout);
+        NSString *const path = NSProcessInfo.processInfo.environment[kMRBenchmarkOutputKey];
+        if (path.length > 0) {
+            NSFileManager *const fileManager = NSFileManager.defaultManager;
+            if (![fileManager fileExistsAtPath:path]) {
+                [fileManager createFileAtPath:path contents:nil attributes:nil];
+            }
+            NSFileHandle *const fileHandle = [NSFileHandle fileHandleForWritingAtPath:path];
+            [fileHandle seekToEndOfFile];
+            [fileHandle writeData:line];
+            [fileHandle closeFile];
+        }
+    }
+}
+
+
+#pragma mark - MRLocalNotificationBenchmarks -
+
+
+@interface MRLocalNotificationBenchmarks : XCTestCase
+@end
+
+
+@implementation MRLocalNotificationBenchmarks
+
+- (MRTestApplication *)applicationWithScheduledCount:(NSUInteger const)count
+{
+    MRTestApplication *const application = MRTestApplication.new;
+    [application addScheduledNotificationsWithCount:count identifiers:YES];
+    application.fetchLatency = MRBenchmarkFetchLatency();
+    [application resetCounters];
+    return application;
+}
+
+- (NSArray *)notificationsWithPrefix:(NSString *const)prefix count:(NSUInteger const)count
+{
+    NSMutableArray *const notifications = [NSMutableArray arrayWithCapacity:count];
+    for (NSUInteger index = 0; index < count; index++) {
+        NSString *const identifier = [NSString stringWithFormat:@"%@-%lu", prefix, (unsigned long)index];
+        [notifications addObject:MRTestNotification(identifier, 60*(index + 1))];
+    }
+    return notifications;
+}
+
+#pragma mark Scheduling
+
+- (void)testScheduleNotification
+{
+    NSUInteger const operations = 100;
+    for (NSNumber *const size in MRBenchmarkSizes()) {
+        MRTestApplication *const application = [self applicationWithScheduledCount:size.unsignedIntegerValue];
+        MRLocalNotificationFacade *const facade = MRTestFacadeWithApplication(application);
+        NSArray *const notifications = [self notificationsWithPrefix:@"scheduled" count:operations];
+        uint64_t const startTime = mach_absolute_time();
+        for (UILocalNotification *const notification in notifications) {
+            XCTAssertTrue([facade scheduleNotification:notification withError:NULL]);
+        }
+        double const nanoseconds = MRBenchmarkNanosecondsSince(startTime);
+        MRBenchmarkReport(@"scheduleNotification:withError:", size.unsignedIntegerValue, operations, nanoseconds,
+                          @{ @"fetches": @(application.fetchCount) });
+    }
+}
+
+- (void)testCanScheduleNotification
+{
+    NSUInteger const operations = 1000;
+    for (NSNumber *const size in MRBenchmarkSizes()) {
+        MRTestApplication *const application = [self applicationWithScheduledCount:size.unsignedIntegerValue];
+        MRLocalNotificationFacade *const facade = MRTestFacadeWithApplication(application);
+        UILocalNotification *const notification = MRTestNotification(@"candidate", 60);
+        uint64_t startTime = mach_absolute_time();
+        for (NSUInteger index = 0; index < operations; index++) {
+            XCTAssertTrue([facade canScheduleNotification:notification withRecovery:YES error:NULL]);
+        }
+        double nanoseconds = MRBenchmarkNanosecondsSince(startTime);
+        MRBenchmarkReport(@"canScheduleNotification:withRecovery:error:NULL", size.unsignedIntegerValue,
+                          operations, nanoseconds, @{ @"fetches": @(application.fetchCount) });
+        [application resetCounters];
+        startTime = mach_absolute_time();
+        for (NSUInteger index = 0; index < operations; index++) {
+            NSError *error;
+            XCTAssertTrue([facade canScheduleNotification:notification withRecovery:YES error:&error]);
+        }
+        nanoseconds = MRBenchmarkNanosecondsSince(startTime);
+        MRBenchmarkReport(@"canScheduleNotification:withRecovery:error:", size.unsignedIntegerValue,
+                          operations, nanoseconds, @{ @"fetches": @(application.fetchCount) });
+    }
+}
+
+- (void)testScheduledNotificationsContainsNotification
+{
+    NSUInteger const operations = 100;
+    for (NSNumber *const size in MRBenchmarkSizes()) {
+        MRTestApplication *const application = [self applicationWithScheduledCount:size.unsignedIntegerValue];
+        MRLocalNotificationFacade *const facade = MRTestFacadeWithApplication(application);
+        UILocalNotification *const identifiedNotification = MRTestNotification(@"existing-0", 3600);
+        UILocalNotification *const anonymousNotification = MRTestNotification(nil, 3600);
+        uint64_t startTime = mach_absolute_time();
+        for (NSUInteger index = 0; index < operations; index++) {
+            XCTAssertTrue([facade scheduledNotificationsContainsNotification:identifiedNotification]);
+        }
+        double nanoseconds = MRBenchmarkNanosecondsSince(startTime);
+        MRBenchmarkReport(@"scheduledNotificationsContainsNotification:identifier", size.unsignedIntegerValue,
+                          operations, nanoseconds, @{ @"fetches": @(application.fetchCount) });
+        [application resetCounters];
+        startTime = mach_absolute_time();
+        for (NSUInteger index = 0; index < operations; index++) {
+            XCTAssertFalse([facade scheduledNotificationsContainsNotification:anonymousNotification]);
+        }
+        nanoseconds = MRBenchmarkNanosecondsSince(startTime);
+        MRBenchmarkReport(@"scheduledNotificationsContainsNotification:equality", size.unsignedIntegerValue,
+                          operations, nanoseconds, @{ @"fetches": @(application.fetchCount) });
+    }
+}
+
+- (void)testCancelNotification
+{
+    NSUInteger const operations = 100;
+    for (NSNumber *const size in MRBenchmarkSizes()) {
+        MRTestApplication *const application = [self applicationWithScheduledCount:size.unsignedIntegerValue];
+        MRLocalNotificationFacade *const facade = MRTestFacadeWithApplication(application);
+        NSArray *const notifications = [self notificationsWithPrefix:@"cancelled" count:operations];
+        [facade scheduleNotifications:notifications errors:NULL];
+        [application resetCounters];
+        uint64_t const startTime = mach_absolute_time();
+        for (UILocalNotification *const notification in notifications) {
+            [facade cancelNotification:notification];
+        }
+        double const nanoseconds = MRBenchmarkNanosecondsSince(startTime);
+        XCTAssertEqual(application.cancelCount, operations);
+        MRBenchmarkReport(@"cancelNotification:", size.unsignedIntegerValue, operations, nanoseconds,
+                          @{ @"fetches": @(application.fetchCount) });
+    }
+}
+
+#pragma mark Journal
+
+- (void)testJournalReplay
+{
+    for (NSNumber *const size in MRBenchmarkSizes()) {
+        NSUInteger const count = size.unsignedIntegerValue;
+        NSString *const path = [NSTemporaryDirectory() stringByAppendingPathComponent:NSUUID.UUID.UUIDString];
+        NSURL *const directoryURL = [NSURL fileURLWithPath:path isDirectory:YES];
+        MRTestApplication *const application = [self applicationWithScheduledCount:0];
+        @autoreleasepool {
+            MRLocalNotificationFacade *const facade = MRTestFacadeWithApplication(application);
+            facade.journalDirectoryURL = directoryURL;
+            [facade scheduleNotifications:[self notificationsWithPrefix:@"journaled" count:count] errors:NULL];
+            XCTAssertEqual(facade.journaledNotifications.count, count);
+        }
+
+        MRLocalNotificationFacade *const journalFacade = MRTestFacadeWithApplication(application);
+        [application resetCounters];
+        uint64_t startTime = mach_absolute_time();
+        journalFacade.journalDirectoryURL = directoryURL;
+        NSArray *notifications = journalFacade.journaledNotifications;
+        double nanoseconds = MRBenchmarkNanosecondsSince(startTime);
+        XCTAssertEqual(notifications.count, count);
+        MRBenchmarkReport(@"journaledNotifications", count, 1, nanoseconds,
+                          @{ @"fetches": @(application.fetchCount) });
+
+        MRLocalNotificationFacade *const applicationFacade = MRTestFacadeWithApplication(application);
+        [application resetCounters];
+        startTime = mach_absolute_time();
+        notifications = applicationFacade.scheduledNotifications;
+        nanoseconds = MRBenchmarkNanosecondsSince(startTime);
+        XCTAssertEqual(notifications.count, count);
+        MRBenchmarkReport(@"scheduledNotifications", count, 1, nanoseconds,
+                          @{ @"fetches": @(application.fetchCount) });
+        [NSFileManager.defaultManager removeItemAtURL:directoryURL error:NULL];
+    }
+}
+
+#pragma mark Action handlers
+
+- (void)testActionHandlerContention
+{
+    NSUInteger const operations = 100;
+    NSUInteger const threadCount = 8;
+    UILocalNotification *const notification = MRTestNotification(@"action", 60);
+    notification.category = @"message";
+    for (NSNumber *const size in MRBenchmarkSizes()) {
+        NSUInteger const count = size.unsignedIntegerValue;
+        MRLocalNotificationFacade *const facade = MRTestFacadeWithApplication(MRTestApplication.new);
+        for (NSUInteger index = 0; index < count; index++) {
+            NSString *const identifier = [NSString stringWithFormat:@"action-%lu", (unsigned long)index];
+            [facade addNotificationHandler:^(NSString *const actionIdentifier, UILocalNotification *const actionNotification) {
+            } forActionWithIdentifier:identifier];
+        }
+        [facade addNotificationHandler:^(NSString *const actionIdentifier, UILocalNotification *const actionNotification) {
+        } forActionWithIdentifier:@"open"];
+
+        uint64_t const startTime = mach_absolute_time();
+        for (NSUInteger index = 0; index < operations; index++) {
+            [facade handleActionWithIdentifier:@"open" forLocalNotification:notification completionHandler:nil];
+        }
+        MRBenchmarkReport(@"handleActionWithIdentifier:uncontended", count, operations,
+                          MRBenchmarkNanosecondsSince(startTime), nil);
+
+        // Half of the threads register and remove handlers while the other half dispatch actions.
+        __block uint64_t registrationNanoseconds = 0;
+        __block uint64_t dispatchNanoseconds = 0;
+        dispatch_apply(threadCount, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t const iteration) {
+            BOOL const registers = (iteration % 2 == 0);
+            uint64_t const threadStartTime = mach_absolute_time();
+            for (NSUInteger index = 0; index < operations; index++) {
+                if (registers) {
+                    id<NSObject> const token = [facade addNotificationHandler:^(NSString *const actionIdentifier, UILocalNotification *const actionNotification) {
+                    } forActionWithIdentifier:nil category:@"message"];
+                    [facade removeNotificationHandler:token];
+                } else {
+                    [facade handleActionWithIdentifier:@"open" forLocalNotification:notification completionHandler:nil];
+                }
+            }
+            uint64_t const nanoseconds = (uint64_t)MRBenchmarkNanosecondsSince(threadStartTime);
+            __atomic_add_fetch((registers ? &registrationNanoseconds : &dispatchNanoseconds), nanoseconds, __ATOMIC_RELAXED);
+        });
+        MRBenchmarkReport(@"handleActionWithIdentifier:contended", count, operations*threadCount/2,
+                          dispatchNanoseconds, @{ @"threads": @(threadCount/2) });
+        MRBenchmarkReport(@"addNotificationHandler:removeNotificationHandler:contended", count,
+                          operations*threadCount/2, registrationNanoseconds, @{ @"threads": @(threadCount/2) });
+    }
+}
+
+#pragma mark Automatic badges
+
+- (void)testAutomaticBadgeInsertion
+{
+    NSUInteger const operations = 10;
+    for (NSNumber *const size in MRBenchmarkSizes()) {
+        NSUInteger const count = size.unsignedIntegerValue;
+        MRTestApplication *const application = [self applicationWithScheduledCount:0];
+        MRLocalNotificationFacade *const facade = MRTestFacadeWithApplication(application);
+        facade.automaticBadges = YES;
+        NSMutableArray *const notifications = [NSMutableArray arrayWithCapacity:count];
+        for (NSUInteger index = 0; index < count; index++) {
+            NSString *const identifier = [NSString stringWithFormat:@"badged-%lu", (unsigned long)index];
+            [notifications addObject:MRTestNotification(identifier, 3600 + 60*index)];
+        }
+        [facade scheduleNotifications:notifications errors:NULL];
+
+        // Appending only badges the new notification.
+        [application resetCounters];
+        uint64_t startTime = mach_absolute_time();
+        for (NSUInteger index = 0; index < operations; index++) {
+            NSString *const identifier = [NSString stringWithFormat:@"last-%lu", (unsigned long)index];
+            [facade scheduleNotification:MRTestNotification(identifier, 3600 + 60*(count + index)) withError:NULL];
+        }
+        double nanoseconds = MRBenchmarkNanosecondsSince(startTime);
+        MRBenchmarkReport(@"automaticBadges:scheduleNotification:last", count, operations, nanoseconds,
+                          @{ @"rescheduled": @(application.scheduleCount - operations) });
+
+        // Inserting first changes the badge of every pending notification.
+        if (count > 1000) {
+            continue;
+        }
+        [application resetCounters];
+        startTime = mach_absolute_time();
+        for (NSUInteger index = 0; index < operations; index++) {
+            NSString *const identifier = [NSString stringWithFormat:@"first-%lu", (unsigned long)index];
+            [facade scheduleNotification:MRTestNotification(identifier, 3600 - 60*(index + 1)) withError:NULL];
+        }
+        nanoseconds = MRBenchmarkNanosecondsSince(startTime);
+        MRBenchmarkReport(@"automaticBadges:scheduleNotification:first", count, operations, nanoseconds,
+                          @{ @"rescheduled": @(application.scheduleCount - operations) });
+    }
+}
+
+#pragma mark Region pool
+
+- (void)testRegionPool
+{
+    NSUInteger const moves = 100;
+    for (NSNumber *const size in @[ @1000, @10000, @100000 ]) {
+        NSUInteger const count = size.unsignedIntegerValue;
+        MRTestApplication *const application = [self applicationWithScheduledCount:0];
+        MRLocalNotificationFacade *const facade = MRTestFacadeWithApplication(application);
+        NSMutableArray *const notifications = [NSMutableArray arrayWithCapacity:count];
+        uint64_t state = 88172645463325252ull;
+        for (NSUInteger index = 0; index < count; index++) {
+            double random[3];
+            for (NSUInteger component = 0; component < 3; component++) {
+                state ^= state << 13;
+                state ^= state >> 7;
+                state ^= state << 17;
+                random[component] = (double)(state >> 11)/(double)(1ull << 53);
+            }
+            // Store locations spread over a 10 by 10 degrees area.
+            CLLocationCoordinate2D const center = CLLocationCoordinate2DMake(36 + 10*random[0], -5 + 10*random[1]);
+            NSString *const identifier = [NSString stringWithFormat:@"store-%lu", (unsigned long)index];
+            CLCircularRegion *const region = [[CLCircularRegion alloc] initWithCenter:center
+                                                                                radius:100 + 400*random[2]
+                                                                            identifier:identifier];
+            UILocalNotification *const notification = [facade buildNotificationWithRegion:region
+                                                                              triggersOnce:NO
+                                                                                  category:nil
+                                                                                  userInfo:@{ MRLocalNotificationIdentifierKey: identifier }];
+            notification.alertBody = @"store nearby";
+            [notifications addObject:notification];
+        }
+
+        uint64_t startTime = mach_absolute_time();
+        for (UILocalNotification *const notification in notifications) {
+            [facade addNotificationToRegionPool:notification error:NULL];
+        }
+        MRBenchmarkReport(@"addNotificationToRegionPool:error:", count, count,
+                          MRBenchmarkNanosecondsSince(startTime), nil);
+
+        // A trip across the area in steps of about 1 km.
+        [application resetCounters];
+        startTime = mach_absolute_time();
+        for (NSUInteger index = 0; index < moves; index++) {
+            CLLocation *const location = [[CLLocation alloc] initWithLatitude:40 + 0.009*index
+                                                                    longitude:-1 + 0.009*index];
+            NSArray *const identifiers = [facade updateRegionPoolWithLocation:location];
+            XCTAssertEqual(identifiers.count, MIN(count, facade.maximumRegionNotifications));
+        }
+        MRBenchmarkReport(@"updateRegionPoolWithLocation:", count, moves, MRBenchmarkNanosecondsSince(startTime),
+                          @{ @"scheduled": @(application.scheduleCount),
+                             @"cancelled": @(application.cancelCount) });
+    }
+}
+
+#pragma mark Simulation
+
+- (void)testSimulatedWorkload
+{
+    NSUInteger const count = MRBenchmarkEventCount();
+    NSTimeInterval const step = 15;
+    NSUInteger const timeZoneChangeStep = (NSUInteger)(30*86400/step);
+    NSArray *const timeZones = @[ [NSTimeZone timeZoneWithName:@"America/New_York"],
+                                  [NSTimeZone timeZoneWithName:@"Asia/Tokyo"],
+                                  [NSTimeZone timeZoneWithName:@"Europe/Madrid"] ];
+    MRLocalNotificationFacade *const facade = MRTestFacadeWithApplication(MRTestApplication.new);
+    NSDate *const startDate = [NSDate dateWithTimeIntervalSinceReferenceDate:MRTestReferenceTime];
+    MRLocalNotificationSimulator *const simulator = [[MRLocalNotificationSimulator alloc] initWithFacade:facade
+                                                                                               startDate:startDate];
+    // Deterministic workload: six schedules out of ten, a daily reminder every 10000 events,
+    // cancellations of recent notifications and a time zone change every 30 days.
+    uint64_t startTime = mach_absolute_time();
+    uint64_t state = 88172645463325252ull;
+    for (NSUInteger index = 0; index < count; index++) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        NSTimeInterval const time = MRTestReferenceTime + step*index;
+        NSDate *const date = [NSDate dateWithTimeIntervalSinceReferenceDate:time];
+        if (index > 0 && index%timeZoneChangeStep == 0) {
+            [simulator addTimeZoneChangeAtDate:date timeZone:timeZones[(index/timeZoneChangeStep)%timeZones.count]];
+        }
+        if (index == 0 || state%10 < 6) {
+            NSString *const identifier = [NSString stringWithFormat:@"event-%lu", (unsigned long)index];
+            NSTimeInterval const delay = 3600 + (NSTimeInterval)((state >> 8)%(47*3600));
+            BOOL const repeats = (index%10000 == 0);
+            [simulator addEventAtDate:date block:^(MRLocalNotificationFacade *const simulatedFacade) {
+                UILocalNotification *const notification = MRTestNotification(identifier, 0);
+                notification.fireDate = [NSDate dateWithTimeIntervalSinceReferenceDate:time + delay];
+                notification.repeatInterval = (repeats ? NSCalendarUnitDay : 0);
+                [simulatedFacade scheduleNotification:notification withError:NULL];
+            }];
+        } else {
+            NSUInteger const cancelledIndex = index - 1 - (NSUInteger)((state >> 8)%MIN(index, 1000));
+            NSString *const identifier = [NSString stringWithFormat:@"event-%lu", (unsigned long)cancelledIndex];
+            [simulator addEventAtDate:date block:^(MRLocalNotificationFacade *const simulatedFacade) {
+                UILocalNotification *const notification = [simulatedFacade scheduledNotificationWithIdentifier:identifier];
+                if (notification) {
+                    [simulatedFacade cancelNotification:notification];
+                }
+            }];
+        }
+    }
+    MRBenchmarkReport(@"MRLocalNotificationSimulator:addEventAtDate:block:", count, count,
+                      MRBenchmarkNanosecondsSince(startTime), nil);
+
+    NSDate *const endDate = [NSDate dateWithTimeIntervalSinceReferenceDate:MRTestReferenceTime + step*count + 2*86400];
+    startTime = mach_absolute_time();
+    NSDictionary *const report = [simulator runUntilDate:endDate];
+    double const nanoseconds = MRBenchmarkNanosecondsSince(startTime);
+    XCTAssertEqualObjects(report[MRLocalNotificationSimulationEventsKey], @(count));
+    MRBenchmarkReport(@"MRLocalNotificationSimulator:runUntilDate:", count, count, nanoseconds, report);
+}
+
+#pragma mark Error codes
+
+- (void)testErrorCodePaths
+{
+    NSUInteger const operations = 1000;
+    for (NSNumber *const size in MRBenchmarkSizes()) {
+        MRTestApplication *const application = [self applicationWithScheduledCount:size.unsignedIntegerValue];
+        MRLocalNotificationFacade *const facade = MRTestFacadeWithApplication(application);
+        UILocalNotification *const missingDateNotification = MRTestNotification(@"missing-date", 60);
+        missingDateNotification.fireDate = nil;
+        NSDictionary *const notificationsByName = @{ @"invalidDate": MRTestNotification(@"past", -MRTestReferenceTime),
+                                                     @"missingDate": missingDateNotification,
+                                                     @"alreadyScheduled": MRTestNotification(@"existing-0", 3600) };
+        for (NSString *const name in notificationsByName) {
+            UILocalNotification *const notification = notificationsByName[name];
+            [application resetCounters];
+            uint64_t const startTime = mach_absolute_time();
+            for (NSUInteger index = 0; index < operations; index++) {
+                MRLocalNotificationErrorCode code = 0;
+                XCTAssertFalse([facade canScheduleNotification:notification withRecovery:NO errorCode:&code]);
+            }
+            double const nanoseconds = MRBenchmarkNanosecondsSince(startTime);
+            NSString *const benchmark = [@"canScheduleNotification:withRecovery:errorCode:" stringByAppendingString:name];
+            MRBenchmarkReport(benchmark, size.unsignedIntegerValue, operations, nanoseconds,
+                              @{ @"fetches": @(application.fetchCount) });
+        }
+    }
+}
+
+#pragma mark Recurrence
+
+- (void)testRecurrenceExpansion
+{
+    NSUInteger const occurrences = 30;
+    MRLocalNotificationFacade *const facade = MRTestFacadeWithApplication(MRTestApplication.new);
+    NSCalendar *const calendar = [[NSCalendar alloc] initWithCalendarIdentifier:NSCalendarIdentifierGregorian];
+    calendar.timeZone = [NSTimeZone timeZoneWithName:@"America/New_York"];
+    NSDate *const startDate = [NSDate dateWithTimeIntervalSinceReferenceDate:MRTestReferenceTime + 180*86400.0];
+    NSDate *const endDate = NSDate.distantFuture;
+    for (NSNumber *const size in MRBenchmarkSizes()) {
+        NSUInteger const count = size.unsignedIntegerValue;
+        NSMutableArray *const notifications = [NSMutableArray arrayWithCapacity:count];
+        for (NSUInteger index = 0; index < count; index++) {
+            UILocalNotification *const notification = MRTestNotification(nil, 60*(index + 1));
+            notification.repeatCalendar = calendar;
+            notification.repeatInterval = NSCalendarUnitDay;
+            [notifications addObject:notification];
+        }
+
+        uint64_t startTime = mach_absolute_time();
+        NSArray *const fireDates = [facade getFireDatesFromNotifications:notifications
+                                                                   after:startDate
+                                                                  before:endDate
+                                                                   limit:occurrences];
+        double nanoseconds = MRBenchmarkNanosecondsSince(startTime);
+        XCTAssertEqual([fireDates.lastObject count], occurrences);
+        MRBenchmarkReport(@"getFireDatesFromNotifications:after:before:limit:", count, count*occurrences,
+                          nanoseconds, nil);
+
+        // Baseline: one NSCalendar step per occurrence, from the first fire date.
+        startTime = mach_absolute_time();
+        for (UILocalNotification *const notification in notifications) {
+            NSMutableArray *const dates = [NSMutableArray arrayWithCapacity:occurrences];
+            NSDate *const fireDate = notification.fireDate;
+            for (NSInteger step = 0; dates.count < occurrences; step++) {
+                NSDate *const date = [calendar dateByAddingUnit:NSCalendarUnitDay value:step toDate:fireDate options:0];
+                if ([date compare:startDate] != NSOrderedAscending) {
+                    [dates addObject:date];
+                }
+            }
+        }
+        nanoseconds = MRBenchmarkNanosecondsSince(startTime);
+        MRBenchmarkReport(@"NSCalendar:dateByAddingUnit:value:toDate:options:", count, count*occurrences,
+                          nanoseconds, nil);
+    }
+}
+
+#pragma mark Allocations
+
+- (void)testValidationAllocations
+{
+    NSUInteger const operations = 1000;
+    MRTestApplication *const application = [self applicationWithScheduledCount:1];
+    MRLocalNotificationFacade *const facade = MRTestFacadeWithApplication(application);
+    facade.contactSupportURL = [NSURL URLWithString:@"mailto:support@example.com"];
+    UILocalNotification *const notification = MRTestNotification(@"past", -60);
+    [facade canScheduleNotification:notification withRecovery:NO errorCode:NULL];
+    __block uint64_t startTime = 0;
+    __block double nanoseconds = 0;
+    uint64_t allocations = MRBenchmarkCountAllocations(^{
+        startTime = mach_absolute_time();
+        for (NSUInteger index = 0; index < operations; index++) {
+            MRLocalNotificationErrorCode code = 0;
+            [facade canScheduleNotification:notification withRecovery:NO errorCode:&code];
+        }
+        nanoseconds = MRBenchmarkNanosecondsSince(startTime);
+    });
+    MRBenchmarkReport(@"allocations:canScheduleNotification:withRecovery:errorCode:", 1, operations, nanoseconds,
+                      @{ @"allocations_per_operation": @((double)allocations / operations) });
+    allocations = MRBenchmarkCountAllocations(^{
+        startTime = mach_absolute_time();
+        for (NSUInteger index = 0; index < operations; index++) {
+            [facade canScheduleNotification:notification withRecovery:NO error:NULL];
+        }
+        nanoseconds = MRBenchmarkNanosecondsSince(startTime);
+    });
+    MRBenchmarkReport(@"allocations:canScheduleNotification:withRecovery:error:NULL", 1, operations, nanoseconds,
+                      @{ @"allocations_per_operation": @((double)allocations / operations) });
+    allocations = MRBenchmarkCountAllocations(^{
+        startTime = mach_absolute_time();
+        for (NSUInteger index = 0; index < operations; index++) {
+            @autoreleasepool {
+                NSError *error;
+                [facade canScheduleNotification:notification withRecovery:NO error:&error];
+            }
+        }
+        nanoseconds = MRBenchmarkNanosecondsSince(startTime);
+    });
+    MRBenchmarkReport(@"allocations:canScheduleNotification:withRecovery:error:", 1, operations, nanoseconds,
+                      @{ @"allocations_per_operation": @((double)allocations / operations) });
+}
+
+- (void)testTemplateAllocations
+{
+    MRLocalNotificationFacade *const facade = MRTestFacadeWithApplication(MRTestApplication.new);
+    facade.defaultSoundName = UILocalNotificationDefaultSoundName;
+    NSDictionary *const userInfo = @{ @"list": @"groceries" };
+    UILocalNotification *const prototype = [facade buildNotificationWithDate:NSDate.distantFuture
+                                                                    timeZone:NO
+                                                                    category:@"reminder"
+                                                                    userInfo:userInfo];
+    [facade customizeNotificationAlert:prototype title:@"Reminder" body:@"Buy milk" action:@"Open" launchImage:nil];
+    [facade customizeNotification:prototype appIconBadge:1 sound:YES];
+    [facade customizeNotificationRepeat:prototype interval:NSCalendarUnitWeekOfYear];
+    MRLocalNotificationTemplate *const notificationTemplate = [facade buildTemplateWithNotification:prototype
+                                                                                      badgeIncrement:1
+                                                                                               error:NULL];
+    for (NSNumber *const size in MRBenchmarkSizes()) {
+        NSUInteger const count = size.unsignedIntegerValue;
+        NSMutableArray *const fireDates = [NSMutableArray arrayWithCapacity:count];
+        for (NSUInteger index = 0; index < count; index++) {
+            [fireDates addObject:[NSDate dateWithTimeIntervalSinceReferenceDate:MRTestReferenceTime + 60*(index + 1)]];
+        }
+        __block uint64_t startTime = 0;
+        __block double nanoseconds = 0;
+        uint64_t allocations = MRBenchmarkCountAllocations(^{
+            @autoreleasepool {
+                startTime = mach_absolute_time();
+                NSArray *const notifications = [facade buildNotificationsWithTemplate:notificationTemplate
+                                                                            fireDates:fireDates];
+                nanoseconds = MRBenchmarkNanosecondsSince(startTime);
+                XCTAssertEqual(notifications.count, count);
+            }
+        });
+        MRBenchmarkReport(@"allocations:buildNotificationsWithTemplate:fireDates:", count, count, nanoseconds,
+                          @{ @"allocations_per_operation": @((double)allocations / count) });
+
+        allocations = MRBenchmarkCountAllocations(^{
+            @autoreleasepool {
+                startTime = mach_absolute_time();
+                NSMutableArray *const notifications = [NSMutableArray arrayWithCapacity:count];
+                NSInteger badgeNumber = 1;
+                for (NSDate *const fireDate in fireDates) {
+                    UILocalNotification *const notification = [facade buildNotificationWithDate:fireDate
+                                                                                       timeZone:NO
+                                                                                       category:@"reminder"
+                                                                                       userInfo:userInfo];
+                    [facade customizeNotificationAlert:notification title:@"Reminder" body:@"Buy milk" action:@"Open" launchImage:nil];
+                    [facade customizeNotification:notification appIconBadge:badgeNumber sound:YES];
+                    [facade customizeNotificationRepeat:notification interval:NSCalendarUnitWeekOfYear];
+                    [notifications addObject:notification];
+                    badgeNumber += 1;
+                }
+                nanoseconds = MRBenchmarkNanosecondsSince(startTime);
+            }
+        });
+        MRBenchmarkReport(@"allocations:buildNotificationWithDate:customize", count, count, nanoseconds,
+                          @{ @"allocations_per_operation": @((double)allocations / count) });
+    }
+}
+
+#pragma mark Dates
+
+- (void)testDateHelpers
+{
+    MRLocalNotificationFacade *const facade = MRTestFacadeWithApplication(MRTestApplication.new);
+    for (NSNumber *const size in MRBenchmarkSizes()) {
+        NSUInteger const count = size.unsignedIntegerValue;
+        NSMutableData *const intervalsData = [NSMutableData dataWithLength:count*sizeof(NSTimeInterval)];
+        NSMutableData *const componentsData = [NSMutableData dataWithLength:count*sizeof(MRLocalNotificationDateComponents)];
+        NSTimeInterval *const timeIntervals = intervalsData.mutableBytes;
+        MRLocalNotificationDateComponents *const components = componentsData.mutableBytes;
+        for (NSUInteger index = 0; index < count; index++) {
+            timeIntervals[index] = MRTestReferenceTime + 3637.0*index;
+        }
+
+        uint64_t startTime = mach_absolute_time();
+        [facade getComponents:components fromTimeIntervals:timeIntervals count:count];
+        MRBenchmarkReport(@"getComponents:fromTimeIntervals:count:", count, count,
+                          MRBenchmarkNanosecondsSince(startTime), nil);
+
+        startTime = mach_absolute_time();
+        [facade buildTimeIntervals:timeIntervals fromComponents:components count:count];
+        MRBenchmarkReport(@"buildTimeIntervals:fromComponents:count:", count, count,
+                          MRBenchmarkNanosecondsSince(startTime), nil);
+
+        startTime = mach_absolute_time();
+        for (NSUInteger index = 0; index < count; index++) {
+            NSDate *const date = [NSDate dateWithTimeIntervalSinceReferenceDate:timeIntervals[index]];
+            NSInteger day, month, year, hour, minute, second;
+            [facade date:date getDay:&day month:&month year:&year hour:&hour minute:&minute second:&second];
+        }
+        MRBenchmarkReport(@"date:getDay:month:year:hour:minute:second:", count, count,
+                          MRBenchmarkNanosecondsSince(startTime), nil);
+
+        startTime = mach_absolute_time();
+        for (NSUInteger index = 0; index < count; index++) {
+            MRLocalNotificationDateComponents const dateComponents = components[index];
+            NSDate *const date = [facade buildDateWithDay:dateComponents.day
+                                                    month:dateComponents.month
+                                                     year:dateComponents.year
+                                                     hour:dateComponents.hour
+                                                   minute:dateComponents.minute
+                                                   second:dateComponents.second];
+            XCTAssertNotNil(date);
+        }
+        MRBenchmarkReport(@"buildDateWithDay:month:year:hour:minute:second:", count, count,
+                          MRBenchmarkNanosecondsSince(startTime), nil);
+
+        startTime = mach_absolute_time();
+        for (NSUInteger index = 0; index < count; index++) {
+            NSDate *const date = [NSDate dateWithTimeIntervalSinceReferenceDate:timeIntervals[index]];
+            [facade convertDateToGMT:[facade convertDateToDefaultTimeZone:date]];
+        }
+        MRBenchmarkReport(@"convertDateToDefaultTimeZone:convertDateToGMT:", count, count,
+                          MRBenchmarkNanosecondsSince(startTime), nil);
+    }
+}
+
+- (void)testDateThroughput
+{
+    NSUInteger const count = 100000;
+    NSUInteger const threadCount = 4;
+    NSTimeZone *const timeZone = [NSTimeZone timeZoneWithName:@"America/New_York"];
+    NSCalendar *const calendar = [[NSCalendar alloc] initWithCalendarIdentifier:NSCalendarIdentifierGregorian];
+    calendar.timeZone = timeZone;
+    MRLocalNotificationFacade *const facade = MRTestFacadeWithApplication(MRTestApplication.new);
+    facade.defaultCalendar = calendar;
+    facade.defaultTimeZone = timeZone;
+    NSMutableData *const intervalsData = [NSMutableData dataWithLength:count*sizeof(NSTimeInterval)];
+    NSMutableData *const componentsData = [NSMutableData dataWithLength:count*sizeof(MRLocalNotificationDateComponents)];
+    NSTimeInterval *const timeIntervals = intervalsData.mutableBytes;
+    MRLocalNotificationDateComponents *const components = componentsData.mutableBytes;
+    for (NSUInteger index = 0; index < count; index++) {
+        timeIntervals[index] = MRTestReferenceTime + 3637.0*index;
+    }
+    [facade getComponents:components fromTimeIntervals:timeIntervals count:count];
+
+    uint64_t startTime = mach_absolute_time();
+    dispatch_apply(threadCount, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t const iteration) {
+        NSMutableData *const builtData = [NSMutableData dataWithLength:count*sizeof(NSTimeInterval)];
+        NSMutableData *const decomposedData = [NSMutableData dataWithLength:count*sizeof(MRLocalNotificationDateComponents)];
+        [facade buildTimeIntervals:builtData.mutableBytes fromComponents:components count:count];
+        [facade getComponents:decomposedData.mutableBytes fromTimeIntervals:builtData.mutableBytes count:count];
+    });
+    double nanoseconds = MRBenchmarkNanosecondsSince(startTime);
+    MRBenchmarkReport(@"throughput:buildTimeIntervals:getComponents:", count, 2*count*threadCount, nanoseconds,
+                      @{ @"threads": @(threadCount) });
+
+    startTime = mach_absolute_time();
+    dispatch_apply(threadCount, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t const iteration) {
+        NSCalendar *const threadCalendar = calendar.copy;
+        NSCalendarUnit const units = (NSCalendarUnitYear | NSCalendarUnitMonth | NSCalendarUnitDay |
+                                      NSCalendarUnitHour | NSCalendarUnitMinute | NSCalendarUnitSecond);
+        for (NSUInteger index = 0; index < count; index++) {
+            @autoreleasepool {
+                NSDateComponents *const dateComponents = [[NSDateComponents alloc] init];
+                dateComponents.year = components[index].year;
+                dateComponents.month = components[index].month;
+                dateComponents.day = components[index].day;
+                dateComponents.hour = components[index].hour;
+                dateComponents.minute = components[index].minute;
+                dateComponents.second = components[index].second;
+                NSDate *const date = [threadCalendar dateFromComponents:dateComponents];
+                [threadCalendar components:units fromDate:date];
+            }
+        }
+    });
+    nanoseconds = MRBenchmarkNanosecondsSince(startTime);
+    MRBenchmarkReport(@"throughput:NSCalendar:dateFromComponents:components:fromDate:", count, 2*count*threadCount,
+                      nanoseconds, @{ @"threads": @(threadCount) });
+}
+
+#pragma mark Startup
+
+- (void)testStartupCosts
+{
+    NSUInteger const operations = 1000;
+    MRTestApplication *const application = MRTestApplication.new;
+    NSMutableDictionary *const startupCosts = NSMutableDictionary.dictionary;
+    double nanoseconds = 0;
+    for (NSUInteger index = 0; index < operations; index++) {
+        @autoreleasepool {
+            uint64_t const startTime = mach_absolute_time();
+            MRLocalNotificationFacade *const facade = [[MRLocalNotificationFacade alloc] init];
+            facade.defaultApplication = (UIApplication *)application;
+            [facade hasRegisteredNotifications];
+            [facade isRegisteredForNotifications];
+            [facade defaultTimeZone];
+            [facade defaultCalendar];
+            nanoseconds += MRBenchmarkNanosecondsSince(startTime);
+            facade.instrumentationEnabled = YES;
+            NSDictionary *const costs = facade.metricsSnapshot[MRLocalNotificationMetricsStartupKey];
+            for (NSString *const name in costs) {
+                startupCosts[name] = @([startupCosts[name] doubleValue] + [costs[name] doubleValue]/operations);
+            }
+        }
+    }
+    MRBenchmarkReport(@"init:firstResolution", 0, operations, nanoseconds, startupCosts);
+}
+
+- (void)testLaunchNotificationHandling
+{
+    NSUInteger const operations = 1000;
+    MRTestApplication *const application = MRTestApplication.new;
+    UILocalNotification *const notification = MRTestNotification(@"launch", 60);
+    NSDictionary *const launchOptions = @{ UIApplicationLaunchOptionsLocalNotificationKey: notification };
+    uint64_t startTime = mach_absolute_time();
+    for (NSUInteger index = 0; index < operations; index++) {
+        @autoreleasepool {
+            MRLocalNotificationFacade *const facade = MRTestFacadeWithApplication(application);
+            [facade handleDidReceiveLocalNotification:[facade getNotificationFromLaunchOptions:launchOptions]];
+        }
+    }
+    double nanoseconds = MRBenchmarkNanosecondsSince(startTime);
+    MRBenchmarkReport(@"launch:handleDidReceiveLocalNotification:", 0, operations, nanoseconds, @{});
+
+    MRLocalNotificationFacade *const defaultInstance = MRLocalNotificationFacade.defaultInstance;
+    defaultInstance.defaultApplication = (UIApplication *)application;
+    startTime = mach_absolute_time();
+    for (NSUInteger index = 0; index < operations; index++) {
+        XCTAssertEqual([MRLocalNotificationFacade deferHandlingOfNotificationFromLaunchOptions:launchOptions],
+                       notification);
+    }
+    nanoseconds = MRBenchmarkNanosecondsSince(startTime);
+    // The main queue is serial, so this runs after every deferred notification has been handled.
+    XCTestExpectation *const expectation = [self expectationWithDescription:@"handled"];
+    dispatch_async(dispatch_get_main_queue(), ^{
+        [expectation fulfill];
+    });
+    [self waitForExpectationsWithTimeout:60 handler:nil];
+    double const handlingNanoseconds = MRBenchmarkNanosecondsSince(startTime);
+    defaultInstance.defaultApplication = nil;
+    MRBenchmarkReport(@"launch:deferHandlingOfNotificationFromLaunchOptions:", 0, operations, nanoseconds,
+                      @{ @"handlingNanoseconds": @(handlingNanoseconds) });
+}
+
+@end
@@ -0,0 +1,417 @@
+// MRLocalNotificationDateTests.m
+//
+// Copyright (c) 2015 Héctor Marqués
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#import <XCTest/XCTest.h>
+#import "MRLocalNotificationFacade.h"
+#import "MRTestApplication.h"
+
+
+@interface MRLocalNotificationDateTests : XCTestCase
+@property (nonatomic, strong) MRTestApplication *application;
+@property (nonatomic, strong) MRLocalNotificationFacade *facade;
+@end
+
+
+@implementation MRLocalNotificationDateTests
+
+- (void)setUp
+{
+    [super setUp];
+    self.application = MRTestApplication.new;
+    self.facade = MRTestFacadeWithApplication(self.application);
+}
+
+- (void)tearDown
+{
+    self.facade = nil;
+    self.application = nil;
+    [super tearDown];
+}
+
+- (NSArray *)timeZones
+{
+    NSArray *const names = @[ @"Europe/Madrid",
+                              @"America/New_York",
+                              @"America/Sao_Paulo",
+                              @"Australia/Lord_Howe",
+                              @"Pacific/Apia",
+                              @"Asia/Tehran" ];
+    NSMutableArray *const timeZones = [NSMutableArray arrayWithCapacity:names.count];
+    for (NSString *const name in names) {
+        NSTimeZone *const timeZone = [NSTimeZone timeZoneWithName:name];
+        XCTAssertNotNil(timeZone, @"%@", name);
+        if (timeZone) {
+            [timeZones addObject:timeZone];
+        }
+    }
+    return timeZones;
+}
+
+- (NSArray *)transitionTimesOfTimeZone:(NSTimeZone *const)timeZone
+{
+    NSDate *const endDate = [NSDate dateWithTimeIntervalSinceReferenceDate:MRTestReferenceTime + 70*365*86400.0];
+    NSMutableArray *const times = NSMutableArray.array;
+    NSDate *date = [timeZone nextDaylightSavingTimeTransitionAfterDate:[NSDate dateWithTimeIntervalSince1970:0]];
+    while (date && [date compare:endDate] == NSOrderedAscending) {
+        [times addObject:@(date.timeIntervalSinceReferenceDate)];
+        date = [timeZone nextDaylightSavingTimeTransitionAfterDate:date];
+    }
+    return times;
+}
+
+#pragma mark Transition table
+
+- (void)testConversionToDefaultTimeZoneAroundTransitions
+{
+    NSTimeInterval const deltas[] = { -3601, -1, 0, 1, 3599, 3600 };
+    NSUInteger const deltaCount = sizeof(deltas)/sizeof(deltas[0]);
+    for (NSTimeZone *const timeZone in self.timeZones) {
+        self.facade.defaultTimeZone = timeZone;
+        for (NSNumber *const transitionTime in [self transitionTimesOfTimeZone:timeZone]) {
+            NSTimeInterval timeIntervals[deltaCount];
+            for (NSUInteger index = 0; index < deltaCount; index++) {
+                timeIntervals[index] = transitionTime.doubleValue + deltas[index];
+            }
+            [self.facade convertTimeIntervalsToDefaultTimeZone:timeIntervals count:deltaCount];
+            for (NSUInteger index = 0; index < deltaCount; index++) {
+                NSDate *const gmtDate = [NSDate dateWithTimeIntervalSinceReferenceDate:transitionTime.doubleValue + deltas[index]];
+                NSTimeInterval const expected = (gmtDate.timeIntervalSinceReferenceDate +
+                                                 [timeZone secondsFromGMTForDate:gmtDate]);
+                XCTAssertEqual(timeIntervals[index], expected, @"%@ %@", timeZone.name, gmtDate);
+                XCTAssertEqual([self.facade convertDateToDefaultTimeZone:gmtDate].timeIntervalSinceReferenceDate,
+                               expected, @"%@ %@", timeZone.name, gmtDate);
+            }
+        }
+    }
+}
+
+- (void)testConversionToGMTAroundTransitions
+{
+    for (NSTimeZone *const timeZone in self.timeZones) {
+        self.facade.defaultTimeZone = timeZone;
+        for (NSNumber *const transitionTime in [self transitionTimesOfTimeZone:timeZone]) {
+            for (NSTimeInterval delta = -7200; delta <= 7200; delta += 1800) {
+                NSDate *const timeDate = [NSDate dateWithTimeIntervalSinceReferenceDate:transitionTime.doubleValue + delta];
+                NSTimeInterval const expected = (timeDate.timeIntervalSinceReferenceDate -
+                                                 [timeZone secondsFromGMTForDate:timeDate]);
+                NSTimeInterval timeInterval = timeDate.timeIntervalSinceReferenceDate;
+                [self.facade convertTimeIntervalsToGMT:&timeInterval count:1];
+                XCTAssertEqual(timeInterval, expected, @"%@ %@", timeZone.name, timeDate);
+                XCTAssertEqual([self.facade convertDateToGMT:timeDate].timeIntervalSinceReferenceDate,
+                               expected, @"%@ %@", timeZone.name, timeDate);
+            }
+        }
+    }
+}
+
+- (void)testConversionOutsideTableRange
+{
+    NSTimeZone *const timeZone = [NSTimeZone timeZoneWithName:@"America/New_York"];
+    self.facade.defaultTimeZone = timeZone;
+    NSTimeInterval const years = 365.2425*86400;
+    NSTimeInterval const times[] = { -120*years, -40*years, 110*years, 200*years };
+    for (NSUInteger index = 0; index < sizeof(times)/sizeof(times[0]); index++) {
+        NSDate *const gmtDate = [NSDate dateWithTimeIntervalSinceReferenceDate:times[index]];
+        NSTimeInterval const expected = times[index] + [timeZone secondsFromGMTForDate:gmtDate];
+        XCTAssertEqual([self.facade convertDateToDefaultTimeZone:gmtDate].timeIntervalSinceReferenceDate,
+                       expected, @"%@", gmtDate);
+    }
+}
+
+- (void)testFloatingFireDateAroundTransitions
+{
+    NSTimeZone *const timeZone = [NSTimeZone timeZoneWithName:@"Europe/Madrid"];
+    for (NSNumber *const transitionTime in [self transitionTimesOfTimeZone:timeZone]) {
+        UILocalNotification *const notification = MRTestNotification(nil, 0);
+        notification.fireDate = [NSDate dateWithTimeIntervalSinceReferenceDate:transitionTime.doubleValue + 1];
+        notification.timeZone = timeZone;
+        NSDate *const fireDate = notification.fireDate;
+        NSTimeInterval const expected = (fireDate.timeIntervalSinceReferenceDate -
+                                         [timeZone secondsFromGMTForDate:fireDate]);
+        XCTAssertEqual([self.facade getGMTFireDateFromNotification:notification].timeIntervalSinceReferenceDate,
+                       expected, @"%@", fireDate);
+    }
+}
+
+#pragma mark Date building
+
+- (NSCalendar *)gregorianCalendarWithTimeZone:(NSTimeZone *const)timeZone
+{
+    NSCalendar *const calendar = [[NSCalendar alloc] initWithCalendarIdentifier:NSCalendarIdentifierGregorian];
+    calendar.timeZone = timeZone;
+    return calendar;
+}
+
+- (NSDate *)dateFromComponents:(MRLocalNotificationDateComponents const)components
+                      calendar:(NSCalendar *const)calendar
+{
+    NSDateComponents *const dateComponents = [[NSDateComponents alloc] init];
+    dateComponents.year = components.year;
+    dateComponents.month = components.month;
+    dateComponents.day = components.day;
+    dateComponents.hour = components.hour;
+    dateComponents.minute = components.minute;
+    dateComponents.second = components.second;
+    return [calendar dateFromComponents:dateComponents];
+}
+
+- (void)testBuildDateInDaylightSavingTimeGap
+{
+    NSTimeZone *const timeZone = [NSTimeZone timeZoneWithName:@"Europe/Madrid"];
+    self.facade.defaultCalendar = [self gregorianCalendarWithTimeZone:timeZone];
+    self.facade.defaultTimeZone = timeZone;
+    // Clocks jump from 02:00 to 03:00 on 2030-03-31, so 02:30 is 03:30 CEST, 01:30 GMT.
+    NSDate *const date = [self.facade buildDateWithDay:31 month:3 year:2030 hour:2 minute:30 second:0];
+    MRLocalNotificationDateComponents const gmtComponents = { 2030, 3, 31, 1, 30, 0 };
+    NSCalendar *const gmtCalendar = [self gregorianCalendarWithTimeZone:[NSTimeZone timeZoneForSecondsFromGMT:0]];
+    XCTAssertEqualObjects(date, [self dateFromComponents:gmtComponents calendar:gmtCalendar]);
+    MRLocalNotificationDateComponents const localComponents = { 2030, 3, 31, 2, 30, 0 };
+    XCTAssertEqualObjects(date, [self dateFromComponents:localComponents calendar:self.facade.defaultCalendar]);
+}
+
+- (void)testBuildDateInDaylightSavingTimeOverlap
+{
+    NSTimeZone *const timeZone = [NSTimeZone timeZoneWithName:@"Europe/Madrid"];
+    self.facade.defaultCalendar = [self gregorianCalendarWithTimeZone:timeZone];
+    self.facade.defaultTimeZone = timeZone;
+    // Clocks go back from 03:00 to 02:00 on 2030-10-27, so 02:30 happens first at 00:30 GMT.
+    NSDate *const date = [self.facade buildDateWithDay:27 month:10 year:2030 hour:2 minute:30 second:0];
+    MRLocalNotificationDateComponents const gmtComponents = { 2030, 10, 27, 0, 30, 0 };
+    NSCalendar *const gmtCalendar = [self gregorianCalendarWithTimeZone:[NSTimeZone timeZoneForSecondsFromGMT:0]];
+    XCTAssertEqualObjects(date, [self dateFromComponents:gmtComponents calendar:gmtCalendar]);
+}
+
+- (void)testBuildTimeIntervalsMatchesCalendarAroundTransitions
+{
+    NSTimeInterval const startTime = MRTestReferenceTime - 10*365*86400.0;
+    NSTimeInterval const endTime = MRTestReferenceTime + 10*365*86400.0;
+    for (NSTimeZone *const timeZone in self.timeZones) {
+        NSCalendar *const calendar = [self gregorianCalendarWithTimeZone:timeZone];
+        self.facade.defaultCalendar = calendar;
+        self.facade.defaultTimeZone = timeZone;
+        for (NSNumber *const transitionTime in [self transitionTimesOfTimeZone:timeZone]) {
+            if (transitionTime.doubleValue < startTime || transitionTime.doubleValue > endTime) {
+                continue;
+            }
+            // Local wall times every quarter of an hour, three hours around the transition.
+            NSDate *const transitionDate = [NSDate dateWithTimeIntervalSinceReferenceDate:transitionTime.doubleValue];
+            NSTimeInterval const localTransitionTime = (transitionTime.doubleValue +
+                                                        [timeZone secondsFromGMTForDate:transitionDate]);
+            for (NSTimeInterval delta = -3*3600; delta <= 3*3600; delta += 900) {
+                MRLocalNotificationDateComponents components;
+                NSTimeInterval const localTime = localTransitionTime + delta;
+                NSCalendar *const gmtCalendar = [self gregorianCalendarWithTimeZone:[NSTimeZone timeZoneForSecondsFromGMT:0]];
+                NSDateComponents *const dateComponents =
+                [gmtCalendar components:(NSCalendarUnitYear | NSCalendarUnitMonth | NSCalendarUnitDay |
+                                         NSCalendarUnitHour | NSCalendarUnitMinute | NSCalendarUnitSecond)
+                               fromDate:[NSDate dateWithTimeIntervalSinceReferenceDate:localTime]];
+                components.year = dateComponents.year;
+                components.month = dateComponents.month;
+                components.day = dateComponents.day;
+                components.hour = dateComponents.hour;
+                components.minute = dateComponents.minute;
+                components.second = dateComponents.second;
+                NSTimeInterval timeInterval;
+                [self.facade buildTimeIntervals:&timeInterval fromComponents:&components count:1];
+                NSDate *const expectedDate = [self dateFromComponents:components calendar:calendar];
+                XCTAssertEqual(timeInterval, expectedDate.timeIntervalSinceReferenceDate,
+                               @"%@ %@", timeZone.name, dateComponents);
+            }
+        }
+    }
+}
+
+- (void)testConcurrentDateBuildingAndDecomposition
+{
+    NSTimeZone *const timeZone = [NSTimeZone timeZoneWithName:@"America/New_York"];
+    NSCalendar *const calendar = [self gregorianCalendarWithTimeZone:timeZone];
+    NSUInteger const count = 10000;
+    NSMutableData *const expectedData = [NSMutableData dataWithLength:count*sizeof(NSTimeInterval)];
+    NSMutableData *const componentsData = [NSMutableData dataWithLength:count*sizeof(MRLocalNotificationDateComponents)];
+    NSTimeInterval *const expected = expectedData.mutableBytes;
+    MRLocalNotificationDateComponents *const components = componentsData.mutableBytes;
+    for (NSUInteger index = 0; index < count; index++) {
+        NSDate *const date = [NSDate dateWithTimeIntervalSinceReferenceDate:MRTestReferenceTime + index*7*3600.0 + 930];
+        NSDateComponents *const dateComponents =
+        [calendar components:(NSCalendarUnitYear | NSCalendarUnitMonth | NSCalendarUnitDay |
+                              NSCalendarUnitHour | NSCalendarUnitMinute | NSCalendarUnitSecond)
+                    fromDate:date];
+        components[index] = (MRLocalNotificationDateComponents){ dateComponents.year, dateComponents.month,
+                                                                 dateComponents.day, dateComponents.hour,
+                                                                 dateComponents.minute, dateComponents.second };
+        expected[index] = [self dateFromComponents:components[index] calendar:calendar].timeIntervalSinceReferenceDate;
+    }
+    // A new facade, so that threads also race to build the transition table.
+    MRLocalNotificationFacade *const facade = MRTestFacadeWithApplication(self.application);
+    facade.defaultCalendar = calendar;
+    facade.defaultTimeZone = timeZone;
+    __block int32_t failures = 0;
+    dispatch_apply(8, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t const iteration) {
+        NSMutableData *const timeIntervalsData = [NSMutableData dataWithLength:count*sizeof(NSTimeInterval)];
+        NSMutableData *const decomposedData = [NSMutableData dataWithLength:count*sizeof(MRLocalNotificationDateComponents)];
+        NSTimeInterval *const timeIntervals = timeIntervalsData.mutableBytes;
+        MRLocalNotificationDateComponents *const decomposed = decomposedData.mutableBytes;
+        [facade buildTimeIntervals:timeIntervals fromComponents:components count:count];
+        [facade getComponents:decomposed fromTimeIntervals:timeIntervals count:count];
+        for (NSUInteger index = 0; index < count; index++) {
+            NSDate *const date = [NSDate dateWithTimeIntervalSinceReferenceDate:timeIntervals[index]];
+            NSDateComponents *const dateComponents = [calendar components:(NSCalendarUnitHour | NSCalendarUnitMinute)
+                                                                 fromDate:date];
+            if (timeIntervals[index] != expected[index] ||
+                decomposed[index].hour != dateComponents.hour ||
+                decomposed[index].minute != dateComponents.minute) {
+                __atomic_add_fetch(&failures, 1, __ATOMIC_RELAXED);
+            }
+        }
+    });
+    XCTAssertEqual(failures, 0);
+}
+
+
+#pragma mark Recurrence
+
+- (UILocalNotification *)repeatingNotificationWithCalendar:(NSCalendar *const)calendar
+                                                components:(MRLocalNotificationDateComponents const)components
+                                                  interval:(NSCalendarUnit const)repeatInterval
+{
+    UILocalNotification *const notification = MRTestNotification(nil, 0);
+    notification.fireDate = [self dateFromComponents:components calendar:calendar];
+    notification.repeatCalendar = calendar;
+    notification.repeatInterval = repeatInterval;
+    return notification;
+}
+
+- (void)testOccurrencesMatchCalendarAcrossTransitions
+{
+    MRLocalNotificationDateComponents const components = { 2030, 1, 15, 9, 30, 0 };
+    NSCalendarUnit const units[] = { NSCalendarUnitDay, NSCalendarUnitWeekOfYear, NSCalendarUnitMonth };
+    for (NSTimeZone *const timeZone in self.timeZones) {
+        NSCalendar *const calendar = [self gregorianCalendarWithTimeZone:timeZone];
+        for (NSUInteger unitIndex = 0; unitIndex < sizeof(units)/sizeof(*units); unitIndex++) {
+            NSCalendarUnit const unit = (units[unitIndex] == NSCalendarUnitWeekOfYear
+                                         ? NSCalendarUnitDay
+                                         : units[unitIndex]);
+            NSInteger const step = (units[unitIndex] == NSCalendarUnitWeekOfYear ? 7 : 1);
+            UILocalNotification *const notification = [self repeatingNotificationWithCalendar:calendar
+                                                                                   components:components
+                                                                                     interval:units[unitIndex]];
+            NSEnumerator *const enumerator = [self.facade enumeratorOfFireDatesFromNotification:notification rule:nil];
+            for (NSInteger index = 0; index < 400; index++) {
+                NSDate *const expectedDate = [calendar dateByAddingUnit:unit
+                                                                  value:index*step
+                                                                 toDate:notification.fireDate
+                                                                options:0];
+                XCTAssertEqualObjects(enumerator.nextObject, expectedDate, @"%@ %lu", timeZone.name, (unsigned long)unit);
+            }
+        }
+    }
+}
+
+- (void)testNonRepeatingNotificationFiresOnce
+{
+    UILocalNotification *const notification = MRTestNotification(nil, 60);
+    NSEnumerator *const enumerator = [self.facade enumeratorOfFireDatesFromNotification:notification rule:nil];
+    XCTAssertEqualObjects(enumerator.nextObject, notification.fireDate);
+    XCTAssertNil(enumerator.nextObject);
+}
+
+- (void)testWeekdaysAndCount
+{
+    NSTimeZone *const timeZone = [NSTimeZone timeZoneWithName:@"Europe/Madrid"];
+    NSCalendar *const calendar = [self gregorianCalendarWithTimeZone:timeZone];
+    // 2030-01-01 is a Tuesday.
+    MRLocalNotificationDateComponents const components = { 2030, 1, 1, 8, 0, 0 };
+    UILocalNotification *const notification = [self repeatingNotificationWithCalendar:calendar
+                                                                           components:components
+                                                                             interval:NSCalendarUnitWeekOfYear];
+    MRLocalNotificationRecurrenceRule *const rule = [self.facade getRecurrenceRuleFromNotification:notification];
+    NSMutableIndexSet *const weekdays = NSMutableIndexSet.indexSet;
+    [weekdays addIndex:2];
+    [weekdays addIndex:4];
+    rule.weekdays = weekdays;
+    rule.count = 5;
+    NSArray *const dates = [self.facade getFireDatesFromNotification:notification
+                                                                rule:rule
+                                                               after:NSDate.distantPast
+                                                              before:NSDate.distantFuture
+                                                               limit:0];
+    NSMutableArray *const days = NSMutableArray.array;
+    for (NSDate *const date in dates) {
+        NSDateComponents *const dateComponents = [calendar components:(NSCalendarUnitDay | NSCalendarUnitHour)
+                                                             fromDate:date];
+        XCTAssertEqual(dateComponents.hour, 8);
+        [days addObject:@(dateComponents.day)];
+    }
+    // Wednesday 2, Monday 7, Wednesday 9, Monday 14, Wednesday 16.
+    XCTAssertEqualObjects(days, (@[ @2, @7, @9, @14, @16 ]));
+}
+
+- (void)testUntilIsInclusive
+{
+    NSTimeZone *const timeZone = [NSTimeZone timeZoneWithName:@"Europe/Madrid"];
+    NSCalendar *const calendar = [self gregorianCalendarWithTimeZone:timeZone];
+    MRLocalNotificationDateComponents const components = { 2030, 1, 1, 8, 0, 0 };
+    UILocalNotification *const notification = [self repeatingNotificationWithCalendar:calendar
+                                                                           components:components
+                                                                             interval:NSCalendarUnitDay];
+    MRLocalNotificationRecurrenceRule *const rule = [self.facade getRecurrenceRuleFromNotification:notification];
+    rule.until = [calendar dateByAddingUnit:NSCalendarUnitDay value:9 toDate:notification.fireDate options:0];
+    NSArray *const dates = [self.facade getFireDatesFromNotification:notification
+                                                                rule:rule
+                                                               after:NSDate.distantPast
+                                                              before:NSDate.distantFuture
+                                                               limit:0];
+    XCTAssertEqual(dates.count, 10u);
+    XCTAssertEqualObjects(dates.lastObject, rule.until);
+}
+
+- (void)testWindowQueryMatchesEnumeration
+{
+    NSTimeZone *const timeZone = [NSTimeZone timeZoneWithName:@"America/New_York"];
+    NSCalendar *const calendar = [self gregorianCalendarWithTimeZone:timeZone];
+    MRLocalNotificationDateComponents const components = { 2030, 1, 31, 23, 15, 0 };
+    NSCalendarUnit const units[] = { NSCalendarUnitHour, NSCalendarUnitDay, NSCalendarUnitWeekOfYear,
+                                     NSCalendarUnitMonth, NSCalendarUnitYear };
+    for (NSUInteger unitIndex = 0; unitIndex < sizeof(units)/sizeof(*units); unitIndex++) {
+        UILocalNotification *const notification = [self repeatingNotificationWithCalendar:calendar
+                                                                               components:components
+                                                                                 interval:units[unitIndex]];
+        NSDate *const startDate = [notification.fireDate dateByAddingTimeInterval:3*365*86400.0];
+        NSDate *const endDate = [startDate dateByAddingTimeInterval:2*365*86400.0];
+        NSMutableArray *const expectedDates = NSMutableArray.array;
+        NSEnumerator *const enumerator = [self.facade enumeratorOfFireDatesFromNotification:notification rule:nil];
+        NSDate *date;
+        while ((date = enumerator.nextObject) && [date compare:endDate] == NSOrderedAscending) {
+            if ([date compare:startDate] != NSOrderedAscending && expectedDates.count < 50) {
+                [expectedDates addObject:date];
+            }
+        }
+        NSArray *const dates = [self.facade getFireDatesFromNotification:notification
+                                                                    rule:nil
+                                                                   after:startDate
+                                                                  before:endDate
+                                                                   limit:50];
+        XCTAssertEqualObjects(dates, expectedDates, @"%lu", (unsigned long)units[unitIndex]);
+    }
+}
+
+@end
@@ -0,0 +1,1489 @@
+// MRLocalNotificationFacadeTests.m
+//
+// Copyright (c) 2015 Héctor Marqués
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#import <XCTest/XCTest.h>
+#import <CoreLocation/CoreLocation.h>
+#import "MRLocalNotificationFacade.h"
+#import "MRTestApplication.h"
+
+
+// Records the alerts presented by the facade instead of showing them.
+@interface MRTestAlertPresenter : UIViewController
+@property (nonatomic, readonly) NSMutableArray *presentedAlerts;
+@end
+
+
+@implementation MRTestAlertPresenter
+
+- (instancetype)init
+{
+    self = [super init];
+    if (self) {
+        _presentedAlerts = NSMutableArray.array;
+    }
+    return self;
+}
+
+- (void)presentViewController:(UIViewController *const)viewController
+                     animated:(BOOL const)animated
+                   completion:(void(^const)(void))completion
+{
+    [_presentedAlerts addObject:viewController];
+    if (completion) {
+        completion();
+    }
+}
+
+@end
+
+
+@interface MRLocalNotificationFacadeTests : XCTestCase
+@property (nonatomic, strong) MRTestApplication *application;
+@property (nonatomic, strong) MRLocalNotificationFacade *facade;
+@end
+
+
+@implementation MRLocalNotificationFacadeTests
+
+- (void)setUp
+{
+    [super setUp];
+    self.application = MRTestApplication.new;
+    self.facade = MRTestFacadeWithApplication(self.application);
+}
+
+- (void)tearDown
+{
+    self.facade = nil;
+    self.application = nil;
+    [super tearDown];
+}
+
+#pragma mark Batch scheduling
+
+- (void)testScheduleNotificationsFetchesScheduledNotificationsOnce
+{
+    [self.application addScheduledNotificationsWithCount:100 identifiers:NO];
+    [self.application resetCounters];
+    NSMutableArray *const notifications = NSMutableArray.array;
+    for (NSUInteger index = 0; index < 200; index++) {
+        [notifications addObject:MRTestNotification(nil, 60*(index + 1))];
+    }
+    NSArray *errors;
+    NSIndexSet *const scheduledIndexes = [self.facade scheduleNotifications:notifications errors:&errors];
+    XCTAssertEqual(scheduledIndexes.count, notifications.count);
+    XCTAssertEqual(errors.count, notifications.count);
+    XCTAssertEqual(self.application.fetchCount, 1u);
+    XCTAssertEqual(self.application.scheduleCount, notifications.count);
+    XCTAssertEqual(self.application.scheduledLocalNotifications.count, 300u);
+}
+
+- (void)testScheduleNotificationsReportsOneErrorPerNotification
+{
+    [self.application addScheduledNotificationsWithCount:1 identifiers:NO];
+    UILocalNotification *const pendingNotification = self.application.scheduledLocalNotifications.firstObject;
+    UILocalNotification *const validNotification = MRTestNotification(nil, 60);
+    UILocalNotification *const pastNotification = MRTestNotification(nil, -60);
+    NSArray *const notifications = @[ validNotification,
+                                      validNotification.copy,
+                                      pendingNotification,
+                                      pastNotification ];
+    NSArray *errors;
+    NSIndexSet *const scheduledIndexes = [self.facade scheduleNotifications:notifications errors:&errors];
+    XCTAssertEqualObjects(scheduledIndexes, [NSIndexSet indexSetWithIndex:0]);
+    XCTAssertEqual(errors.count, notifications.count);
+    XCTAssertEqualObjects(errors[0], NSNull.null);
+    XCTAssertEqual([errors[1] code], MRLocalNotificationErrorAlreadyScheduled);
+    XCTAssertEqual([errors[2] code], MRLocalNotificationErrorAlreadyScheduled);
+    XCTAssertEqual([errors[3] code], MRLocalNotificationErrorInvalidDate);
+}
+
+- (void)testScheduleNotificationsChecksIdentifiersAgainstIndex
+{
+    [self.application addScheduledNotificationsWithCount:10 identifiers:YES];
+    [self.application resetCounters];
+    NSArray *const notifications = @[ MRTestNotification(@"existing-3", 60),
+                                      MRTestNotification(@"new", 60),
+                                      MRTestNotification(@"new", 120) ];
+    NSArray *errors;
+    NSIndexSet *const scheduledIndexes = [self.facade scheduleNotifications:notifications errors:&errors];
+    XCTAssertEqualObjects(scheduledIndexes, [NSIndexSet indexSetWithIndex:1]);
+    XCTAssertEqual([errors[0] code], MRLocalNotificationErrorAlreadyScheduled);
+    XCTAssertEqual([errors[2] code], MRLocalNotificationErrorAlreadyScheduled);
+    XCTAssertLessThanOrEqual(self.application.fetchCount, 1u);
+    XCTAssertNotNil([self.facade scheduledNotificationWithIdentifier:@"new"]);
+}
+
+#pragma mark Time index
+
+- (void)testNextScheduledNotificationWhenNothingIsScheduled
+{
+    XCTAssertNil(self.facade.nextScheduledNotification);
+    NSDate *const startDate = [NSDate dateWithTimeIntervalSinceReferenceDate:MRTestReferenceTime];
+    NSArray *const notifications = [self.facade scheduledNotificationsFiringFrom:startDate
+                                                                              to:NSDate.distantFuture];
+    XCTAssertEqual(notifications.count, 0u);
+}
+
+- (void)testNextScheduledNotificationAfterCancellingEverything
+{
+    UILocalNotification *const notification = MRTestNotification(@"only", 60);
+    XCTAssertTrue([self.facade scheduleNotification:notification withError:NULL]);
+    XCTAssertEqualObjects([self.facade getIdentifierFromNotification:self.facade.nextScheduledNotification], @"only");
+    [self.facade cancelNotification:notification];
+    XCTAssertNil(self.facade.nextScheduledNotification);
+}
+
+- (void)testNextScheduledNotificationAfterFiring
+{
+    XCTAssertTrue([self.facade scheduleNotification:MRTestNotification(@"first", 60) withError:NULL]);
+    XCTAssertTrue([self.facade scheduleNotification:MRTestNotification(@"second", 120) withError:NULL]);
+    self.application.now = MRTestReferenceTime + 90;
+    XCTAssertEqualObjects([self.facade getIdentifierFromNotification:self.facade.nextScheduledNotification], @"second");
+    self.application.now = MRTestReferenceTime + 150;
+    XCTAssertNil(self.facade.nextScheduledNotification);
+}
+
+- (void)testScheduledNotificationsFiringInWindow
+{
+    for (NSUInteger index = 0; index < 100; index++) {
+        NSString *const identifier = [NSString stringWithFormat:@"%lu", (unsigned long)index];
+        XCTAssertTrue([self.facade scheduleNotification:MRTestNotification(identifier, 60*(100 - index))
+                                              withError:NULL]);
+    }
+    NSDate *const startDate = [NSDate dateWithTimeIntervalSinceReferenceDate:MRTestReferenceTime + 60*10];
+    NSDate *const endDate = [NSDate dateWithTimeIntervalSinceReferenceDate:MRTestReferenceTime + 60*20];
+    NSArray *const notifications = [self.facade scheduledNotificationsFiringFrom:startDate to:endDate];
+    XCTAssertEqual(notifications.count, 10u);
+    XCTAssertEqualObjects([self.facade getIdentifierFromNotification:notifications.firstObject], @"90");
+    XCTAssertEqualObjects([self.facade getIdentifierFromNotification:notifications.lastObject], @"81");
+}
+
+- (void)testSystemTimeZoneChangeReordersFloatingNotifications
+{
+    NSTimeZone *const systemTimeZone = NSTimeZone.defaultTimeZone;
+    NSTimeZone *const madridTimeZone = [NSTimeZone timeZoneWithName:@"Europe/Madrid"];
+    NSTimeZone *const newYorkTimeZone = [NSTimeZone timeZoneWithName:@"America/New_York"];
+    [NSTimeZone setDefaultTimeZone:madridTimeZone];
+    @try {
+        // 03:00 in Madrid (UTC+1) is 02:00 GMT, before "fixed"; 03:00 in New York (UTC-5) is 08:00 GMT, after it.
+        UILocalNotification *const floatingNotification = MRTestNotification(@"floating", 3*3600);
+        floatingNotification.timeZone = madridTimeZone;
+        XCTAssertTrue([self.facade scheduleNotification:floatingNotification withError:NULL]);
+        XCTAssertTrue([self.facade scheduleNotification:MRTestNotification(@"fixed", 4*3600) withError:NULL]);
+        NSDate *const startDate = [NSDate dateWithTimeIntervalSinceReferenceDate:MRTestReferenceTime];
+        NSArray *notifications = [self.facade scheduledNotificationsFiringFrom:startDate to:NSDate.distantFuture];
+        XCTAssertEqualObjects([self.facade getIdentifierFromNotification:self.facade.nextScheduledNotification], @"floating");
+        XCTAssertEqualObjects([self.facade getIdentifierFromNotification:notifications.lastObject], @"fixed");
+        [NSTimeZone setDefaultTimeZone:newYorkTimeZone];
+        [NSNotificationCenter.defaultCenter postNotificationName:NSSystemTimeZoneDidChangeNotification object:nil];
+        notifications = [self.facade scheduledNotificationsFiringFrom:startDate to:NSDate.distantFuture];
+        XCTAssertEqualObjects([self.facade getIdentifierFromNotification:self.facade.nextScheduledNotification], @"fixed");
+        XCTAssertEqualObjects([self.facade getIdentifierFromNotification:notifications.lastObject], @"floating");
+        NSDate *const endDate = [NSDate dateWithTimeIntervalSinceReferenceDate:MRTestReferenceTime + 6*3600];
+        notifications = [self.facade scheduledNotificationsFiringFrom:startDate to:endDate];
+        XCTAssertEqual(notifications.count, 1u);
+    } @finally {
+        [NSTimeZone setDefaultTimeZone:systemTimeZone];
+        [NSNotificationCenter.defaultCenter postNotificationName:NSSystemTimeZoneDidChangeNotification object:nil];
+    }
+}
+
+#pragma mark Region notifications
+
+- (UILocalNotification *)regionNotificationWithIdentifier:(NSString *const)identifier
+{
+    CLCircularRegion *const region =
+    [[CLCircularRegion alloc] initWithCenter:CLLocationCoordinate2DMake(41.3851, 2.1734)
+                                      radius:100
+                                  identifier:identifier];
+    UILocalNotification *const notification = [self.facade buildNotificationWithRegion:region
+                                                                          triggersOnce:YES
+                                                                              category:nil
+                                                                              userInfo:@{ MRLocalNotificationIdentifierKey: identifier }];
+    notification.alertBody = @"entered region";
+    return notification;
+}
+
+- (void)testScheduleRegionNotification
+{
+    UILocalNotification *const notification = [self regionNotificationWithIdentifier:@"region"];
+    NSError *error;
+    XCTAssertTrue([self.facade scheduleNotification:notification withError:&error]);
+    XCTAssertNil(error);
+    XCTAssertTrue([self.facade scheduledNotificationsContainsNotification:notification]);
+    XCTAssertEqual(self.application.scheduledLocalNotifications.count, 1u);
+}
+
+- (void)testScheduleNotificationsAcceptsRegionNotifications
+{
+    UILocalNotification *const undatedNotification = MRTestNotification(nil, 60);
+    undatedNotification.fireDate = nil;
+    NSArray *const notifications = @[ [self regionNotificationWithIdentifier:@"region"],
+                                      undatedNotification ];
+    NSArray *errors;
+    NSIndexSet *const scheduledIndexes = [self.facade scheduleNotifications:notifications errors:&errors];
+    XCTAssertEqualObjects(scheduledIndexes, [NSIndexSet indexSetWithIndex:0]);
+    XCTAssertEqualObjects(errors[0], NSNull.null);
+    XCTAssertEqual([errors[1] code], MRLocalNotificationErrorMissingDate);
+}
+
+- (void)testEnqueueRegionNotification
+{
+    __block dispatch_block_t pendingCommit;
+    self.facade.commitExecutor = ^(dispatch_block_t const block) {
+        pendingCommit = block;
+    };
+    __block BOOL scheduled = NO;
+    [self.facade enqueueScheduleNotification:[self regionNotificationWithIdentifier:@"region"]
+                                  completion:^(BOOL const success, NSError *const error) {
+                                      scheduled = success;
+                                  }];
+    dispatch_sync(self.facade.pipelineQueue, ^{});
+    XCTAssertNotNil(pendingCommit);
+    pendingCommit();
+    XCTAssertTrue(scheduled);
+    XCTAssertNotNil([self.facade scheduledNotificationWithIdentifier:@"region"]);
+}
+
+
+#pragma mark Desired notifications
+
+- (void)testApplyDesiredNotificationsFetchesScheduledNotificationsOnce
+{
+    [self.application addScheduledNotificationsWithCount:10 identifiers:YES];
+    [self.application resetCounters];
+    NSMutableArray *const desiredNotifications = NSMutableArray.array;
+    for (NSUInteger index = 0; index < 5; index++) {
+        NSString *const identifier = [NSString stringWithFormat:@"existing-%lu", (unsigned long)index];
+        [desiredNotifications addObject:MRTestNotification(identifier, 3600 + index)];
+    }
+    [desiredNotifications addObject:MRTestNotification(@"existing-5", 60)];
+    [desiredNotifications addObject:MRTestNotification(@"new", 60)];
+    NSDictionary *const changes = [self.facade applyDesiredNotifications:desiredNotifications];
+    XCTAssertEqual(self.application.fetchCount, 1u);
+    XCTAssertEqualObjects(changes[MRLocalNotificationInsertedIdentifiersKey], @[ @"new" ]);
+    XCTAssertEqualObjects(changes[MRLocalNotificationUpdatedIdentifiersKey], @[ @"existing-5" ]);
+    XCTAssertEqual([changes[MRLocalNotificationUnchangedIdentifiersKey] count], 5u);
+    XCTAssertEqual([changes[MRLocalNotificationDeletedIdentifiersKey] count], 4u);
+    XCTAssertEqual(self.application.scheduledLocalNotifications.count, 7u);
+}
+
+#pragma mark Region pool
+
+- (CLLocation *)poolLocation
+{
+    return [[CLLocation alloc] initWithLatitude:41.3851 longitude:2.1734];
+}
+
+- (void)testCancelledPoolNotificationIsScheduledAgain
+{
+    XCTAssertTrue([self.facade addNotificationToRegionPool:[self regionNotificationWithIdentifier:@"a"] error:NULL]);
+    XCTAssertTrue([self.facade addNotificationToRegionPool:[self regionNotificationWithIdentifier:@"b"] error:NULL]);
+    [self.facade updateRegionPoolWithLocation:self.poolLocation];
+    XCTAssertEqual(self.application.scheduledLocalNotifications.count, 2u);
+    [self.facade cancelNotification:[self.facade scheduledNotificationWithIdentifier:@"a"]];
+    XCTAssertEqual(self.application.scheduledLocalNotifications.count, 1u);
+    [self.facade updateRegionPoolWithLocation:self.poolLocation];
+    XCTAssertEqual(self.application.scheduledLocalNotifications.count, 2u);
+    XCTAssertNotNil([self.facade scheduledNotificationWithIdentifier:@"a"]);
+}
+
+- (void)testRemoveAllNotificationsFromRegionPool
+{
+    for (NSUInteger index = 0; index < 5; index++) {
+        NSString *const identifier = [NSString stringWithFormat:@"%lu", (unsigned long)index];
+        XCTAssertTrue([self.facade addNotificationToRegionPool:[self regionNotificationWithIdentifier:identifier]
+                                                         error:NULL]);
+    }
+    [self.facade updateRegionPoolWithLocation:self.poolLocation];
+    XCTAssertEqual(self.application.scheduledLocalNotifications.count, 5u);
+    [self.facade removeAllNotificationsFromRegionPool];
+    XCTAssertEqual(self.application.scheduledLocalNotifications.count, 0u);
+}
+
+- (void)testReplacingScheduledPoolNotificationKeepsItScheduled
+{
+    XCTAssertTrue([self.facade addNotificationToRegionPool:[self regionNotificationWithIdentifier:@"a"] error:NULL]);
+    [self.facade updateRegionPoolWithLocation:self.poolLocation];
+    UILocalNotification *const replacement = [self regionNotificationWithIdentifier:@"a"];
+    replacement.alertBody = @"replaced";
+    XCTAssertTrue([self.facade addNotificationToRegionPool:replacement error:NULL]);
+    [self.application resetCounters];
+    [self.facade updateRegionPoolWithLocation:self.poolLocation];
+    XCTAssertEqual(self.application.scheduleCount, 0u);
+    XCTAssertEqualObjects([self.facade scheduledNotificationWithIdentifier:@"a"].alertBody, @"replaced");
+}
+
+- (UILocalNotification *)regionNotificationWithIdentifier:(NSString *const)identifier
+                                                 latitude:(CLLocationDegrees const)latitude
+                                                longitude:(CLLocationDegrees const)longitude
+                                                   radius:(CLLocationDistance const)radius
+{
+    UILocalNotification *const notification = [self regionNotificationWithIdentifier:identifier];
+    notification.region = [[CLCircularRegion alloc] initWithCenter:CLLocationCoordinate2DMake(latitude, longitude)
+                                                             radius:radius
+                                                         identifier:identifier];
+    return notification;
+}
+
+- (CLLocationDistance)distanceFromLocation:(CLLocation *const)location
+                                  toRegion:(CLCircularRegion *const)region
+{
+    double const radians = M_PI/180;
+    CLLocationCoordinate2D const coordinate = location.coordinate;
+    CLLocationCoordinate2D const center = region.center;
+    double const sinLatitude = sin((center.latitude - coordinate.latitude)*radians/2);
+    double const sinLongitude = sin((center.longitude - coordinate.longitude)*radians/2);
+    double const haversine = (sinLatitude*sinLatitude +
+                              cos(coordinate.latitude*radians)*cos(center.latitude*radians)*sinLongitude*sinLongitude);
+    double const distance = 2*6371008.8*asin(MIN(1, sqrt(haversine)));
+    return MAX(0, distance - region.radius);
+}
+
+- (void)testRegionPoolSelectsNearestRegions
+{
+    NSUInteger const maximumRegionNotifications = 20;
+    self.facade.maximumRegionNotifications = maximumRegionNotifications;
+    NSMutableArray *const regions = NSMutableArray.array;
+    uint64_t state = 88172645463325252ull;
+    for (NSUInteger index = 0; index < 3000; index++) {
+        double random[3];
+        for (NSUInteger component = 0; component < 3; component++) {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            random[component] = (double)(state >> 11)/(double)(1ull << 53);
+        }
+        // Two thirds around Barcelona, the rest anywhere.
+        BOOL const isLocal = (index%3 != 0);
+        CLLocationDegrees const latitude = (isLocal ? 41.3851 + 2*random[0] - 1 : 178*random[0] - 89);
+        CLLocationDegrees const longitude = (isLocal ? 2.1734 + 2*random[1] - 1 : 360*random[1] - 180);
+        NSString *const identifier = [NSString stringWithFormat:@"%lu", (unsigned long)index];
+        UILocalNotification *const notification = [self regionNotificationWithIdentifier:identifier
+                                                                                 latitude:latitude
+                                                                                longitude:longitude
+                                                                                   radius:50 + 5000*random[2]];
+        XCTAssertTrue([self.facade addNotificationToRegionPool:notification error:NULL]);
+        [regions addObject:notification.region];
+    }
+    NSArray *const locations = @[ self.poolLocation,
+                                  [[CLLocation alloc] initWithLatitude:40.4168 longitude:-3.7038],
+                                  [[CLLocation alloc] initWithLatitude:-33.8688 longitude:151.2093],
+                                  [[CLLocation alloc] initWithLatitude:0 longitude:179.99],
+                                  [[CLLocation alloc] initWithLatitude:89.9 longitude:0] ];
+    for (CLLocation *const location in locations) {
+        NSMutableArray *const distances = NSMutableArray.array;
+        for (CLCircularRegion *const region in regions) {
+            [distances addObject:@([self distanceFromLocation:location toRegion:region])];
+        }
+        [distances sortUsingSelector:@selector(compare:)];
+        NSArray *const identifiers = [self.facade updateRegionPoolWithLocation:location];
+        XCTAssertEqual(identifiers.count, maximumRegionNotifications);
+        CLLocationDistance previousDistance = 0;
+        for (NSString *const identifier in identifiers) {
+            CLCircularRegion *const region = regions[(NSUInteger)identifier.integerValue];
+            CLLocationDistance const distance = [self distanceFromLocation:location toRegion:region];
+            XCTAssertGreaterThanOrEqual(distance + 1e-6, previousDistance, @"%@", location);
+            previousDistance = distance;
+        }
+        XCTAssertLessThanOrEqual(previousDistance, [distances[maximumRegionNotifications - 1] doubleValue] + 1e-6,
+                                 @"%@", location);
+        XCTAssertEqual(self.application.scheduledLocalNotifications.count, maximumRegionNotifications);
+    }
+}
+
+- (void)testRegionContainingLocationComesFirst
+{
+    self.facade.maximumRegionNotifications = 1;
+    // The center of the large region is farther away, but the location is inside it.
+    UILocalNotification *const smallNotification = [self regionNotificationWithIdentifier:@"small"
+                                                                                  latitude:41.3941
+                                                                                 longitude:2.1734
+                                                                                    radius:100];
+    UILocalNotification *const largeNotification = [self regionNotificationWithIdentifier:@"large"
+                                                                                  latitude:41.4301
+                                                                                 longitude:2.1734
+                                                                                    radius:10000];
+    XCTAssertTrue([self.facade addNotificationToRegionPool:smallNotification error:NULL]);
+    XCTAssertTrue([self.facade addNotificationToRegionPool:largeNotification error:NULL]);
+    XCTAssertEqualObjects([self.facade updateRegionPoolWithLocation:self.poolLocation], @[ @"large" ]);
+}
+
+- (void)testUpdateRegionPoolOnlySwapsDifferences
+{
+    self.facade.maximumRegionNotifications = 3;
+    for (NSUInteger index = 0; index < 6; index++) {
+        NSString *const identifier = [NSString stringWithFormat:@"%lu", (unsigned long)index];
+        UILocalNotification *const notification = [self regionNotificationWithIdentifier:identifier
+                                                                                 latitude:41.3851 + 0.01*index
+                                                                                longitude:2.1734
+                                                                                   radius:100];
+        XCTAssertTrue([self.facade addNotificationToRegionPool:notification error:NULL]);
+    }
+    XCTAssertEqualObjects([self.facade updateRegionPoolWithLocation:self.poolLocation], (@[ @"0", @"1", @"2" ]));
+    [self.application resetCounters];
+    CLLocation *const location = [[CLLocation alloc] initWithLatitude:41.3851 + 0.021 longitude:2.1734];
+    NSArray *const identifiers = [self.facade updateRegionPoolWithLocation:location];
+    XCTAssertEqualObjects([identifiers sortedArrayUsingSelector:@selector(compare:)], (@[ @"1", @"2", @"3" ]));
+    XCTAssertEqual(self.application.cancelCount, 1u);
+    XCTAssertEqual(self.application.scheduleCount, 1u);
+    XCTAssertNil([self.facade scheduledNotificationWithIdentifier:@"0"]);
+    XCTAssertNotNil([self.facade scheduledNotificationWithIdentifier:@"3"]);
+}
+
+- (void)testRegionPoolRejectsInvalidNotifications
+{
+    UILocalNotification *const anonymousNotification = [self regionNotificationWithIdentifier:@"region"];
+    anonymousNotification.userInfo = nil;
+    NSError *error;
+    XCTAssertFalse([self.facade addNotificationToRegionPool:anonymousNotification error:&error]);
+    XCTAssertEqual(error.code, MRLocalNotificationErrorInvalidObject);
+    error = nil;
+    XCTAssertFalse([self.facade addNotificationToRegionPool:MRTestNotification(@"dated", 60) error:&error]);
+    XCTAssertEqual(error.code, MRLocalNotificationErrorInvalidObject);
+}
+
+- (void)testRemoveNotificationFromRegionPoolCancelsIt
+{
+    UILocalNotification *const notification = [self regionNotificationWithIdentifier:@"a"];
+    XCTAssertTrue([self.facade addNotificationToRegionPool:notification error:NULL]);
+    XCTAssertEqualObjects([self.facade updateRegionPoolWithLocation:self.poolLocation], @[ @"a" ]);
+    [self.facade removeNotificationFromRegionPool:notification];
+    XCTAssertEqual(self.application.scheduledLocalNotifications.count, 0u);
+    XCTAssertEqualObjects([self.facade updateRegionPoolWithLocation:self.poolLocation], @[]);
+}
+
+#pragma mark Overflow queue
+
+- (void)scheduleOverflowNotificationsWithDelays:(NSArray *const)delays
+{
+    for (NSNumber *const delay in delays) {
+        NSString *const identifier = [NSString stringWithFormat:@"%@", delay];
+        XCTAssertTrue([self.facade scheduleNotification:MRTestNotification(identifier, delay.doubleValue)
+                                              withError:NULL]);
+    }
+}
+
+- (NSArray *)identifiersOfScheduledLocalNotifications
+{
+    NSMutableArray *const identifiers = NSMutableArray.array;
+    for (UILocalNotification *const notification in self.application.scheduledLocalNotifications) {
+        [identifiers addObject:[self.facade getIdentifierFromNotification:notification]];
+    }
+    [identifiers sortUsingSelector:@selector(compare:)];
+    return identifiers;
+}
+
+- (void)testOverflowKeepsEarliestNotificationsScheduled
+{
+    self.facade.maximumScheduledNotifications = 3;
+    [self scheduleOverflowNotificationsWithDelays:@[ @500, @400 ]];
+    [self.application resetCounters];
+    [self scheduleOverflowNotificationsWithDelays:@[ @300, @200, @100 ]];
+    XCTAssertEqual(self.application.fetchCount, 0u);
+    XCTAssertEqual(self.application.cancelCount, 2u);
+    XCTAssertEqualObjects(self.identifiersOfScheduledLocalNotifications, (@[ @"100", @"200", @"300" ]));
+    XCTAssertEqual(self.facade.queuedNotifications.count, 2u);
+}
+
+- (void)testReplenishAfterDeliveryDoesNotFetch
+{
+    self.facade.maximumScheduledNotifications = 3;
+    [self scheduleOverflowNotificationsWithDelays:@[ @100, @200, @300, @400, @500 ]];
+    [self.application resetCounters];
+    self.application.now = MRTestReferenceTime + 250;
+    [self.facade replenishScheduledNotifications];
+    XCTAssertEqual(self.application.fetchCount, 0u);
+    XCTAssertEqual(self.application.scheduleCount, 2u);
+    XCTAssertEqualObjects(self.identifiersOfScheduledLocalNotifications, (@[ @"300", @"400", @"500" ]));
+    XCTAssertEqual(self.facade.queuedNotifications.count, 0u);
+}
+
+- (void)testCancelFreesOverflowSlot
+{
+    self.facade.maximumScheduledNotifications = 2;
+    [self scheduleOverflowNotificationsWithDelays:@[ @100, @200, @300 ]];
+    [self.application resetCounters];
+    [self.facade cancelNotification:[self.facade scheduledNotificationWithIdentifier:@"100"]];
+    XCTAssertEqual(self.application.fetchCount, 0u);
+    XCTAssertEqualObjects(self.identifiersOfScheduledLocalNotifications, (@[ @"200", @"300" ]));
+    XCTAssertEqual(self.facade.queuedNotifications.count, 0u);
+}
+
+- (void)testOverflowNeverEvictsRepeatingNotificationsFiringEarlier
+{
+    self.facade.maximumScheduledNotifications = 2;
+    UILocalNotification *const repeatingNotification = MRTestNotification(@"daily", 50);
+    repeatingNotification.repeatInterval = NSCalendarUnitDay;
+    XCTAssertTrue([self.facade scheduleNotification:repeatingNotification withError:NULL]);
+    [self scheduleOverflowNotificationsWithDelays:@[ @200, @100 ]];
+    self.application.now = MRTestReferenceTime + 150;
+    [self.facade replenishScheduledNotifications];
+    XCTAssertEqualObjects(self.identifiersOfScheduledLocalNotifications, (@[ @"200", @"daily" ]));
+}
+
+
+#pragma mark User info index
+
+- (void)testUserInfoIndexDoesNotReadPayloadStore
+{
+    NSString *const path = [NSTemporaryDirectory() stringByAppendingPathComponent:NSUUID.UUID.UUIDString];
+    NSURL *const directoryURL = [NSURL fileURLWithPath:path isDirectory:YES];
+    self.facade.payloadStoreDirectoryURL = directoryURL;
+    UILocalNotification *notification;
+    for (NSUInteger index = 0; index < 100; index++) {
+        NSString *const identifier = [NSString stringWithFormat:@"%lu", (unsigned long)index];
+        notification = MRTestNotification(nil, 60*(index + 1));
+        notification.userInfo = @{ MRLocalNotificationIdentifierKey: identifier,
+                                   @"parity": (index % 2 == 0 ? @"even" : @"odd"),
+                                   @"index": @(index) };
+        XCTAssertTrue([self.facade scheduleNotification:notification withError:NULL]);
+    }
+    // Waits for the payload writes and then removes them, so only payloads in memory can be found.
+    XCTAssertEqualObjects([self.facade getUserInfoFromNotification:notification][@"index"], @99);
+    XCTAssertTrue([NSFileManager.defaultManager removeItemAtURL:directoryURL error:NULL]);
+    NSArray *const cancelledNotifications = [self.facade cancelNotificationsWithUserInfoValue:@"even"
+                                                                                      forKey:@"parity"];
+    XCTAssertEqual(cancelledNotifications.count, 50u);
+    XCTAssertEqual(self.application.scheduledLocalNotifications.count, 50u);
+    XCTAssertEqual([self.facade cancelNotificationsWithUserInfoValue:@42 forKey:@"index"].count, 0u);
+    XCTAssertEqual([self.facade cancelNotificationsWithUserInfoValue:@43 forKey:@"index"].count, 1u);
+}
+
+
+#pragma mark Payload store
+
+- (NSURL *)temporaryDirectoryURL
+{
+    NSString *const path = [NSTemporaryDirectory() stringByAppendingPathComponent:NSUUID.UUID.UUIDString];
+    return [NSURL fileURLWithPath:path isDirectory:YES];
+}
+
+- (NSUInteger)payloadCountOfFacade:(MRLocalNotificationFacade *const)facade
+{
+    // Reads are queued after the writes and removals of the payload store, so this waits for them.
+    UILocalNotification *const notification = MRTestNotification(nil, 60);
+    notification.userInfo = @{ MRLocalNotificationPayloadKey: @"missing" };
+    [facade getUserInfoFromNotification:notification];
+    NSArray *const fileURLs = [NSFileManager.defaultManager contentsOfDirectoryAtURL:facade.payloadStoreDirectoryURL
+                                                          includingPropertiesForKeys:nil
+                                                                             options:0
+                                                                               error:NULL];
+    return [fileURLs filteredArrayUsingPredicate:[NSPredicate predicateWithFormat:@"pathExtension == 'plist'"]].count;
+}
+
+- (UILocalNotification *)schedulePayloadNotificationWithIdentifier:(NSString *const)identifier
+                                                             delay:(NSTimeInterval const)delay
+                                                              list:(NSString *const)list
+{
+    UILocalNotification *const notification = MRTestNotification(nil, delay);
+    notification.userInfo = @{ MRLocalNotificationIdentifierKey: identifier, @"list": list };
+    XCTAssertTrue([self.facade scheduleNotification:notification withError:NULL]);
+    for (UILocalNotification *const scheduledNotification in self.application.scheduledLocalNotifications) {
+        if ([[self.facade getIdentifierFromNotification:scheduledNotification] isEqualToString:identifier]) {
+            return scheduledNotification;
+        }
+    }
+    return nil;
+}
+
+- (void)testReceivedNotificationGetsUserInfoFromPayloadStore
+{
+    self.facade.payloadStoreDirectoryURL = self.temporaryDirectoryURL;
+    UILocalNotification *const deliveredNotification = [self schedulePayloadNotificationWithIdentifier:@"received"
+                                                                                                 delay:60
+                                                                                                  list:@"groceries"];
+    XCTAssertNil(deliveredNotification.userInfo[@"list"]);
+    XCTAssertEqual([self payloadCountOfFacade:self.facade], 1u);
+    __block NSDictionary *receivedUserInfo;
+    self.facade.onDidReceiveNotification = ^(UILocalNotification *const notification, BOOL *const shouldShowAlert) {
+        receivedUserInfo = notification.userInfo;
+    };
+    self.application.now = MRTestReferenceTime + 60;
+    [self.facade handleDidReceiveLocalNotification:deliveredNotification];
+    XCTAssertEqualObjects(receivedUserInfo[MRLocalNotificationIdentifierKey], @"received");
+    XCTAssertEqualObjects(receivedUserInfo[@"list"], @"groceries");
+    XCTAssertNil(receivedUserInfo[MRLocalNotificationPayloadKey]);
+    XCTAssertEqual([self payloadCountOfFacade:self.facade], 0u);
+    XCTAssertNil([self.facade getUserInfoFromNotification:deliveredNotification][@"list"]);
+}
+
+- (void)testActionHandlerGetsUserInfoFromPayloadStore
+{
+    self.facade.payloadStoreDirectoryURL = self.temporaryDirectoryURL;
+    UILocalNotification *const onceNotification = [self schedulePayloadNotificationWithIdentifier:@"once"
+                                                                                           delay:60
+                                                                                            list:@"groceries"];
+    UILocalNotification *notification = MRTestNotification(nil, 120);
+    notification.repeatInterval = NSCalendarUnitDay;
+    notification.userInfo = @{ MRLocalNotificationIdentifierKey: @"daily", @"list": @"chores" };
+    XCTAssertTrue([self.facade scheduleNotification:notification withError:NULL]);
+    UILocalNotification *dailyNotification;
+    for (notification in self.application.scheduledLocalNotifications) {
+        if ([[self.facade getIdentifierFromNotification:notification] isEqualToString:@"daily"]) {
+            dailyNotification = notification;
+        }
+    }
+    XCTAssertNil(dailyNotification.userInfo[@"list"]);
+    XCTAssertEqual([self payloadCountOfFacade:self.facade], 2u);
+    NSMutableArray *const lists = NSMutableArray.array;
+    [self.facade setNotificationHandler:^(NSString *const identifier, UILocalNotification *const notification) {
+        [lists addObject:notification.userInfo[@"list"] ?: NSNull.null];
+    } forActionWithIdentifier:@"open"];
+    self.application.now = MRTestReferenceTime + 150;
+    XCTAssertNil([self.facade scheduledNotificationWithIdentifier:@"once"]);
+    [self.facade handleActionWithIdentifier:@"open" forLocalNotification:onceNotification completionHandler:nil];
+    [self.facade handleActionWithIdentifier:@"open" forLocalNotification:dailyNotification completionHandler:nil];
+    XCTAssertEqualObjects(lists, (@[ @"groceries", @"chores" ]));
+    // The repeating notification is still scheduled, so only its payload is kept.
+    XCTAssertEqual([self payloadCountOfFacade:self.facade], 1u);
+    [self.facade handleActionWithIdentifier:@"open" forLocalNotification:dailyNotification completionHandler:nil];
+    XCTAssertEqualObjects(lists.lastObject, @"chores");
+}
+
+- (void)testUnhandledPayloadsAreSweptWhenIndexIsLoaded
+{
+    NSURL *const directoryURL = self.temporaryDirectoryURL;
+    self.facade.payloadStoreDirectoryURL = directoryURL;
+    [self schedulePayloadNotificationWithIdentifier:@"delivered" delay:60 list:@"groceries"];
+    UILocalNotification *const keptNotification = [self schedulePayloadNotificationWithIdentifier:@"kept"
+                                                                                           delay:120
+                                                                                            list:@"chores"];
+    XCTAssertEqual([self payloadCountOfFacade:self.facade], 2u);
+    // "delivered" fires while the application is not running, so it is never handled.
+    self.application.now = MRTestReferenceTime + 90;
+    MRLocalNotificationFacade *const facade = MRTestFacadeWithApplication(self.application);
+    facade.payloadStoreDirectoryURL = directoryURL;
+    XCTAssertNotNil([facade scheduledNotificationWithIdentifier:@"kept"]);
+    XCTAssertEqual([self payloadCountOfFacade:facade], 1u);
+    XCTAssertEqualObjects([facade getUserInfoFromNotification:keptNotification][@"list"], @"chores");
+}
+
+
+#pragma mark Pipeline
+
+- (dispatch_block_t)installPipelineCommitExecutor
+{
+    NSMutableArray *const pendingCommits = NSMutableArray.array;
+    self.facade.commitExecutor = ^(dispatch_block_t const block) {
+        @synchronized(pendingCommits) {
+            [pendingCommits addObject:block];
+        }
+    };
+    MRLocalNotificationFacade *const facade = self.facade;
+    return ^{
+        dispatch_sync(facade.pipelineQueue, ^{});
+        NSArray *commits;
+        @synchronized(pendingCommits) {
+            commits = pendingCommits.copy;
+            [pendingCommits removeAllObjects];
+        }
+        for (dispatch_block_t const commit in commits) {
+            commit();
+        }
+    };
+}
+
+- (void)testPipelineValidatesAgainstSettingsOfPreviousCommit
+{
+    dispatch_block_t const commit = [self installPipelineCommitExecutor];
+    [self.facade enqueueScheduleNotification:MRTestNotification(@"first", 60) completion:nil];
+    commit();
+    __block NSInteger pastCode = 0;
+    __block BOOL scheduled = NO;
+    __block NSInteger duplicateCode = 0;
+    [self.facade enqueueScheduleNotification:MRTestNotification(@"past", -60)
+                                  completion:^(BOOL const success, NSError *const error) {
+                                      pastCode = (success ? 0 : error.code);
+                                  }];
+    [self.facade enqueueScheduleNotification:MRTestNotification(@"second", 120)
+                                  completion:^(BOOL const success, NSError *const error) {
+                                      scheduled = success;
+                                  }];
+    [self.facade enqueueScheduleNotification:MRTestNotification(@"first", 60)
+                                  completion:^(BOOL const success, NSError *const error) {
+                                      duplicateCode = (success ? 0 : error.code);
+                                  }];
+    [self.application resetCounters];
+    commit();
+    XCTAssertEqual(pastCode, MRLocalNotificationErrorInvalidDate);
+    XCTAssertTrue(scheduled);
+    XCTAssertEqual(duplicateCode, MRLocalNotificationErrorAlreadyScheduled);
+    XCTAssertEqual(self.application.scheduleCount, 1u);
+    XCTAssertEqual(self.application.fetchCount, 0u);
+}
+
+- (void)testPipelineValidatesAgainAfterSettingsChange
+{
+    dispatch_block_t const commit = [self installPipelineCommitExecutor];
+    [self.facade enqueueScheduleNotification:MRTestNotification(@"first", 60) completion:nil];
+    commit();
+    __block NSError *soundError;
+    UILocalNotification *const notification = MRTestNotification(@"sound", 120);
+    notification.soundName = UILocalNotificationDefaultSoundName;
+    [self.facade enqueueScheduleNotification:notification
+                                  completion:^(BOOL const success, NSError *const error) {
+                                      soundError = error;
+                                  }];
+    dispatch_sync(self.facade.pipelineQueue, ^{});
+    self.application.allowedTypes = UIUserNotificationTypeAlert;
+    [self.facade handleDidRegisterUserNotificationSettings:self.application.currentUserNotificationSettings];
+    commit();
+    XCTAssertEqual(soundError.code, MRLocalNotificationErrorSoundNotAllowed);
+}
+
+
+#pragma mark Automatic badges
+
+- (NSInteger)badgeOfNotificationWithIdentifier:(NSString *const)identifier
+{
+    return [self.facade scheduledNotificationWithIdentifier:identifier].applicationIconBadgeNumber;
+}
+
+- (void)testBadgeBaseOnlyMovesWhenNonRepeatingNotificationIsDelivered
+{
+    self.facade.automaticBadges = YES;
+    UILocalNotification *const repeatingNotification = MRTestNotification(@"daily", 30);
+    repeatingNotification.repeatInterval = NSCalendarUnitDay;
+    XCTAssertTrue([self.facade scheduleNotification:repeatingNotification withError:NULL]);
+    XCTAssertTrue([self.facade scheduleNotification:MRTestNotification(@"first", 60) withError:NULL]);
+    XCTAssertTrue([self.facade scheduleNotification:MRTestNotification(@"second", 120) withError:NULL]);
+    XCTAssertEqual([self badgeOfNotificationWithIdentifier:@"daily"], 1);
+    XCTAssertEqual([self badgeOfNotificationWithIdentifier:@"first"], 2);
+    XCTAssertEqual([self badgeOfNotificationWithIdentifier:@"second"], 3);
+    self.application.now = MRTestReferenceTime + 45;
+    XCTAssertEqualObjects([self.facade getIdentifierFromNotification:self.facade.nextScheduledNotification], @"first");
+    XCTAssertEqual(self.facade.automaticBadgeBase, 0);
+    XCTAssertEqual([self badgeOfNotificationWithIdentifier:@"first"], 1);
+    XCTAssertEqual([self badgeOfNotificationWithIdentifier:@"second"], 2);
+    XCTAssertEqual([self badgeOfNotificationWithIdentifier:@"daily"], 3);
+    self.application.now = MRTestReferenceTime + 90;
+    XCTAssertEqualObjects([self.facade getIdentifierFromNotification:self.facade.nextScheduledNotification], @"second");
+    XCTAssertEqual(self.facade.automaticBadgeBase, 1);
+    XCTAssertEqual([self badgeOfNotificationWithIdentifier:@"second"], 2);
+    XCTAssertEqual([self badgeOfNotificationWithIdentifier:@"daily"], 3);
+}
+
+- (void)testPruningSequencesBadgesOnce
+{
+    self.facade.automaticBadges = YES;
+    NSUInteger const count = 10;
+    for (NSUInteger index = 0; index < count; index++) {
+        NSString *const identifier = [NSString stringWithFormat:@"%lu", (unsigned long)index];
+        UILocalNotification *const notification = MRTestNotification(identifier, 10*(index + 1));
+        notification.repeatInterval = NSCalendarUnitDay;
+        XCTAssertTrue([self.facade scheduleNotification:notification withError:NULL]);
+    }
+    XCTAssertTrue([self.facade scheduleNotification:MRTestNotification(@"last", 200) withError:NULL]);
+    XCTAssertEqual([self badgeOfNotificationWithIdentifier:@"last"], 11);
+    NSUInteger const scheduleCount = self.application.scheduleCount;
+    self.application.now = MRTestReferenceTime + 150;
+    XCTAssertEqualObjects([self.facade getIdentifierFromNotification:self.facade.nextScheduledNotification], @"last");
+    // Every notification moves, but each one is rescheduled only once.
+    XCTAssertEqual(self.application.scheduleCount - scheduleCount, count + 1);
+    XCTAssertEqual([self badgeOfNotificationWithIdentifier:@"last"], 1);
+    XCTAssertEqual([self badgeOfNotificationWithIdentifier:@"0"], 2);
+    XCTAssertEqual([self badgeOfNotificationWithIdentifier:@"9"], 11);
+}
+
+#pragma mark Journal
+
+- (void)testJournaledNotificationsAreReplayedByNewFacade
+{
+    NSString *const path = [NSTemporaryDirectory() stringByAppendingPathComponent:NSUUID.UUID.UUIDString];
+    NSURL *const directoryURL = [NSURL fileURLWithPath:path isDirectory:YES];
+    self.facade.journalDirectoryURL = directoryURL;
+    for (NSUInteger index = 0; index < 3; index++) {
+        NSString *const identifier = [NSString stringWithFormat:@"%lu", (unsigned long)index];
+        XCTAssertTrue([self.facade scheduleNotification:MRTestNotification(identifier, 60*(index + 1))
+                                              withError:NULL]);
+    }
+    [self.facade cancelNotification:[self.facade scheduledNotificationWithIdentifier:@"1"]];
+    XCTAssertEqual(self.facade.journaledNotifications.count, 2u);
+    MRLocalNotificationFacade *const facade = MRTestFacadeWithApplication(self.application);
+    facade.journalDirectoryURL = directoryURL;
+    NSMutableArray *const identifiers = NSMutableArray.array;
+    for (UILocalNotification *const notification in facade.journaledNotifications) {
+        [identifiers addObject:[facade getIdentifierFromNotification:notification]];
+    }
+    [identifiers sortUsingSelector:@selector(compare:)];
+    XCTAssertEqualObjects(identifiers, (@[ @"0", @"2" ]));
+    self.application.now = MRTestReferenceTime + 90;
+    XCTAssertEqual(facade.journaledNotifications.count, 1u);
+    [NSFileManager.defaultManager removeItemAtURL:directoryURL error:NULL];
+}
+
+
+#pragma mark Error codes
+
+- (void)testErrorCodeIsLeftUntouchedForValidNotification
+{
+    MRLocalNotificationErrorCode code = MRLocalNotificationErrorUnknown;
+    XCTAssertTrue([self.facade canScheduleNotification:MRTestNotification(@"valid", 60)
+                                          withRecovery:NO
+                                             errorCode:&code]);
+    XCTAssertEqual(code, MRLocalNotificationErrorUnknown);
+}
+
+- (void)testErrorCodesMatchErrors
+{
+    [self.application addScheduledNotificationsWithCount:1 identifiers:YES];
+    UILocalNotification *const missingDateNotification = MRTestNotification(@"missing-date", 60);
+    missingDateNotification.fireDate = nil;
+    UILocalNotification *const missingAlertBodyNotification = MRTestNotification(@"missing-alert-body", 60);
+    missingAlertBodyNotification.alertBody = nil;
+    NSArray *const notifications = @[ MRTestNotification(@"past", -60),
+                                      missingDateNotification,
+                                      missingAlertBodyNotification,
+                                      MRTestNotification(@"existing-0", 60) ];
+    MRLocalNotificationErrorCode const expectedCodes[] = { MRLocalNotificationErrorInvalidDate,
+                                                           MRLocalNotificationErrorMissingDate,
+                                                           MRLocalNotificationErrorMissingAlertBody,
+                                                           MRLocalNotificationErrorAlreadyScheduled };
+    [notifications enumerateObjectsUsingBlock:^(UILocalNotification *const notification, NSUInteger const index, BOOL *const stop) {
+        MRLocalNotificationErrorCode code = 0;
+        XCTAssertFalse([self.facade canScheduleNotification:notification withRecovery:YES errorCode:&code]);
+        XCTAssertEqual(code, expectedCodes[index]);
+        NSError *error;
+        XCTAssertFalse([self.facade canScheduleNotification:notification withRecovery:YES error:&error]);
+        XCTAssertEqualObjects(error.domain, MRLocalNotificationErrorDomain);
+        XCTAssertEqual(error.code, code);
+        XCTAssertEqualObjects(error.localizedFailureReason, [self.facade buildErrorWithCode:code].localizedFailureReason);
+    }];
+}
+
+- (void)testRecoverableErrorCode
+{
+    self.application.allowedTypes = UIUserNotificationTypeAlert;
+    UILocalNotification *const notification = MRTestNotification(@"sound", 60);
+    notification.soundName = UILocalNotificationDefaultSoundName;
+    MRLocalNotificationErrorCode code = 0;
+    XCTAssertTrue([self.facade canScheduleNotification:notification withRecovery:YES errorCode:&code]);
+    XCTAssertEqual(code, MRLocalNotificationErrorSoundNotAllowed);
+    code = 0;
+    XCTAssertFalse([self.facade canScheduleNotification:notification withRecovery:NO errorCode:&code]);
+    XCTAssertEqual(code, MRLocalNotificationErrorSoundNotAllowed);
+}
+
+- (void)testErrorIsOnlyBuiltWhenRequested
+{
+    self.facade.contactSupportURL = [NSURL URLWithString:@"mailto:support@example.com"];
+    UILocalNotification *const notification = MRTestNotification(@"past", -60);
+    MRLocalNotificationErrorCode code = 0;
+    XCTAssertFalse([self.facade canScheduleNotification:notification withRecovery:YES errorCode:&code]);
+    XCTAssertFalse([self.facade canScheduleNotification:notification withRecovery:YES error:NULL]);
+    XCTAssertEqual(self.application.canOpenURLCount, 0u);
+    NSError *error;
+    XCTAssertFalse([self.facade canScheduleNotification:notification withRecovery:YES error:&error]);
+    XCTAssertNotNil(error);
+    XCTAssertEqual(self.application.canOpenURLCount, 1u);
+}
+
+
+#pragma mark Action handlers
+
+- (UILocalNotification *)actionNotificationWithCategory:(NSString *const)category
+{
+    UILocalNotification *const notification = MRTestNotification(@"action", 60);
+    notification.category = category;
+    return notification;
+}
+
+- (void)testSetNotificationHandlerReplacesOnlyPreviousSetHandler
+{
+    NSMutableArray *const calls = NSMutableArray.array;
+    [self.facade setNotificationHandler:^(NSString *const identifier, UILocalNotification *const notification) {
+        [calls addObject:@"first"];
+    } forActionWithIdentifier:@"open"];
+    [self.facade addNotificationHandler:^(NSString *const identifier, UILocalNotification *const notification) {
+        [calls addObject:@"added"];
+    } forActionWithIdentifier:@"open"];
+    [self.facade setNotificationHandler:^(NSString *const identifier, UILocalNotification *const notification) {
+        [calls addObject:@"second"];
+    } forActionWithIdentifier:@"open"];
+    __block BOOL completed = NO;
+    [self.facade handleActionWithIdentifier:@"open"
+                       forLocalNotification:[self actionNotificationWithCategory:nil]
+                          completionHandler:^{
+                              completed = YES;
+                          }];
+    XCTAssertTrue(completed);
+    XCTAssertEqualObjects(calls, (@[ @"added", @"second" ]));
+    [calls removeAllObjects];
+    [self.facade setNotificationHandler:nil forActionWithIdentifier:@"open"];
+    [self.facade handleActionWithIdentifier:@"open"
+                       forLocalNotification:[self actionNotificationWithCategory:nil]
+                          completionHandler:nil];
+    XCTAssertEqualObjects(calls, (@[ @"added" ]));
+}
+
+- (void)testPrefixAndCategoryHandlers
+{
+    NSMutableArray *const calls = NSMutableArray.array;
+    [self.facade addNotificationHandler:^(NSString *const identifier, UILocalNotification *const notification) {
+        [calls addObject:[@"exact " stringByAppendingString:identifier]];
+    } forActionWithIdentifier:@"reply.later"];
+    [self.facade addNotificationHandler:^(NSString *const identifier, UILocalNotification *const notification) {
+        [calls addObject:[@"category " stringByAppendingString:identifier]];
+    } forActionWithIdentifier:nil category:@"message"];
+    [self.facade addNotificationHandler:^(NSString *const identifier, UILocalNotification *const notification) {
+        [calls addObject:[@"category action " stringByAppendingString:identifier]];
+    } forActionWithIdentifier:@"reply.now" category:@"message"];
+    [self.facade addNotificationHandler:^(NSString *const identifier, UILocalNotification *const notification) {
+        [calls addObject:[@"prefix " stringByAppendingString:identifier]];
+    } forActionWithIdentifierPrefix:@"reply."];
+    [self.facade handleActionWithIdentifier:@"reply.later"
+                       forLocalNotification:[self actionNotificationWithCategory:@"message"]
+                          completionHandler:nil];
+    XCTAssertEqualObjects(calls, (@[ @"exact reply.later", @"category reply.later", @"prefix reply.later" ]));
+    [calls removeAllObjects];
+    [self.facade handleActionWithIdentifier:@"reply.now"
+                       forLocalNotification:[self actionNotificationWithCategory:@"reminder"]
+                          completionHandler:nil];
+    XCTAssertEqualObjects(calls, (@[ @"prefix reply.now" ]));
+    [calls removeAllObjects];
+    [self.facade handleActionWithIdentifier:@"reply.now"
+                       forLocalNotification:[self actionNotificationWithCategory:@"message"]
+                          completionHandler:nil];
+    XCTAssertEqualObjects(calls, (@[ @"category reply.now", @"category action reply.now", @"prefix reply.now" ]));
+}
+
+- (void)testRemoveNotificationHandler
+{
+    __block NSUInteger calls = 0;
+    id<NSObject> const token = [self.facade addNotificationHandler:^(NSString *const identifier, UILocalNotification *const notification) {
+        calls += 1;
+    } forActionWithIdentifierPrefix:@""];
+    UILocalNotification *const notification = [self actionNotificationWithCategory:nil];
+    [self.facade handleActionWithIdentifier:@"open" forLocalNotification:notification completionHandler:nil];
+    [self.facade removeNotificationHandler:token];
+    [self.facade handleActionWithIdentifier:@"open" forLocalNotification:notification completionHandler:nil];
+    XCTAssertEqual(calls, 1u);
+}
+
+- (void)testConcurrentHandlersCompleteOnce
+{
+    self.facade.concurrentActionHandlers = YES;
+    __block int32_t calls = 0;
+    for (NSUInteger index = 0; index < 8; index++) {
+        [self.facade addNotificationHandler:^(NSString *const identifier, UILocalNotification *const notification) {
+            [NSThread sleepForTimeInterval:0.01];
+            __atomic_add_fetch(&calls, 1, __ATOMIC_RELAXED);
+        } forActionWithIdentifier:@"open"];
+    }
+    XCTestExpectation *const expectation = [self expectationWithDescription:@"completion"];
+    [self.facade handleActionWithIdentifier:@"open"
+                       forLocalNotification:[self actionNotificationWithCategory:nil]
+                          completionHandler:^{
+                              XCTAssertTrue(NSThread.isMainThread);
+                              XCTAssertEqual(__atomic_load_n(&calls, __ATOMIC_RELAXED), 8);
+                              [expectation fulfill];
+                          }];
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+}
+
+- (void)testRegistrationWhileDispatching
+{
+    MRLocalNotificationFacade *const facade = self.facade;
+    UILocalNotification *const notification = [self actionNotificationWithCategory:@"message"];
+    __block int32_t permanentCalls = 0;
+    [facade addNotificationHandler:^(NSString *const actionIdentifier, UILocalNotification *const actionNotification) {
+        __atomic_add_fetch(&permanentCalls, 1, __ATOMIC_RELAXED);
+    } forActionWithIdentifier:@"open"];
+    NSUInteger const operations = 500;
+    dispatch_apply(8, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t const iteration) {
+        for (NSUInteger index = 0; index < operations; index++) {
+            if (iteration % 2 == 0) {
+                id<NSObject> const token = [facade addNotificationHandler:^(NSString *const actionIdentifier, UILocalNotification *const actionNotification) {
+                } forActionWithIdentifier:@"open" category:@"message"];
+                [facade removeNotificationHandler:token];
+            } else {
+                [facade handleActionWithIdentifier:@"open" forLocalNotification:notification completionHandler:nil];
+            }
+        }
+    });
+    XCTAssertEqual(permanentCalls, (int32_t)(4*operations));
+}
+
+#pragma mark Templates
+
+- (UILocalNotification *)templateNotification
+{
+    UILocalNotification *const notification = MRTestNotification(@"template", 60);
+    notification.category = @"reminder";
+    notification.alertAction = @"Open";
+    notification.soundName = UILocalNotificationDefaultSoundName;
+    notification.applicationIconBadgeNumber = 1;
+    notification.repeatInterval = NSCalendarUnitWeekOfYear;
+    notification.userInfo = @{ MRLocalNotificationIdentifierKey: @"template", @"list": @"groceries" };
+    return notification;
+}
+
+- (void)testTemplateNotificationsShareThePrototypeFields
+{
+    UILocalNotification *const notification = self.templateNotification;
+    NSError *error;
+    MRLocalNotificationTemplate *const notificationTemplate = [self.facade buildTemplateWithNotification:notification
+                                                                                           badgeIncrement:0
+                                                                                                    error:&error];
+    XCTAssertNotNil(notificationTemplate);
+    XCTAssertNil(error);
+    XCTAssertNil(notificationTemplate.prototype.fireDate);
+    XCTAssertEqualObjects(notificationTemplate.prototype.userInfo, @{ @"list": @"groceries" });
+    NSArray *const fireDates = @[ [NSDate dateWithTimeIntervalSinceReferenceDate:MRTestReferenceTime + 60],
+                                  [NSDate dateWithTimeIntervalSinceReferenceDate:MRTestReferenceTime + 120] ];
+    NSArray *const notifications = [self.facade buildNotificationsWithTemplate:notificationTemplate
+                                                                      fireDates:fireDates];
+    XCTAssertEqual(notifications.count, fireDates.count);
+    [notifications enumerateObjectsUsingBlock:^(UILocalNotification *const builtNotification, NSUInteger const index, BOOL *const stop) {
+        XCTAssertEqualObjects(builtNotification.fireDate, fireDates[index]);
+        XCTAssertEqualObjects(builtNotification.category, notification.category);
+        XCTAssertEqualObjects(builtNotification.alertBody, notification.alertBody);
+        XCTAssertEqualObjects(builtNotification.alertAction, notification.alertAction);
+        XCTAssertEqualObjects(builtNotification.soundName, notification.soundName);
+        XCTAssertEqual(builtNotification.applicationIconBadgeNumber, notification.applicationIconBadgeNumber);
+        XCTAssertEqual(builtNotification.repeatInterval, notification.repeatInterval);
+        XCTAssertEqualObjects(builtNotification.userInfo, notificationTemplate.prototype.userInfo);
+        XCTAssertNil([self.facade getIdentifierFromNotification:builtNotification]);
+    }];
+}
+
+- (void)testTemplateNotificationsWithIdentifiersCanAllBeScheduled
+{
+    MRLocalNotificationTemplate *const notificationTemplate = [self.facade buildTemplateWithNotification:self.templateNotification
+                                                                                           badgeIncrement:0
+                                                                                                    error:NULL];
+    NSTimeInterval const fireIntervals[] = { 60, 120, 180 };
+    NSArray *const identifiers = @[ @"first", @"second", @"third" ];
+    NSArray *const notifications = [self.facade buildNotificationsWithTemplate:notificationTemplate
+                                                                  fireIntervals:fireIntervals
+                                                                          count:3
+                                                                    identifiers:identifiers];
+    NSArray *errors;
+    NSIndexSet *const scheduledIndexes = [self.facade scheduleNotifications:notifications errors:&errors];
+    XCTAssertEqualObjects(scheduledIndexes, [NSIndexSet indexSetWithIndexesInRange:NSMakeRange(0, 3)]);
+    for (NSUInteger index = 0; index < identifiers.count; index++) {
+        UILocalNotification *const notification = [self.facade scheduledNotificationWithIdentifier:identifiers[index]];
+        XCTAssertEqual(notification.fireDate.timeIntervalSinceReferenceDate, MRTestReferenceTime + fireIntervals[index]);
+        XCTAssertEqualObjects([self.facade getUserInfoFromNotification:notification][@"list"], @"groceries");
+    }
+    NSArray *const cancelledNotifications = [self.facade cancelNotificationsWithCategory:@"reminder"];
+    XCTAssertEqual(cancelledNotifications.count, 3u);
+    XCTAssertEqual(self.application.scheduledLocalNotifications.count, 0u);
+}
+
+- (void)testTemplateBadgeIncrementAndFireIntervals
+{
+    MRLocalNotificationTemplate *const notificationTemplate = [self.facade buildTemplateWithNotification:self.templateNotification
+                                                                                           badgeIncrement:2
+                                                                                                    error:NULL];
+    NSTimeInterval const fireIntervals[] = { 60, 3600, 86400 };
+    NSArray *const notifications = [self.facade buildNotificationsWithTemplate:notificationTemplate
+                                                                  fireIntervals:fireIntervals
+                                                                          count:3];
+    XCTAssertEqual(notifications.count, 3u);
+    for (NSUInteger index = 0; index < notifications.count; index++) {
+        UILocalNotification *const notification = notifications[index];
+        XCTAssertEqual(notification.fireDate.timeIntervalSinceReferenceDate, MRTestReferenceTime + fireIntervals[index]);
+        XCTAssertEqual(notification.applicationIconBadgeNumber, (NSInteger)(1 + 2*index));
+    }
+}
+
+- (void)testTemplateIsValidatedAgainstSettings
+{
+    self.application.allowedTypes = (UIUserNotificationTypeAlert | UIUserNotificationTypeBadge);
+    NSError *error;
+    MRLocalNotificationTemplate *notificationTemplate = [self.facade buildTemplateWithNotification:self.templateNotification
+                                                                                     badgeIncrement:0
+                                                                                              error:&error];
+    XCTAssertNotNil(notificationTemplate);
+    XCTAssertEqual(error.code, MRLocalNotificationErrorSoundNotAllowed);
+    UILocalNotification *const notification = self.templateNotification;
+    notification.alertBody = nil;
+    notification.applicationIconBadgeNumber = 0;
+    error = nil;
+    notificationTemplate = [self.facade buildTemplateWithNotification:notification badgeIncrement:0 error:&error];
+    XCTAssertNil(notificationTemplate);
+    XCTAssertEqual(error.code, MRLocalNotificationErrorMissingAlertBody);
+}
+
+#pragma mark Metrics
+
+- (NSUInteger)metricsCountForApplicationCall:(NSString *const)name
+{
+    return [self.facade.metricsSnapshot[MRLocalNotificationMetricsApplicationCallsKey][name] unsignedIntegerValue];
+}
+
+- (NSUInteger)metricsCountForOperation:(NSString *const)name
+{
+    return [self.facade.metricsSnapshot[MRLocalNotificationMetricsLatenciesKey][name][@"count"] unsignedIntegerValue];
+}
+
+- (void)exerciseFacadeForMetrics
+{
+    for (NSUInteger index = 0; index < 10; index++) {
+        NSString *const identifier = [NSString stringWithFormat:@"metrics-%lu", (unsigned long)index];
+        XCTAssertTrue([self.facade scheduleNotification:MRTestNotification(identifier, 60*(index + 1)) withError:NULL]);
+    }
+    for (NSUInteger index = 0; index < 3; index++) {
+        NSString *const identifier = [NSString stringWithFormat:@"metrics-%lu", (unsigned long)index];
+        [self.facade cancelNotification:[self.facade scheduledNotificationWithIdentifier:identifier]];
+    }
+    XCTAssertEqual(self.facade.scheduledNotifications.count, 7u);
+    NSError *error;
+    XCTAssertFalse([self.facade canScheduleNotification:MRTestNotification(@"past", -60) withRecovery:NO error:&error]);
+    XCTAssertEqual(error.code, MRLocalNotificationErrorInvalidDate);
+    UILocalNotification *const silentNotification = MRTestNotification(@"silent", 60);
+    silentNotification.alertBody = nil;
+    MRLocalNotificationErrorCode code = 0;
+    XCTAssertFalse([self.facade canScheduleNotification:silentNotification withRecovery:NO errorCode:&code]);
+    XCTAssertEqual(code, MRLocalNotificationErrorMissingAlertBody);
+}
+
+- (void)testMetricsCountApplicationCallsAndErrorCodes
+{
+    self.facade.instrumentationEnabled = YES;
+    self.facade.contactSupportURL = [NSURL URLWithString:@"mailto:support@example.com"];
+    [self.application resetCounters];
+    [self exerciseFacadeForMetrics];
+    XCTAssertEqual([self metricsCountForApplicationCall:@"scheduledLocalNotifications"], self.application.fetchCount);
+    XCTAssertEqual([self metricsCountForApplicationCall:@"scheduleLocalNotification"], self.application.scheduleCount);
+    XCTAssertEqual([self metricsCountForApplicationCall:@"cancelLocalNotification"], self.application.cancelCount);
+    XCTAssertEqual([self metricsCountForApplicationCall:@"canOpenURL"], self.application.canOpenURLCount);
+    XCTAssertEqual(self.application.scheduleCount, 10u);
+    XCTAssertEqual(self.application.cancelCount, 3u);
+    XCTAssertGreaterThan(self.application.canOpenURLCount, 0u);
+    XCTAssertEqual([self metricsCountForOperation:@"schedule"], 10u);
+    XCTAssertEqual([self metricsCountForOperation:@"cancel"], 3u);
+    XCTAssertGreaterThanOrEqual([self metricsCountForOperation:@"validate"], 12u);
+    NSDictionary *const errors = self.facade.metricsSnapshot[MRLocalNotificationMetricsErrorsKey];
+    XCTAssertEqualObjects(errors, (@{ @(MRLocalNotificationErrorInvalidDate): @1,
+                                      @(MRLocalNotificationErrorMissingAlertBody): @1 }));
+}
+
+- (void)testDisabledInstrumentationDoesNotCount
+{
+    XCTAssertEqualObjects(self.facade.metricsSnapshot, @{});
+    [self exerciseFacadeForMetrics];
+    XCTAssertEqualObjects(self.facade.metricsSnapshot, @{});
+    self.facade.instrumentationEnabled = YES;
+    XCTAssertEqual([self metricsCountForApplicationCall:@"scheduleLocalNotification"], 0u);
+    XCTAssertEqual([self metricsCountForOperation:@"schedule"], 0u);
+    XCTAssertEqual([self.facade.metricsSnapshot[MRLocalNotificationMetricsErrorsKey] count], 0u);
+    [self.application resetCounters];
+    XCTAssertTrue([self.facade scheduleNotification:MRTestNotification(@"enabled", 60) withError:NULL]);
+    XCTAssertEqual([self metricsCountForApplicationCall:@"scheduleLocalNotification"], self.application.scheduleCount);
+    self.facade.instrumentationEnabled = NO;
+    XCTAssertTrue([self.facade scheduleNotification:MRTestNotification(@"disabled", 60) withError:NULL]);
+    XCTAssertEqualObjects(self.facade.metricsSnapshot, @{});
+}
+
+- (void)testResetMetricsZeroesCounters
+{
+    self.facade.instrumentationEnabled = YES;
+    [self exerciseFacadeForMetrics];
+    [self.facade resetMetrics];
+    NSDictionary *const snapshot = self.facade.metricsSnapshot;
+    for (NSNumber *const count in [snapshot[MRLocalNotificationMetricsApplicationCallsKey] allValues]) {
+        XCTAssertEqual(count.integerValue, 0);
+    }
+    NSDictionary *const latencies = snapshot[MRLocalNotificationMetricsLatenciesKey];
+    for (NSString *const operation in latencies) {
+        XCTAssertEqual([latencies[operation][@"count"] integerValue], 0);
+        XCTAssertEqual([latencies[operation][@"nanoseconds"] integerValue], 0);
+        for (NSNumber *const count in latencies[operation][@"histogram"]) {
+            XCTAssertEqual(count.integerValue, 0);
+        }
+    }
+    XCTAssertEqual([snapshot[MRLocalNotificationMetricsErrorsKey] count], 0u);
+    XCTAssertNotNil(snapshot[MRLocalNotificationMetricsStartupKey][@"init"]);
+    [self.facade cancelAllNotifications];
+    [self.application resetCounters];
+    [self exerciseFacadeForMetrics];
+    XCTAssertEqual([self metricsCountForApplicationCall:@"scheduleLocalNotification"], self.application.scheduleCount);
+}
+
+
+#pragma mark Bulk cancellation
+
+- (void)scheduleNotificationWithIdentifier:(NSString *const)identifier
+                                     delay:(NSTimeInterval const)delay
+                                  category:(NSString *const)category
+{
+    UILocalNotification *const notification = MRTestNotification(identifier, delay);
+    notification.category = category;
+    XCTAssertTrue([self.facade scheduleNotification:notification withError:NULL]);
+}
+
+- (NSArray *)identifiersOfNotifications:(NSArray *const)notifications
+{
+    NSMutableArray *const identifiers = NSMutableArray.array;
+    for (UILocalNotification *const notification in notifications) {
+        [identifiers addObject:([self.facade getIdentifierFromNotification:notification] ?: NSNull.null)];
+    }
+    [identifiers sortUsingSelector:@selector(compare:)];
+    return identifiers;
+}
+
+- (void)testCancelNotificationsWithFireDateRangeBoundaries
+{
+    [self scheduleNotificationWithIdentifier:@"060" delay:60 category:nil];
+    [self scheduleNotificationWithIdentifier:@"120" delay:120 category:nil];
+    [self scheduleNotificationWithIdentifier:@"180" delay:180 category:nil];
+    [self scheduleNotificationWithIdentifier:@"240" delay:240 category:nil];
+    NSDate *const startDate = [NSDate dateWithTimeIntervalSinceReferenceDate:MRTestReferenceTime + 120];
+    NSDate *const endDate = [NSDate dateWithTimeIntervalSinceReferenceDate:MRTestReferenceTime + 240];
+    NSArray *const cancelledNotifications = [self.facade cancelNotificationsWithFireDateFrom:startDate to:endDate];
+    XCTAssertEqualObjects([self identifiersOfNotifications:cancelledNotifications], (@[ @"120", @"180" ]));
+    XCTAssertEqualObjects(self.identifiersOfScheduledLocalNotifications, (@[ @"060", @"240" ]));
+    XCTAssertEqual([self.facade cancelNotificationsWithFireDateFrom:startDate to:startDate].count, 0u);
+}
+
+- (void)testCancelNotificationsWithCategory
+{
+    [self scheduleNotificationWithIdentifier:@"first" delay:60 category:@"reminder"];
+    [self scheduleNotificationWithIdentifier:@"second" delay:120 category:@"reminder"];
+    [self scheduleNotificationWithIdentifier:@"message" delay:180 category:@"message"];
+    [self scheduleNotificationWithIdentifier:@"plain" delay:240 category:nil];
+    XCTAssertEqual([self.facade cancelNotificationsWithCategory:@"missing"].count, 0u);
+    XCTAssertEqual([self.facade cancelNotificationsWithCategory:@"Reminder"].count, 0u);
+    NSArray *const cancelledNotifications = [self.facade cancelNotificationsWithCategory:@"reminder"];
+    XCTAssertEqualObjects([self identifiersOfNotifications:cancelledNotifications], (@[ @"first", @"second" ]));
+    XCTAssertEqualObjects(self.identifiersOfScheduledLocalNotifications, (@[ @"message", @"plain" ]));
+    XCTAssertEqual([self.facade cancelNotificationsWithCategory:@"reminder"].count, 0u);
+}
+
+- (void)testBulkCancellationIgnoresNotificationsWithoutIdentifiers
+{
+    [self scheduleNotificationWithIdentifier:nil delay:60 category:@"reminder"];
+    [self scheduleNotificationWithIdentifier:@"identified" delay:120 category:@"reminder"];
+    NSDate *const startDate = [NSDate dateWithTimeIntervalSinceReferenceDate:MRTestReferenceTime];
+    XCTAssertEqual([self.facade cancelNotificationsMatchingPredicate:[NSPredicate predicateWithValue:YES]].count, 1u);
+    XCTAssertEqual([self.facade cancelNotificationsWithCategory:@"reminder"].count, 0u);
+    XCTAssertEqual([self.facade cancelNotificationsWithFireDateFrom:startDate to:NSDate.distantFuture].count, 0u);
+    NSArray *const scheduledNotifications = self.application.scheduledLocalNotifications;
+    XCTAssertEqual(scheduledNotifications.count, 1u);
+    XCTAssertNil([self.facade getIdentifierFromNotification:scheduledNotifications.firstObject]);
+}
+
+- (void)testBulkCancellationUpdatesIndexes
+{
+    NSString *const path = [NSTemporaryDirectory() stringByAppendingPathComponent:NSUUID.UUID.UUIDString];
+    NSURL *const directoryURL = [NSURL fileURLWithPath:path isDirectory:YES];
+    self.facade.journalDirectoryURL = directoryURL;
+    [self scheduleNotificationWithIdentifier:@"060" delay:60 category:@"reminder"];
+    [self scheduleNotificationWithIdentifier:@"120" delay:120 category:@"reminder"];
+    [self scheduleNotificationWithIdentifier:@"180" delay:180 category:@"message"];
+    NSPredicate *const predicate = [NSPredicate predicateWithFormat:@"alertBody CONTAINS '120'"];
+    NSArray *const cancelledNotifications = [self.facade cancelNotificationsMatchingPredicate:predicate];
+    XCTAssertEqualObjects([self identifiersOfNotifications:cancelledNotifications], (@[ @"120" ]));
+    XCTAssertNil([self.facade scheduledNotificationWithIdentifier:@"120"]);
+    XCTAssertEqualObjects([self identifiersOfNotifications:self.facade.journaledNotifications], (@[ @"060", @"180" ]));
+    NSDate *const startDate = [NSDate dateWithTimeIntervalSinceReferenceDate:MRTestReferenceTime];
+    NSArray *const firingNotifications = [self.facade scheduledNotificationsFiringFrom:startDate
+                                                                                    to:NSDate.distantFuture];
+    XCTAssertEqualObjects([self identifiersOfNotifications:firingNotifications], (@[ @"060", @"180" ]));
+    [self.facade cancelNotificationsWithFireDateFrom:startDate
+                                                  to:[NSDate dateWithTimeIntervalSinceReferenceDate:MRTestReferenceTime + 90]];
+    XCTAssertEqualObjects([self identifiersOfNotifications:self.facade.journaledNotifications], (@[ @"180" ]));
+    XCTAssertEqual([self.facade cancelNotificationsWithCategory:@"reminder"].count, 0u);
+    XCTAssertEqualObjects([self.facade getIdentifierFromNotification:self.facade.nextScheduledNotification], @"180");
+    XCTAssertEqualObjects(self.identifiersOfScheduledLocalNotifications, (@[ @"180" ]));
+    [NSFileManager.defaultManager removeItemAtURL:directoryURL error:NULL];
+}
+
+
+#pragma mark Startup
+
+- (void)testDeferHandlingOfNotificationFromLaunchOptions
+{
+    XCTAssertNil([MRLocalNotificationFacade deferHandlingOfNotificationFromLaunchOptions:nil]);
+    NSDictionary *launchOptions = @{ UIApplicationLaunchOptionsLocalNotificationKey: @"launch" };
+    XCTAssertNil([MRLocalNotificationFacade deferHandlingOfNotificationFromLaunchOptions:launchOptions]);
+    MRLocalNotificationFacade *const facade = MRLocalNotificationFacade.defaultInstance;
+    facade.defaultApplication = (UIApplication *)self.application;
+    XCTestExpectation *const expectation = [self expectationWithDescription:@"handled"];
+    __block UILocalNotification *handledNotification;
+    __block BOOL handledShouldShowAlert = YES;
+    facade.onDidReceiveNotification = ^(UILocalNotification *const notification, BOOL *const shouldShowAlert) {
+        XCTAssertTrue(NSThread.isMainThread);
+        handledNotification = notification;
+        handledShouldShowAlert = *shouldShowAlert;
+        [expectation fulfill];
+    };
+    UILocalNotification *const notification = MRTestNotification(@"launch", 60);
+    launchOptions = @{ UIApplicationLaunchOptionsLocalNotificationKey: notification };
+    XCTAssertEqual([MRLocalNotificationFacade deferHandlingOfNotificationFromLaunchOptions:launchOptions], notification);
+    XCTAssertNil(handledNotification);
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+    XCTAssertEqual(handledNotification, notification);
+    XCTAssertFalse(handledShouldShowAlert);
+    facade.onDidReceiveNotification = nil;
+    facade.defaultApplication = nil;
+}
+
+- (void)testStartupCostsAreRecordedOnFirstResolution
+{
+    MRLocalNotificationFacade *const facade = [[MRLocalNotificationFacade alloc] init];
+    facade.defaultApplication = (UIApplication *)self.application;
+    facade.instrumentationEnabled = YES;
+    NSDictionary *startupCosts = facade.metricsSnapshot[MRLocalNotificationMetricsStartupKey];
+    XCTAssertEqualObjects(startupCosts.allKeys, (@[ @"init" ]));
+    XCTAssertNotNil(facade.defaultTimeZone);
+    XCTAssertNotNil(facade.defaultCalendar);
+    dispatch_apply(8, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t const iteration) {
+        [facade hasRegisteredNotifications];
+        [facade isRegisteredForNotifications];
+    });
+    startupCosts = facade.metricsSnapshot[MRLocalNotificationMetricsStartupKey];
+    NSArray *const names = [startupCosts.allKeys sortedArrayUsingSelector:@selector(compare:)];
+    XCTAssertEqualObjects(names, (@[ @"defaultCalendar", @"defaultTimeZone", @"hasRegisteredNotifications",
+                                     @"init", @"settings" ]));
+    NSDictionary *const applicationCalls = facade.metricsSnapshot[MRLocalNotificationMetricsApplicationCallsKey];
+    XCTAssertEqual([applicationCalls[@"currentUserNotificationSettings"] integerValue], 1);
+    [facade isAlertTypeAllowed];
+    XCTAssertEqualObjects(facade.metricsSnapshot[MRLocalNotificationMetricsStartupKey], startupCosts);
+}
+
+
+#pragma mark Coalescing
+
+- (MRLocalNotificationCoalescer *)coalescerWithBatches:(NSMutableArray *const)handledBatches
+                                                timers:(NSMutableArray *const)timers
+{
+    MRLocalNotificationCoalescer *const coalescer =
+    [[MRLocalNotificationCoalescer alloc] initWithWindow:30 batchHandler:^(NSArray *const batches) {
+        [handledBatches addObject:batches];
+    }];
+    coalescer.scheduler = ^(NSTimeInterval const delay, dispatch_block_t const block) {
+        XCTAssertEqual(delay, 30);
+        [timers addObject:block];
+    };
+    return coalescer;
+}
+
+- (void)testCoalescerGroupsItemsByCategory
+{
+    NSMutableArray *const handledBatches = NSMutableArray.array;
+    NSMutableArray *const timers = NSMutableArray.array;
+    MRLocalNotificationCoalescer *const coalescer = [self coalescerWithBatches:handledBatches timers:timers];
+    [coalescer addItem:@"a" category:@"message"];
+    [coalescer addItem:@"b" category:@"reminder"];
+    [coalescer addItem:@"c" category:@"message"];
+    [coalescer addItem:@"d" category:nil];
+    XCTAssertEqual(coalescer.pendingCount, 4u);
+    XCTAssertEqual(timers.count, 1u);
+    XCTAssertEqual(handledBatches.count, 0u);
+    ((dispatch_block_t)timers[0])();
+    XCTAssertEqualObjects(handledBatches, (@[ @[ @[ @"a", @"c" ], @[ @"b" ], @[ @"d" ] ] ]));
+    XCTAssertEqual(coalescer.pendingCount, 0u);
+}
+
+- (void)testCoalescerOpensNewWindowAfterExpiry
+{
+    NSMutableArray *const handledBatches = NSMutableArray.array;
+    NSMutableArray *const timers = NSMutableArray.array;
+    MRLocalNotificationCoalescer *const coalescer = [self coalescerWithBatches:handledBatches timers:timers];
+    [coalescer addItem:@"a" category:@"message"];
+    ((dispatch_block_t)timers[0])();
+    [coalescer addItem:@"b" category:@"message"];
+    XCTAssertEqual(timers.count, 2u);
+    ((dispatch_block_t)timers[1])();
+    XCTAssertEqualObjects(handledBatches, (@[ @[ @[ @"a" ] ], @[ @[ @"b" ] ] ]));
+}
+
+- (void)testCoalescerFlushIgnoresStaleTimer
+{
+    NSMutableArray *const handledBatches = NSMutableArray.array;
+    NSMutableArray *const timers = NSMutableArray.array;
+    MRLocalNotificationCoalescer *const coalescer = [self coalescerWithBatches:handledBatches timers:timers];
+    [coalescer flush];
+    XCTAssertEqual(handledBatches.count, 0u);
+    [coalescer addItem:@"a" category:@"message"];
+    [coalescer flush];
+    XCTAssertEqualObjects(handledBatches, (@[ @[ @[ @"a" ] ] ]));
+    [coalescer addItem:@"b" category:@"message"];
+    XCTAssertEqual(timers.count, 2u);
+    // The timer of the flushed window must not close the window opened by "b".
+    ((dispatch_block_t)timers[0])();
+    XCTAssertEqual(handledBatches.count, 1u);
+    XCTAssertEqual(coalescer.pendingCount, 1u);
+    ((dispatch_block_t)timers[1])();
+    XCTAssertEqualObjects(handledBatches.lastObject, (@[ @[ @"b" ] ]));
+}
+
+- (void)receiveNotificationsForCoalescing
+{
+    NSArray *const categories = @[ @"message", @"reminder", @"message" ];
+    for (NSUInteger index = 0; index < categories.count; index++) {
+        NSString *const identifier = [NSString stringWithFormat:@"%lu", (unsigned long)index];
+        UILocalNotification *const notification = MRTestNotification(identifier, 60);
+        notification.category = categories[index];
+        [self.facade handleDidReceiveLocalNotification:notification];
+    }
+}
+
+- (void)testCoalescedNotificationsArePassedInBatches
+{
+    self.facade.notificationCoalescingWindow = 60;
+    NSMutableArray *const identifiers = NSMutableArray.array;
+    self.facade.onDidReceiveNotifications = ^(NSArray *const batches, BOOL *const shouldShowAlert) {
+        for (NSArray *const batch in batches) {
+            [identifiers addObject:[self identifiersOfNotifications:batch]];
+        }
+    };
+    [self receiveNotificationsForCoalescing];
+    XCTAssertEqual(identifiers.count, 0u);
+    // Changing the window closes the current one.
+    self.facade.notificationCoalescingWindow = 0;
+    XCTAssertEqualObjects(identifiers, (@[ @[ @"0", @"2" ], @[ @"1" ] ]));
+}
+
+- (void)testCoalescedNotificationsShowOneAlert
+{
+    MRTestAlertPresenter *const presenter = MRTestAlertPresenter.new;
+    self.facade.defaultAlertPresenter = presenter;
+    self.application.applicationState = UIApplicationStateActive;
+    self.facade.notificationCoalescingWindow = 60;
+    __block NSUInteger batchCount = 0;
+    self.facade.onDidReceiveNotifications = ^(NSArray *const batches, BOOL *const shouldShowAlert) {
+        XCTAssertTrue(*shouldShowAlert);
+        batchCount = batches.count;
+    };
+    [self receiveNotificationsForCoalescing];
+    self.facade.notificationCoalescingWindow = 0;
+    XCTAssertEqual(batchCount, 2u);
+    XCTAssertEqual(presenter.presentedAlerts.count, 1u);
+    self.facade.onDidReceiveNotifications = nil;
+    __block NSUInteger notificationCount = 0;
+    self.facade.onDidReceiveNotification = ^(UILocalNotification *const notification, BOOL *const shouldShowAlert) {
+        notificationCount += 1;
+    };
+    self.facade.notificationCoalescingWindow = 60;
+    [self receiveNotificationsForCoalescing];
+    self.facade.notificationCoalescingWindow = 0;
+    XCTAssertEqual(notificationCount, 3u);
+    XCTAssertEqual(presenter.presentedAlerts.count, 2u);
+}
+
+@end
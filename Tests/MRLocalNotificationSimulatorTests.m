@@ -0,0 +1,168 @@
+// MRLocalNotificationSimulatorTests.m
+//
+// Copyright (c) 2015 Héctor Marqués
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#import <XCTest/XCTest.h>
+#import "MRLocalNotificationFacade.h"
+#import "MRTestApplication.h"
+
+
+@interface MRLocalNotificationSimulatorTests : XCTestCase
+@property (nonatomic, strong) MRLocalNotificationFacade *facade;
+@property (nonatomic, strong) MRLocalNotificationSimulator *simulator;
+@property (nonatomic, strong) NSTimeZone *systemTimeZone;
+@end
+
+
+@implementation MRLocalNotificationSimulatorTests
+
+- (void)setUp
+{
+    [super setUp];
+    self.systemTimeZone = NSTimeZone.defaultTimeZone;
+    self.facade = MRTestFacadeWithApplication(MRTestApplication.new);
+    NSDate *const startDate = [NSDate dateWithTimeIntervalSinceReferenceDate:MRTestReferenceTime];
+    self.simulator = [[MRLocalNotificationSimulator alloc] initWithFacade:self.facade startDate:startDate];
+}
+
+- (void)tearDown
+{
+    [NSTimeZone setDefaultTimeZone:self.systemTimeZone];
+    self.simulator = nil;
+    self.facade = nil;
+    [super tearDown];
+}
+
+- (NSDate *)dateAfterReferenceTime:(NSTimeInterval const)delay
+{
+    return [NSDate dateWithTimeIntervalSinceReferenceDate:MRTestReferenceTime + delay];
+}
+
+#pragma mark Time zone changes
+
+- (void)testRunRestoresDefaultTimeZone
+{
+    NSTimeZone *const timeZone = [NSTimeZone timeZoneWithName:@"Asia/Tokyo"];
+    __block NSTimeZone *eventTimeZone;
+    [self.simulator addTimeZoneChangeAtDate:[self dateAfterReferenceTime:60] timeZone:timeZone];
+    [self.simulator addEventAtDate:[self dateAfterReferenceTime:120] block:^(MRLocalNotificationFacade *const facade) {
+        eventTimeZone = NSTimeZone.defaultTimeZone;
+    }];
+    [self.simulator runUntilDate:[self dateAfterReferenceTime:180]];
+    XCTAssertEqualObjects(eventTimeZone, timeZone);
+    XCTAssertEqualObjects(NSTimeZone.defaultTimeZone, self.systemTimeZone);
+}
+
+- (void)testRunRestoresDefaultTimeZoneWhenAnEventRaises
+{
+    NSTimeZone *const timeZone = [NSTimeZone timeZoneWithName:@"Asia/Tokyo"];
+    [self.simulator addTimeZoneChangeAtDate:[self dateAfterReferenceTime:60] timeZone:timeZone];
+    [self.simulator addEventAtDate:[self dateAfterReferenceTime:120] block:^(MRLocalNotificationFacade *const facade) {
+        [NSException raise:NSInternalInconsistencyException format:@"event failed"];
+    }];
+    XCTAssertThrows([self.simulator runUntilDate:[self dateAfterReferenceTime:180]]);
+    XCTAssertEqualObjects(NSTimeZone.defaultTimeZone, self.systemTimeZone);
+}
+
+- (void)testTimeZoneIsAppliedAgainOnLaterRuns
+{
+    NSTimeZone *const timeZone = [NSTimeZone timeZoneWithName:@"Asia/Tokyo"];
+    __block NSTimeZone *eventTimeZone;
+    [self.simulator addTimeZoneChangeAtDate:[self dateAfterReferenceTime:60] timeZone:timeZone];
+    [self.simulator addEventAtDate:[self dateAfterReferenceTime:240] block:^(MRLocalNotificationFacade *const facade) {
+        eventTimeZone = NSTimeZone.defaultTimeZone;
+    }];
+    [self.simulator runUntilDate:[self dateAfterReferenceTime:120]];
+    XCTAssertEqualObjects(NSTimeZone.defaultTimeZone, self.systemTimeZone);
+    [self.simulator runUntilDate:[self dateAfterReferenceTime:300]];
+    XCTAssertEqualObjects(eventTimeZone, timeZone);
+    XCTAssertEqualObjects(NSTimeZone.defaultTimeZone, self.systemTimeZone);
+}
+
+- (void)testFloatingNotificationFollowsTimeZoneChange
+{
+    NSTimeZone *const madridTimeZone = [NSTimeZone timeZoneWithName:@"Europe/Madrid"];
+    NSTimeZone *const newYorkTimeZone = [NSTimeZone timeZoneWithName:@"America/New_York"];
+    NSMutableDictionary *const deliveryDates = NSMutableDictionary.dictionary;
+    __weak MRLocalNotificationSimulator *const simulator = self.simulator;
+    self.facade.onDidReceiveNotification = ^(UILocalNotification *const notification, BOOL *const shouldShowAlert) {
+        deliveryDates[notification.userInfo[MRLocalNotificationIdentifierKey]] = simulator.currentDate;
+    };
+    [self.simulator addTimeZoneChangeAtDate:[self dateAfterReferenceTime:0] timeZone:madridTimeZone];
+    [self.simulator addEventAtDate:[self dateAfterReferenceTime:0] block:^(MRLocalNotificationFacade *const facade) {
+        // 03:00 in Madrid (UTC+1) is 02:00 GMT; 03:00 in New York (UTC-5) is 08:00 GMT.
+        UILocalNotification *const floatingNotification = MRTestNotification(@"floating", 3*3600);
+        floatingNotification.timeZone = madridTimeZone;
+        [facade scheduleNotification:floatingNotification withError:NULL];
+        [facade scheduleNotification:MRTestNotification(@"fixed", 3*3600) withError:NULL];
+    }];
+    [self.simulator addTimeZoneChangeAtDate:[self dateAfterReferenceTime:3600] timeZone:newYorkTimeZone];
+    [self.simulator runUntilDate:[self dateAfterReferenceTime:86400]];
+    XCTAssertEqualObjects(deliveryDates[@"fixed"], [self dateAfterReferenceTime:3*3600]);
+    XCTAssertEqualObjects(deliveryDates[@"floating"], [self dateAfterReferenceTime:8*3600]);
+}
+
+#pragma mark Deliveries
+
+- (void)testDeliversScheduledNotifications
+{
+    [self.simulator addEventAtDate:[self dateAfterReferenceTime:0] block:^(MRLocalNotificationFacade *const facade) {
+        for (NSUInteger index = 0; index < 3; index++) {
+            NSString *const identifier = [NSString stringWithFormat:@"%lu", (unsigned long)index];
+            [facade scheduleNotification:MRTestNotification(identifier, 60*(index + 1)) withError:NULL];
+        }
+    }];
+    NSDictionary *const report = [self.simulator runUntilDate:[self dateAfterReferenceTime:3600]];
+    XCTAssertEqualObjects(report[MRLocalNotificationSimulationEventsKey], @1);
+    XCTAssertEqualObjects(report[MRLocalNotificationSimulationDeliveredKey], @3);
+    XCTAssertEqualObjects(report[MRLocalNotificationSimulationDroppedKey], @0);
+    XCTAssertEqual(self.simulator.pendingNotifications.count, 0u);
+    XCTAssertEqualObjects(self.simulator.currentDate, [self dateAfterReferenceTime:3600]);
+}
+
+- (void)testDeliversRepeatingNotificationOnEveryOccurrence
+{
+    [self.simulator addEventAtDate:[self dateAfterReferenceTime:0] block:^(MRLocalNotificationFacade *const facade) {
+        UILocalNotification *const notification = MRTestNotification(@"daily", 60);
+        notification.repeatInterval = NSCalendarUnitDay;
+        [facade scheduleNotification:notification withError:NULL];
+    }];
+    NSDictionary *const report = [self.simulator runUntilDate:[self dateAfterReferenceTime:3*86400]];
+    XCTAssertEqualObjects(report[MRLocalNotificationSimulationDeliveredKey], @3);
+    XCTAssertEqual(self.simulator.pendingNotifications.count, 1u);
+}
+
+- (void)testDropsNotificationsOverTheLimit
+{
+    self.simulator.maximumPendingNotifications = 2;
+    [self.simulator addEventAtDate:[self dateAfterReferenceTime:0] block:^(MRLocalNotificationFacade *const facade) {
+        for (NSUInteger index = 0; index < 3; index++) {
+            NSString *const identifier = [NSString stringWithFormat:@"%lu", (unsigned long)index];
+            [facade scheduleNotification:MRTestNotification(identifier, 60*(index + 1)) withError:NULL];
+        }
+    }];
+    NSDictionary *const report = [self.simulator runUntilDate:[self dateAfterReferenceTime:30]];
+    XCTAssertEqualObjects(report[MRLocalNotificationSimulationDroppedKey], @1);
+    XCTAssertEqual(self.simulator.pendingNotifications.count, 2u);
+}
+
+@end
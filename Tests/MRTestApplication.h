@@ -0,0 +1,129 @@
+// MRTestApplication.h
+//
+// Copyright (c) 2015 Héctor Marqués
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#import <UIKit/UIKit.h>
+
+@class MRLocalNotificationFacade;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ 2030-01-01 00:00:00 GMT, the time returned by the clock of the facades built with `MRTestFacadeWithApplication`.
+ */
+extern NSTimeInterval const MRTestReferenceTime;
+
+/**
+ Stand-in for `UIApplication` to be injected through `MRLocalNotificationFacade.defaultApplication`.
+
+ It keeps the pending notifications in memory and counts the calls made by the facade. Like the system does, notifications that do not repeat are no longer pending once `now` reaches their fire date.
+ */
+@interface MRTestApplication : NSObject
+
+/**
+ The maximum number of pending notifications. Like the system does, the notifications that fire last are dropped when the limit is exceeded. `0` means no limit.
+ */
+@property (nonatomic, assign) NSUInteger maximumScheduledNotifications;
+
+/**
+ Time spent by each `scheduledLocalNotifications` call, simulating the round trip to the system.
+ */
+@property (nonatomic, assign) NSTimeInterval fetchLatency;
+
+/**
+ The notification types returned in `currentUserNotificationSettings`. Defaults to alerts, badges and sounds.
+ */
+@property (nonatomic, assign) UIUserNotificationType allowedTypes;
+
+/**
+ The current time, in seconds since the reference date. Defaults to `MRTestReferenceTime`.
+ */
+@property (nonatomic, assign) NSTimeInterval now;
+
+@property (nonatomic, readonly) NSArray *scheduledLocalNotifications;
+@property (nonatomic, readonly) NSArray *presentedLocalNotifications;
+@property (nullable, nonatomic, readonly) UIUserNotificationSettings *currentUserNotificationSettings;
+@property (nonatomic, assign) UIApplicationState applicationState;
+@property (nullable, nonatomic, readonly) UIWindow *keyWindow;
+@property (nonatomic, assign) NSInteger applicationIconBadgeNumber;
+
+/**
+ Number of `scheduledLocalNotifications` calls.
+ */
+@property (nonatomic, readonly) NSUInteger fetchCount;
+
+/**
+ Number of `scheduleLocalNotification:` calls.
+ */
+@property (nonatomic, readonly) NSUInteger scheduleCount;
+
+/**
+ Number of `cancelLocalNotification:` calls.
+ */
+@property (nonatomic, readonly) NSUInteger cancelCount;
+
+/**
+ Number of notifications dropped because of `maximumScheduledNotifications`.
+ */
+@property (nonatomic, readonly) NSUInteger droppedCount;
+
+/**
+ Number of `canOpenURL:` calls.
+ */
+@property (nonatomic, readonly) NSUInteger canOpenURLCount;
+
+- (void)scheduleLocalNotification:(UILocalNotification *)notification;
+- (void)cancelLocalNotification:(UILocalNotification *)notification;
+- (void)cancelAllLocalNotifications;
+- (void)presentLocalNotificationNow:(UILocalNotification *)notification;
+- (void)registerUserNotificationSettings:(UIUserNotificationSettings *)settings;
+- (BOOL)canOpenURL:(NSURL *)url;
+- (BOOL)openURL:(NSURL *)url;
+
+/**
+ Adds `count` pending notifications without going through the facade, as if they were scheduled by a previous run.
+
+ @param count The number of notifications.
+ @param identifiers Whether the notifications carry an identifier in `userInfo` or not.
+ */
+- (void)addScheduledNotificationsWithCount:(NSUInteger)count identifiers:(BOOL)identifiers;
+
+/**
+ Sets all the call counters to zero.
+ */
+- (void)resetCounters;
+
+@end
+
+/**
+ Returns a new facade using `application` as `defaultApplication`, `application.now` as clock and a fixed time zone.
+ */
+extern MRLocalNotificationFacade *MRTestFacadeWithApplication(MRTestApplication *application);
+
+/**
+ Returns a valid notification firing `delay` seconds after `MRTestReferenceTime`.
+
+ @param identifier The value for `MRLocalNotificationIdentifierKey` in `userInfo`, if any.
+ @param delay Seconds after `MRTestReferenceTime`.
+ */
+extern UILocalNotification *MRTestNotification(NSString *_Nullable identifier, NSTimeInterval delay);
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,203 @@
+// MRTestApplication.m
+//
+// Copyright (c) 2015 Héctor Marqués
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#import "MRTestApplication.h"
+#import "MRLocalNotificationFacade.h"
+
+
+NSTimeInterval const MRTestReferenceTime = 915148800;
+
+
+#pragma mark - MRTestApplication -
+
+
+@implementation MRTestApplication {
+    NSMutableArray *_notifications;
+    NSMutableArray *_presentedNotifications;
+    NSSet *_categories;
+}
+
+- (NSArray *)scheduledLocalNotifications
+{
+    _fetchCount += 1;
+    [self mr_removeDeliveredNotifications];
+    if (self.fetchLatency > 0) {
+        [NSThread sleepForTimeInterval:self.fetchLatency];
+    }
+    // The system returns new objects on every call.
+    NSMutableArray *const notifications = [NSMutableArray arrayWithCapacity:_notifications.count];
+    for (UILocalNotification *const notification in _notifications) {
+        [notifications addObject:notification.copy];
+    }
+    return notifications;
+}
+
+- (NSArray *)presentedLocalNotifications
+{
+    return _presentedNotifications.copy;
+}
+
+- (UIUserNotificationSettings *)currentUserNotificationSettings
+{
+    return [UIUserNotificationSettings settingsForTypes:self.allowedTypes categories:_categories];
+}
+
+- (UIWindow *)keyWindow
+{
+    return nil;
+}
+
+- (void)scheduleLocalNotification:(UILocalNotification *const)notification
+{
+    NSParameterAssert(notification);
+    _scheduleCount += 1;
+    [self mr_removeDeliveredNotifications];
+    [_notifications addObject:notification.copy];
+    NSUInteger const maximumScheduledNotifications = self.maximumScheduledNotifications;
+    if (maximumScheduledNotifications > 0 && _notifications.count > maximumScheduledNotifications) {
+        // Notifications without fire date are region-triggered and never dropped.
+        UILocalNotification *lastNotification;
+        for (UILocalNotification *const candidate in _notifications) {
+            NSDate *const fireDate = candidate.fireDate;
+            if (fireDate && (lastNotification == nil || [fireDate compare:lastNotification.fireDate] != NSOrderedAscending)) {
+                lastNotification = candidate;
+            }
+        }
+        [_notifications removeObjectIdenticalTo:(lastNotification ?: _notifications.lastObject)];
+        _droppedCount += 1;
+    }
+}
+
+- (void)cancelLocalNotification:(UILocalNotification *const)notification
+{
+    _cancelCount += 1;
+    NSUInteger const index = [_notifications indexOfObject:notification];
+    if (index != NSNotFound) {
+        [_notifications removeObjectAtIndex:index];
+    }
+}
+
+- (void)cancelAllLocalNotifications
+{
+    [_notifications removeAllObjects];
+}
+
+- (void)presentLocalNotificationNow:(UILocalNotification *const)notification
+{
+    [_presentedNotifications addObject:notification.copy];
+}
+
+- (void)registerUserNotificationSettings:(UIUserNotificationSettings *const)settings
+{
+    _categories = settings.categories;
+}
+
+- (BOOL)canOpenURL:(NSURL *const)url
+{
+    _canOpenURLCount += 1;
+    return NO;
+}
+
+- (BOOL)openURL:(NSURL *const)url
+{
+    return NO;
+}
+
+- (void)addScheduledNotificationsWithCount:(NSUInteger const)count identifiers:(BOOL const)identifiers
+{
+    NSUInteger const offset = _notifications.count;
+    for (NSUInteger index = 0; index < count; index++) {
+        NSString *const identifier = (identifiers
+                                      ? [NSString stringWithFormat:@"existing-%lu", (unsigned long)(offset + index)]
+                                      : nil);
+        [_notifications addObject:MRTestNotification(identifier, 3600 + offset + index)];
+    }
+}
+
+- (void)resetCounters
+{
+    _fetchCount = 0;
+    _scheduleCount = 0;
+    _cancelCount = 0;
+    _droppedCount = 0;
+    _canOpenURLCount = 0;
+}
+
+#pragma mark Private
+
+- (void)mr_removeDeliveredNotifications
+{
+    NSIndexSet *const indexes = [_notifications indexesOfObjectsPassingTest:^BOOL(UILocalNotification *const notification, NSUInteger const index, BOOL *const stop) {
+        return (notification.repeatInterval == 0 &&
+                notification.fireDate &&
+                notification.fireDate.timeIntervalSinceReferenceDate <= self.now);
+    }];
+    [_notifications removeObjectsAtIndexes:indexes];
+}
+
+#pragma mark - NSObject
+
+- (instancetype)init
+{
+    self = [super init];
+    if (self) {
+        _notifications = NSMutableArray.array;
+        _presentedNotifications = NSMutableArray.array;
+        _allowedTypes = (UIUserNotificationTypeAlert |
+                         UIUserNotificationTypeBadge |
+                         UIUserNotificationTypeSound);
+        _applicationState = UIApplicationStateBackground;
+        _now = MRTestReferenceTime;
+    }
+    return self;
+}
+
+@end
+
+
+#pragma mark - Functions -
+
+
+MRLocalNotificationFacade *MRTestFacadeWithApplication(MRTestApplication *const application)
+{
+    NSCParameterAssert(application);
+    MRLocalNotificationFacade *const facade = [[MRLocalNotificationFacade alloc] init];
+    facade.defaultApplication = (UIApplication *)application;
+    facade.defaultTimeZone = [NSTimeZone timeZoneWithName:@"Europe/Madrid"];
+    __weak MRTestApplication *const weakApplication = application;
+    facade.clock = ^NSTimeInterval{
+        MRTestApplication *const strongApplication = weakApplication;
+        return (strongApplication ? strongApplication.now : MRTestReferenceTime);
+    };
+    return facade;
+}
+
+UILocalNotification *MRTestNotification(NSString *const identifier, NSTimeInterval const delay)
+{
+    UILocalNotification *const notification = [[UILocalNotification alloc] init];
+    notification.fireDate = [NSDate dateWithTimeIntervalSinceReferenceDate:MRTestReferenceTime + delay];
+    notification.alertBody = [NSString stringWithFormat:@"fires %.0f seconds after the reference time", delay];
+    if (identifier) {
+        notification.userInfo = @{ MRLocalNotificationIdentifierKey: identifier };
+    }
+    return notification;
+}